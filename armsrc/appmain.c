@@ -67,6 +67,7 @@
 #include "sam_picopass.h"
 #include "sam_seos.h"
 #include "sam_mfc.h"
+#include "lz4chunk.h"
 
 #ifdef WITH_LCD
 #include "LCD_disabled.h"
@@ -511,8 +512,22 @@ static void SendStatus(uint32_t wait) {
     reply_ng(CMD_STATUS, PM3_SUCCESS, NULL, 0);
 }
 
+// Sends len bytes from mem as LZ4 compressed chunks, in MIX frames
+// arg0 = offset of the chunk, arg1 = bytes it stands for, arg2 as given
+static void SendCompressed(uint16_t cmd, const uint8_t *mem, uint32_t len, uint32_t arg2) {
+    uint8_t payload[LZ4CHUNK_PAYLOAD_SIZE];
+    for (uint32_t offset = 0; offset < len;) {
+        int rawlen = 0;
+        int n = lz4chunk_pack(mem + offset, len - offset, payload, sizeof(payload), &rawlen);
+        int result = reply_mix(cmd, offset, rawlen, arg2, payload, n);
+        if (result != PM3_SUCCESS)
+            Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", offset, offset + rawlen, n, result);
+        offset += rawlen;
+    }
+}
+
 static void SendCapabilities(void) {
-    capabilities_t capabilities;
+    capabilities_t capabilities = {0};
     capabilities.version = CAPABILITIES_VERSION;
     capabilities.via_fpc = g_reply_via_fpc;
     capabilities.via_usb = g_reply_via_usb;
@@ -637,6 +652,10 @@ static void SendCapabilities(void) {
     capabilities.compiled_with_zx8211 = false;
 #endif
 
+    capabilities.tagged_frames = true;
+    capabilities.compressed_download = true;
+    capabilities.coalesced_frames = true;
+
     reply_ng(CMD_CAPABILITIES, PM3_SUCCESS, (uint8_t *)&capabilities, sizeof(capabilities));
 }
 
@@ -2570,14 +2589,18 @@ static void PacketReceived(PacketCommandNG *packet) {
 
             // arg0 = startindex
             // arg1 = length bytes to transfer
-            // arg2 = BigBuf tracelen
+            // arg2 = flags, DOWNLOAD_FLAG_LZ4
             //Dbprintf("transfer to client parameters: %" PRIu32 " | %" PRIu32 " | %" PRIu32, startidx, numofbytes, packet->oldarg[2]);
 
-            for (size_t offset = 0; offset < numofbytes; offset += PM3_CMD_DATA_SIZE) {
-                size_t len = MIN((numofbytes - offset), PM3_CMD_DATA_SIZE);
-                int result = reply_old(CMD_DOWNLOADED_BIGBUF, offset, len, BigBuf_get_traceLen(), &mem[startidx + offset], len);
-                if (result != PM3_SUCCESS)
-                    Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", offset, offset + len, len, result);
+            if ((packet->oldarg[2] & DOWNLOAD_FLAG_LZ4) == DOWNLOAD_FLAG_LZ4) {
+                SendCompressed(CMD_DOWNLOADED_BIGBUF, &mem[startidx], numofbytes, BigBuf_get_traceLen());
+            } else {
+                for (size_t offset = 0; offset < numofbytes; offset += PM3_CMD_DATA_SIZE) {
+                    size_t len = MIN((numofbytes - offset), PM3_CMD_DATA_SIZE);
+                    int result = reply_old(CMD_DOWNLOADED_BIGBUF, offset, len, BigBuf_get_traceLen(), &mem[startidx + offset], len);
+                    if (result != PM3_SUCCESS)
+                        Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", offset, offset + len, len, result);
+                }
             }
             // Trigger a finish downloading signal with an ACK frame
             // arg0 = status of download transfer
@@ -2629,13 +2652,17 @@ static void PacketReceived(PacketCommandNG *packet) {
 
             // arg0 = startindex
             // arg1 = length bytes to transfer
-            // arg2 = RFU
+            // arg2 = flags, DOWNLOAD_FLAG_LZ4
 
-            for (size_t i = 0; i < numofbytes; i += PM3_CMD_DATA_SIZE) {
-                size_t len = MIN((numofbytes - i), PM3_CMD_DATA_SIZE);
-                int result = reply_old(CMD_DOWNLOADED_EML_BIGBUF, i, len, 0, mem + startidx + i, len);
-                if (result != PM3_SUCCESS)
-                    Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", i, i + len, len, result);
+            if ((packet->oldarg[2] & DOWNLOAD_FLAG_LZ4) == DOWNLOAD_FLAG_LZ4) {
+                SendCompressed(CMD_DOWNLOADED_EML_BIGBUF, mem + startidx, numofbytes, 0);
+            } else {
+                for (size_t i = 0; i < numofbytes; i += PM3_CMD_DATA_SIZE) {
+                    size_t len = MIN((numofbytes - i), PM3_CMD_DATA_SIZE);
+                    int result = reply_old(CMD_DOWNLOADED_EML_BIGBUF, i, len, 0, mem + startidx + i, len);
+                    if (result != PM3_SUCCESS)
+                        Dbprintf("transfer to client failed ::  | bytes between %d - %d (%d) | result: %d", i, i + len, len, result);
+                }
             }
             // Trigger a finish downloading signal with an ACK frame
             reply_mix(CMD_ACK, 1, 0, 0, 0, 0);
@@ -3223,6 +3250,8 @@ void  __attribute__((noreturn)) AppMain(void) {
         int ret = receive_ng(&rx);
         if (ret == PM3_SUCCESS) {
             PacketReceived(&rx);
+            // what is sent from now on doesn't answer that command
+            g_reply_seq = 0;
         } else if (ret != PM3_ENODATA) {
 
             Dbprintf("Error in frame reception: %d %s", ret, (ret == PM3_EIO) ? "PM3_EIO" : "");
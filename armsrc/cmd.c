@@ -26,6 +26,8 @@ bool g_reply_with_crc_on_fpc = true;
 // "Session" flag, to tell via which interface next msgs should be sent: USB or FPC USART
 bool g_reply_via_fpc = false;
 bool g_reply_via_usb = false;
+// Tag of the tagged NG command being answered, 0 when replies go out untagged
+uint16_t g_reply_seq = 0;
 
 int reply_old(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len) {
     PacketResponseOLD txcmd = {CMD_UNKNOWN, {0, 0, 0}, {{0}}};
@@ -73,11 +75,14 @@ int reply_old(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const v
 }
 
 static int reply_ng_internal(uint16_t cmd, int8_t status, uint8_t reason, const uint8_t *data, size_t len, bool ng) {
-    PacketResponseNGRaw txBufferNG;
+    PacketResponseNGTaggedRaw txBufferNG;
     size_t txBufferNGLen;
 
+    // replies to a tagged command carry its tag
+    size_t taglen = (g_reply_seq) ? PM3_NG_TAG_SIZE : 0;
+
     // Compose the outgoing command frame
-    txBufferNG.pre.magic = RESPONSENG_PREAMBLE_MAGIC;
+    txBufferNG.pre.magic = (taglen) ? RESPONSENG_TAGGED_MAGIC : RESPONSENG_PREAMBLE_MAGIC;
     txBufferNG.pre.cmd = cmd;
     txBufferNG.pre.status = status;
     txBufferNG.pre.reason = reason;
@@ -91,22 +96,26 @@ static int reply_ng_internal(uint16_t cmd, int8_t status, uint8_t reason, const
     // length is only 15bit (32768)
     txBufferNG.pre.length = (len & 0x7FFF);
 
+    if (taglen) {
+        memcpy(txBufferNG.body, &g_reply_seq, taglen);
+    }
+
     // Add the (optional) content to the frame, with a maximum size of PM3_CMD_DATA_SIZE
     if (data && len) {
-        memcpy(txBufferNG.data, data, len);
+        memcpy(txBufferNG.body + taglen, data, len);
     }
 
-    PacketResponseNGPostamble *tx_post = (PacketResponseNGPostamble *)((uint8_t *)&txBufferNG + sizeof(PacketResponseNGPreamble) + len);
+    PacketResponseNGPostamble *tx_post = (PacketResponseNGPostamble *)(txBufferNG.body + taglen + len);
 
     // Note: if we send to both FPC & USB, we'll set CRC for both if any of them require CRC
     if ((g_reply_via_fpc && g_reply_with_crc_on_fpc) || ((g_reply_via_usb) && g_reply_with_crc_on_usb)) {
         uint8_t first, second;
-        compute_crc(CRC_14443_A, (uint8_t *)&txBufferNG, sizeof(PacketResponseNGPreamble) + len, &first, &second);
+        compute_crc(CRC_14443_A, (uint8_t *)&txBufferNG, sizeof(PacketResponseNGPreamble) + taglen + len, &first, &second);
         tx_post->crc = ((first << 8) | second);
     } else {
         tx_post->crc = RESPONSENG_POSTAMBLE_MAGIC;
     }
-    txBufferNGLen = sizeof(PacketResponseNGPreamble) + len + sizeof(PacketResponseNGPostamble);
+    txBufferNGLen = sizeof(PacketResponseNGPreamble) + taglen + len + sizeof(PacketResponseNGPostamble);
 
 #ifdef WITH_FPC_USART_HOST
     int resultfpc = PM3_EUNDEF;
@@ -163,7 +172,7 @@ int reply_reason(uint16_t cmd, int8_t status, int8_t reason, const uint8_t *data
 
 static int receive_ng_internal(PacketCommandNG *rx, uint32_t read_ng(uint8_t *data, size_t len), bool usb, bool fpc) {
 
-    PacketCommandNGRaw rx_raw;
+    PacketCommandNGTaggedRaw rx_raw;
     size_t bytes = read_ng((uint8_t *)&rx_raw.pre, sizeof(PacketCommandNGPreamble));
 
     if (bytes == 0) {
@@ -177,22 +186,31 @@ static int receive_ng_internal(PacketCommandNG *rx, uint32_t read_ng(uint8_t *da
     rx->magic = rx_raw.pre.magic;
     rx->ng = rx_raw.pre.ng;
     rx->cmd = rx_raw.pre.cmd;
+    rx->seq = 0;
 
     uint16_t length = rx_raw.pre.length;
 
-    if (rx->magic == COMMANDNG_PREAMBLE_MAGIC) { // New style NG command
+    if (rx->magic == COMMANDNG_PREAMBLE_MAGIC || rx->magic == COMMANDNG_TAGGED_MAGIC) { // New style NG command
         if (length > PM3_CMD_DATA_SIZE) {
             return PM3_EOVFLOW;
         }
 
+        // a tagged command has its tag in front of the payload
+        size_t taglen = (rx->magic == COMMANDNG_TAGGED_MAGIC) ? PM3_NG_TAG_SIZE : 0;
+
         // Get the core and variable length payload
-        bytes = read_ng((uint8_t *)&rx_raw.data, length);
-        if (bytes != length) {
+        bytes = read_ng(rx_raw.body, taglen + length);
+        if (bytes != taglen + length) {
             return PM3_EIO;
         }
 
+        if (taglen) {
+            memcpy(&rx->seq, rx_raw.body, taglen);
+        }
+        const uint8_t *payload = rx_raw.body + taglen;
+
         if (rx->ng) {
-            memcpy(rx->data.asBytes, rx_raw.data, length);
+            memcpy(rx->data.asBytes, payload, length);
             rx->length = length;
         } else {
             uint64_t arg[3] = {0};
@@ -200,25 +218,26 @@ static int receive_ng_internal(PacketCommandNG *rx, uint32_t read_ng(uint8_t *da
                 return PM3_EIO;
             }
 
-            memcpy(arg, rx_raw.data, sizeof(arg));
+            memcpy(arg, payload, sizeof(arg));
             rx->oldarg[0] = arg[0];
             rx->oldarg[1] = arg[1];
             rx->oldarg[2] = arg[2];
-            memcpy(rx->data.asBytes, rx_raw.data + sizeof(arg), length - sizeof(arg));
+            memcpy(rx->data.asBytes, payload + sizeof(arg), length - sizeof(arg));
             rx->length = length - sizeof(arg);
         }
 
         // Get the postamble
-        bytes = read_ng((uint8_t *)&rx_raw.foopost, sizeof(PacketCommandNGPostamble));
+        PacketCommandNGPostamble post;
+        bytes = read_ng((uint8_t *)&post, sizeof(PacketCommandNGPostamble));
         if (bytes != sizeof(PacketCommandNGPostamble)) {
             return PM3_EIO;
         }
 
         // Check CRC, accept MAGIC as placeholder
-        rx->crc = rx_raw.foopost.crc;
+        rx->crc = post.crc;
         if (rx->crc != COMMANDNG_POSTAMBLE_MAGIC) {
             uint8_t first, second;
-            compute_crc(CRC_14443_A, (uint8_t *)&rx_raw, sizeof(PacketCommandNGPreamble) + length, &first, &second);
+            compute_crc(CRC_14443_A, (uint8_t *)&rx_raw, sizeof(PacketCommandNGPreamble) + taglen + length, &first, &second);
             if ((first << 8) + second != rx->crc) {
                 return PM3_EIO;
             }
@@ -226,6 +245,7 @@ static int receive_ng_internal(PacketCommandNG *rx, uint32_t read_ng(uint8_t *da
 
         g_reply_via_usb = usb;
         g_reply_via_fpc = fpc;
+        g_reply_seq = rx->seq;
 
     } else {                               // Old style command
         PacketCommandOLD rx_old;
@@ -237,6 +257,7 @@ static int receive_ng_internal(PacketCommandNG *rx, uint32_t read_ng(uint8_t *da
 
         g_reply_via_usb = usb;
         g_reply_via_fpc = fpc;
+        g_reply_seq = 0;
         rx->ng = false;
         rx->magic = 0;
         rx->crc = 0;
@@ -252,8 +273,8 @@ static int receive_ng_internal(PacketCommandNG *rx, uint32_t read_ng(uint8_t *da
 
 int receive_ng(PacketCommandNG *rx) {
 
-    // Check if there is a packet available
-    if (usb_poll_validate_length()) {
+    // Check if there is a packet available, a USB packet may carry several frames
+    if (usb_read_ng_has_buffered_data() || usb_poll_validate_length()) {
         return receive_ng_internal(rx, usb_read_ng, true, false);
     }
 
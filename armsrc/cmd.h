@@ -26,6 +26,8 @@ extern bool g_reply_with_crc_on_fpc;
 // "Session" flag, to tell via which interface next msgs should be sent: USB and/or FPC USART
 extern bool g_reply_via_fpc;
 extern bool g_reply_via_usb;
+// Tag of the tagged NG command being answered, 0 when replies go out untagged
+extern uint16_t g_reply_seq;
 
 int reply_old(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len);
 int reply_ng(uint16_t cmd, int8_t status, const uint8_t *data, size_t len);
@@ -346,11 +346,12 @@ int BUTTON_HELD(int ms) {
 
 // This function returns false if no data is available or
 // the USB connection is invalid.
+// Frames left over from a USB packet which carried several count as available.
 bool data_available(void) {
 #ifdef WITH_FPC_USART_HOST
-    return usb_poll_validate_length() || (usart_rxdata_available() > 0);
+    return usb_read_ng_has_buffered_data() || usb_poll_validate_length() || (usart_rxdata_available() > 0);
 #else
-    return usb_poll_validate_length();
+    return usb_read_ng_has_buffered_data() || usb_poll_validate_length();
 #endif
 }
 
@@ -359,9 +360,9 @@ bool data_available(void) {
 // the timing is critical.
 bool data_available_fast(void) {
 #ifdef WITH_FPC_USART_HOST
-    return usb_available_length() || (usart_rxdata_available() > 0);
+    return usb_read_ng_has_buffered_data() || usb_available_length() || (usart_rxdata_available() > 0);
 #else
-    return usb_available_length();
+    return usb_read_ng_has_buffered_data() || usb_available_length();
 #endif
 }
 
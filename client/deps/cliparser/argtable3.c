@@ -165,6 +165,74 @@ void dbg_printf(const char *fmt, ...) {
     va_end(args);
 }
 
+/*
+ * Scratch memory for the argument structs.
+ *
+ * The client builds a fresh argtable for every command it runs and frees it
+ * again right after. Those blocks come from a per thread stack instead of
+ * the heap: freeing marks a block, the stack shrinks once its topmost blocks
+ * are all marked. Anything which doesn't fit goes to malloc as before.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#define ARG_SCRATCH_SIZE    (32 * 1024)
+#define ARG_SCRATCH_HDR     16
+#define ARG_SCRATCH_NONE    ((size_t) -1)
+
+typedef struct {
+    size_t prev;        /* offset of the block below */
+    size_t freed;
+} arg_scratch_hdr_t;
+
+static __thread unsigned char *arg_scratch = NULL;
+static __thread size_t arg_scratch_top = 0;
+static __thread size_t arg_scratch_last = ARG_SCRATCH_NONE;
+
+static void *arg_malloc(size_t size) {
+    size_t need = ARG_SCRATCH_HDR + ((size + 15) & ~(size_t)15);
+
+    if (arg_scratch == NULL) {
+        arg_scratch = (unsigned char *)malloc(ARG_SCRATCH_SIZE);
+    }
+    if (arg_scratch == NULL || arg_scratch_top + need > ARG_SCRATCH_SIZE) {
+        return malloc(size);
+    }
+
+    arg_scratch_hdr_t *hdr = (arg_scratch_hdr_t *)(arg_scratch + arg_scratch_top);
+    hdr->prev = arg_scratch_last;
+    hdr->freed = 0;
+    arg_scratch_last = arg_scratch_top;
+    arg_scratch_top += need;
+    return (unsigned char *)hdr + ARG_SCRATCH_HDR;
+}
+
+static void *arg_calloc(size_t nmemb, size_t size) {
+    void *p = arg_malloc(nmemb * size);
+    if (p != NULL) {
+        memset(p, 0, nmemb * size);
+    }
+    return p;
+}
+
+static void arg_mfree(void *p) {
+    unsigned char *c = (unsigned char *)p;
+    if (arg_scratch == NULL || c < arg_scratch || c >= arg_scratch + ARG_SCRATCH_SIZE) {
+        free(p);
+        return;
+    }
+
+    ((arg_scratch_hdr_t *)(c - ARG_SCRATCH_HDR))->freed = 1;
+    while (arg_scratch_last != ARG_SCRATCH_NONE) {
+        arg_scratch_hdr_t *hdr = (arg_scratch_hdr_t *)(arg_scratch + arg_scratch_last);
+        if (hdr->freed == 0) {
+            break;
+        }
+        arg_scratch_top = arg_scratch_last;
+        arg_scratch_last = hdr->prev;
+    }
+}
+
 #include "getopt.h"
 
 /* $Id: getopt_long.c,v 1.1 2009/10/16 19:50:28 rodney Exp rodney $ */
@@ -900,7 +968,7 @@ struct arg_date *arg_daten(
 
     /* allocate storage for the arg_date struct + tmval[] array.    */
     /* we use calloc because we want the tmval[] array zero filled. */
-    result = (struct arg_date *)calloc(1, nbytes);
+    result = (struct arg_date *)arg_calloc(1, nbytes);
     if (result) {
         /* init the arg_hdr struct */
         result->hdr.flag      = ARG_HASVALUE;
@@ -1496,7 +1564,7 @@ struct arg_dbl *arg_dbln(
     nbytes = sizeof(struct arg_dbl)     /* storage for struct arg_dbl */
              + (maxcount + 1) * sizeof(double); /* storage for dval[maxcount] array plus one extra for padding to memory boundary */
 
-    result = (struct arg_dbl *)malloc(nbytes);
+    result = (struct arg_dbl *)arg_malloc(nbytes);
     if (result) {
         size_t addr;
         size_t rem;
@@ -1618,7 +1686,7 @@ struct arg_end *arg_end(int maxcount) {
              + maxcount * sizeof(void *)  /* storage for void* parent[maxcount] array */
              + maxcount * sizeof(char *); /* storage for char* argval[maxcount] array */
 
-    result = (struct arg_end *)malloc(nbytes);
+    result = (struct arg_end *)arg_malloc(nbytes);
     if (result) {
         /* init the arg_hdr struct */
         result->hdr.flag      = ARG_TERMINATOR;
@@ -1859,7 +1927,7 @@ struct arg_file *arg_filen(
              + sizeof(char *) * maxcount  /* storage for basename[maxcount] array */
              + sizeof(char *) * maxcount; /* storage for extension[maxcount] array */
 
-    result = (struct arg_file *)malloc(nbytes);
+    result = (struct arg_file *)arg_malloc(nbytes);
     if (result) {
         int i;
 
@@ -2200,7 +2268,7 @@ struct arg_int *arg_intn(
     nbytes = sizeof(struct arg_int)    /* storage for struct arg_int */
              + maxcount * sizeof(int); /* storage for ival[maxcount] array */
 
-    result = (struct arg_int *)malloc(nbytes);
+    result = (struct arg_int *)arg_malloc(nbytes);
     if (result) {
         /* init the arg_hdr struct */
         result->hdr.flag      = ARG_HASVALUE;
@@ -2455,7 +2523,7 @@ struct arg_u64 *arg_u64_n(
     nbytes = sizeof(struct arg_u64)    /* storage for struct arg_u64 */
              + maxcount * sizeof(uint64_t); /* storage for uval[maxcount] array */
 
-    result = (struct arg_u64 *)malloc(nbytes);
+    result = (struct arg_u64 *)arg_malloc(nbytes);
     if (result) {
         /* init the arg_hdr struct */
         result->hdr.flag      = ARG_HASVALUE;
@@ -2597,7 +2665,7 @@ struct arg_lit *arg_litn(
     /* foolproof things by ensuring maxcount is not less than mincount */
     maxcount = (maxcount < mincount) ? mincount : maxcount;
 
-    result = (struct arg_lit *)malloc(sizeof(struct arg_lit));
+    result = (struct arg_lit *)arg_malloc(sizeof(struct arg_lit));
     if (result) {
         /* init the arg_hdr struct */
         result->hdr.flag      = 0;
@@ -2655,7 +2723,7 @@ struct arg_lit *arg_litn(
 #include "argtable3.h"
 
 struct arg_rem *arg_rem(const char *datatype, const char *glossary) {
-    struct arg_rem *result = (struct arg_rem *)malloc(sizeof(struct arg_rem));
+    struct arg_rem *result = (struct arg_rem *)arg_malloc(sizeof(struct arg_rem));
     if (result) {
         result->hdr.flag = 0;
         result->hdr.shortopts = NULL;
@@ -2948,7 +3016,7 @@ struct arg_rex *arg_rexn(const char *shortopts,
              + sizeof(struct privhdr)     /* storage for private arg_rex data */
              + maxcount * sizeof(char *);  /* storage for sval[maxcount] array */
 
-    result = (struct arg_rex *)malloc(nbytes);
+    result = (struct arg_rex *)arg_malloc(nbytes);
     if (result == NULL)
         return result;
 
@@ -3857,7 +3925,7 @@ struct arg_str *arg_strn(
     nbytes = sizeof(struct arg_str)     /* storage for struct arg_str */
              + maxcount * sizeof(char *); /* storage for sval[maxcount] array */
 
-    result = (struct arg_str *)malloc(nbytes);
+    result = (struct arg_str *)arg_malloc(nbytes);
     if (result) {
         int i;
 
@@ -4014,7 +4082,7 @@ static struct longoptions *alloc_longoptions(struct arg_hdr **table) {
     nbytes = sizeof(struct longoptions)
              + sizeof(struct option) * noptions
              + longoptlen;
-    result = (struct longoptions *)malloc(nbytes);
+    result = (struct longoptions *)arg_malloc(nbytes);
     if (result) {
         int option_index = 0;
         char *store;
@@ -4073,7 +4141,7 @@ static char *alloc_shortoptions(struct arg_hdr **table) {
         len += 3 * (hdr->shortopts ? strlen(hdr->shortopts) : 0);
     }
 
-    result = malloc(len);
+    result = arg_malloc(len);
     if (result) {
         char *res = result;
 
@@ -4128,8 +4196,8 @@ static void arg_parse_tagged(int argc,
         /* one or both memory allocs failed */
         arg_register_error(endtable, endtable, ARG_EMALLOC, NULL);
         /* free anything that was allocated (this is null safe) */
-        free(shortoptions);
-        free(longoptions);
+        arg_mfree(shortoptions);
+        arg_mfree(longoptions);
         return;
     }
 
@@ -4218,8 +4286,8 @@ static void arg_parse_tagged(int argc,
         }
     }
 
-    free(shortoptions);
-    free(longoptions);
+    arg_mfree(shortoptions);
+    arg_mfree(longoptions);
 }
 
 
@@ -4352,7 +4420,7 @@ int arg_parse(int argc, char * *argv, void * *argtable) {
         return endtable->count;
     }
 
-    argvcopy = (char **)malloc(sizeof(char *) * (argc + 1));
+    argvcopy = (char **)arg_malloc(sizeof(char *) * (argc + 1));
     if (argvcopy) {
         int i;
 
@@ -4377,7 +4445,7 @@ int arg_parse(int argc, char * *argv, void * *argtable) {
             arg_parse_check(table, endtable);
 
         /* release the local copt of argv[] */
-        free(argvcopy);
+        arg_mfree(argvcopy);
     } else {
         /* memory alloc failed */
         arg_register_error(endtable, endtable, ARG_EMALLOC, NULL);
@@ -4974,7 +5042,7 @@ void arg_free(void * *argtable) {
             break;
 
         flag = table[tabindex]->flag;
-        free(table[tabindex]);
+        arg_mfree(table[tabindex]);
         table[tabindex++] = NULL;
 
     } while (!(flag & ARG_TERMINATOR));
@@ -4989,7 +5057,7 @@ void arg_freetable(void * *argtable, size_t n) {
         if (table[tabindex] == NULL)
             continue;
 
-        free(table[tabindex]);
+        arg_mfree(table[tabindex]);
         table[tabindex] = NULL;
     };
 }
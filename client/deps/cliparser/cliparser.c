@@ -32,8 +32,17 @@
 // Option width set to 30 to allow option descriptions to align.  approx line 74
 // Example width set to 50 to allow help descriptions to align.  approx line 93
 
+// released contexts, the next commands of this thread take them again
+#define CLI_CTX_CACHE_SIZE  4
+static __thread CLIParserContext *ctx_cache[CLI_CTX_CACHE_SIZE];
+static __thread int ctx_cached = 0;
+
 int CLIParserInit(CLIParserContext **ctx, const char *vprogramName, const char *vprogramHint, const char *vprogramHelp) {
-    *ctx = calloc(sizeof(CLIParserContext), sizeof(uint8_t));
+    if (ctx_cached > 0) {
+        *ctx = ctx_cache[--ctx_cached];
+    } else {
+        *ctx = malloc(sizeof(CLIParserContext));
+    }
     if (*ctx == NULL) {
         PrintAndLogEx(ERR, "ERROR: Insufficient memory\n");
         return 2;
@@ -44,11 +53,25 @@ int CLIParserInit(CLIParserContext **ctx, const char *vprogramName, const char *
     (*ctx)->programName = vprogramName;
     (*ctx)->programHint = vprogramHint;
     (*ctx)->programHelp = vprogramHelp;
-    memset((*ctx)->buf, 0x00, sizeof((*ctx)->buf));
+    (*ctx)->buf[0] = 0x00;
 
     return PM3_SUCCESS;
 }
 
+void CLIParserRelease(CLIParserContext **ctx) {
+    if (*ctx == NULL) {
+        return;
+    }
+
+    arg_freetable((*ctx)->argtable, (*ctx)->argtableLen);
+    if (ctx_cached < CLI_CTX_CACHE_SIZE) {
+        ctx_cache[ctx_cached++] = *ctx;
+    } else {
+        free(*ctx);
+    }
+    *ctx = NULL;
+}
+
 void CLIParserPrintHelp(CLIParserContext *ctx) {
     if (ctx->programHint) {
         PrintAndLogEx(NORMAL, "\n"_DescriptionColor_("%s"), ctx->programHint);
@@ -56,9 +79,11 @@ void CLIParserPrintHelp(CLIParserContext *ctx) {
 
     PrintAndLogEx(NORMAL, "\n"_SectionTagColor_("usage:"));
     PrintAndLogEx(NORMAL, "    "_CommandColor_("%s")NOLF, ctx->programName);
+    PrintAndLogFlush();
     arg_print_syntax(stdout, ctx->argtable, "\n\n");
 
     PrintAndLogEx(NORMAL, _SectionTagColor_("options:"));
+    PrintAndLogFlush();
     arg_print_glossary(stdout, ctx->argtable, "    "_ArgColor_("%-30s")" "_ArgHelpColor_("%s")"\n");
     PrintAndLogEx(NORMAL, "");
 
@@ -134,6 +159,7 @@ int CLIParserParseArg(CLIParserContext *ctx, int argc, char **argv, void *vargta
     /* If the parser returned any errors then display them and exit */
     if (nerrors > 0) {
         /* Display the error details contained in the arg_end struct.*/
+        PrintAndLogFlush();
         arg_print_errors(stdout, ((struct arg_end *)(ctx->argtable)[vargtableLen - 1]), ctx->programName);
         PrintAndLogEx(WARNING, "Try " _YELLOW_("'%s --help'") " for more information.\n", ctx->programName);
         fflush(stdout);
@@ -158,11 +184,13 @@ int CLIParserParseString(CLIParserContext *ctx, const char *str, void *vargtable
 
 int CLIParserParseStringEx(CLIParserContext *ctx, const char *str, void *vargtable[], size_t vargtableLen, bool allowEmptyExec, bool clueData) {
     int argc = 0;
-    char *argv[MAX_INPUT_ARG_LENGTH] = {NULL};
+    // only the first argc entries are used
+    char *argv[MAX_INPUT_ARG_LENGTH];
 
     int len = strlen(str);
 
-    memset(ctx->buf, 0x00, ARRAYLEN(ctx->buf));
+    // every char of str takes at most one byte of buf, behind the program name
+    memset(ctx->buf, 0x00, MIN(ARRAYLEN(ctx->buf), strlen(ctx->programName) + len + 2));
 
     char *bufptr = ctx->buf;
     char *bufptrend = ctx->buf + ARRAYLEN(ctx->buf) - 1;
@@ -42,7 +42,7 @@
 #define arg_strx1(shortopts, longopts, datatype, glossary) (arg_strn((shortopts), (longopts), (datatype), 1, 250, (glossary)))
 #define arg_strx0(shortopts, longopts, datatype, glossary) (arg_strn((shortopts), (longopts), (datatype), 0, 250, (glossary)))
 
-#define CLIParserFree(ctx)        if ((ctx)) {arg_freetable((ctx)->argtable, (ctx)->argtableLen); free((ctx)); (ctx)=NULL;}
+#define CLIParserFree(ctx)        CLIParserRelease(&(ctx))
 
 #define CLIExecWithReturn(ctx, cmd, atbl, ifempty)    if (CLIParserParseString((ctx), (cmd), (atbl), arg_getsize((atbl)), (ifempty))) {CLIParserFree((ctx)); return PM3_ESOFT;}
 
@@ -74,6 +74,8 @@ typedef struct {
 } CLIParserOption;
 
 int CLIParserInit(CLIParserContext **ctx, const char *vprogramName, const char *vprogramHint, const char *vprogramHelp);
+// frees the argtable and keeps the context for the next CLIParserInit of this thread
+void CLIParserRelease(CLIParserContext **ctx);
 void CLIParserPrintHelp(CLIParserContext *ctx);
 int CLIParserParseString(CLIParserContext *ctx, const char *str, void *vargtable[], size_t vargtableLen, bool allowEmptyExec);
 int CLIParserParseStringEx(CLIParserContext *ctx, const char *str, void *vargtable[], size_t vargtableLen, bool allowEmptyExec, bool clueData);
@@ -200,6 +200,67 @@ bool id48lib_key_recovery_next(
     ID48LIB_KEY *potential_key_output
 );
 
+/// <summary>
+/// Called from the thread that called id48lib_key_recovery_parallel()
+/// each time more of the search space has been searched.
+/// </summary>
+/// <param name="completed">Number of search partitions completed so far.</param>
+/// <param name="total">Total number of search partitions.</param>
+/// <param name="context">The caller-provided `progress_context`.</param>
+/// <returns>
+/// true to continue the search, false to cancel it.
+/// </returns>
+typedef bool (*ID48LIB_RECOVERY_PROGRESS)(uint32_t completed, uint32_t total, void *context);
+
+typedef enum _ID48LIB_RECOVERY_RESULT {
+    ID48LIB_RECOVERY_SUCCESS   = 0, // whole space searched, all potential keys returned
+    ID48LIB_RECOVERY_CANCELLED = 1, // progress callback returned false
+    ID48LIB_RECOVERY_OVERFLOW  = 2, // more potential keys than `max_potential_keys`
+} ID48LIB_RECOVERY_RESULT;
+
+/// <summary>
+/// Finds all potential keys at once, splitting the search
+/// space across `thread_count` worker threads.
+/// The potential keys are returned in the same order as
+/// repeated calls to id48lib_key_recovery_next() would,
+/// regardless of the thread count.
+/// Unlike init()/next(), this function keeps no global
+/// state, so it may be called from multiple threads.
+/// </summary>
+/// <param name="thread_count">
+/// Number of worker threads.  0 or 1 searches on the calling thread.
+/// Ignored when built with ID48_NO_THREADS.
+/// </param>
+/// <param name="progress">
+/// Optional (may be NULL) progress and cancellation callback.
+/// </param>
+/// <param name="progress_context">
+/// Passed unchanged to the progress callback.
+/// </param>
+/// <param name="potential_keys_output">
+/// Caller-provided buffer for up to `max_potential_keys` keys.
+/// Contents are unspecified unless ID48LIB_RECOVERY_SUCCESS is returned.
+/// </param>
+/// <param name="potential_key_count">
+/// Number of potential keys found.  When cancelled, only
+/// counts the keys found before the search stopped.
+/// </param>
+/// <remarks>
+/// Other parameters are as for id48lib_key_recovery_init().
+/// </remarks>
+ID48LIB_RECOVERY_RESULT id48lib_key_recovery_parallel(
+    const ID48LIB_KEY *input_partial_key,
+    const ID48LIB_NONCE *input_nonce,
+    const ID48LIB_FRN *input_frn,
+    const ID48LIB_GRN *input_grn,
+    uint32_t thread_count,
+    ID48LIB_RECOVERY_PROGRESS progress,
+    void *progress_context,
+    ID48LIB_KEY *potential_keys_output,
+    size_t max_potential_keys,
+    size_t *potential_key_count
+);
+
 #if defined(__cplusplus)
 }
 #endif
@@ -25,6 +25,10 @@
 
 #include "id48_internals.h"
 
+#if !defined(ID48_NO_THREADS)
+#include <pthread.h>
+#endif
+
 #ifndef nullptr
 #define nullptr ((void*)0)
 #endif
@@ -105,6 +109,17 @@ typedef struct _RECOVERY_STATE {
     /// </summary>
     ID48LIB_NONCE known_nonce;
     /// <summary>
+    /// First key to test, 0¹⁶·K₄₇..K₀₀.
+    /// Zero unless the search is restricted to a partition.
+    /// </summary>
+    KEY_BITS_K47_TO_K00 first_key;
+    /// <summary>
+    /// Key bits at or above this shift are fixed for the search.
+    /// 48 searches the whole space, 40 searches only the keys
+    /// sharing K₄₇..K₄₀ with `first_key` (which also share s₀₀).
+    /// </summary>
+    int8_t fixed_key_bit_shift;
+    /// <summary>
     /// boolean to identify first run after initialization (an edge case)
     /// </summary>
     bool is_fresh_initialization;
@@ -221,32 +236,39 @@ static bool validate_output_from_additional_fifteen_zero_bits(RECOVERY_STATE *s)
 }
 
 
-// intentionally declare this global state only here, as a way
-// of forcing the above functions to act on a pointer.  Ensuring
-// the above routines don't inadvertently use the global state
-// makes it easier to enable a multi-threaded version.
-RECOVERY_STATE g_S = { 0 };
-
 static void init(
+    RECOVERY_STATE       *s,
     const ID48LIB_KEY    *input_partial_key,
     const ID48LIB_NONCE *input_nonce,
     const ID48LIB_FRN    *input_frn,
     const ID48LIB_GRN    *input_grn
 ) {
-    memset(&g_S, 0, sizeof(RECOVERY_STATE));
-    memset(&(g_S.states[0]), 0xAA, sizeof(ID48LIBX_STATE_REGISTERS) * MAXIMUM_STATE_HISTORY);
-    g_S.known_k95_to_k48.k[0] = input_partial_key->k[0];
-    g_S.known_k95_to_k48.k[1] = input_partial_key->k[1];
-    g_S.known_k95_to_k48.k[2] = input_partial_key->k[2];
-    g_S.known_k95_to_k48.k[3] = input_partial_key->k[3];
-    g_S.known_k95_to_k48.k[4] = input_partial_key->k[4];
-    g_S.known_k95_to_k48.k[5] = input_partial_key->k[5];
-    g_S.known_nonce = *input_nonce;
-    g_S.expected_output_bits = create_expected_output_bits(input_frn, input_grn);
-    g_S.more_keys_to_test = true;
-    g_S.is_fresh_initialization = true;
+    memset(s, 0, sizeof(RECOVERY_STATE));
+    memset(&(s->states[0]), 0xAA, sizeof(ID48LIBX_STATE_REGISTERS) * MAXIMUM_STATE_HISTORY);
+    s->known_k95_to_k48.k[0] = input_partial_key->k[0];
+    s->known_k95_to_k48.k[1] = input_partial_key->k[1];
+    s->known_k95_to_k48.k[2] = input_partial_key->k[2];
+    s->known_k95_to_k48.k[3] = input_partial_key->k[3];
+    s->known_k95_to_k48.k[4] = input_partial_key->k[4];
+    s->known_k95_to_k48.k[5] = input_partial_key->k[5];
+    s->known_nonce = *input_nonce;
+    s->expected_output_bits = create_expected_output_bits(input_frn, input_grn);
+    s->first_key.Raw = 0ull;
+    s->fixed_key_bit_shift = 48;
+    s->more_keys_to_test = true;
+    s->is_fresh_initialization = true;
+}
+/// <summary>
+/// Restricts an initialized search to the keys with K₄₇..K₄₀ == `partition`.
+/// Each partition shares s₀₀, so partitions can be searched independently.
+/// </summary>
+static void restrict_to_partition(RECOVERY_STATE *s, uint8_t partition) {
+    ASSERT(s->is_fresh_initialization);
+    s->first_key.Raw = ((uint64_t)partition) << 40;
+    s->fixed_key_bit_shift = 40;
 }
 static bool get_next_potential_key(
+    RECOVERY_STATE *s,
     ID48LIB_KEY *potential_key_output
 ) {
     memset(potential_key_output, 0, sizeof(ID48LIB_KEY));
@@ -265,7 +287,7 @@ static bool get_next_potential_key(
     //        bit that was zero.
 
     // Early exit when no more keys to test
-    if (!g_S.more_keys_to_test) {
+    if (!s->more_keys_to_test) {
         return false;
     }
 
@@ -273,21 +295,15 @@ static bool get_next_potential_key(
     int8_t current_key_bit_shift;
 
     // Setup the next key to be tested.
-    if (g_S.is_fresh_initialization) {
-        // first-time init is easy: key is zero, and zero bits set
-        g_S.is_fresh_initialization = false;
-        k_low.Raw = 0ull;
+    if (s->is_fresh_initialization) {
+        // first-time init is easy: key is the first of the (partial) space, and zero bits set
+        s->is_fresh_initialization = false;
+        k_low = s->first_key;
         current_key_bit_shift = 47;
     } else {
         // by definition, a returned potential key had all the bits defined
         current_key_bit_shift = 0;
-        k_low = g_S.last_returned_potential_key;
-
-        // edge case: returned potential key 0xFFFFFFFFFFFFull, so no more keys to be tested!
-        if (k_low.Raw == 0xFFFFFFFFFFFFull) {
-            g_S.more_keys_to_test = false;
-            return false;
-        }
+        k_low = s->last_returned_potential_key;
 
         // backtrack to first zero value, flipping bits...
         if (1) {
@@ -300,6 +316,13 @@ static bool get_next_potential_key(
             // and flip that next bit also
             k_low.Raw ^= mask;
         }
+
+        // edge case: returned potential key was the last one (e.g., 0xFFFFFFFFFFFFull),
+        // so no more keys to be tested!
+        if (current_key_bit_shift >= s->fixed_key_bit_shift) {
+            s->more_keys_to_test = false;
+            return false;
+        }
     }
 
     // TODO: move above setup to re-use code in below loop ...
@@ -317,7 +340,7 @@ static bool get_next_potential_key(
         ASSERT(current_key_bit_shift < 48);
         // Anytime bit shift is 40+, changes would affect s00 ...
         if (current_key_bit_shift > 39) {
-            restart_and_calculate_s00(&g_S, &k_low);
+            restart_and_calculate_s00(s, &k_low);
             current_key_bit_shift = 39; // k47..k40 used to get to s00
         }
 
@@ -327,8 +350,8 @@ static bool get_next_potential_key(
         while (current_key_bit_shift > 32) { // k39..k33 used to move from s00-->s07
             uint8_t src_idx = 39 - current_key_bit_shift;
             bool input_bit = !!(((uint8_t)(k_low.Raw >> current_key_bit_shift)) & 0x1u);
-            ID48LIBX_SUCCESSOR_RESULT r = successor_fn(&(g_S.states[src_idx]), input_bit);
-            g_S.states[src_idx + 1] = r.state;
+            ID48LIBX_SUCCESSOR_RESULT r = successor_fn(&(s->states[src_idx]), input_bit);
+            s->states[src_idx + 1] = r.state;
             --current_key_bit_shift;
         }
 
@@ -339,11 +362,11 @@ static bool get_next_potential_key(
         // Check if the current state + current key bit (as stored) gives expected result.
         const uint8_t src_idx = 39 - current_key_bit_shift;
         bool input_bit = !!(((uint8_t)(k_low.Raw >> current_key_bit_shift)) & 0x1u);
-        ID48LIBX_SUCCESSOR_RESULT r = successor_fn(&(g_S.states[src_idx]), input_bit);
+        ID48LIBX_SUCCESSOR_RESULT r = successor_fn(&(s->states[src_idx]), input_bit);
         // can unconditionally overwrite next state...
-        g_S.states[src_idx + 1] = r.state;
+        s->states[src_idx + 1] = r.state;
 
-        bool expected_result = get_expected_output_bit(&g_S, src_idx);
+        bool expected_result = get_expected_output_bit(s, src_idx);
         bool matched = expected_result == (!!r.output);
         // when matched the last bit, actually check the next 15x inputs (all zero) as well
         if (matched && current_key_bit_shift == 0) {
@@ -351,18 +374,18 @@ static bool get_next_potential_key(
             // but, must also test 15x additional zero bit inputs before
             // reporting that this may be a potential key
             ASSERT(src_idx == 39);
-            matched = validate_output_from_additional_fifteen_zero_bits(&g_S);
+            matched = validate_output_from_additional_fifteen_zero_bits(s);
         }
 
         // Exit point ... found a potential key!
         if (matched && current_key_bit_shift == 0) {
-            g_S.last_returned_potential_key = k_low;
-            potential_key_output->k[ 0] = g_S.known_k95_to_k48.k[0];
-            potential_key_output->k[ 1] = g_S.known_k95_to_k48.k[1];
-            potential_key_output->k[ 2] = g_S.known_k95_to_k48.k[2];
-            potential_key_output->k[ 3] = g_S.known_k95_to_k48.k[3];
-            potential_key_output->k[ 4] = g_S.known_k95_to_k48.k[4];
-            potential_key_output->k[ 5] = g_S.known_k95_to_k48.k[5];
+            s->last_returned_potential_key = k_low;
+            potential_key_output->k[ 0] = s->known_k95_to_k48.k[0];
+            potential_key_output->k[ 1] = s->known_k95_to_k48.k[1];
+            potential_key_output->k[ 2] = s->known_k95_to_k48.k[2];
+            potential_key_output->k[ 3] = s->known_k95_to_k48.k[3];
+            potential_key_output->k[ 4] = s->known_k95_to_k48.k[4];
+            potential_key_output->k[ 5] = s->known_k95_to_k48.k[5];
             potential_key_output->k[ 6] = (uint8_t)(k_low.Raw >> (8 * 5));
             potential_key_output->k[ 7] = (uint8_t)(k_low.Raw >> (8 * 4));
             potential_key_output->k[ 8] = (uint8_t)(k_low.Raw >> (8 * 3));
@@ -379,7 +402,7 @@ static bool get_next_potential_key(
         // Backtrack to find next one to be tested.
         else {
             // not required ... but makes debugging easier
-            memset(&g_S.states[src_idx + 1], 0xAA, sizeof(ID48LIBX_STATE_REGISTERS));
+            memset(&s->states[src_idx + 1], 0xAA, sizeof(ID48LIBX_STATE_REGISTERS));
 
             // that bit of the key results in wrong output.
             // backtrack until the next zero bit, flip it to one, and
@@ -398,10 +421,10 @@ static bool get_next_potential_key(
                 k_low.Raw ^= mask;
             }
 
-            // EXIT CONDITION: k_low wraps to invalid value
-            if (current_key_bit_shift >= 48) {
+            // EXIT CONDITION: k_low wraps to invalid value (or leaves the partition)
+            if (current_key_bit_shift >= s->fixed_key_bit_shift) {
                 // no more results available ... return!
-                g_S.more_keys_to_test = false;
+                s->more_keys_to_test = false;
                 return 0u;
             }
 
@@ -412,6 +435,162 @@ static bool get_next_potential_key(
 
 
 
+#pragma region    // parallel recovery
+// K₄₇..K₄₀ select s₀₀, so each of the 256 values is an independent partition
+// of the search.  Workers pull partitions in ascending order, and the found
+// keys are sorted at the end, so results match the serial enumeration order
+// regardless of thread count or scheduling.
+#define RECOVERY_PARTITION_COUNT (256u)
+#define RECOVERY_MAXIMUM_THREADS (256u)
+
+typedef struct _PARALLEL_RECOVERY {
+    const ID48LIB_KEY   *partial_key;
+    const ID48LIB_NONCE *nonce;
+    const ID48LIB_FRN   *frn;
+    const ID48LIB_GRN   *grn;
+    ID48LIB_KEY *keys;             // caller's output buffer
+    size_t       max_keys;
+    size_t       key_count;        // may exceed max_keys (overflow)
+    uint32_t     next_partition;
+    uint32_t     completed_partitions;
+    bool         cancelled;
+#if !defined(ID48_NO_THREADS)
+    pthread_mutex_t lock;
+    pthread_cond_t  partition_completed;
+#endif
+} PARALLEL_RECOVERY;
+
+static void parallel_lock(PARALLEL_RECOVERY *p) {
+#if !defined(ID48_NO_THREADS)
+    pthread_mutex_lock(&p->lock);
+#else
+    (void)p;
+#endif
+}
+static void parallel_unlock(PARALLEL_RECOVERY *p) {
+#if !defined(ID48_NO_THREADS)
+    pthread_mutex_unlock(&p->lock);
+#else
+    (void)p;
+#endif
+}
+
+static void search_partition(PARALLEL_RECOVERY *p, RECOVERY_STATE *s, uint8_t partition) {
+    ID48LIB_KEY found;
+    init(s, p->partial_key, p->nonce, p->frn, p->grn);
+    restrict_to_partition(s, partition);
+    while (get_next_potential_key(s, &found)) {
+        parallel_lock(p);
+        if (p->key_count < p->max_keys) {
+            p->keys[p->key_count] = found;
+        }
+        ++p->key_count;
+        parallel_unlock(p);
+    }
+}
+
+static void sort_potential_keys(ID48LIB_KEY *keys, size_t count) {
+    // only a handful of keys are ever found, so insertion sort is fine.
+    // K₉₅..K₄₈ are identical, and k[6..11] are big-endian K₄₇..K₀₀.
+    for (size_t i = 1; i < count; ++i) {
+        ID48LIB_KEY tmp = keys[i];
+        size_t j = i;
+        while ((j > 0) && (memcmp(&(keys[j - 1].k[6]), &(tmp.k[6]), 6) > 0)) {
+            keys[j] = keys[j - 1];
+            --j;
+        }
+        keys[j] = tmp;
+    }
+}
+
+static void run_serial(PARALLEL_RECOVERY *p, ID48LIB_RECOVERY_PROGRESS progress, void *progress_context) {
+    RECOVERY_STATE s;
+    while (!p->cancelled && (p->next_partition < RECOVERY_PARTITION_COUNT)) {
+        search_partition(p, &s, (uint8_t)(p->next_partition++));
+        ++p->completed_partitions;
+        if ((progress != nullptr) && !progress(p->completed_partitions, RECOVERY_PARTITION_COUNT, progress_context)) {
+            p->cancelled = true;
+        }
+    }
+}
+
+#if !defined(ID48_NO_THREADS)
+static void *recovery_worker(void *arg) {
+    PARALLEL_RECOVERY *p = (PARALLEL_RECOVERY *)arg;
+    RECOVERY_STATE s;
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->cancelled && (p->next_partition < RECOVERY_PARTITION_COUNT)) {
+        uint8_t partition = (uint8_t)(p->next_partition++);
+        pthread_mutex_unlock(&p->lock);
+
+        search_partition(p, &s, partition);
+
+        pthread_mutex_lock(&p->lock);
+        ++p->completed_partitions;
+        pthread_cond_signal(&p->partition_completed);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return nullptr;
+}
+
+/// <summary>
+/// Runs the workers, while the calling thread reports progress.
+/// Returns false if no worker thread could be started.
+/// </summary>
+static bool run_threaded(PARALLEL_RECOVERY *p, uint32_t thread_count, ID48LIB_RECOVERY_PROGRESS progress, void *progress_context) {
+    pthread_t threads[RECOVERY_MAXIMUM_THREADS];
+    uint32_t started = 0;
+
+    if (pthread_mutex_init(&p->lock, nullptr) != 0) {
+        return false;
+    }
+    if (pthread_cond_init(&p->partition_completed, nullptr) != 0) {
+        pthread_mutex_destroy(&p->lock);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < thread_count; ++i) {
+        if (pthread_create(&threads[started], nullptr, recovery_worker, p) == 0) {
+            ++started;
+        }
+    }
+
+    if (started != 0) {
+        // callbacks are only ever invoked from the calling thread
+        uint32_t reported = 0;
+        pthread_mutex_lock(&p->lock);
+        while (!p->cancelled && (reported < RECOVERY_PARTITION_COUNT)) {
+            while (p->completed_partitions == reported) {
+                pthread_cond_wait(&p->partition_completed, &p->lock);
+            }
+            reported = p->completed_partitions;
+            if (progress != nullptr) {
+                pthread_mutex_unlock(&p->lock);
+                bool keep_going = progress(reported, RECOVERY_PARTITION_COUNT, progress_context);
+                pthread_mutex_lock(&p->lock);
+                if (!keep_going) {
+                    p->cancelled = true;
+                }
+            }
+        }
+        pthread_mutex_unlock(&p->lock);
+
+        for (uint32_t i = 0; i < started; ++i) {
+            pthread_join(threads[i], nullptr);
+        }
+    }
+
+    pthread_cond_destroy(&p->partition_completed);
+    pthread_mutex_destroy(&p->lock);
+    return started != 0;
+}
+#endif // !defined(ID48_NO_THREADS)
+#pragma endregion // parallel recovery
+
+
+
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // ******************************************************************************************************************** //
 // *** Everything above this line in the file is declared static,                                                   *** //
@@ -422,16 +601,63 @@ static bool get_next_potential_key(
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
+// The iterative API keeps its state here.  All of the above functions act on
+// a pointer, so the parallel API gives each worker its own state instead.
+RECOVERY_STATE g_S = { 0 };
+
 void id48lib_key_recovery_init(
     const ID48LIB_KEY    *input_partial_key,
     const ID48LIB_NONCE *input_nonce,
     const ID48LIB_FRN    *input_frn,
     const ID48LIB_GRN    *input_grn
 ) {
-    init(input_partial_key, input_nonce, input_frn, input_grn);
+    init(&g_S, input_partial_key, input_nonce, input_frn, input_grn);
 }
 bool id48lib_key_recovery_next(
     ID48LIB_KEY *potential_key_output
 ) {
-    return get_next_potential_key(potential_key_output);
+    return get_next_potential_key(&g_S, potential_key_output);
+}
+ID48LIB_RECOVERY_RESULT id48lib_key_recovery_parallel(
+    const ID48LIB_KEY    *input_partial_key,
+    const ID48LIB_NONCE *input_nonce,
+    const ID48LIB_FRN    *input_frn,
+    const ID48LIB_GRN    *input_grn,
+    uint32_t thread_count,
+    ID48LIB_RECOVERY_PROGRESS progress,
+    void *progress_context,
+    ID48LIB_KEY *potential_keys_output,
+    size_t max_potential_keys,
+    size_t *potential_key_count
+) {
+    PARALLEL_RECOVERY p;
+    memset(&p, 0, sizeof(PARALLEL_RECOVERY));
+    p.partial_key = input_partial_key;
+    p.nonce       = input_nonce;
+    p.frn         = input_frn;
+    p.grn         = input_grn;
+    p.keys        = potential_keys_output;
+    p.max_keys    = max_potential_keys;
+
+    if (thread_count > RECOVERY_MAXIMUM_THREADS) {
+        thread_count = RECOVERY_MAXIMUM_THREADS;
+    }
+
+#if !defined(ID48_NO_THREADS)
+    if ((thread_count < 2) || !run_threaded(&p, thread_count, progress, progress_context)) {
+        run_serial(&p, progress, progress_context);
+    }
+#else
+    run_serial(&p, progress, progress_context);
+#endif
+
+    *potential_key_count = p.key_count;
+    if (p.cancelled) {
+        return ID48LIB_RECOVERY_CANCELLED;
+    }
+    if (p.key_count > p.max_keys) {
+        return ID48LIB_RECOVERY_OVERFLOW;
+    }
+    sort_potential_keys(potential_keys_output, p.key_count);
+    return ID48LIB_RECOVERY_SUCCESS;
 }
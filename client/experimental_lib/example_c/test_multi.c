@@ -0,0 +1,64 @@
+#include "pm3.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One thread per device, each one pinging its own Proxmark3
+#define PINGS 20
+
+typedef struct {
+    pm3 *p;
+    int ok;
+} worker_t;
+
+static void *worker(void *arg) {
+    worker_t *w = (worker_t *)arg;
+    for (int i = 0; i < PINGS; i++) {
+        pm3_console(w->p, "hw ping", true, true);
+        if (strstr(pm3_grabbed_output_get(w->p), "Ping response") != NULL) {
+            w->ok++;
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+
+    if (argc < 3) {
+        printf("Usage: %s <port> <port> [<port>...]\n", argv[0]);
+        exit(-1);
+    }
+
+    int n = argc - 1;
+    worker_t *workers = calloc(n, sizeof(worker_t));
+    pthread_t *threads = calloc(n, sizeof(pthread_t));
+
+    for (int i = 0; i < n; i++) {
+        workers[i].p = pm3_open(argv[i + 1]);
+        if (workers[i].p == NULL) {
+            printf("Failed to open %s\n", argv[i + 1]);
+            exit(-1);
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        pthread_create(&threads[i], NULL, worker, &workers[i]);
+    }
+
+    int res = 0;
+    for (int i = 0; i < n; i++) {
+        pthread_join(threads[i], NULL);
+        printf("%s: %d/%d pings\n", pm3_name_get(workers[i].p), workers[i].ok, PINGS);
+        if (workers[i].ok != PINGS) {
+            res = 1;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        pm3_close(workers[i].p);
+    }
+    free(threads);
+    free(workers);
+    return res;
+}
@@ -20,3 +20,8 @@ prefs = json.loads(p.grabbed_output)
 print("Save path: ", prefs['file.default.savepath'])
 print("Dump path: ", prefs['file.default.dumppath'])
 print("Trace path:", prefs['file.default.tracepath'])
+
+print("Reading samples:")
+p.console("lf read")
+samples = p.graph   # memoryview of int32, a copy of the graph as it is now
+print("Samples:   ", len(samples), "min", min(samples), "max", max(samples))
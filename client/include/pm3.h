@@ -17,13 +17,33 @@
 #define LIBPM3_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 typedef struct pm3_device pm3;
 
+// Every device has a session of its own, several of them can be opened and
+// driven from different threads. The graph / demod buffers are still shared.
+
 pm3 *pm3_open(const char *port);
 int pm3_console(pm3 *dev, const char *cmd, bool capture, bool quiet);
 const char *pm3_grabbed_output_get(pm3 *dev);
 const char *pm3_name_get(pm3 *dev);
 void pm3_close(pm3 *dev);
 pm3 *pm3_get_current_dev(void);
+
+// Binary results, for scripts which would otherwise parse the printed output.
+// A view of len items of itemsize bytes, no copy is made: it is only valid
+// until the next command, copy what you want to keep. The Python and Lua
+// bindings hand out copies
+typedef struct {
+    const void *data;
+    size_t len;
+    size_t itemsize;
+} pm3_buffer_t;
+
+pm3_buffer_t pm3_graph_get(pm3 *dev);   // graph samples, int32
+pm3_buffer_t pm3_demod_get(pm3 *dev);   // demodulated bits, one per byte
+pm3_buffer_t pm3_trace_get(pm3 *dev);   // trace records, as in a .trace file
+pm3_buffer_t pm3_dump_get(pm3 *dev);    // the last dump saved by a command
+pm3_buffer_t pm3_eml_get(pm3 *dev);     // emulator memory, downloaded from the device
 #endif // LIBPM3_H
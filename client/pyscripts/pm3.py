@@ -70,6 +70,13 @@ class pm3(object):
         return _pm3.pm3_console(self, cmd, capture, quiet)
     name = property(_pm3.pm3_name_get)
     grabbed_output = property(_pm3.pm3_grabbed_output_get)
+    # graph, demod, trace, dump and eml are read only memoryviews of a copy of the
+    # client buffers, taken on each access: read them again after console()
+    graph = property(_pm3.pm3_graph_get)
+    demod = property(_pm3.pm3_demod_get)
+    trace = property(_pm3.pm3_trace_get)
+    dump = property(_pm3.pm3_dump_get)
+    eml = property(_pm3.pm3_eml_get)
 
 # Register pm3 in _pm3:
 _pm3.pm3_swigregister(pm3)
@@ -29,6 +29,9 @@
 #include "graph.h"               // for graph data
 #include "comms.h"
 #include "lfdemod.h"             // for demod code
+#include "lfdemod_simd.h"        // for lf demod kernel engines
+#include "scandir.h"
+#include "util_posix.h"          // usclock
 #include "cmdlf.h"               // for lf_getconfig
 #include "loclass/cipherutils.h" // for decimating samples in getsamples
 #include "cmdlfem410x.h"         // askem410xdecode
@@ -42,6 +45,8 @@
 #include "mbedtls/ctr_drbg.h"    // random generator
 #include "atrs.h"                // ATR lookup
 #include "crypto/libpcrypto.h"   // Cryptography
+#include "pm3z.h"                // compressed traces
+#include "traceevent.h"         // spans
 
 
 uint8_t g_DemodBuffer[MAX_DEMOD_BUF_LEN] = { 0x00 };
@@ -49,8 +54,30 @@ size_t g_DemodBufferLen = 0;
 int32_t g_DemodStartIdx = 0;
 int g_DemodClock = 0;
 
+// sampling config of the samples in the graph, bits_per_sample 0 when unknown.
+// It only holds for the graph it came with, any later edit makes it unknown.
+static sample_config s_graph_config;
+static uint64_t s_graph_config_gen;
+
 static int CmdHelp(const char *Cmd);
 
+// NULL for unknown
+static void graph_config_set(const sample_config *config) {
+    if (config == NULL) {
+        memset(&s_graph_config, 0, sizeof(s_graph_config));
+    } else {
+        s_graph_config = *config;
+    }
+    s_graph_config_gen = graphGeneration();
+}
+
+static const sample_config *graph_config_get(void) {
+    if (s_graph_config_gen != graphGeneration() || s_graph_config.bits_per_sample == 0) {
+        return NULL;
+    }
+    return &s_graph_config;
+}
+
 
 // https://www.eskimo.com/~scs/c-faq.com/stdio/commaprint.html
 static char *commaprint(size_t n) {
@@ -370,6 +397,8 @@ int CmdGetBitStream(const char *Cmd) {
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     CLIParserFree(ctx);
 
+    graphHistoryPush();
+
     CmdHpf("");
     for (uint32_t i = 0; i < g_GraphTraceLen; i++) {
         g_GraphBuffer[i] = (g_GraphBuffer[i] >= 1) ? 1 : 0;
@@ -392,6 +421,8 @@ static int CmdConvertBitStream(const char *Cmd) {
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     CLIParserFree(ctx);
 
+    graphHistoryPush();
+
     if (isGraphBitstream()) {
         convertGraphFromBitstream();
     } else {
@@ -407,6 +438,7 @@ static int CmdConvertBitStream(const char *Cmd) {
 // emSearch will auto search for EM410x format in bitstream
 // askType switches decode: ask/raw = 0, ask/manchester = 1
 int ASKDemod_ext(int clk, int invert, int maxErr, size_t maxlen, bool amplify, bool verbose, bool emSearch, uint8_t askType, bool *stCheck) {
+    TRACE_SPAN("demod", "ask");
     PrintAndLogEx(DEBUG, "DEBUG: (ASKDemod_ext) clk %i invert %i maxErr %i maxLen %zu amplify %i verbose %i emSearch %i askType %i "
                   , clk
                   , invert
@@ -422,7 +454,7 @@ int ASKDemod_ext(int clk, int invert, int maxErr, size_t maxlen, bool amplify, b
     if (maxlen == 0)
         maxlen = g_pm3_capabilities.bigbuf_size;
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    uint8_t *bits = calloc(GRAPH_SCRATCH_LEN, sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return PM3_EMALLOC;
@@ -733,6 +765,7 @@ static int CmdBiphaseDecodeRaw(const char *Cmd) {
 
 // ASK Demod then Biphase decode g_GraphBuffer samples
 int ASKbiphaseDemod(int offset, int clk, int invert, int maxErr, bool verbose) {
+    TRACE_SPAN("demod", "biphase");
     //ask raw demod g_GraphBuffer first
 
     uint8_t *bs = calloc(MAX_DEMOD_BUF_LEN, sizeof(uint8_t));
@@ -849,6 +882,7 @@ static int Cmdaskrawdemod(const char *Cmd) {
 }
 
 int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveGrph, bool verbose) {
+    TRACE_SPAN("demod", "autocorrelate");
     // sanity check
     if (window > len) {
         window = len;
@@ -864,7 +898,7 @@ int AutoCorrelate(const int *in, int *out, size_t len, size_t window, bool SaveG
     // Computed variance
     double variance = compute_variance(in, len);
 
-    int *correl_buf = calloc(MAX_GRAPH_TRACE_LEN, sizeof(int));
+    int *correl_buf = calloc(GRAPH_SCRATCH_LEN, sizeof(int));
 
     uint8_t peak_cnt = 0;
     size_t peaks[10] = {0};
@@ -992,6 +1026,11 @@ static int CmdBitsamples(const char *Cmd) {
         return PM3_ETIMEOUT;
     }
 
+    if (reserveGraphBuffer(sizeof(got) * 8) == false) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
     for (size_t j = 0; j < ARRAYLEN(got); j++) {
         for (uint8_t k = 0; k < 8; k++) {
             if (got[j] & (1 << (7 - k)))
@@ -1018,6 +1057,9 @@ static int CmdBuffClear(const char *Cmd) {
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     CLIParserFree(ctx);
+
+    graphHistoryPush();
+
     clearCommandBuffer();
     SendCommandNG(CMD_BUFF_CLEAR, NULL, 0);
     ClearGraph(true);
@@ -1043,6 +1085,8 @@ static int CmdDecimate(const char *Cmd) {
     int n = arg_get_int_def(ctx, 1, 2);
     CLIParserFree(ctx);
 
+    graphHistoryPush();
+
     for (size_t i = 0; i < (g_GraphTraceLen / n); ++i)
         g_GraphBuffer[i] = g_GraphBuffer[i * n];
 
@@ -1075,16 +1119,24 @@ static int CmdUndecimate(const char *Cmd) {
     int factor = arg_get_int_def(ctx, 1, 2);
     CLIParserFree(ctx);
 
-    //We have memory, don't we?
-    int *swap = calloc(MAX_GRAPH_TRACE_LEN, sizeof(int));
-    if (swap == NULL) {
+    // the graph grows by factor, up to the graph limit
+    size_t swap_len = g_GraphTraceLen * factor;
+    if (swap_len >= GRAPH_TRACE_LEN_LIMIT) {
+        swap_len = GRAPH_TRACE_LEN_LIMIT - 1;
+    }
+
+    int *swap = calloc(swap_len, sizeof(int));
+    if (swap == NULL || reserveGraphBuffer(swap_len) == false) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(swap);
         return PM3_EMALLOC;
     }
+
+    graphHistoryPush();
     uint32_t g_index = 0, s_index = 0;
-    while (g_index < g_GraphTraceLen && s_index + factor < MAX_GRAPH_TRACE_LEN) {
+    while (g_index < g_GraphTraceLen && s_index + factor < swap_len) {
         int count = 0;
-        for (count = 0; count < factor && s_index + count < MAX_GRAPH_TRACE_LEN; count++) {
+        for (count = 0; count < factor && s_index + count < swap_len; count++) {
             swap[s_index + count] = (
                                         (double)(factor - count) / (factor - 1)) * g_GraphBuffer[g_index] +
                                     ((double)count / factor) * g_GraphBuffer[g_index + 1]
@@ -1119,6 +1171,8 @@ static int CmdGraphShiftZero(const char *Cmd) {
     int shift = arg_get_int_def(ctx, 1, 0);
     CLIParserFree(ctx);
 
+    graphHistoryPush();
+
     for (size_t i = 0; i < g_GraphTraceLen; i++) {
         int shiftedVal = g_GraphBuffer[i] + shift;
 
@@ -1164,6 +1218,8 @@ static int CmdAskEdgeDetect(const char *Cmd) {
     int threshold = arg_get_int_def(ctx, 1, 25);
     CLIParserFree(ctx);
 
+    graphHistoryPush();
+
     PrintAndLogEx(INFO, "using threshold " _YELLOW_("%i"), threshold);
     int res = AskEdgeDetect(g_GraphBuffer, g_GraphBuffer, g_GraphTraceLen, threshold);
     RepaintGraphWindow();
@@ -1173,6 +1229,18 @@ static int CmdAskEdgeDetect(const char *Cmd) {
 // Print our clock rate
 // uses data from graphbuffer
 // adjusted to take char parameter for type of modulation to find the clock - by marshmellow.
+static void print_clock_scores(void) {
+    const clock_scores_t *cs = getClockScores();
+    if (cs->count < 2)
+        return;
+
+    PrintAndLogEx(INFO, "clock | confidence");
+    PrintAndLogEx(INFO, "------+-----------");
+    for (uint8_t i = 0; i < cs->count; i++) {
+        PrintAndLogEx(INFO, " %4u | %3u%%", cs->clock[i], cs->confidence[i]);
+    }
+}
+
 static int CmdDetectClockRate(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "data detectclock",
@@ -1232,6 +1300,7 @@ static int CmdDetectClockRate(const char *Cmd) {
     if (p)
         GetPskClock("", true);
 
+    print_clock_scores();
     RepaintGraphWindow();
     return PM3_SUCCESS;
 }
@@ -1265,6 +1334,7 @@ static char *GetFSKType(uint8_t fchigh, uint8_t fclow, uint8_t invert) {
 // takes 4 arguments - Clock, invert, fchigh, fclow
 // defaults: clock = 50, invert=1, fchigh=10, fclow=8 (RF/10 RF/8 (fsk2a))
 int FSKrawDemod(uint8_t rfLen, uint8_t invert, uint8_t fchigh, uint8_t fclow, bool verbose) {
+    TRACE_SPAN("demod", "fsk");
     //raw fsk demod  no manchester decoding no start bit finding just get binary from wave
     if (getSignalProperties()->isnoise) {
         if (verbose) {
@@ -1273,7 +1343,7 @@ int FSKrawDemod(uint8_t rfLen, uint8_t invert, uint8_t fchigh, uint8_t fclow, bo
         return PM3_ESOFT;
     }
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    uint8_t *bits = calloc(GRAPH_SCRATCH_LEN, sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return PM3_EMALLOC;
@@ -1369,6 +1439,7 @@ static int CmdFSKrawdemod(const char *Cmd) {
 
 // attempt to psk1 demod graph buffer
 int PSKDemod(int clk, int invert, int maxErr, bool verbose) {
+    TRACE_SPAN("demod", "psk");
     if (getSignalProperties()->isnoise) {
         if (verbose) {
             PrintAndLogEx(INFO, "signal looks like noise");
@@ -1376,7 +1447,7 @@ int PSKDemod(int clk, int invert, int maxErr, bool verbose) {
         return PM3_ESOFT;
     }
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    uint8_t *bits = calloc(GRAPH_SCRATCH_LEN, sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return PM3_EMALLOC;
@@ -1416,6 +1487,7 @@ int PSKDemod(int clk, int invert, int maxErr, bool verbose) {
 // attempts to demodulate nrz only
 // prints binary found and saves in g_DemodBuffer for further commands
 int NRZrawDemod(int clk, int invert, int maxErr, bool verbose) {
+    TRACE_SPAN("demod", "nrz");
 
     int errCnt = 0, clkStartIdx = 0;
 
@@ -1426,7 +1498,7 @@ int NRZrawDemod(int clk, int invert, int maxErr, bool verbose) {
         return PM3_ESOFT;
     }
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    uint8_t *bits = calloc(GRAPH_SCRATCH_LEN, sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return PM3_EMALLOC;
@@ -1809,6 +1881,8 @@ int CmdHpf(const char *Cmd) {
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     CLIParserFree(ctx);
 
+    graphHistoryPush();
+
     uint8_t *bits = calloc(g_GraphTraceLen, sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
@@ -1826,18 +1900,140 @@ int CmdHpf(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
-static bool _headBit(BitstreamOut_t *stream) {
-    int bytepos = stream->position >> 3; // divide by 8
-    int bitpos = (stream->position++) & 7; // mask out 00000111
-    return (*(stream->buffer + bytepos) >> (7 - bitpos)) & 1;
+// Samples of less than 8 bits are packed msb first, 8 samples fill bits_per_sample
+// bytes. Each one lands in the upper bits of a byte, like the device sampled it.
+typedef struct {
+    const uint8_t *src;
+    int32_t *dest;
+    size_t samples;
+    size_t done;
+    uint8_t bits;
+} sample_unpack_t;
+
+// 1, 2 and 4 bit samples, one table row per packed byte
+static int32_t s_unpack1[256][8];
+static int32_t s_unpack2[256][4];
+static int32_t s_unpack4[256][2];
+static bool s_unpack_init = false;
+
+static void unpack_tables_init(void) {
+    if (s_unpack_init) {
+        return;
+    }
+    for (int b = 0; b < 256; b++) {
+        for (int k = 0; k < 8; k++) {
+            s_unpack1[b][k] = (((b >> (7 - k)) & 0x1) << 7) - 127;
+        }
+        for (int k = 0; k < 4; k++) {
+            s_unpack2[b][k] = (((b >> (6 - (k * 2))) & 0x3) << 6) - 127;
+        }
+        for (int k = 0; k < 2; k++) {
+            s_unpack4[b][k] = (((b >> (4 - (k * 4))) & 0xF) << 4) - 127;
+        }
+    }
+    s_unpack_init = true;
 }
 
-static uint8_t getByte(uint8_t bits_per_sample, BitstreamOut_t *b) {
+// sample idx, one bit at a time. Only used for the last, incomplete group
+static int32_t unpack_one(const uint8_t *src, size_t idx, uint8_t bits) {
+    size_t pos = idx * bits;
     uint8_t val = 0;
-    for (int i = 0 ; i < bits_per_sample; i++)
-        val |= (_headBit(b) << (7 - i));
+    for (int i = 0; i < bits; i++, pos++) {
+        val |= ((src[pos >> 3] >> (7 - (pos & 7))) & 1) << (7 - i);
+    }
+    return ((int32_t)val) - 127;
+}
+
+// unpack the samples held in the first avail bytes of the source
+static void unpack_samples(sample_unpack_t *u, size_t avail) {
+
+    size_t end = MIN((avail / u->bits) * 8, u->samples);
+    end &= ~(size_t)7;
+
+    size_t i = u->done;
+    const uint8_t *s = u->src + (i / 8) * u->bits;
+    int32_t *d = u->dest;
+
+    switch (u->bits) {
+        case 1:
+            for (; i < end; i += 8, s++) {
+                memcpy(d + i, s_unpack1[s[0]], sizeof(s_unpack1[0]));
+            }
+            break;
+        case 2:
+            for (; i < end; i += 8, s += 2) {
+                memcpy(d + i, s_unpack2[s[0]], sizeof(s_unpack2[0]));
+                memcpy(d + i + 4, s_unpack2[s[1]], sizeof(s_unpack2[0]));
+            }
+            break;
+        case 4:
+            for (; i < end; i += 8, s += 4) {
+                for (int k = 0; k < 4; k++) {
+                    memcpy(d + i + (k * 2), s_unpack4[s[k]], sizeof(s_unpack4[0]));
+                }
+            }
+            break;
+        case 8:
+            for (; i < end; i++) {
+                d[i] = ((int32_t)u->src[i]) - 127;
+            }
+            break;
+        default: {
+            // 3, 5, 6 and 7 bits, a group of 8 samples fits a 64 bit word
+            uint8_t shift = 8 - u->bits;
+            uint8_t mask = (1 << u->bits) - 1;
+            for (; i < end; i += 8, s += u->bits) {
+                uint64_t w = 0;
+                for (int k = 0; k < u->bits; k++) {
+                    w = (w << 8) | s[k];
+                }
+                for (int k = 7; k >= 0; k--, w >>= u->bits) {
+                    d[i + k] = ((int32_t)((w & mask) << shift)) - 127;
+                }
+            }
+            break;
+        }
+    }
 
-    return val;
+    // trailing samples, once all of their bytes are in
+    if (end < u->samples && (avail * 8) >= (u->samples * u->bits)) {
+        for (; i < u->samples; i++) {
+            d[i] = unpack_one(u->src, i, u->bits);
+        }
+    }
+    u->done = i;
+}
+
+static void unpack_init(sample_unpack_t *u, const uint8_t *src, size_t samples, uint8_t bits, int32_t *dest) {
+    unpack_tables_init();
+    u->src = src;
+    u->dest = dest;
+    u->samples = samples;
+    u->done = 0;
+    u->bits = (bits == 0 || bits > 8) ? 8 : bits;
+}
+
+static void unpack_progress(const uint8_t *dest, uint32_t received, void *ctx) {
+    (void)dest;
+    unpack_samples((sample_unpack_t *)ctx, received);
+}
+
+// sampled data is in the graph buffer, update what depends on it
+static int samples_to_graph_done(void) {
+    uint8_t *bits = calloc(g_GraphTraceLen, sizeof(uint8_t));
+    if (bits == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    size_t size = getFromGraphBuffer(bits);
+    // set signal properties low/high/mean/amplitude and is_noise detection
+    computeSignalProperties(bits, size);
+    free(bits);
+
+    setClockGrid(0, 0);
+    g_DemodBufferLen = 0;
+    RepaintGraphWindow();
+    return PM3_SUCCESS;
 }
 
 int getSamples(uint32_t n, bool verbose) {
@@ -1845,93 +2041,123 @@ int getSamples(uint32_t n, bool verbose) {
 }
 
 int getSamplesEx(uint32_t start, uint32_t end, bool verbose, bool ignore_lf_config) {
+    TRACE_SPAN("demod", "samples");
 
     if (end < start) {
         PrintAndLogEx(WARNING, "error, end (%u) is smaller than start (%u)", end, start);
         return PM3_EINVARG;
     }
 
+    uint8_t bits_per_sample = 8;
+
+    sample_config sc = {0};
+    if (IfPm3Lf() && ignore_lf_config == false) {
+        lf_getconfig(&sc);
+        if (sc.bits_per_sample > 0 && sc.bits_per_sample <= 8) {
+            bits_per_sample = sc.bits_per_sample;
+        }
+    }
+
     // If we get all but the last byte in bigbuf,
     // we don't have to worry about remaining trash
     // in the last byte in case the bits-per-sample
     // does not line up on byte boundaries
-    uint8_t got[g_pm3_capabilities.bigbuf_size - 1];
-    memset(got, 0x00, sizeof(got));
+    uint32_t maxbytes = g_pm3_capabilities.bigbuf_size - 1;
 
+    // n samples, only download the bytes holding them
     uint32_t n = end - start;
+    if (n == 0 || n > maxbytes) {
+        n = maxbytes;
+    }
+
+    uint32_t bytes = (uint32_t)(((uint64_t)n * bits_per_sample + 7) / 8);
 
-    if (n == 0 || n > g_pm3_capabilities.bigbuf_size - 1) {
-        n = g_pm3_capabilities.bigbuf_size - 1;
+    uint8_t *got = calloc(bytes, sizeof(uint8_t));
+    int32_t *samples = calloc(n, sizeof(int32_t));
+    if (got == NULL || samples == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(got);
+        free(samples);
+        return PM3_EMALLOC;
     }
 
     if (verbose) {
-        PrintAndLogEx(INFO, "Reading " _YELLOW_("%u") " bytes from device memory", n);
+        PrintAndLogEx(INFO, "Reading " _YELLOW_("%u") " bytes from device memory", bytes);
     }
 
+    // unpack chunks as they arrive
+    sample_unpack_t u;
+    unpack_init(&u, got, n, bits_per_sample, samples);
+
     PacketResponseNG resp;
-    if (GetFromDevice(BIG_BUF, got, n, start, NULL, 0, &resp, 10000, true) == false) {
+    if (GetFromDeviceEx(BIG_BUF, got, bytes, start, NULL, 0, &resp, 10000, true, unpack_progress, &u) == false) {
         PrintAndLogEx(WARNING, "timeout while waiting for reply");
+        free(got);
+        free(samples);
         return PM3_ETIMEOUT;
     }
+    unpack_samples(&u, bytes);
+    free(got);
 
     if (verbose) {
         PrintAndLogEx(SUCCESS, "Data fetched");
-    }
-
-    uint8_t bits_per_sample = 8;
-
-    if (IfPm3Lf() && ignore_lf_config == false) {
-        sample_config sc;
-        lf_getconfig(&sc);
-        if (verbose) {
+        if (IfPm3Lf() && ignore_lf_config == false) {
             PrintAndLogEx(INFO, "Samples @ " _YELLOW_("%d") " bits/smpl, decimation 1:%d ", sc.bits_per_sample, sc.decimation);
         }
-        bits_per_sample = sc.bits_per_sample;
     }
 
-    return getSamplesFromBufEx(got, n, bits_per_sample, verbose);;
-}
-
-int getSamplesFromBufEx(uint8_t *data, size_t sample_num, uint8_t bits_per_sample, bool verbose) {
-
-    size_t max_num = MIN(sample_num, MAX_GRAPH_TRACE_LEN);
+    size_t max_num = MIN(n, GRAPH_TRACE_LEN_LIMIT - 1);
+    if (reserveGraphBuffer(max_num) == false) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(samples);
+        return PM3_EMALLOC;
+    }
 
-    if (bits_per_sample < 8) {
+    graphHistoryPush();
+    memcpy(g_GraphBuffer, samples, max_num * sizeof(int32_t));
+    g_GraphTraceLen = max_num;
+    free(samples);
 
-        if (verbose) PrintAndLogEx(INFO, "Unpacking...");
+    if (bits_per_sample != sc.bits_per_sample) {
+        memset(&sc, 0, sizeof(sc));
+        sc.bits_per_sample = bits_per_sample;
+    }
+    graph_config_set(&sc);
 
-        BitstreamOut_t bout = {data, bits_per_sample * sample_num,  0};
-        size_t j = 0;
-        for (j = 0; j < max_num; j++) {
-            uint8_t sample = getByte(bits_per_sample, &bout);
-            g_GraphBuffer[j] = ((int) sample) - 127;
-        }
-        g_GraphTraceLen = j;
+    if (verbose && bits_per_sample < 8) {
+        PrintAndLogEx(INFO, "Unpacked %zu samples", max_num);
+    }
 
-        if (verbose) PrintAndLogEx(INFO, "Unpacked %zu samples", j);
+    return samples_to_graph_done();
+}
 
-    } else {
-        for (size_t j = 0; j < max_num; j++) {
-            g_GraphBuffer[j] = ((int)data[j]) - 127;
-        }
-        g_GraphTraceLen = max_num;
-    }
+int getSamplesFromBufEx(uint8_t *data, size_t sample_num, uint8_t bits_per_sample, bool verbose) {
+    TRACE_SPAN("demod", "samples from buffer");
 
-    uint8_t *bits = calloc(g_GraphTraceLen, sizeof(uint8_t));
-    if (bits == NULL) {
+    size_t max_num = MIN(sample_num, GRAPH_TRACE_LEN_LIMIT - 1);
+    if (reserveGraphBuffer(max_num) == false) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return PM3_EMALLOC;
     }
-    size_t size = getFromGraphBuffer(bits);
-    // set signal properties low/high/mean/amplitude and is_noise detection
-    computeSignalProperties(bits, size);
-    free(bits);
 
-    setClockGrid(0, 0);
-    g_DemodBufferLen = 0;
-    RepaintGraphWindow();
+    graphHistoryPush();
+    sample_config sc = { .bits_per_sample = bits_per_sample };
+    graph_config_set(&sc);
 
-    return PM3_SUCCESS;
+    if (verbose && bits_per_sample < 8) {
+        PrintAndLogEx(INFO, "Unpacking...");
+    }
+
+    sample_unpack_t u;
+    unpack_init(&u, data, max_num, bits_per_sample, g_GraphBuffer);
+    unpack_samples(&u, ((max_num * u.bits) + 7) / 8);
+    g_GraphTraceLen = u.done;
+
+    if (verbose && bits_per_sample < 8) {
+        PrintAndLogEx(INFO, "Unpacked %zu samples", u.done);
+    }
+
+    return samples_to_graph_done();
 }
 
 static int CmdSamples(const char *Cmd) {
@@ -1957,12 +2183,121 @@ static int CmdSamples(const char *Cmd) {
 }
 
 
+// text or 8-bit binary samples
+static int load_graph_file(const char *path, bool is_bin) {
+    FILE *f;
+    if (is_bin)
+        f = fopen(path, "rb");
+    else
+        f = fopen(path, "r");
+
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "couldn't open `" _YELLOW_("%s") "`", path);
+        return PM3_EFILE;
+    }
+
+    graphHistoryPush();
+    g_GraphTraceLen = 0;
+    graph_config_set(NULL);
+
+    bool truncated = false;
+    if (is_bin) {
+        uint8_t val[2];
+        while (fread(val, 1, 1, f)) {
+            if (reserveGraphBuffer(g_GraphTraceLen) == false) {
+                truncated = true;
+                break;
+            }
+            g_GraphBuffer[g_GraphTraceLen] = val[0] - 127;
+            g_GraphTraceLen++;
+        }
+    } else {
+        char line[80];
+        while (fgets(line, sizeof(line), f)) {
+            if (reserveGraphBuffer(g_GraphTraceLen) == false) {
+                truncated = true;
+                break;
+            }
+            g_GraphBuffer[g_GraphTraceLen] = atoi(line);
+            g_GraphTraceLen++;
+        }
+    }
+    fclose(f);
+
+    if (truncated) {
+        PrintAndLogEx(WARNING, "trace truncated, graph can't grow past " _YELLOW_("%s") " samples", commaprint(g_GraphTraceLen));
+    }
+    return PM3_SUCCESS;
+}
+
+// count samples from sample start on, 0 for all of them
+static int load_graph_pm3z(const char *path, uint64_t start, uint64_t count) {
+    pm3z_file_t *pz = NULL;
+    int res = pm3z_open(path, &pz);
+    if (res != PM3_SUCCESS) {
+        return res;
+    }
+
+    const pm3z_header_t *hdr = pm3z_header(pz);
+    if (start >= hdr->samples) {
+        PrintAndLogEx(WARNING, "start " _YELLOW_("%" PRIu64) " is past the end of the trace, " _YELLOW_("%" PRIu64) " samples", start, hdr->samples);
+        pm3z_close(pz);
+        return PM3_EINVARG;
+    }
+
+    if (count == 0 || count > hdr->samples - start) {
+        count = hdr->samples - start;
+    }
+    if (count >= GRAPH_TRACE_LEN_LIMIT) {
+        count = GRAPH_TRACE_LEN_LIMIT - 1;
+        PrintAndLogEx(WARNING, "trace truncated, graph can't grow past " _YELLOW_("%s") " samples", commaprint(count));
+    }
+
+    // decoded aside, a corrupt block leaves the graph as it was
+    int32_t *samples = calloc(count, sizeof(int32_t));
+    if (samples == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        pm3z_close(pz);
+        return PM3_EMALLOC;
+    }
+
+    size_t got = pm3z_read(pz, start, count, samples);
+    sample_config sc;
+    pm3z_get_config(pz, &sc);
+    pm3z_close(pz);
+
+    if (got != count) {
+        free(samples);
+        return PM3_EFILE;
+    }
+
+    if (reserveGraphBuffer(count) == false) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(samples);
+        return PM3_EMALLOC;
+    }
+
+    graphHistoryPush();
+    memcpy(g_GraphBuffer, samples, count * sizeof(int32_t));
+    g_GraphTraceLen = count;
+    free(samples);
+    graph_config_set(&sc);
+
+    if (sc.bits_per_sample) {
+        PrintAndLogEx(INFO, "Samples @ " _YELLOW_("%d") " bits/smpl, decimation 1:%d ", sc.bits_per_sample, sc.decimation);
+    }
+    return PM3_SUCCESS;
+}
+
 static int CmdLoad(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "data load",
-                  "This command loads the contents of a pm3 file into graph window\n",
-                  "data load -f myfilename"
+                  "This command loads the contents of a pm3 file into graph window\n"
+                  "Text (.pm3), 8-bit binary and compressed binary (.pm3z) files are supported.\n"
+                  "A part of a .pm3z file can be loaded with `--start` / `--len`",
+                  "data load -f myfilename\n"
+                  "data load -f myfilename.pm3z --start 100000 --len 20000"
                  );
 
     void *argtable[] = {
@@ -1970,6 +2305,8 @@ static int CmdLoad(const char *Cmd) {
         arg_str1("f", "file", "<fn>", "file to load"),
         arg_lit0("b", "bin", "binary file"),
         arg_lit0("n",  "no-fix",  "Load data from file without any transformations"),
+        arg_u64_0(NULL, "start", "<dec>", "first sample to load (pm3z)"),
+        arg_u64_0(NULL, "len", "<dec>", "number of samples to load (pm3z)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -1979,6 +2316,8 @@ static int CmdLoad(const char *Cmd) {
     CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
     bool is_bin = arg_get_lit(ctx, 2);
     bool nofix = arg_get_lit(ctx, 3);
+    uint64_t start = arg_get_u64_def(ctx, 4, 0);
+    uint64_t count = arg_get_u64_def(ctx, 5, 0);
     CLIParserFree(ctx);
 
     char *path = NULL;
@@ -1988,42 +2327,20 @@ static int CmdLoad(const char *Cmd) {
         }
     }
 
-    FILE *f;
-    if (is_bin)
-        f = fopen(path, "rb");
-    else
-        f = fopen(path, "r");
-
-    if (f == NULL) {
-        PrintAndLogEx(WARNING, "couldn't open `" _YELLOW_("%s") "`", path);
-        free(path);
-        return PM3_EFILE;
+    int res;
+    if (pm3z_is_pm3z(path)) {
+        res = load_graph_pm3z(path, start, count);
+    } else {
+        if (start || count) {
+            PrintAndLogEx(WARNING, "`--start` / `--len` only apply to pm3z files, loading all samples");
+        }
+        res = load_graph_file(path, is_bin);
     }
     free(path);
 
-    g_GraphTraceLen = 0;
-
-    if (is_bin) {
-        uint8_t val[2];
-        while (fread(val, 1, 1, f)) {
-            g_GraphBuffer[g_GraphTraceLen] = val[0] - 127;
-            g_GraphTraceLen++;
-
-            if (g_GraphTraceLen >= MAX_GRAPH_TRACE_LEN) {
-                break;
-            }
-        }
-    } else {
-        char line[80];
-        while (fgets(line, sizeof(line), f)) {
-            g_GraphBuffer[g_GraphTraceLen] = atoi(line);
-            g_GraphTraceLen++;
-
-            if (g_GraphTraceLen >= MAX_GRAPH_TRACE_LEN)
-                break;
-        }
+    if (res != PM3_SUCCESS) {
+        return res;
     }
-    fclose(f);
 
     PrintAndLogEx(SUCCESS, "loaded " _YELLOW_("%s") " samples", commaprint(g_GraphTraceLen));
 
@@ -2039,6 +2356,8 @@ static int CmdLoad(const char *Cmd) {
         setGraphBuffer(bits, size);
         computeSignalProperties(bits, size);
         free(bits);
+        // the offset removal is part of loading, the config still describes the samples
+        s_graph_config_gen = graphGeneration();
     }
 
     setClockGrid(0, 0);
@@ -2069,6 +2388,8 @@ int CmdLtrim(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    graphHistoryPush();
+
     for (size_t i = ds; i < g_GraphTraceLen; ++i) {
         g_GraphBuffer[i - ds] = g_GraphBuffer[i];
     }
@@ -2101,6 +2422,8 @@ static int CmdRtrim(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    graphHistoryPush();
+
     g_GraphTraceLen = ds;
     RepaintGraphWindow();
     return PM3_SUCCESS;
@@ -2133,6 +2456,8 @@ static int CmdMtrim(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    graphHistoryPush();
+
     // leave start position sample
     start++;
 
@@ -2160,6 +2485,8 @@ int CmdNorm(const char *Cmd) {
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     CLIParserFree(ctx);
 
+    graphHistoryPush();
+
     int max = INT_MIN, min = INT_MAX;
 
     // Find local min, max
@@ -2212,20 +2539,24 @@ int CmdSave(const char *Cmd) {
     CLIParserInit(&ctx, "data save",
                   "Save signal trace from graph window , i.e. the GraphBuffer\n"
                   "This is a text file with number -127 to 127.  With the option `w` you can save it as wave file\n"
+                  "With the option `z` it is saved as LZ4 compressed binary file, with the sampling config\n"
                   "Filename should be without file extension",
                   "data save -f myfilename         -> save graph buffer to file\n"
-                  "data save --wave -f myfilename  -> save graph buffer to wave file"
+                  "data save --wave -f myfilename  -> save graph buffer to wave file\n"
+                  "data save --pm3z -f myfilename  -> save graph buffer to compressed binary file"
                  );
 
     void *argtable[] = {
         arg_param_begin,
         arg_lit0("w", "wave", "save as wave format (.wav)"),
         arg_str1("f", "file", "<fn w/o ext>", "save file name"),
+        arg_lit0("z", "pm3z", "save as compressed binary format (.pm3z)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
 
     bool as_wave = arg_get_lit(ctx, 1);
+    bool as_pm3z = arg_get_lit(ctx, 3);
 
     int fnlen = 0;
     char filename[FILE_PATH_SIZE] = {0};
@@ -2238,8 +2569,15 @@ int CmdSave(const char *Cmd) {
         return PM3_SUCCESS;
     }
 
+    if (as_wave && as_pm3z) {
+        PrintAndLogEx(WARNING, "select only one of `--wave` and `--pm3z`");
+        return PM3_EINVARG;
+    }
+
     if (as_wave)
         return saveFileWAVE(filename, g_GraphBuffer, g_GraphTraceLen);
+    else if (as_pm3z)
+        return saveFilePM3Z(filename, g_GraphBuffer, g_GraphTraceLen, graph_config_get());
     else
         return saveFilePM3(filename, g_GraphBuffer, g_GraphTraceLen);
 }
@@ -2321,6 +2659,8 @@ static int CmdDirectionalThreshold(const char *Cmd) {
     int8_t up = arg_get_int(ctx, 2);
     CLIParserFree(ctx);
 
+    graphHistoryPush();
+
     PrintAndLogEx(INFO, "Applying up threshold: " _YELLOW_("%i") ", down threshold: " _YELLOW_("%i") "\n", up, down);
 
     directionalThreshold(g_GraphBuffer, g_GraphBuffer, g_GraphTraceLen, up, down);
@@ -2340,6 +2680,83 @@ static int CmdDirectionalThreshold(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static void print_graph_history(void) {
+    size_t undo = 0, redo = 0, bytes = 0;
+    graphHistoryStats(&undo, &redo, &bytes);
+    PrintAndLogEx(INFO, "GraphBuffer " _YELLOW_("%s") " samples, undo levels " _YELLOW_("%zu") ", redo levels " _YELLOW_("%zu") ", history " _YELLOW_("%zu") " KiB",
+                  commaprint(g_GraphTraceLen), undo, redo, bytes / 1024);
+}
+
+static int CmdUndo(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "data undo",
+                  "Undo the last operations on the GraphBuffer.\n"
+                  "Filters, trims, loads and reads keep up to 16 undo levels.\n"
+                  "Unchanged parts of the trace are shared between levels.",
+                  "data undo\n"
+                  "data undo -n 3    -> undo three operations\n"
+                  "data undo --info  -> show history levels"
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_int0("n", NULL, "<dec>", "number of operations to undo (def 1)"),
+        arg_lit0("i", "info", "only show history levels"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    int n = arg_get_int_def(ctx, 1, 1);
+    bool info = arg_get_lit(ctx, 2);
+    CLIParserFree(ctx);
+
+    int done = 0;
+    while (info == false && done < n && graphHistoryUndo()) {
+        done++;
+    }
+
+    if (info == false) {
+        if (done == 0) {
+            PrintAndLogEx(WARNING, "nothing to undo");
+        } else {
+            PrintAndLogEx(SUCCESS, "undid " _GREEN_("%d") " operation(s)", done);
+            RepaintGraphWindow();
+        }
+    }
+    print_graph_history();
+    return (info || done) ? PM3_SUCCESS : PM3_ESOFT;
+}
+
+static int CmdRedo(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "data redo",
+                  "Redo operations on the GraphBuffer undone by `data undo`.\n"
+                  "Any new operation on the GraphBuffer drops the redo levels.",
+                  "data redo\n"
+                  "data redo -n 3    -> redo three operations"
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_int0("n", NULL, "<dec>", "number of operations to redo (def 1)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    int n = arg_get_int_def(ctx, 1, 1);
+    CLIParserFree(ctx);
+
+    int done = 0;
+    while (done < n && graphHistoryRedo()) {
+        done++;
+    }
+
+    if (done == 0) {
+        PrintAndLogEx(WARNING, "nothing to redo");
+    } else {
+        PrintAndLogEx(SUCCESS, "redid " _GREEN_("%d") " operation(s)", done);
+        RepaintGraphWindow();
+    }
+    print_graph_history();
+    return (done) ? PM3_SUCCESS : PM3_ESOFT;
+}
+
 static int CmdZerocrossings(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "data zerocrossings",
@@ -2353,6 +2770,8 @@ static int CmdZerocrossings(const char *Cmd) {
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     CLIParserFree(ctx);
 
+    graphHistoryPush();
+
     // Zero-crossings aren't meaningful unless the signal is zero-mean.
     CmdHpf("");
 
@@ -2657,6 +3076,8 @@ static int CmdDataIIR(const char *Cmd) {
     uint8_t k = (arg_get_u32_def(ctx, 1, 0) & 0xFF);
     CLIParserFree(ctx);
 
+    graphHistoryPush();
+
     iceSimple_Filter(g_GraphBuffer, g_GraphTraceLen, k);
 
     uint8_t *bits = calloc(g_GraphTraceLen, sizeof(uint8_t));
@@ -2787,8 +3208,7 @@ static int try_detect_modulation(void) {
         clk = GetPskClock("", false);
         if (clk > 0) {
             // allow undo
-            buffer_savestate_t saveState = save_bufferS32(g_GraphBuffer, g_GraphTraceLen);
-            saveState.offset = g_GridOffset;
+            graph_snapshot_t *snap = graphSnapshotTake();
             // skip first 160 samples to allow antenna to settle in (psk gets inverted occasionally otherwise)
             CmdLtrim("-i 160");
             if ((PSKDemod(0, 0, 6, false) == PM3_SUCCESS)) {
@@ -2800,8 +3220,8 @@ static int try_detect_modulation(void) {
                 tests[hits].carrier = GetPskCarrier(false);
             }
             //undo trim samples
-            restore_bufferS32(saveState, g_GraphBuffer);
-            g_GridOffset = saveState.offset;
+            graphSnapshotRestore(snap);
+            graphSnapshotFree(snap);
         }
     }
 
@@ -3418,6 +3838,8 @@ static int CmdCenterThreshold(const char *Cmd) {
     int8_t up = arg_get_int(ctx, 2);
     CLIParserFree(ctx);
 
+    graphHistoryPush();
+
     PrintAndLogEx(INFO, "Applying up threshold: " _YELLOW_("%i") ", down threshold: " _YELLOW_("%i") "\n", up, down);
 
     centerThreshold(g_GraphBuffer, g_GraphBuffer, g_GraphTraceLen, up, down);
@@ -3471,6 +3893,8 @@ static int CmdEnvelope(const char *Cmd) {
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     CLIParserFree(ctx);
 
+    graphHistoryPush();
+
     envelope_square(g_GraphBuffer, g_GraphBuffer, g_GraphTraceLen);
 
     uint8_t *bits = calloc(g_GraphTraceLen, sizeof(uint8_t));
@@ -3976,6 +4400,263 @@ static int CmdTestSaveState32S(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// load a .pm3 trace as 8-bit samples, same conversion as data load / getFromGraphBuffer
+static size_t lfsimd_load_trace(const char *path, uint8_t **samples) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return 0;
+    }
+
+    size_t cap = MAX_GRAPH_TRACE_LEN;
+    uint8_t *buf = calloc(cap, sizeof(uint8_t));
+    if (buf == NULL) {
+        fclose(f);
+        return 0;
+    }
+
+    size_t n = 0;
+    char line[80];
+    while (fgets(line, sizeof(line), f) && n < GRAPH_TRACE_LEN_LIMIT) {
+        if (n == cap) {
+            uint8_t *tmp = realloc(buf, cap * 2);
+            if (tmp == NULL) {
+                break;
+            }
+            buf = tmp;
+            cap *= 2;
+        }
+        int v = atoi(line) + 128;
+        buf[n++] = (v < 0) ? 0 : (v > 255) ? 255 : v;
+    }
+    fclose(f);
+
+    *samples = buf;
+    return n;
+}
+
+typedef enum {
+    LFSIMD_K_OFFSET = 0,
+    LFSIMD_K_THRESHOLD,
+    LFSIMD_K_NEXT_RISE,
+    LFSIMD_K_NEXT_DIFF,
+    LFSIMD_K_SIGNAL,
+    LFSIMD_K_FSKDEMOD,
+    LFSIMD_K_COUNT
+} lfsimd_kernel_t;
+
+static const char *lfsimd_kernel_names[LFSIMD_K_COUNT] = {
+    "offset", "threshold", "next rise", "next diff", "signal props", "fskdemod"
+};
+
+// run every kernel once for the digest of its results, then time it
+static uint64_t lfsimd_run_trace(const uint8_t *samples, size_t n, uint8_t *work, uint32_t iterations, uint64_t *us) {
+    uint64_t digest = 0xcbf29ce484222325ULL;
+#define LFSIMD_MIX(x) digest = (digest ^ (uint64_t)(x)) * 0x100000001b3ULL
+
+    for (uint32_t it = 0; it <= iterations; it++) {
+        uint64_t t = usclock();
+        for (int off = -260; off <= 260; off += 65) {
+            memcpy(work, samples, n);
+            lfsimd_offset(work, n, off);
+            for (size_t i = 0; (it == 0) && (i < n); i++) LFSIMD_MIX(work[i]);
+        }
+        if (it) us[LFSIMD_K_OFFSET] += usclock() - t;
+
+        t = usclock();
+        for (int level = -1; level <= 257; level += 43) {
+            memcpy(work, samples, n);
+            lfsimd_threshold(work, n, level);
+            for (size_t i = 0; (it == 0) && (i < n); i++) LFSIMD_MIX(work[i]);
+        }
+        if (it) us[LFSIMD_K_THRESHOLD] += usclock() - t;
+
+        // edges of the raw samples and of a thresholded copy
+        memcpy(work, samples, n);
+        lfsimd_threshold(work, n, 128);
+
+        t = usclock();
+        size_t cnt = 0;
+        for (size_t i = lfsimd_next_rise(samples, 1, n); i < n; i = lfsimd_next_rise(samples, i + 1, n)) {
+            if (it == 0) LFSIMD_MIX(i);
+            cnt++;
+        }
+        for (size_t i = lfsimd_next_rise(work, 1, n); i < n; i = lfsimd_next_rise(work, i + 1, n)) {
+            if (it == 0) LFSIMD_MIX(i);
+            cnt++;
+        }
+        if (it) us[LFSIMD_K_NEXT_RISE] += usclock() - t;
+
+        t = usclock();
+        for (size_t i = 0; i < n; i = lfsimd_next_diff(work, i + 1, n, work[i])) {
+            if (it == 0) LFSIMD_MIX(i);
+            cnt++;
+        }
+        if (it) us[LFSIMD_K_NEXT_DIFF] += usclock() - t;
+        LFSIMD_MIX(cnt);
+
+        t = usclock();
+        memcpy(work, samples, n);
+        removeSignalOffset(work, n);
+        computeSignalProperties(work, n);
+        if (it) us[LFSIMD_K_SIGNAL] += usclock() - t;
+
+        const signal_t *sp = getSignalProperties();
+        LFSIMD_MIX(sp->low);
+        LFSIMD_MIX(sp->high);
+        LFSIMD_MIX(sp->mean);
+        LFSIMD_MIX(sp->isnoise);
+
+        // fskdemod runs on the offset removed samples, kept at the end of work
+        uint8_t *centered = work + n;
+        memcpy(centered, work, n);
+
+        t = usclock();
+        for (uint8_t inv = 0; inv < 2; inv++) {
+            int start = 0;
+            memcpy(work, centered, n);
+            size_t bits = fskdemod(work, n, 50, inv, 10, 8, &start);
+            if (it == 0) {
+                LFSIMD_MIX(bits);
+                LFSIMD_MIX(start);
+                for (size_t i = 0; i < bits; i++) LFSIMD_MIX(work[i]);
+            }
+        }
+        if (it) us[LFSIMD_K_FSKDEMOD] += usclock() - t;
+    }
+
+#undef LFSIMD_MIX
+    return digest;
+}
+
+static int CmdLFSimd(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "data lfsimd",
+                  "Benchmark the LF demod kernels with every SIMD engine this CPU supports\n"
+                  "and check they all give the same results as the scalar code.\n"
+                  "Uses the samples in GraphBuffer, or every .pm3 trace in a folder",
+                  "data lfsimd\n"
+                  "data lfsimd -d traces -n 1   --> check all traces in the traces folder"
+                 );
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str0("d", "dir", "<dir>", "folder with .pm3 traces"),
+        arg_u64_0("n", "iter", "<dec>", "iterations per kernel (def 10)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    int dlen = 0;
+    char dir[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 1), (uint8_t *)dir, FILE_PATH_SIZE - 2, &dlen);
+    uint32_t iterations = arg_get_u32_def(ctx, 2, 10);
+    CLIParserFree(ctx);
+
+    if (iterations == 0) {
+        iterations = 1;
+    }
+
+    lfsimd_engine_t engines[LFSIMD_ENGINES];
+    uint8_t engine_cnt = 0;
+    for (lfsimd_engine_t e = LFSIMD_NONE; e < LFSIMD_ENGINES; e++) {
+        if (lfsimd_supported(e)) {
+            engines[engine_cnt++] = e;
+        }
+    }
+
+    struct dirent **namelist = NULL;
+    int files = 0;
+    if (dlen) {
+        if (dir[dlen - 1] != '/') {
+            dir[dlen++] = '/';
+        }
+        files = scandir(dir, &namelist, NULL, alphasort);
+        if (files < 0) {
+            PrintAndLogEx(FAILED, "couldn't open folder `" _YELLOW_("%s") "`", dir);
+            return PM3_EFILE;
+        }
+    } else if (g_GraphTraceLen < SIGNAL_MIN_SAMPLES) {
+        PrintAndLogEx(WARNING, "GraphBuffer is empty, load a trace or use `-d`");
+        return PM3_EINVARG;
+    }
+
+    lfsimd_engine_t in_use = lfsimd_get_engine();
+    uint64_t us[LFSIMD_ENGINES][LFSIMD_K_COUNT];
+    memset(us, 0, sizeof(us));
+    uint32_t traces = 0, mismatches = 0;
+    uint64_t samples_total = 0;
+
+    for (int f = (dlen) ? 0 : -1; f < files; f++) {
+        uint8_t *samples = NULL;
+        size_t n;
+        char name[FILE_PATH_SIZE + 256] = "GraphBuffer";
+
+        if (f < 0) {
+            samples = calloc(g_GraphTraceLen, sizeof(uint8_t));
+            n = (samples) ? getFromGraphBuffer(samples) : 0;
+        } else {
+            if (str_endswith(namelist[f]->d_name, ".pm3") == false) {
+                continue;
+            }
+            snprintf(name, sizeof(name), "%s%s", dir, namelist[f]->d_name);
+            n = lfsimd_load_trace(name, &samples);
+        }
+
+        // the kernels work on a copy, fskdemod also keeps the offset removed samples
+        uint8_t *work = (n >= SIGNAL_MIN_SAMPLES) ? calloc(2 * n, sizeof(uint8_t)) : NULL;
+        if (work != NULL) {
+            uint64_t ref = 0;
+            for (uint8_t e = 0; e < engine_cnt; e++) {
+                lfsimd_set_engine(engines[e]);
+                uint64_t digest = lfsimd_run_trace(samples, n, work, iterations, us[engines[e]]);
+                if (e == 0) {
+                    ref = digest;
+                } else if (digest != ref) {
+                    PrintAndLogEx(FAILED, "%s differs from %s on " _YELLOW_("%s"), lfsimd_name(engines[e]), lfsimd_name(engines[0]), name);
+                    mismatches++;
+                }
+            }
+            traces++;
+            samples_total += n;
+        } else if (n >= SIGNAL_MIN_SAMPLES) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory for " _YELLOW_("%s"), name);
+        }
+        free(work);
+        free(samples);
+    }
+
+    for (int f = 0; f < files; f++) {
+        free(namelist[f]);
+    }
+    free(namelist);
+    lfsimd_set_engine(in_use);
+
+    // every kernel ran over samples_total samples, iterations times
+    PrintAndLogEx(INFO, "%u trace(s), %s samples, %u iteration(s), engine in use " _YELLOW_("%s"), traces, commaprint(samples_total), iterations, lfsimd_name(in_use));
+    char line[200] = {0};
+    snprintf(line, sizeof(line), " %-13s", "kernel");
+    for (uint8_t e = 0; e < engine_cnt; e++) {
+        snprintf(line + strlen(line), sizeof(line) - strlen(line), " | %8s ms", lfsimd_name(engines[e]));
+    }
+    PrintAndLogEx(INFO, "%s", line);
+    for (int k = 0; k < LFSIMD_K_COUNT; k++) {
+        snprintf(line, sizeof(line), " %-13s", lfsimd_kernel_names[k]);
+        for (uint8_t e = 0; e < engine_cnt; e++) {
+            snprintf(line + strlen(line), sizeof(line) - strlen(line), " | %11.2f", us[engines[e]][k] / 1000.0);
+        }
+        PrintAndLogEx(INFO, "%s", line);
+    }
+
+    if (traces == 0) {
+        PrintAndLogEx(WARNING, "no traces with enough samples");
+        return PM3_ESOFT;
+    }
+    if (mismatches) {
+        PrintAndLogEx(FAILED, "Equivalence........... ( " _RED_("fail") " )");
+        return PM3_ESOFT;
+    }
+    PrintAndLogEx(SUCCESS, "Equivalence........... ( " _GREEN_("ok") " )");
+    return PM3_SUCCESS;
+}
+
 static command_t CommandTable[] = {
     {"help",             CmdHelp,                 AlwaysAvailable,  "This help"},
     {"-----------",      CmdHelp,                 AlwaysAvailable, "------------------------- " _CYAN_("General") "-------------------------"},
@@ -4012,11 +4693,13 @@ static command_t CommandTable[] = {
     {"ltrim",            CmdLtrim,                AlwaysAvailable,  "Trim samples from left of trace"},
     {"mtrim",            CmdMtrim,                AlwaysAvailable,  "Trim out samples from the specified start to the specified stop"},
     {"norm",             CmdNorm,                 AlwaysAvailable,  "Normalize max/min to +/-128"},
+    {"redo",             CmdRedo,                 AlwaysAvailable,  "Redo operations undone on the graph"},
     {"rtrim",            CmdRtrim,                AlwaysAvailable,  "Trim samples from right of trace"},
     {"setgraphmarkers",  CmdSetGraphMarkers,      AlwaysAvailable,  "Set the markers in the graph window"},
     {"shiftgraphzero",   CmdGraphShiftZero,       AlwaysAvailable,  "Shift 0 for Graphed wave + or - shift value"},
     {"timescale",        CmdTimeScale,            AlwaysAvailable,  "Set cursor display timescale"},
     {"undecimate",       CmdUndecimate,           AlwaysAvailable,  "Un-decimate samples"},
+    {"undo",             CmdUndo,                 AlwaysAvailable,  "Undo operations on the graph"},
     {"zerocrossings",    CmdZerocrossings,        AlwaysAvailable,  "Count time between zero-crossings"},
 
     {"-----------",      CmdHelp,                 AlwaysAvailable, "------------------------- " _CYAN_("Operations") "-------------------------"},
@@ -4027,6 +4710,7 @@ static command_t CommandTable[] = {
     {"crypto",           CmdCryptography,         AlwaysAvailable,  "Encrypt and decrypt data"},
     {"diff",             CmdDiff,                 AlwaysAvailable,  "Diff of input files"},
     {"hexsamples",       CmdHexsamples,           IfPm3Present,     "Dump big buffer as hex bytes"},
+    {"lfsimd",           CmdLFSimd,               AlwaysAvailable,  "Benchmark and verify the LF demod SIMD kernels"},
     {"samples",          CmdSamples,              IfPm3Present,     "Get raw samples for graph window ( GraphBuffer )"},
 
     {"-----------",      CmdHelp,                 IfClientDebugEnabled, "------------------------- " _CYAN_("Debug") "-------------------------"},
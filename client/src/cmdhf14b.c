@@ -1974,6 +1974,7 @@ static int CmdHF14BRestore(const char *Cmd) {
         uint8_t out[ST25TB_SR_BLOCK_SIZE] = {0};
         status = read_sr_block(blockno, out, sizeof(out));
         if (status == PM3_SUCCESS) {
+            PrintAndLogFlush();
             if (memcmp(data + blockno * ST25TB_SR_BLOCK_SIZE, out, ST25TB_SR_BLOCK_SIZE) == 0) {
                 printf("\33[2K\r");
                 PrintAndLogEx(INFO, "SRx write block %d/%d ( " _GREEN_("ok") " )" NOLF, blockno, block_cnt - 1);
@@ -1982,6 +1983,7 @@ static int CmdHF14BRestore(const char *Cmd) {
                 PrintAndLogEx(INFO, "SRx write block %d/%d ( " _RED_("different") " )", blockno, block_cnt - 1);
             }
         } else {
+            PrintAndLogFlush();
             printf("\n");
             PrintAndLogEx(INFO, "Verifying block %d/%d ( " _RED_("failed") " )", blockno, block_cnt - 1);
         }
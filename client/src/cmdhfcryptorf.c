@@ -28,6 +28,8 @@
 #include "protocols.h"    // definitions of ISO14B protocol
 #include "iso14b.h"
 #include "cliparser.h"    // cliparsing
+#include "util.h"         // num_CPUs, kbd_enter_pressed
+#include "cryptorf/sma_recover.h"
 
 #define TIMEOUT 2000
 
@@ -529,16 +531,135 @@ static int CmdHFCryptoRFESave(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+static bool cryptorf_recover_progress(const sma_progress_t *p, void *ctx) {
+    (void)ctx;
+
+    if (kbd_enter_pressed()) {
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(WARNING, "\naborted via keyboard!");
+        return false;
+    }
+
+    switch (p->stage) {
+        case SMA_STAGE_RIGHT:
+            if (p->done == p->total) {
+                PrintAndLogEx(NORMAL, "");
+                PrintAndLogEx(INFO, "Right states.... " _YELLOW_("%u") ", top-bin " _YELLOW_("%u") " correct bits", p->right_count, p->right_topbits);
+                if (p->right_topbits < 96) {
+                    PrintAndLogEx(WARNING, "Right top-bin is smaller than 96 bits, better find another trace");
+                }
+            } else if ((p->done % 32) == 0) {
+                PrintAndLogEx(INPLACE, "Searching right states... %3" PRIu64 "%%", (p->done * 100) / p->total);
+            }
+            break;
+        case SMA_STAGE_LEFT:
+            if (p->done == 0) {
+                PrintAndLogEx(INFO, "Right state " _YELLOW_("%u") "/" _YELLOW_("%u") " ( 0x%07" PRIx64 " ), " _YELLOW_("%" PRIu64) " right candidates"
+                              , p->right_index + 1, p->right_count, p->right_state, p->right_candidates);
+            } else if (p->done == p->total) {
+                PrintAndLogEx(NORMAL, "");
+                PrintAndLogEx(INFO, "Left states..... " _YELLOW_("%" PRIu64), p->found);
+            } else if ((p->done % 16) == 0) {
+                PrintAndLogEx(INPLACE, "Searching left states... %3" PRIu64 "%%", (p->done * 100) / p->total);
+            }
+            break;
+        case SMA_STAGE_CANDIDATES:
+            if (p->done == p->total) {
+                PrintAndLogEx(NORMAL, "");
+                PrintAndLogEx(INFO, "Checked......... " _YELLOW_("%" PRIu64) " combinations", p->found);
+            } else if (p->done != 0) {
+                PrintAndLogEx(INPLACE, "Checking candidates... %3" PRIu64 "%%", (p->done * 100) / p->total);
+            }
+            break;
+    }
+    return true;
+}
+
+static int CmdHFCryptoRFRecover(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hf cryptorf recover",
+                  "Recover the secret seed Gc of a SecureMemory / CryptoRF tag from one sniffed authentication.\n"
+                  "Does not need a tag, takes minutes to hours depending on the trace and CPU count.",
+                  "hf cryptorf recover --ci ffffffffffffffff --q 1234567812345678 --ch 88c9d4466a501a87 --ci1 dec2ee1b1c9276e9\n"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_str1(NULL, "ci",  "<hex>", "Card nonce Ci, 8 hex bytes"),
+        arg_str1(NULL, "q",   "<hex>", "Reader nonce Q, 8 hex bytes"),
+        arg_str1(NULL, "ch",  "<hex>", "Reader challenge Ch, 8 hex bytes"),
+        arg_str1(NULL, "ci1", "<hex>", "Card answer Ci+1, 8 hex bytes"),
+        arg_int0("t", "threads", "<dec>", "Number of threads (def: number of CPUs)"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, false);
+
+    uint8_t ci[8] = {0};
+    uint8_t q[8] = {0};
+    uint8_t ch[8] = {0};
+    uint8_t ci1[8] = {0};
+    int ci_len = 0, q_len = 0, ch_len = 0, ci1_len = 0;
+    CLIGetHexWithReturn(ctx, 1, ci, &ci_len);
+    CLIGetHexWithReturn(ctx, 2, q, &q_len);
+    CLIGetHexWithReturn(ctx, 3, ch, &ch_len);
+    CLIGetHexWithReturn(ctx, 4, ci1, &ci1_len);
+    int threads = arg_get_int_def(ctx, 5, num_CPUs());
+    CLIParserFree(ctx);
+
+    if (ci_len != 8 || q_len != 8 || ch_len != 8 || ci1_len != 8) {
+        PrintAndLogEx(FAILED, "Ci, Q, Ch and Ci+1 must be 8 hex bytes each");
+        return PM3_EINVARG;
+    }
+
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    PrintAndLogEx(INFO, "Recovering with " _YELLOW_("%d") " threads, press " _GREEN_("<Enter>") " to abort", threads);
+
+    sma_options_t opts = {
+        .threads = (uint32_t)threads,
+        .progress = cryptorf_recover_progress,
+        .progress_ctx = NULL,
+    };
+
+    uint8_t gc[8] = {0};
+    sma_result_t res = sma_recover(ci, q, ch, ci1, &opts, gc);
+    PrintAndLogEx(NORMAL, "");
+
+    switch (res) {
+        case SMA_KEY_FOUND:
+            PrintAndLogEx(SUCCESS, "Valid key found [ " _GREEN_("%s") " ]", sprint_hex_inrow(gc, sizeof(gc)));
+            return PM3_SUCCESS;
+        case SMA_CANCELLED:
+            return PM3_EOPABORTED;
+        case SMA_EMALLOC:
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            return PM3_EMALLOC;
+        case SMA_KEY_NOT_FOUND:
+        default:
+            PrintAndLogEx(FAILED, "Could not find key, try another trace");
+            return PM3_ESOFT;
+    }
+}
+
+// The device side commands were never tested against real tags, they stay hidden unless the client debug is on
+static bool IfDebugPm3Iso14443b(void) {
+    return IfClientDebugEnabled() && IfPm3Iso14443b();
+}
+
 static command_t CommandTable[] = {
-    {"help",    CmdHelp,              AlwaysAvailable, "This help"},
-    {"dump",    CmdHFCryptoRFDump,    IfPm3Iso14443b,  "Read all memory pages of an CryptoRF tag, save to file"},
-    {"info",    CmdHFCryptoRFInfo,    IfPm3Iso14443b,  "Tag information"},
-    {"list",    CmdHFCryptoRFList,    AlwaysAvailable,  "List ISO 14443B history"},
-    {"reader",  CmdHFCryptoRFReader,  IfPm3Iso14443b,  "Act as a CryptoRF reader to identify a tag"},
-    {"sim",     CmdHFCryptoRFSim,     IfPm3Iso14443b,  "Fake CryptoRF tag"},
-    {"sniff",   CmdHFCryptoRFSniff,   IfPm3Iso14443b,  "Eavesdrop CryptoRF"},
-    {"eload",   CmdHFCryptoRFELoad,   AlwaysAvailable, "Upload file into emulator memory"},
-    {"esave",   CmdHFCryptoRFESave,   AlwaysAvailable, "Save emulator memory to file"},
+    {"help",    CmdHelp,              AlwaysAvailable,      "This help"},
+    {"recover", CmdHFCryptoRFRecover, AlwaysAvailable,      "Recover secret seed from a sniffed authentication"},
+    {"-----------", CmdHelp,          IfClientDebugEnabled, "------------------------- " _CYAN_("Debug") "-------------------------"},
+    {"dump",    CmdHFCryptoRFDump,    IfDebugPm3Iso14443b,  "Read all memory pages of an CryptoRF tag, save to file"},
+    {"info",    CmdHFCryptoRFInfo,    IfDebugPm3Iso14443b,  "Tag information"},
+    {"list",    CmdHFCryptoRFList,    IfClientDebugEnabled, "List ISO 14443B history"},
+    {"reader",  CmdHFCryptoRFReader,  IfDebugPm3Iso14443b,  "Act as a CryptoRF reader to identify a tag"},
+    {"sim",     CmdHFCryptoRFSim,     IfDebugPm3Iso14443b,  "Fake CryptoRF tag"},
+    {"sniff",   CmdHFCryptoRFSniff,   IfDebugPm3Iso14443b,  "Eavesdrop CryptoRF"},
+    {"eload",   CmdHFCryptoRFELoad,   IfClientDebugEnabled, "Upload file into emulator memory"},
+    {"esave",   CmdHFCryptoRFESave,   IfClientDebugEnabled, "Save emulator memory to file"},
     {NULL, NULL, NULL, NULL}
 };
 
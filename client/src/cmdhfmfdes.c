@@ -2205,6 +2205,7 @@ static int CmdHF14ADesBruteApps(const char *Cmd) {
         res = DesfireSelectAIDHexNoFieldOn(&dctx, id);
 
         if (res == PM3_SUCCESS) {
+            PrintAndLogFlush();
             printf("\33[2K\r"); // clear current line before printing
             PrintAndLogEx(SUCCESS, "Got new APPID " _GREEN_("%06X"), id);
         }
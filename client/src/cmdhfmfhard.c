@@ -44,6 +44,7 @@
 #include "hardnested_bf_core.h"
 #include "hardnested_bitarray_core.h"
 #include "fileutils.h"
+#include "traceevent.h"
 
 #define NUM_CHECK_BITFLIPS_THREADS      (num_CPUs())
 #define NUM_REDUCTION_WORKING_THREADS   (num_CPUs())
@@ -1583,6 +1584,7 @@ static int simulate_acquire_nonces(void) {
 }
 
 static int acquire_nonces(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, bool nonce_file_write, bool slow, char *filename) {
+    TRACE_SPAN("crack", "acquire nonces");
 
     last_sample_clock = msclock();
     hardnested_stage = CHECK_1ST_BYTES;
@@ -2240,6 +2242,7 @@ __attribute__((force_align_arg_pointer))
 
 
 static void generate_candidates(uint8_t sum_a0_idx, uint8_t sum_a8_idx) {
+    TRACE_SPAN("crack", "generate candidates");
 
     // create mutexes for accessing the statelist cache and our "book of work"
     pthread_mutex_init(&statelist_cache_mutex, NULL);
@@ -2309,6 +2312,7 @@ static void pre_XOR_nonces(void) {
 }
 
 static bool brute_force(uint64_t *found_key) {
+    TRACE_SPAN("crack", "brute force");
     if (known_target_key != -1) {
         TestIfKeyExists(known_target_key);
     }
@@ -2419,6 +2423,7 @@ static void init_it_all(void) {
 }
 
 int mfnestedhard(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *trgkey, bool nonce_file_read, bool nonce_file_write, bool slow, int tests, uint64_t *foundkey, char *filename) {
+    TRACE_SPAN("crack", "hardnested");
     char progress_text[80];
     char instr_set[12] = {0};
 
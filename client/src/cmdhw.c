@@ -39,11 +39,11 @@
 #include "pm3_cmd.h"
 #include "pmflash.h"        // rdv40validation_t
 #include "cmdflashmem.h"    // get_signature..
-#include "uart/uart.h"      // configure timeout
 #include "util_posix.h"
 #include "flash.h"          // reboot to bootloader mode
 #include "proxgui.h"
 #include "graph.h"          // for graph data
+#include "lz4chunk.h"       // self test
 
 #include "lua.h"
 
@@ -1274,7 +1274,7 @@ static int CmdTimeout(const char *Cmd) {
     int32_t arg = arg_get_int_def(ctx, 1, -1);
     CLIParserFree(ctx);
 
-    uint32_t oldTimeout = uart_get_timeouts();
+    uint32_t oldTimeout = GetCommunicationTimeout();
 
     // timeout is not given/invalid, just show the current timeout then return
     if (arg < 0) {
@@ -1289,7 +1289,7 @@ static int CmdTimeout(const char *Cmd) {
     } else if (newTimeout > 5000) {
         PrintAndLogEx(WARNING, "Timeout greater than 5000 ms makes the client unresponsive.");
     }
-    uart_reconfigure_timeouts(newTimeout);
+    SetCommunicationTimeout(newTimeout);
     PrintAndLogEx(INFO, "Old communication timeout... %u ms", oldTimeout);
     PrintAndLogEx(INFO, "New communication timeout... " _GREEN_("%u") " ms", newTimeout);
     return PM3_SUCCESS;
@@ -1348,6 +1348,286 @@ static int CmdPing(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// Packs src into chunks as the device does, unpacks them and compares
+static bool lz4chunk_roundtrip(const uint8_t *src, int srclen, uint8_t *dst, int *lz4_chunks, int *stored_chunks) {
+    uint8_t payload[LZ4CHUNK_PAYLOAD_SIZE];
+    memset(dst, 0xA5, srclen);
+    *lz4_chunks = 0;
+    *stored_chunks = 0;
+    for (int offset = 0; offset < srclen;) {
+        int rawlen = 0;
+        int n = lz4chunk_pack(src + offset, srclen - offset, payload, sizeof(payload), &rawlen);
+        if (n <= 1 || n > (int)sizeof(payload) || rawlen <= 0 || rawlen > srclen - offset) {
+            return false;
+        }
+        if (payload[0] == LZ4CHUNK_LZ4) {
+            (*lz4_chunks)++;
+        } else {
+            (*stored_chunks)++;
+        }
+        if (lz4chunk_unpack(payload, n, dst + offset, rawlen) != rawlen) {
+            return false;
+        }
+        offset += rawlen;
+    }
+    return (memcmp(src, dst, srclen) == 0);
+}
+
+static int lz4chunk_selftest(void) {
+
+    // two sample sized stretches with a stretch of noise in between
+    const int size = 3 * 4096;
+    uint8_t *src = calloc(size, sizeof(uint8_t));
+    uint8_t *dst = calloc(size, sizeof(uint8_t));
+    if (src == NULL || dst == NULL) {
+        free(src);
+        free(dst);
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    uint32_t x = 0x2545F491;
+    for (int i = 0; i < size; i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        src[i] = ((i / 4096) == 1) ? (x & 0xFF) : (((i / 32) & 1) ? 0xB0 : 0x40) + (x & 1);
+    }
+
+    struct {
+        const char *desc;
+        int offset;
+        int len;
+        bool lz4;       // expect compressed chunks
+        bool stored;    // expect stored chunks
+    } tests[] = {
+        {"compressible",             0,                                  4096, true,  false},
+        {"incompressible",           4096,                               4096, false, true},
+        {"mixed",                    0,                                  size, true,  true},
+        {"one byte",                 4096,                               1,    false, true},
+        {"payload - 2",              4096,          LZ4CHUNK_PAYLOAD_SIZE - 2, false, true},
+        {"payload - 1",              4096,          LZ4CHUNK_PAYLOAD_SIZE - 1, false, true},
+        {"payload",                  4096,              LZ4CHUNK_PAYLOAD_SIZE, false, true},
+        {"payload + 1",              4096,          LZ4CHUNK_PAYLOAD_SIZE + 1, false, true},
+        {"samples, payload - 1",     0,             LZ4CHUNK_PAYLOAD_SIZE - 1, true,  false},
+        {"noise into samples",       2 * 4096 - 100,                     1000, true,  false},
+        {"empty",                    0,                                  0,    false, false},
+    };
+
+    bool ok = true;
+    for (size_t i = 0; i < ARRAYLEN(tests); i++) {
+        int lz4_chunks = 0, stored_chunks = 0;
+        bool res = lz4chunk_roundtrip(src + tests[i].offset, tests[i].len, dst, &lz4_chunks, &stored_chunks);
+        res = res && ((lz4_chunks > 0) == tests[i].lz4) && ((stored_chunks > 0) == tests[i].stored);
+        PrintAndLogEx(INFO, "%-20s %5d bytes, %3d lz4 %3d stored chunks ( %s )"
+                      , tests[i].desc, tests[i].len, lz4_chunks, stored_chunks
+                      , (res) ? _GREEN_("ok") : _RED_("fail"));
+        ok &= res;
+    }
+
+    // corrupt chunks are refused
+    uint8_t payload[LZ4CHUNK_PAYLOAD_SIZE];
+    int rawlen = 0;
+    int n = lz4chunk_pack(src, 4096, payload, sizeof(payload), &rawlen);
+    bool res = (lz4chunk_unpack(payload, n - 1, dst, rawlen) < 0);
+    payload[0] = 0x7F;
+    res = res && (lz4chunk_unpack(payload, n, dst, rawlen) < 0);
+    n = lz4chunk_pack(src + 4096, 100, payload, sizeof(payload), &rawlen);
+    res = res && (lz4chunk_unpack(payload, n, dst, rawlen + 1) < 0);
+    res = res && (lz4chunk_unpack(payload, 1, dst, 0) < 0);
+    PrintAndLogEx(INFO, "%-20s ( %s )", "corrupt chunks", (res) ? _GREEN_("ok") : _RED_("fail"));
+    ok &= res;
+
+    free(src);
+    free(dst);
+    PrintAndLogEx(SUCCESS, "Tests ( %s )", (ok) ? _GREEN_("ok") : _RED_("fail"));
+    return (ok) ? PM3_SUCCESS : PM3_ESOFT;
+}
+
+static int CmdBench(const char *Cmd) {
+    CLIParserContext *ctx;
+    CLIParserInit(&ctx, "hw bench",
+                  "Measure the throughput of the link to the Proxmark3.\n"
+                  "Times round trips of full size pings, the same pings pipelined,\n"
+                  "then repeated downloads of the device BigBuf, plain and LZ4 compressed",
+                  "hw bench\n"
+                  "hw bench -n 20            -> 20 rounds of each\n"
+                  "hw bench -n 5 --len 8192  -> 5 rounds, 8192 bytes per download\n"
+                  "hw bench --test           -> self test of the compressed chunks, no device needed"
+                 );
+
+    void *argtable[] = {
+        arg_param_begin,
+        arg_u64_0("n", "rounds", "<dec>", "number of pings and downloads (def 10)"),
+        arg_u64_0("l", "len", "<dec>", "bytes per download (def whole BigBuf)"),
+        arg_lit0(NULL, "test", "self test of the LZ4 chunk packing used by compressed downloads"),
+        arg_param_end
+    };
+    CLIExecWithReturn(ctx, Cmd, argtable, true);
+    uint32_t rounds = arg_get_u32_def(ctx, 1, 10);
+    uint32_t len = arg_get_u32_def(ctx, 2, g_pm3_capabilities.bigbuf_size);
+    bool selftest = arg_get_lit(ctx, 3);
+    CLIParserFree(ctx);
+
+    if (selftest) {
+        return lz4chunk_selftest();
+    }
+
+    if (g_session.pm3_present == false) {
+        PrintAndLogEx(WARNING, "Not connected to a Proxmark3");
+        return PM3_ENOTTY;
+    }
+
+    if (rounds == 0) {
+        rounds = 1;
+    }
+    if (len == 0 || len > g_pm3_capabilities.bigbuf_size) {
+        len = g_pm3_capabilities.bigbuf_size;
+    }
+
+    uint8_t *buf = calloc(len, sizeof(uint8_t));
+    if (buf == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    uint8_t data[PM3_CMD_DATA_SIZE];
+    for (uint16_t i = 0; i < sizeof(data); i++) {
+        data[i] = i & 0xFF;
+    }
+
+    clearCommandBuffer();
+    PacketResponseNG resp;
+
+    // round trips, latency bound
+    uint64_t tms = msclock();
+    for (uint32_t i = 0; i < rounds; i++) {
+        SendCommandNG(CMD_PING, data, sizeof(data));
+        if (WaitForResponseTimeout(CMD_PING, &resp, 1000) == false) {
+            PrintAndLogEx(WARNING, "Ping response " _RED_("timeout"));
+            free(buf);
+            return PM3_ETIMEOUT;
+        }
+    }
+    tms = msclock() - tms;
+
+    PrintAndLogEx(INFO, "--- " _CYAN_("Link throughput") " ---------------------------");
+    PrintAndLogEx(SUCCESS, "Ping........... %u x %zu bytes in " _YELLOW_("%" PRIu64) " ms, %.2f ms per round trip"
+                  , rounds, sizeof(data), tms, (double)tms / rounds);
+
+    // the same pings pipelined, each one marked with its index
+    pm3_future_t *inflight[PM3_MAX_IN_FLIGHT];
+    uint32_t sent = 0, done = 0, bad = 0;
+    bool ok = true;
+    tms = msclock();
+    while (done < rounds) {
+
+        while (sent < rounds && sent - done < PM3_MAX_IN_FLIGHT) {
+            memcpy(data, &sent, sizeof(sent));
+            inflight[sent % PM3_MAX_IN_FLIGHT] = SendCommandAsync(CMD_PING, data, sizeof(data));
+            if (inflight[sent % PM3_MAX_IN_FLIGHT] == NULL) {
+                ok = false;
+                break;
+            }
+            sent++;
+        }
+
+        if (ok == false) {
+            break;
+        }
+
+        // the oldest one, later ones may well be done already
+        if (WaitForFuture(inflight[done % PM3_MAX_IN_FLIGHT], &resp, 1000) == false) {
+            ok = false;
+            done++;
+            break;
+        }
+
+        memcpy(data, &done, sizeof(done));
+        if (resp.cmd != CMD_PING || resp.length != sizeof(data) || memcmp(data, resp.data.asBytes, sizeof(data)) != 0) {
+            bad++;
+        }
+        done++;
+    }
+    tms = msclock() - tms;
+
+    if (ok == false) {
+        // release what is still outstanding
+        for (; done < sent; done++) {
+            WaitForFuture(inflight[done % PM3_MAX_IN_FLIGHT], NULL, 0);
+        }
+        PrintAndLogEx(WARNING, "Pipelined ping response " _RED_("timeout"));
+        free(buf);
+        return PM3_ETIMEOUT;
+    }
+
+    PrintAndLogEx(SUCCESS, "Pipelined...... %u x %zu bytes in " _YELLOW_("%" PRIu64) " ms, %.2f ms per command, %s replies, %s ( %s )"
+                  , rounds, sizeof(data), tms, (double)tms / rounds
+                  , (g_pm3_capabilities.tagged_frames) ? "tagged" : "untagged"
+                  , (g_pm3_capabilities.coalesced_frames) ? "coalesced writes" : "one write per frame"
+                  , (bad) ? _RED_("fail") : _GREEN_("ok"));
+
+    // bulk download, many frames back to back
+    dl_lz4_mode_t lz4_mode = SetDownloadCompression(DL_LZ4_OFF);
+    tms = msclock();
+    for (uint32_t i = 0; i < rounds; i++) {
+        if (GetFromDevice(BIG_BUF, buf, len, 0, NULL, 0, NULL, 2500, false) == false) {
+            PrintAndLogEx(WARNING, "Download " _RED_("failed"));
+            SetDownloadCompression(lz4_mode);
+            free(buf);
+            return PM3_ETIMEOUT;
+        }
+    }
+    tms = msclock() - tms;
+
+    uint64_t total = (uint64_t)rounds * len;
+    // the device answers with one frame per PM3_CMD_DATA_SIZE bytes
+    uint64_t frames = (uint64_t)rounds * ((len + PM3_CMD_DATA_SIZE - 1) / PM3_CMD_DATA_SIZE);
+    PrintAndLogEx(SUCCESS, "Download....... %u x %u bytes in " _YELLOW_("%" PRIu64) " ms", rounds, len, tms);
+    PrintAndLogEx(SUCCESS, "Throughput..... " _GREEN_("%.1f") " kB/s, %.0f frames/s"
+                  , (tms) ? (double)total / tms : 0.0
+                  , (tms) ? (double)frames * 1000 / tms : 0.0);
+
+    // the same downloads LZ4 compressed, checked against the plain one
+    if (g_pm3_capabilities.compressed_download) {
+
+        uint8_t *lz4buf = calloc(len, sizeof(uint8_t));
+        if (lz4buf == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            SetDownloadCompression(lz4_mode);
+            free(buf);
+            return PM3_EMALLOC;
+        }
+
+        SetDownloadCompression(DL_LZ4_ON);
+        bool same = true;
+        tms = msclock();
+        for (uint32_t i = 0; i < rounds; i++) {
+            if (GetFromDevice(BIG_BUF, lz4buf, len, 0, NULL, 0, NULL, 2500, false) == false) {
+                PrintAndLogEx(WARNING, "Compressed download " _RED_("failed"));
+                SetDownloadCompression(lz4_mode);
+                free(lz4buf);
+                free(buf);
+                return PM3_ETIMEOUT;
+            }
+            same &= (memcmp(buf, lz4buf, len) == 0);
+            memset(lz4buf, 0, len);
+        }
+        tms = msclock() - tms;
+        free(lz4buf);
+
+        PrintAndLogEx(SUCCESS, "Download LZ4... %u x %u bytes in " _YELLOW_("%" PRIu64) " ms, " _GREEN_("%.1f") " kB/s ( %s )"
+                      , rounds, len, tms
+                      , (tms) ? (double)total / tms : 0.0
+                      , (same) ? _GREEN_("ok") : _RED_("fail"));
+    }
+    SetDownloadCompression(lz4_mode);
+    free(buf);
+
+    PrintAndLogEx(NORMAL, "");
+    return PM3_SUCCESS;
+}
+
 static int CmdConnect(const char *Cmd) {
 
     CLIParserContext *ctx;
@@ -1466,6 +1746,7 @@ static command_t CommandTable[] = {
     {"timeout",       CmdTimeout,      AlwaysAvailable,  "Set the communication timeout on the client side"},
     {"version",       CmdVersion,      AlwaysAvailable,  "Show version information about the client and Proxmark3"},
     {"-------------", CmdHelp,         AlwaysAvailable,  "----------------------- " _CYAN_("Hardware") " -----------------------"},
+    {"bench",         CmdBench,        AlwaysAvailable,  "Measure the throughput of the link to the device"},
     {"break",         CmdBreak,        IfPm3Present,     "Send break loop usb command"},
     {"bootloader",    CmdBootloader,   IfPm3Present,     "Reboot into bootloader mode"},
     {"connect",       CmdConnect,      AlwaysAvailable,  "Connect to the device via serial port"},
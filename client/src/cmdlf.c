@@ -30,6 +30,7 @@
 #include "proxgui.h"
 #include "cliparser.h"      // args parsing
 #include "graph.h"          // for graph data
+#include "lflive.h"         // live demod of realtime samples
 #include "cmddata.h"        // for `lf search`
 #include "cmdhw.h"          // for setting FPGA image
 #include "cmdlfawid.h"      // for awid menu
@@ -70,6 +71,7 @@
 #include "crc.h"
 #include "pm3_cmd.h"        // for LF_CMDREAD_MAX_EXTRA_SYMBOLS
 #include "fpga.h"           // for set_fpga_mode
+#include "traceevent.h"
 
 static int CmdHelp(const char *Cmd);
 
@@ -742,7 +744,226 @@ int CmdLFConfig(const char *Cmd) {
     return lf_setconfig(&config);
 }
 
-static int lf_read_internal(bool realtime, bool verbose, uint64_t samples) {
+// feeds the live demod from the raw receive ring
+typedef struct {
+    lf_live_t *live;
+    size_t len;         // ring size
+    uint8_t group;      // bytes holding 8 samples
+    size_t fed;         // bytes handed to the live demod
+    size_t offset;      // ring position 0 in the capture
+    size_t skipped;
+} lf_live_feed_t;
+
+static void lf_live_progress(const uint8_t *buf, uint32_t received, void *ctx) {
+    lf_live_feed_t *f = (lf_live_feed_t *)ctx;
+
+    // received counts from offset on and may wrap in very long sessions
+    size_t total = f->fed + (uint32_t)(received - (uint32_t)(f->fed - f->offset));
+    if (total - f->fed > f->len) {
+        // overwritten before we got to it, go on with whole sample groups
+        size_t skip = total - f->fed - f->len;
+        skip += (f->group - (skip % f->group)) % f->group;
+        f->fed += skip;
+        f->skipped += skip;
+    }
+
+    while (f->fed < total) {
+        size_t at = (f->fed - f->offset) % f->len;
+        size_t n = MIN(total - f->fed, f->len - at);
+        lf_live_feed(f->live, buf + at, n);
+        f->fed += n;
+    }
+}
+
+// samples stream in as the device takes them. Asking for 0 samples with live
+// demodulation runs until <Enter>. A live capture only keeps the last
+// LF_LIVE_CAPTURE_LEN bytes, which end up in the graph.
+static int lf_realtime_internal(uint16_t cmd, lf_sample_payload_t *payload, const sample_config *config, uint64_t samples, bool verbose, bool live) {
+
+    const uint8_t bits_per_sample = config->bits_per_sample;
+    const bool is_trigger_threshold_set = (config->trigger_threshold > 0);
+    const uint8_t group = (bits_per_sample) ? bits_per_sample : 8;
+
+    size_t sample_bytes = samples * bits_per_sample;
+    sample_bytes = (sample_bytes / 8) + (sample_bytes % 8 != 0);
+    if (live && samples == 0) {
+        sample_bytes = SIZE_MAX;
+    }
+
+    size_t buf_len = sample_bytes;
+    if (live) {
+        buf_len = MIN(sample_bytes, (LF_LIVE_CAPTURE_LEN / group) * group);
+    }
+
+    uint8_t *realtimeBuf = calloc(MAX(buf_len, 1), sizeof(uint8_t));
+    if (realtimeBuf == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+
+    lf_live_feed_t feed = { NULL, buf_len, group, 0, 0, 0 };
+    if (live) {
+        feed.live = lf_live_start(bits_per_sample);
+        if (feed.live == NULL) {
+            PrintAndLogEx(WARNING, "Failed to start live demodulation");
+            free(realtimeBuf);
+            return PM3_EMALLOC;
+        }
+    }
+
+    // In real-time mode, the LF bitstream should be loaded before receiving raw data.
+    // Otherwise, the first batch of raw data might contain the response of CMD_WTX.
+    int result = set_fpga_mode(FPGA_BITSTREAM_LF);
+    if (result != PM3_SUCCESS) {
+        PrintAndLogEx(FAILED, "failed to load LF bitstream to FPGA");
+        lf_live_stop(feed.live);
+        free(realtimeBuf);
+        return result;
+    }
+
+    if (live) {
+        PrintAndLogEx(INFO, "Live demodulation of " _YELLOW_("EM 410x") " and " _YELLOW_("HID Prox") ", IDs show up as they are found");
+    }
+
+    SendCommandNG(cmd, (uint8_t *)payload, sizeof(lf_sample_payload_t));
+
+    size_t first_receive_len = 0;
+    if (is_trigger_threshold_set) {
+        first_receive_len = MIN(32, buf_len);
+        // Wait until a bunch of data arrives
+        first_receive_len = WaitForRawDataTimeout(realtimeBuf, first_receive_len, -1, false);
+        if (live) {
+            lf_live_progress(realtimeBuf, first_receive_len, &feed);
+        }
+    }
+
+    // the bytes after the trigger, a ring after the first ones when live
+    uint8_t *rest = realtimeBuf + first_receive_len;
+    feed.len = buf_len - first_receive_len;
+    feed.offset = first_receive_len;
+    if (live) {
+        feed.len -= feed.len % group;
+    }
+
+    size_t rest_bytes = WaitForRawDataTimeoutEx(rest, feed.len, sample_bytes - first_receive_len, 1000, true,
+                                                (live) ? lf_live_progress : NULL, &feed);
+    lf_live_stop(feed.live);
+
+    if (feed.skipped) {
+        PrintAndLogEx(WARNING, "Live demod missed %zu bytes", feed.skipped);
+    }
+
+    // what is left of the capture, in order
+    size_t got_bytes = first_receive_len + rest_bytes;
+    uint8_t *data = realtimeBuf;
+    if (rest_bytes > feed.len) {
+        size_t keep = feed.len - group;
+        size_t start = got_bytes - keep;
+        start += (group - (start % group)) % group;
+        keep = got_bytes - start;
+
+        data = calloc(keep, sizeof(uint8_t));
+        if (data == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            free(realtimeBuf);
+            return PM3_EMALLOC;
+        }
+        size_t at = (start - first_receive_len) % feed.len;
+        size_t n = MIN(keep, feed.len - at);
+        memcpy(data, rest + at, n);
+        memcpy(data + n, rest, keep - n);
+
+        PrintAndLogEx(INFO, "Graph holds the last %zu of %zu bytes", keep, got_bytes);
+        got_bytes = keep;
+    }
+
+    samples = got_bytes * 8 / group;
+    PrintAndLogEx(INFO, "Done: %" PRIu64 " samples (%zu bytes)", samples, got_bytes);
+    if (samples != 0) {
+        getSamplesFromBufEx(data, samples, bits_per_sample, verbose);
+    }
+
+    if (data != realtimeBuf) {
+        free(data);
+    }
+    free(realtimeBuf);
+    return PM3_SUCCESS;
+}
+
+// offline run of the live demod: the graph is packed the way the device sends
+// samples and handed over in uneven chunks through a small receive ring, like
+// lf_realtime_internal() does while the transfer runs
+#define LF_LIVE_GRAPH_RING  (8 * 1024)
+// a tag keeps sending, a short trace is replayed until the demod saw this many windows.
+// A window of silence between copies keeps the splice from decoding to a shifted ID
+#define LF_LIVE_GRAPH_MIN   (4 * LF_LIVE_WINDOW)
+#define LF_LIVE_GRAPH_GAP   LF_LIVE_WINDOW
+
+static int lf_live_graph(uint8_t bits_per_sample) {
+
+    const uint8_t group = (bits_per_sample == 0 || bits_per_sample > 8) ? 8 : bits_per_sample;
+    if (g_GraphTraceLen == 0) {
+        PrintAndLogEx(WARNING, "No samples in the graph");
+        return PM3_ENODATA;
+    }
+
+    size_t loops = (LF_LIVE_GRAPH_MIN + g_GraphTraceLen - 1) / g_GraphTraceLen;
+    size_t period = g_GraphTraceLen + LF_LIVE_GRAPH_GAP;
+    size_t samples = period * loops;
+    size_t len = ((samples * group) + 7) / 8;
+    uint8_t *packed = calloc(len, sizeof(uint8_t));
+    uint8_t *ring = calloc(LF_LIVE_GRAPH_RING, sizeof(uint8_t));
+    if (packed == NULL || ring == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(packed);
+        free(ring);
+        return PM3_EMALLOC;
+    }
+
+    // msb first, the top bits of each sample, as unpack_samples() expects them
+    size_t pos = 0;
+    for (size_t i = 0; i < samples; i++) {
+        size_t at = i % period;
+        int32_t v = (at < g_GraphTraceLen) ? g_GraphBuffer[at] : 0;
+        uint8_t val = (uint8_t)MAX(0, MIN(255, v + 127));
+        for (int b = 0; b < group; b++, pos++) {
+            packed[pos >> 3] |= ((val >> (7 - b)) & 1) << (7 - (pos & 7));
+        }
+    }
+
+    lf_live_feed_t feed = { NULL, (LF_LIVE_GRAPH_RING / group) * group, group, 0, 0, 0 };
+    feed.live = lf_live_start(bits_per_sample);
+    if (feed.live == NULL) {
+        PrintAndLogEx(WARNING, "Failed to start live demodulation");
+        free(packed);
+        free(ring);
+        return PM3_EMALLOC;
+    }
+
+    PrintAndLogEx(INFO, "Live demodulation of %zu graph samples, %zu time(s), " _YELLOW_("%u") " bps", g_GraphTraceLen, loops, group);
+
+    // sizes that don't line up with sample groups, the ring or the demod windows
+    static const size_t chunks[] = { 1, 7, 61, 509, 1021, 4093 };
+    size_t received = 0;
+    for (size_t c = 0; received < len; c++) {
+        size_t n = MIN(chunks[c % ARRAYLEN(chunks)], len - received);
+        for (size_t i = 0; i < n; i++, received++) {
+            ring[received % feed.len] = packed[received];
+        }
+        lf_live_progress(ring, (uint32_t)received, &feed);
+    }
+    lf_live_stop(feed.live);
+
+    if (feed.skipped) {
+        PrintAndLogEx(WARNING, "Live demod missed %zu bytes", feed.skipped);
+    }
+
+    free(packed);
+    free(ring);
+    return PM3_SUCCESS;
+}
+
+static int lf_read_internal(bool realtime, bool verbose, uint64_t samples, bool live) {
     if (!g_session.pm3_present) return PM3_ENOTTY;
 
     lf_sample_payload_t payload = {0};
@@ -760,41 +981,7 @@ static int lf_read_internal(bool realtime, bool verbose, uint64_t samples) {
     const bool is_trigger_threshold_set = (current_config.trigger_threshold > 0);
 
     if (realtime) {
-        uint8_t *realtimeBuf = calloc(samples, sizeof(uint8_t));
-        if (realtimeBuf == NULL) {
-            PrintAndLogEx(WARNING, "Failed to allocate memory");
-            return PM3_EMALLOC;
-        }
-
-        size_t sample_bytes = samples * bits_per_sample;
-        sample_bytes = (sample_bytes / 8) + (sample_bytes % 8 != 0);
-
-        // In real-time mode, the LF bitstream should be loaded before receiving raw data.
-        // Otherwise, the first batch of raw data might contain the response of CMD_WTX.
-        int result = set_fpga_mode(FPGA_BITSTREAM_LF);
-        if (result != PM3_SUCCESS) {
-            PrintAndLogEx(FAILED, "failed to load LF bitstream to FPGA");
-            free(realtimeBuf);
-            return result;
-        }
-
-        SendCommandNG(CMD_LF_ACQ_RAW_ADC, (uint8_t *)&payload, sizeof(payload));
-        if (is_trigger_threshold_set) {
-            size_t first_receive_len = 32;
-            // Wait until a bunch of data arrives
-            first_receive_len = WaitForRawDataTimeout(realtimeBuf, first_receive_len, -1, false);
-            sample_bytes = WaitForRawDataTimeout(realtimeBuf + first_receive_len, sample_bytes - first_receive_len, 1000, true);
-            sample_bytes += first_receive_len;
-        } else {
-            sample_bytes = WaitForRawDataTimeout(realtimeBuf, sample_bytes, 1000, true);
-        }
-        samples = sample_bytes * 8 / bits_per_sample;
-        PrintAndLogEx(INFO, "Done: %" PRIu64 " samples (%zu bytes)", samples, sample_bytes);
-        if (samples != 0) {
-            getSamplesFromBufEx(realtimeBuf, samples, bits_per_sample, verbose);
-        }
-
-        free(realtimeBuf);
+        return lf_realtime_internal(CMD_LF_ACQ_RAW_ADC, &payload, &current_config, samples, verbose, live);
     } else {
         payload.samples = (samples > MAX_LF_SAMPLES) ? MAX_LF_SAMPLES : samples;
         SendCommandNG(CMD_LF_ACQ_RAW_ADC, (uint8_t *)&payload, sizeof(payload));
@@ -818,7 +1005,8 @@ static int lf_read_internal(bool realtime, bool verbose, uint64_t samples) {
 }
 
 int lf_read(bool verbose, uint64_t samples) {
-    return lf_read_internal(false, verbose, samples);
+    TRACE_SPAN("lf", "lf read");
+    return lf_read_internal(false, verbose, samples, false);
 }
 
 int CmdLFRead(const char *Cmd) {
@@ -831,6 +1019,8 @@ int CmdLFRead(const char *Cmd) {
                   _CYAN_("it will try to use the real-time sampling mode."),
                   "lf read -v -s 12000   --> collect 12000 samples\n"
                   "lf read -s 3000 -@    --> oscilloscope style \n"
+                  "lf read --live        --> print tag IDs as they are read, until <Enter>\n"
+                  "lf read --live -1     --> same, from the samples in the graph buffer\n"
                  );
 
     void *argtable[] = {
@@ -838,27 +1028,47 @@ int CmdLFRead(const char *Cmd) {
         arg_u64_0("s", "samples", "<dec>", "number of samples to collect"),
         arg_lit0("v", "verbose", "verbose output"),
         arg_lit0("@", NULL, "continuous reading mode"),
+        arg_lit0(NULL, "live", "real-time mode, print EM 410x / HID IDs while sampling"),
+        arg_lit0("1", NULL, "with --live, demodulate the graph buffer instead of reading"),
+        arg_int0("b", "bps", "<1-8>", "with -1, bits per sample to pack the graph to (default 8)"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     uint64_t samples = arg_get_u64_def(ctx, 1, 0);
     bool verbose = arg_get_lit(ctx, 2);
     bool cm = arg_get_lit(ctx, 3);
+    bool live = arg_get_lit(ctx, 4);
+    bool use_graph = arg_get_lit(ctx, 5);
+    int bps = arg_get_int_def(ctx, 6, 8);
     CLIParserFree(ctx);
 
+    if (use_graph) {
+        if (live == false) {
+            PrintAndLogEx(WARNING, "-1 needs --live");
+            return PM3_EINVARG;
+        }
+        if (bps < 1 || bps > 8) {
+            PrintAndLogEx(WARNING, "bps must be 1 - 8");
+            return PM3_EINVARG;
+        }
+        return lf_live_graph(bps);
+    }
+
     // the 40000 there should be the result of BigBuf_max_traceLen(),
     // but IDK how to get it.
-    bool realtime = samples > 40000;
+    bool realtime = (samples > 40000) || live;
 
-    if (g_session.pm3_present == false)
+    if (g_session.pm3_present == false) {
+        PrintAndLogEx(WARNING, "Not connected to a Proxmark3, use " _YELLOW_("`lf read --live -1`") " on a loaded trace");
         return PM3_ENOTTY;
+    }
 
     if (cm || realtime) {
         PrintAndLogEx(INFO, "Press " _GREEN_("<Enter>") " to exit");
     }
     int ret = PM3_SUCCESS;
     do {
-        ret = lf_read_internal(realtime, verbose, samples);
+        ret = lf_read_internal(realtime, verbose, samples, live);
     } while (cm && (kbd_enter_pressed() == false));
 
     if (ret == PM3_SUCCESS) {
@@ -871,7 +1081,7 @@ int CmdLFRead(const char *Cmd) {
     return ret;
 }
 
-int lf_sniff(bool realtime, bool verbose, uint64_t samples) {
+static int lf_sniff_internal(bool realtime, bool verbose, uint64_t samples, bool live) {
     if (!g_session.pm3_present) return PM3_ENOTTY;
 
     lf_sample_payload_t payload = {0};
@@ -889,41 +1099,7 @@ int lf_sniff(bool realtime, bool verbose, uint64_t samples) {
     const bool is_trigger_threshold_set = (current_config.trigger_threshold > 0);
 
     if (realtime) {
-        uint8_t *realtimeBuf = calloc(samples, sizeof(uint8_t));
-        if (realtimeBuf == NULL) {
-            PrintAndLogEx(WARNING, "Failed to allocate memory");
-            return PM3_EMALLOC;
-        }
-
-        size_t sample_bytes = samples * bits_per_sample;
-        sample_bytes = (sample_bytes / 8) + (sample_bytes % 8 != 0);
-
-        // In real-time mode, the LF bitstream should be loaded before receiving raw data.
-        // Otherwise, the first batch of raw data might contain the response of CMD_WTX.
-        int result = set_fpga_mode(FPGA_BITSTREAM_LF);
-        if (result != PM3_SUCCESS) {
-            PrintAndLogEx(FAILED, "failed to load LF bitstream to FPGA");
-            free(realtimeBuf);
-            return result;
-        }
-
-        SendCommandNG(CMD_LF_SNIFF_RAW_ADC, (uint8_t *)&payload, sizeof(payload));
-        if (is_trigger_threshold_set) {
-            size_t first_receive_len = 32;
-            // Wait until a bunch of data arrives
-            first_receive_len = WaitForRawDataTimeout(realtimeBuf, first_receive_len, -1, false);
-            sample_bytes = WaitForRawDataTimeout(realtimeBuf + first_receive_len, sample_bytes - first_receive_len, 1000, true);
-            sample_bytes += first_receive_len;
-        } else {
-            sample_bytes = WaitForRawDataTimeout(realtimeBuf, sample_bytes, 1000, true);
-        }
-        samples = sample_bytes * 8 / bits_per_sample;
-        PrintAndLogEx(INFO, "Done: %" PRIu64 " samples (%zu bytes)", samples, sample_bytes);
-        if (samples != 0) {
-            getSamplesFromBufEx(realtimeBuf, samples, bits_per_sample, verbose);
-        }
-
-        free(realtimeBuf);
+        return lf_realtime_internal(CMD_LF_SNIFF_RAW_ADC, &payload, &current_config, samples, verbose, live);
     } else {
         payload.samples = (samples > MAX_LF_SAMPLES) ? MAX_LF_SAMPLES : samples;
         SendCommandNG(CMD_LF_SNIFF_RAW_ADC, (uint8_t *)&payload, sizeof(payload));
@@ -944,6 +1120,11 @@ int lf_sniff(bool realtime, bool verbose, uint64_t samples) {
     return PM3_SUCCESS;
 }
 
+int lf_sniff(bool realtime, bool verbose, uint64_t samples) {
+    TRACE_SPAN("lf", "lf sniff");
+    return lf_sniff_internal(realtime, verbose, samples, false);
+}
+
 int CmdLFSniff(const char *Cmd) {
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "lf sniff",
@@ -957,6 +1138,7 @@ int CmdLFSniff(const char *Cmd) {
                   _CYAN_("it will try to use the real-time sampling mode."),
                   "lf sniff -v\n"
                   "lf sniff -s 3000 -@    --> oscilloscope style \n"
+                  "lf sniff --live        --> print tag IDs as they are sniffed, until <Enter>\n"
                  );
 
     void *argtable[] = {
@@ -964,17 +1146,19 @@ int CmdLFSniff(const char *Cmd) {
         arg_u64_0("s", "samples", "<dec>", "number of samples to collect"),
         arg_lit0("v", "verbose", "verbose output"),
         arg_lit0("@", NULL, "continuous sniffing mode"),
+        arg_lit0(NULL, "live", "real-time mode, print EM 410x / HID IDs while sampling"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, true);
     uint64_t samples = arg_get_u64_def(ctx, 1, 0);
     bool verbose = arg_get_lit(ctx, 2);
     bool cm = arg_get_lit(ctx, 3);
+    bool live = arg_get_lit(ctx, 4);
     CLIParserFree(ctx);
 
     // the 40000 there should be the result of BigBuf_max_traceLen(),
     // but IDK how to get it.
-    bool realtime = samples > 40000;
+    bool realtime = (samples > 40000) || live;
 
     if (g_session.pm3_present == false)
         return PM3_ENOTTY;
@@ -984,7 +1168,7 @@ int CmdLFSniff(const char *Cmd) {
     }
     int ret = PM3_SUCCESS;
     do {
-        ret = lf_sniff(realtime, verbose, samples);
+        ret = lf_sniff_internal(realtime, verbose, samples, live);
     } while (cm && (kbd_enter_pressed() == false));
     return ret;
 }
@@ -1566,8 +1750,7 @@ static bool check_chiptype(bool getDeviceData) {
     }
 
     //Save the state of the Graph and Demod Buffers
-    buffer_savestate_t saveState_gb = save_bufferS32(g_GraphBuffer, g_GraphTraceLen);
-    saveState_gb.offset = g_GridOffset;
+    graph_snapshot_t *snap_gb = graphSnapshotTake();
     buffer_savestate_t saveState_db = save_buffer8(g_DemodBuffer, g_DemodBufferLen);
     saveState_db.clock = g_DemodClock;
     saveState_db.offset = g_DemodStartIdx;
@@ -1642,8 +1825,8 @@ out:
     g_DemodClock = saveState_db.clock;
     g_DemodStartIdx = saveState_db.offset;
 
-    restore_bufferS32(saveState_gb, g_GraphBuffer);
-    g_GridOffset = saveState_gb.offset;
+    graphSnapshotRestore(snap_gb);
+    graphSnapshotFree(snap_gb);
 
     return retval;
 }
@@ -1688,6 +1871,7 @@ static int check_autocorrelate(const char *prefix, int clock) {
 }
 
 int CmdLFfind(const char *Cmd) {
+    TRACE_SPAN("demod", "lf search");
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "lf search",
@@ -2144,7 +2328,7 @@ static command_t CommandTable[] = {
     {"-----------", CmdHelp,            AlwaysAvailable, "--------------------- " _CYAN_("General") " ---------------------"},
     {"config",      CmdLFConfig,        IfPm3Lf,         "Get/Set config for LF sampling, bit/sample, decimation, frequency"},
     {"cmdread",     CmdLFCommandRead,   IfPm3Lf,         "Modulate LF reader field to send command before read"},
-    {"read",        CmdLFRead,          IfPm3Lf,         "Read LF tag"},
+    {"read",        CmdLFRead,          AlwaysAvailable, "Read LF tag"},
     {"search",      CmdLFfind,          AlwaysAvailable, "Read and Search for valid known tag"},
     {"sim",         CmdLFSim,           IfPm3Lf,         "Simulate LF tag from buffer"},
     {"simask",      CmdLFaskSim,        IfPm3Lf,         "Simulate " _YELLOW_("ASK") " tag"},
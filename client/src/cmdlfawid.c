@@ -149,7 +149,7 @@ static int CmdAWIDWatch(const char *Cmd) {
 //print full AWID Prox ID and some bit format details if found
 int demodAWID(bool verbose) {
     (void) verbose; // unused so far
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    uint8_t *bits = calloc(GRAPH_SCRATCH_LEN, sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return PM3_EMALLOC;
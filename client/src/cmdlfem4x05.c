@@ -42,6 +42,7 @@
 #include "cliparser.h"
 #include "cmdhw.h"
 #include "util.h"
+#include "lfsniff.h"       // downlink decoders
 
 //////////////// 4205 / 4305 commands
 
@@ -2264,84 +2265,29 @@ int CmdEM4x05Unlock(const char *Cmd) {
     return exit_code;
 }
 
-static size_t em4x05_Sniff_GetNextBitStart(size_t idx, size_t sc, const int *data, size_t *pulsesamples) {
-    while ((idx < sc) && (data[idx] <= 10)) // find a going high
-        idx++;
+static void em4x05_sniff_print(const lfsniff_record_t *rec, void *ctx) {
+    (void)ctx;
 
-    while ((idx < sc) && (data[idx] > -10)) // find going low  may need to add something here it SHOULD be a small clk around 0, but white seems to extend a bit.
-        idx++;
-
-    (*pulsesamples) = 0;
-    while ((idx < sc) && ((data[idx + 1] - data[idx]) < 10)) { // find "sharp rise"
-        (*pulsesamples)++;
-        idx++;
-    }
-
-    return idx;
-}
-
-static uint32_t em4x05_Sniff_GetBlock(const char *bits, bool fwd) {
-    uint32_t value = 0;
-    uint8_t idx;
-    bool parityerror = false;
-    uint8_t parity;
-
-    parity = 0;
-    for (idx = 0; idx < 8; idx++) {
-        value <<= 1;
-        value += (bits[idx] - '0');
-        parity += (bits[idx] - '0');
+    if (rec->trimmed) {
+        PrintAndLogEx(INFO, "Trim leading 0");
     }
-
-    parity = parity % 2;
-    if (parity != (bits[8] - '0'))
-        parityerror = true;
-
-    parity = 0;
-    for (idx = 9; idx < 17; idx++) {
-        value <<= 1;
-        value += (bits[idx] - '0');
-        parity += (bits[idx] - '0');
+    if (rec->parity_error) {
+        PrintAndLogEx(ERR, "parity error : ");
     }
 
-    parity = parity % 2;
-    if (parity != (bits[17] - '0'))
-        parityerror = true;
-
-    parity = 0;
-
-    for (idx = 18; idx < 26; idx++) {
-        value <<= 1;
-        value += (bits[idx] - '0');
-        parity += (bits[idx] - '0');
+    char dataText[10] = " ";
+    if (rec->has_data || rec->has_password) {
+        snprintf(dataText, sizeof(dataText), "%08X", (rec->has_data) ? rec->data : rec->password);
     }
-
-    parity = parity % 2;
-    if (parity != (bits[26] - '0'))
-        parityerror = true;
-
-    parity = 0;
-    for (idx = 27; idx < 35; idx++) {
-        value <<= 1;
-        value += (bits[idx] - '0');
-        parity += (bits[idx] - '0');
+    char blkAddr[4] = " ";
+    if (rec->block >= 0) {
+        snprintf(blkAddr, sizeof(blkAddr), "%d", rec->block);
     }
 
-    parity = parity % 2;
-    if (parity != (bits[35] - '0'))
-        parityerror = true;
-
-    if (parityerror)
-        PrintAndLogEx(ERR, "parity error : ");
-
-    if (fwd == false) {
-        uint32_t t1 = value;
-        value = 0;
-        for (idx = 0; idx < 32; idx++) {
-            value |= (((t1 >> idx) & 1) << (31 - idx));
-        }
-    }
-    return value;
+    if (rec->has_password)
+        PrintAndLogEx(SUCCESS, "%6" PRIu64 " | %-10s  | " _YELLOW_("%8s")" | " _YELLOW_("%3s")" | %s", rec->offset, rec->cmd, dataText, blkAddr, rec->bits);
+    else
+        PrintAndLogEx(SUCCESS, "%6" PRIu64 " | %-10s  | " _GREEN_("%8s")" | " _GREEN_("%3s")" | %s", rec->offset, rec->cmd, dataText, blkAddr, rec->bits);
 }
 
 int CmdEM4x05Sniff(const char *Cmd) {
@@ -2365,14 +2311,6 @@ int CmdEM4x05Sniff(const char *Cmd) {
     bool fwd = arg_get_lit(ctx, 2);
     CLIParserFree(ctx);
 
-    const char *cmdText;
-    char dataText[100] = {0};
-    char blkAddr[4] = {0};
-    int i;
-    int ZeroWidth;    // 32-42 "1" is 32
-    int CycleWidth;
-    size_t pulseSamples;
-
     // setup and sample data from Proxmark
     // if not directed to existing sample/graphbuffer
     if (sampleData) {
@@ -2389,138 +2327,15 @@ int CmdEM4x05Sniff(const char *Cmd) {
     PrintAndLogEx(SUCCESS, "offset | Command     |   Data   | blk | raw");
     PrintAndLogEx(SUCCESS, "-------+-------------+----------+-----+------------------------------------------------------------");
 
-    smartbuf bits = { 0 };
-    bits.ptr = calloc(EM4X05_BITS_BUFSIZE, sizeof(uint8_t));
-    bits.size = EM4X05_BITS_BUFSIZE;
-    bits.idx = 0;
-    size_t idx = 0;
-    // loop though sample buffer
-    while (idx < g_GraphTraceLen) {
-        bool haveData = false;
-        bool pwd = false;
-
-        idx = em4x05_Sniff_GetNextBitStart(idx, g_GraphTraceLen, g_GraphBuffer, &pulseSamples);
-        size_t pktOffset = idx;
-        if (pulseSamples >= 10)  { // Should be 18 so a bit less to allow for processing
-
-            // Use first bit to get "0" bit samples as a reference
-            ZeroWidth = idx;
-            idx = em4x05_Sniff_GetNextBitStart(idx, g_GraphTraceLen, g_GraphBuffer, &pulseSamples);
-            ZeroWidth = idx - ZeroWidth;
-
-            if (ZeroWidth <= 50) {
-                pktOffset -= ZeroWidth;
-                memset(bits.ptr, 0, bits.size);
-                bits.idx = 0;
-
-                bool eop = false;
-                while ((idx < g_GraphTraceLen) && !eop) {
-                    CycleWidth = idx;
-                    idx = em4x05_Sniff_GetNextBitStart(idx, g_GraphTraceLen, g_GraphBuffer, &pulseSamples);
-
-                    CycleWidth = idx - CycleWidth;
-                    if ((CycleWidth > 300) || (CycleWidth < (ZeroWidth - 5))) { // to long or too short
-                        eop = true;
-                        sb_append_char(&bits, '0');   // Append last zero from the last bit find
-                        cmdText = "";
-
-                        // EM4305 command lengths
-                        // Login        0011 <pwd>          => 4 +     45 => 49
-                        // Write Word   0101 <adr> <data>   => 4 + 7 + 45 => 56
-                        // Read Word    1001 <adr>          => 4 + 7      => 11
-                        // Protect      1100       <data>   => 4 +     45 => 49
-                        // Disable      1010       <data>   => 4 +     45 => 49
-                        // -> disable 1010 11111111 0 11111111 0 11111111 0 11111111 0 00000000 0
-
-                        // Check to see if we got the leading 0
-                        if (((strncmp(bits.ptr, "00011", 5) == 0) && (bits.idx == 50)) ||
-                                ((strncmp(bits.ptr, "00101", 5) == 0) && (bits.idx == 57)) ||
-                                ((strncmp(bits.ptr, "01001", 5) == 0) && (bits.idx == 12)) ||
-                                ((strncmp(bits.ptr, "01100", 5) == 0) && (bits.idx == 50)) ||
-                                ((strncmp(bits.ptr, "01010", 5) == 0) && (bits.idx == 50))) {
-                            memmove(bits.ptr, &bits.ptr[1], bits.idx - 1);
-                            bits.idx--;
-                            PrintAndLogEx(INFO, "Trim leading 0");
-                        }
-                        sb_append_char(&bits, 0);
-                        bits.idx--;
-
-                        // logon
-                        if ((strncmp(bits.ptr, "0011", 4) == 0) && (bits.idx == 49)) {
-                            haveData = true;
-                            pwd = true;
-                            cmdText = "Logon";
-                            strncpy(blkAddr, "   ",  sizeof(blkAddr));
-                            uint32_t tmpValue = em4x05_Sniff_GetBlock(&bits.ptr[4], fwd);
-                            snprintf(dataText, sizeof(dataText), "%08X", tmpValue);
-                        }
-
-                        // write
-                        if ((strncmp(bits.ptr, "0101", 4) == 0) && (bits.idx == 56)) {
-                            haveData = true;
-                            cmdText = "Write";
-                            uint32_t tmpValue = (bits.ptr[4] - '0') + ((bits.ptr[5] - '0') << 1) + ((bits.ptr[6] - '0') << 2)  + ((bits.ptr[7] - '0') << 3);
-                            snprintf(blkAddr, sizeof(blkAddr), "%u", tmpValue);
-                            if (tmpValue == 2) {
-                                pwd = true;
-                            }
-                            tmpValue = em4x05_Sniff_GetBlock(&bits.ptr[11], fwd);
-                            snprintf(dataText, sizeof(dataText), "%08X", tmpValue);
-                        }
-
-                        // read
-                        if ((strncmp(bits.ptr, "1001", 4) == 0) && (bits.idx == 11)) {
-                            haveData = true;
-                            pwd = false;
-                            cmdText = "Read";
-                            uint32_t tmpValue = (bits.ptr[4] - '0') + ((bits.ptr[5] - '0') << 1) + ((bits.ptr[6] - '0') << 2)  + ((bits.ptr[7] - '0') << 3);
-                            snprintf(blkAddr, sizeof(blkAddr), "%u", tmpValue);
-                            strncpy(dataText, " ", sizeof(dataText));
-                        }
-
-                        // protect
-                        if ((strncmp(bits.ptr, "1100", 4) == 0) && (bits.idx == 49)) {
-                            haveData = true;
-                            pwd = false;
-                            cmdText = "Protect";
-                            strncpy(blkAddr, " ",  sizeof(blkAddr));
-                            uint32_t tmpValue = em4x05_Sniff_GetBlock(&bits.ptr[11], fwd);
-                            snprintf(dataText, sizeof(dataText), "%08X", tmpValue);
-                        }
-
-                        // disable
-                        if ((strncmp(bits.ptr, "1010", 4) == 0) && (bits.idx == 49)) {
-                            haveData = true;
-                            pwd = false;
-                            cmdText = "Disable";
-                            strncpy(blkAddr, " ",  sizeof(blkAddr));
-                            uint32_t tmpValue = em4x05_Sniff_GetBlock(&bits.ptr[11], fwd);
-                            snprintf(dataText, sizeof(dataText), "%08X", tmpValue);
-                        }
-
-                        //  bits[bitidx] = 0;
-                    } else {
-                        i = (CycleWidth - ZeroWidth) / 28;
-                        sb_append_char(&bits, '0');
-                        for (int ii = 0; ii < i; ii++) {
-                            sb_append_char(&bits, '1');
-                        }
-                    }
-                }
-            }
-        }
-        idx++;
-
-        // Print results
-        if (haveData) { //&& (minWidth > 1) && (maxWidth > minWidth)){
-            if (pwd)
-                PrintAndLogEx(SUCCESS, "%6zu | %-10s  | " _YELLOW_("%8s")" | " _YELLOW_("%3s")" | %s", pktOffset, cmdText, dataText, blkAddr, bits.ptr);
-            else
-                PrintAndLogEx(SUCCESS, "%6zu | %-10s  | " _GREEN_("%8s")" | " _GREEN_("%3s")" | %s", pktOffset, cmdText, dataText, blkAddr, bits.ptr);
-        }
+    lfsniff_opts_t opts = { .fwd = fwd };
+    lfsniff_t *sniff = lfsniff_new(LFSNIFF_EM4X05, &opts, em4x05_sniff_print, NULL);
+    if (sniff == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
     }
-    free(bits.ptr);
-    bits.ptr = NULL;
+    lfsniff_feed(sniff, g_GraphBuffer, g_GraphTraceLen);
+    lfsniff_finish(sniff);
+    lfsniff_free(sniff);
 
     // footer
     PrintAndLogEx(SUCCESS, "---------------------------------------------------------------------------------------------------");
@@ -27,7 +27,6 @@
 #define EM4305_PROT2_BLOCK  15
 #define EM4469_PROT_BLOCK   3
 
-#define EM4X05_BITS_BUFSIZE 128
 #define EM4X05_BLOCK_SIZE   4
 
 // config blocks
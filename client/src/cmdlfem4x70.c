@@ -384,30 +384,47 @@ static int setpin_em4x70(const em4x70_cmd_input_setpin_t *opts, em4x70_tag_info_
     return resp.status;
 }
 
+static bool recover_em4x70_progress(uint32_t completed, uint32_t total, void *context) {
+    uint32_t *last_percent = (uint32_t *)context;
+    if (kbd_enter_pressed()) {
+        PrintAndLogEx(NORMAL, "");
+        PrintAndLogEx(WARNING, "\naborted via keyboard!");
+        return false;
+    }
+    uint32_t percent = (completed * 100) / total;
+    if (percent >= *last_percent + 10) {
+        PrintAndLogEx(INPLACE, "Searching... %3u%%", percent);
+        *last_percent = percent;
+    }
+    return true;
+}
+
 static int recover_em4x70(const em4x70_cmd_input_recover_t *opts, em4x70_cmd_output_recover_t *data_out) {
     memset(data_out, 0, sizeof(em4x70_cmd_output_recover_t));
 
-    // The library is stateful.  First must initialize its internal context.
-    id48lib_key_recovery_init(&opts->key, &opts->nonce, &opts->frn, &opts->grn);
-
-    // repeatedly call id48lib_key_recovery_next() to get the next potential key
-    ID48LIB_KEY q;
-    int result = PM3_SUCCESS;
-
-    while ((PM3_SUCCESS == result) && id48lib_key_recovery_next(&q)) {
+    // The search space is split across all CPUs, results are in the same order as a serial search
+    size_t count = 0;
+    uint32_t last_percent = 0;
+    ID48LIB_RECOVERY_RESULT r = id48lib_key_recovery_parallel(
+                                    &opts->key, &opts->nonce, &opts->frn, &opts->grn,
+                                    (uint32_t)num_CPUs(),
+                                    recover_em4x70_progress, &last_percent,
+                                    data_out->potential_keys, MAXIMUM_ID48_RECOVERED_KEY_COUNT, &count
+                                );
+    PrintAndLogEx(NORMAL, "");
 
-        if (data_out->potential_key_count >= MAXIMUM_ID48_RECOVERED_KEY_COUNT) {
-            result = PM3_EOVFLOW;
-        } else {
-            data_out->potential_keys[data_out->potential_key_count] = q;
-            ++data_out->potential_key_count;
-        }
+    if (r == ID48LIB_RECOVERY_CANCELLED) {
+        return PM3_EOPABORTED;
+    }
+    if (r == ID48LIB_RECOVERY_OVERFLOW) {
+        return PM3_EOVFLOW;
     }
 
-    if ((PM3_SUCCESS == result) && (data_out->potential_key_count == 0)) {
-        result = PM3_EFAILED;
+    data_out->potential_key_count = (uint8_t)count;
+    if (data_out->potential_key_count == 0) {
+        return PM3_EFAILED;
     }
-    return result;
+    return PM3_SUCCESS;
 }
 
 static int verify_auth_em4x70(const em4x70_cmd_input_verify_auth_t *opts) {
@@ -948,6 +965,8 @@ static int CmdEM4x70Recover(const char *Cmd) {
         if (PM3_EOVFLOW == result) {
             PrintAndLogEx(ERR, "Found more than %d potential keys. This is unexpected and likely a code failure.", MAXIMUM_ID48_RECOVERED_KEY_COUNT);
             return result;
+        } else if (PM3_EOPABORTED == result) {
+            return result;
         } else if (PM3_SUCCESS != result) {
             PrintAndLogEx(ERR, "No potential keys recovered.  This is unexpected and likely a code failure.");
             return result;
@@ -994,7 +1013,7 @@ static int CmdEM4x70Recover(const char *Cmd) {
                       alt_grn.grn[2]
                      );
     }
-    printf("\n");
+    PrintAndLogEx(NORMAL, "");
 
     // which of those keys actually validates?
     if (recover_ctx.opts.verify) {
@@ -1280,6 +1299,8 @@ static int CmdEM4x70AutoRecover(const char *Cmd) {
     if (PM3_EOVFLOW == result) {
         PrintAndLogEx(ERR, "Found more than %d potential keys. This is unexpected and likely a code failure.", MAXIMUM_ID48_RECOVERED_KEY_COUNT);
         return result;
+    } else if (PM3_EOPABORTED == result) {
+        return result;
     } else if (PM3_SUCCESS != result) {
         PrintAndLogEx(ERR, "No potential keys recovered.  This is unexpected and likely a code failure.");
         return result;
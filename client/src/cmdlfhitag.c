@@ -1843,7 +1843,7 @@ static int CmdLFHitag2PWMDemod(const char *Cmd) {
     uint8_t fchigh = (uint8_t)arg_get_int_def(ctx, 3, 29);
     CLIParserFree(ctx);
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN, sizeof(uint8_t));
+    uint8_t *bits = calloc(GRAPH_SCRATCH_LEN, sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return PM3_EMALLOC;
@@ -38,6 +38,7 @@
 #include "cmdlf.h"        // for lf sniff
 #include "generator.h"
 #include "cliparser.h"    // cliparsing
+#include "lfsniff.h"      // downlink decoders
 
 // Some defines for readability
 #define T55XX_DLMODE_FIXED         0 // Default Mode
@@ -1315,40 +1316,46 @@ bool t55xxTryDetectModulation(uint8_t downlink_mode, bool print_config) {
     return t55xxTryDetectModulationEx(downlink_mode, print_config, 0, -1);
 }
 
+// g_DemodBuffer holds a demod test() accepted, keep it as a candidate
+static void t55xx_keep_hit(t55xx_conf_block_t *hit, uint8_t modulation, int bitrate, bool inverted, bool st, uint8_t downlink_mode) {
+    hit->modulation = modulation;
+    hit->bitrate = bitrate;
+    hit->inverted = inverted;
+    hit->block0 = PackBits(hit->offset, 32, g_DemodBuffer);
+    hit->ST = st;
+    hit->downlink_mode = downlink_mode;
+}
+
 bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32_t wanted_conf, uint64_t pwd) {
 
     t55xx_conf_block_t tests[15];
     int bitRate = 0, clk = 0, firstClockEdge = 0;
     uint8_t hits = 0, fc1 = 0, fc2 = 0, ans = 0;
 
+    // every demod below gives up on noise, no need to look for clocks first.
+    // chk / recoverpw end up here for each wrong password
+    if (g_GraphTraceLen == 0 || getSignalProperties()->isnoise) {
+        return false;
+    }
+
     ans = fskClocks(&fc1, &fc2, (uint8_t *)&clk, &firstClockEdge);
 
     if (ans && ((fc1 == 10 && fc2 == 8) || (fc1 == 8 && fc2 == 5))) {
         if ((FSKrawDemod(0, 0, 0, 0, false) == PM3_SUCCESS) && test(DEMOD_FSK, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-            tests[hits].modulation = DEMOD_FSK;
+            uint8_t mod = DEMOD_FSK;
             if (fc1 == 8 && fc2 == 5)
-                tests[hits].modulation = DEMOD_FSK1a;
+                mod = DEMOD_FSK1a;
             else if (fc1 == 10 && fc2 == 8)
-                tests[hits].modulation = DEMOD_FSK2;
-            tests[hits].bitrate = bitRate;
-            tests[hits].inverted = false;
-            tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-            tests[hits].ST = false;
-            tests[hits].downlink_mode = downlink_mode;
-            ++hits;
+                mod = DEMOD_FSK2;
+            t55xx_keep_hit(&tests[hits++], mod, bitRate, false, false, downlink_mode);
         }
         if ((FSKrawDemod(0, 1, 0, 0, false) == PM3_SUCCESS) && test(DEMOD_FSK, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-            tests[hits].modulation = DEMOD_FSK;
+            uint8_t mod = DEMOD_FSK;
             if (fc1 == 8 && fc2 == 5)
-                tests[hits].modulation = DEMOD_FSK1;
+                mod = DEMOD_FSK1;
             else if (fc1 == 10 && fc2 == 8)
-                tests[hits].modulation = DEMOD_FSK2a;
-            tests[hits].bitrate = bitRate;
-            tests[hits].inverted = true;
-            tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-            tests[hits].ST = false;
-            tests[hits].downlink_mode = downlink_mode;
-            ++hits;
+                mod = DEMOD_FSK2a;
+            t55xx_keep_hit(&tests[hits++], mod, bitRate, true, false, downlink_mode);
         }
     } else {
         clk = GetAskClock("", false);
@@ -1360,11 +1367,7 @@ bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32
             // 1 = Ask/Man
             // st = true
             if ((ASKDemod_ext(0, 0, 1, 0, false, false, false, 1, &tests[hits].ST) == PM3_SUCCESS) && test(DEMOD_ASK, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_ASK;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = false;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].downlink_mode = downlink_mode;
+                t55xx_keep_hit(&tests[hits], DEMOD_ASK, bitRate, false, tests[hits].ST, downlink_mode);
                 ++hits;
             }
             tests[hits].ST = true;
@@ -1374,110 +1377,69 @@ bool t55xxTryDetectModulationEx(uint8_t downlink_mode, bool print_config, uint32
             // 1 = Ask/Man
             // st = true
             if ((ASKDemod_ext(0, 1, 1, 0, false, false, false, 1, &tests[hits].ST) == PM3_SUCCESS) && test(DEMOD_ASK, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_ASK;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = true;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].downlink_mode = downlink_mode;
+                t55xx_keep_hit(&tests[hits], DEMOD_ASK, bitRate, true, tests[hits].ST, downlink_mode);
                 ++hits;
             }
             if ((ASKbiphaseDemod(0, 0, 0, 2, false) == PM3_SUCCESS) && test(DEMOD_BI, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_BI;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = false;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].ST = false;
-                tests[hits].downlink_mode = downlink_mode;
-                ++hits;
+                t55xx_keep_hit(&tests[hits++], DEMOD_BI, bitRate, false, false, downlink_mode);
             }
             if ((ASKbiphaseDemod(0, 0, 1, 2, false) == PM3_SUCCESS) && test(DEMOD_BIa, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_BIa;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = true;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].ST = false;
-                tests[hits].downlink_mode = downlink_mode;
-                ++hits;
+                t55xx_keep_hit(&tests[hits++], DEMOD_BIa, bitRate, true, false, downlink_mode);
             }
         }
         clk = GetNrzClock("", false);
         if (clk > 8) { //clock of rf/8 is likely a false positive, so don't use it.
             if ((NRZrawDemod(0, 0, 1, false) == PM3_SUCCESS) && test(DEMOD_NRZ, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_NRZ;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = false;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].ST = false;
-                tests[hits].downlink_mode = downlink_mode;
-                ++hits;
+                t55xx_keep_hit(&tests[hits++], DEMOD_NRZ, bitRate, false, false, downlink_mode);
             }
 
             if ((NRZrawDemod(0, 1, 1, false) == PM3_SUCCESS) && test(DEMOD_NRZ, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_NRZ;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = true;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].ST = false;
-                tests[hits].downlink_mode = downlink_mode;
-                ++hits;
+                t55xx_keep_hit(&tests[hits++], DEMOD_NRZ, bitRate, true, false, downlink_mode);
             }
         }
 
         clk = GetPskClock("", false);
         if (clk > 0) {
             // allow undo
-            buffer_savestate_t saveState = save_bufferS32(g_GraphBuffer, g_GraphTraceLen);
-            saveState.offset = g_GridOffset;
+            graph_snapshot_t *snap = graphSnapshotTake();
             // skip first 160 samples to allow antenna to settle in (psk gets inverted occasionally otherwise)
             CmdLtrim("-i 160");
-            if ((PSKDemod(0, 0, 6, false) == PM3_SUCCESS) && test(DEMOD_PSK1, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_PSK1;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = false;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].ST = false;
-                tests[hits].downlink_mode = downlink_mode;
-                ++hits;
+
+            // PSK2 / PSK3 are the PSK1 bits converted, demod once and keep them
+            uint8_t *psk1 = NULL;
+            size_t psk1_len = 0;
+            if (PSKDemod(0, 0, 6, false) == PM3_SUCCESS) {
+                if (test(DEMOD_PSK1, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
+                    t55xx_keep_hit(&tests[hits++], DEMOD_PSK1, bitRate, false, false, downlink_mode);
+                }
+                psk1_len = g_DemodBufferLen;
+                psk1 = calloc(psk1_len, sizeof(uint8_t));
+                if (psk1 != NULL) {
+                    memcpy(psk1, g_DemodBuffer, psk1_len);
+                }
             }
             if ((PSKDemod(0, 1, 6, false) == PM3_SUCCESS) && test(DEMOD_PSK1, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                tests[hits].modulation = DEMOD_PSK1;
-                tests[hits].bitrate = bitRate;
-                tests[hits].inverted = true;
-                tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                tests[hits].ST = false;
-                tests[hits].downlink_mode = downlink_mode;
-                ++hits;
+                t55xx_keep_hit(&tests[hits++], DEMOD_PSK1, bitRate, true, false, downlink_mode);
             }
-            //ICEMAN: are these PSKDemod calls needed?
-            // PSK2 - needs a call to psk1TOpsk2.
-            if (PSKDemod(0, 0, 6, false) == PM3_SUCCESS) {
+            if (psk1 != NULL) {
+                // PSK2 - needs a call to psk1TOpsk2.
+                setDemodBuff(psk1, psk1_len, 0);
                 psk1TOpsk2(g_DemodBuffer, g_DemodBufferLen);
                 if (test(DEMOD_PSK2, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                    tests[hits].modulation = DEMOD_PSK2;
-                    tests[hits].bitrate = bitRate;
-                    tests[hits].inverted = false;
-                    tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                    tests[hits].ST = false;
-                    tests[hits].downlink_mode = downlink_mode;
-                    ++hits;
+                    t55xx_keep_hit(&tests[hits++], DEMOD_PSK2, bitRate, false, false, downlink_mode);
                 }
-            } // inverse waves does not affect this demod
-            // PSK3 - needs a call to psk1TOpsk2.
-            if (PSKDemod(0, 0, 6, false) == PM3_SUCCESS) {
+                // inverse waves does not affect this demod
+                // PSK3 - needs a call to psk1TOpsk2.
+                setDemodBuff(psk1, psk1_len, 0);
                 psk1TOpsk2(g_DemodBuffer, g_DemodBufferLen);
                 if (test(DEMOD_PSK3, &tests[hits].offset, &bitRate, clk, &tests[hits].Q5)) {
-                    tests[hits].modulation = DEMOD_PSK3;
-                    tests[hits].bitrate = bitRate;
-                    tests[hits].inverted = false;
-                    tests[hits].block0 = PackBits(tests[hits].offset, 32, g_DemodBuffer);
-                    tests[hits].ST = false;
-                    tests[hits].downlink_mode = downlink_mode;
-                    ++hits;
+                    t55xx_keep_hit(&tests[hits++], DEMOD_PSK3, bitRate, false, false, downlink_mode);
                 }
+                free(psk1);
             } // inverse waves does not affect this demod
             //undo trim samples
-            restore_bufferS32(saveState, g_GraphBuffer);
-            g_GridOffset = saveState.offset;
+            graphSnapshotRestore(snap);
+            graphSnapshotFree(snap);
             // t55xx_search_config_psk(g_GraphBuffer, 1);
             // t55xx_search_config_psk(g_GraphBuffer, 2);
         }
@@ -4290,39 +4252,41 @@ static int CmdT55xxProtect(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
-// if the difference between a and b is less than or eq to d  i.e. does a = b +/- d
-#define APPROX_EQ(a, b, d) ((abs(a - b) <= d) ? true : false)
-
-static uint8_t t55sniff_get_packet(const int *pulseBuffer, char *data, uint8_t width0, uint8_t width1, uint8_t tolerance) {
-    int i = 0;
-    bool ok = true;
-    uint8_t len = 0;
-
-    while (ok && (i < 73)) { // 70 bits max Fixed bit packet
-        if (APPROX_EQ(width0, pulseBuffer[i], tolerance))  {
-            data[len++] = '0';
-            i++;
-            continue;
-        }
-        if (APPROX_EQ(width1, pulseBuffer[i], tolerance)) {
-            data[len++] = '1';
-            i++;
-            continue;
-        }
-
-        ok = false;
-    }
-    data[len] = 0x00;
-    return len;
-}
-
-static uint8_t t55sniff_trim_samples(int *pulseBuffer, int *pulseIdx, uint8_t len) {
-    for (uint8_t i = 0; i < (80 - len); i++) {
-        pulseBuffer[i] = pulseBuffer[i + len];
+static void t55sniff_print(const lfsniff_record_t *rec, void *ctx) {
+    (void)ctx;
+
+    char pwdText[12] = " ";
+    char dataText[10] = " ";
+    if (rec->has_password) {
+        snprintf(pwdText, sizeof(pwdText), (rec->password_guess) ? "[%08X]" : " %08X", rec->password);
+    }
+    if (rec->has_data) {
+        snprintf(dataText, sizeof(dataText), "%08X", rec->data);
+    }
+
+    if (rec->block == 7) {
+        PrintAndLogEx(SUCCESS, "%-22s  | "_GREEN_("%10s")" | "_YELLOW_("%8s")" |  "_YELLOW_("%d")"  |   "_GREEN_("%d")"  | %3d | %3d | %s"
+                      , rec->cmd
+                      , pwdText
+                      , dataText
+                      , rec->block
+                      , rec->page
+                      , rec->width0
+                      , rec->width1
+                      , rec->bits
+                     );
+    } else {
+        PrintAndLogEx(SUCCESS, "%-22s  | "_GREEN_("%10s")" | "_GREEN_("%8s")" |  "_GREEN_("%d")"  |   "_GREEN_("%d")"  | %3d | %3d | %s"
+                      , rec->cmd
+                      , pwdText
+                      , dataText
+                      , rec->block
+                      , rec->page
+                      , rec->width0
+                      , rec->width1
+                      , rec->bits
+                     );
     }
-
-    *pulseIdx -= len;
-    return PM3_SUCCESS;
 }
 
 static int CmdT55xxSniff(const char *Cmd) {
@@ -4379,43 +4343,6 @@ static int CmdT55xxSniff(const char *Cmd) {
     if (opt_width1 > -1)
         width1 = (uint8_t)opt_width1 & 0xFF;
 
-
-
-    /*
-        Notes:
-                T55xx packet lengths  (1 of 4 needs to be checked)
-                                     -----------------------------------------------
-                                    |  Default  |    LL 0   | Leading 0 |   1 of 4  |
-                    ----------------------------------------------------------------|
-                   | Standard Write |     38    |     39    |    39     |    40     |
-                   | Protect Write  |     70    |     71    |    73     |    74     |
-                   | AOR            |     34    |     35    |    37     |    38     |
-                   | Standard Read  |      5    |      6    |     7     |     8     |
-                   | Protect Read   |     38    |     39    |    41     |    42     |
-                   | Regular Read   |      2    |      3    |     3     |     4     |
-                   | Reset          |      2    |      3    |     3     |     4     |
-                    ----------------------------------------------------------------
-
-                T55xx bit widths (decimation 1) - Expected, but may vary a little
-                Reference 0 for LL0 and Leading 0 can be longer
-                         -----------------------------------------------
-                        |  Default  |    LL 0   | Leading 0 |   1 of 4  |
-                    ----------------------------------------------------|
-                   | 0  |  16 - 32  |   9 - 33  |   5 - 80  |   tbc     |
-                   | 1  |  48 - 64  |  41 - 72  |  21 - 96  |   tbc     |
-                    ----------------------------------------------------
-                                                             00 01 10 11
-    */
-
-    uint8_t page, blockAddr;
-    size_t idx = 0;
-    uint32_t usedPassword, blockData;
-    int pulseSamples = 0, pulseIdx = 0;
-    char pwdText[100];
-    char dataText[100];
-    int pulseBuffer[80] = { 0 }; // max should be 73 +/- - Holds Pulse widths
-    char data[80]; //  linked to pulseBuffer. - Holds 0/1 from pulse widths
-
     // setup and sample data from Proxmark
     // if not directed to existing sample/graphbuffer
     if (use_graphbuf == false) {
@@ -4432,261 +4359,15 @@ static int CmdT55xxSniff(const char *Cmd) {
     PrintAndLogEx(SUCCESS, "Downlink mode           |  password  |   Data   | blk | page |  0  |  1  | raw");
     PrintAndLogEx(SUCCESS, "------------------------+------------+----------+-----+------+-----+-----+-------------------------------------------------------------------------------");
 
-    idx = 0;
-    // loop though sample buffer
-    while (idx < g_GraphTraceLen) {
-
-        int minWidth = 1000;
-        int maxWidth = 0;
-        data[0] = 0;
-        bool have_data = false;
-        const char *modeText = "Default";
-        strncpy(pwdText, " ", sizeof(pwdText));
-        strncpy(dataText, " ", sizeof(dataText));
-
-        if (pulseSamples == 0) {
-            idx++;
-        }
-
-        // find high
-        while ((idx < g_GraphTraceLen) && (g_GraphBuffer[idx] < 0)) {
-            idx++;
-        }
-
-        // count high samples
-        pulseSamples = 0;
-        while ((idx < g_GraphTraceLen) && (g_GraphBuffer[idx] > 0)) { // last bit seems to be high to zero, but can vary in width..
-            pulseSamples++;
-            idx++;
-        }
-
-        if (pulseSamples > 0) {
-            pulseBuffer[pulseIdx++] = pulseSamples;
-            if (pulseIdx > 79) { // make room for next sample - if not used by now, it won't be.
-                t55sniff_trim_samples(pulseBuffer, &pulseIdx, 1);
-            }
-
-            // Check Samples for valid packets;
-            // We should find (outside of leading bits) we have a packet of "1" and "0" at same widths.
-            if (pulseIdx >= 6) {// min size for a read - ignoring 1of4 10 0 <adr>
-
-                // We auto find widths
-                if ((width0 == 0) && (width1 == 0)) {
-                    // We ignore bit 0 for the moment as it may be a ref. pulse, so check last
-                    uint32_t ii = 2;
-                    minWidth = pulseBuffer[1];
-                    maxWidth = pulseBuffer[1];
-                    bool done = false;
-
-                    while ((!done) && (ii < pulseIdx) && ((maxWidth <= minWidth) || (APPROX_EQ(minWidth, maxWidth, tolerance)))) { // min should be 8, 16-32 more normal
-                        if (pulseBuffer[ii] + 3 < minWidth) {
-                            minWidth = pulseBuffer[ii];
-                            done = true;
-                        }
-                        if (pulseBuffer[ii] - 1 > maxWidth) {
-                            maxWidth = pulseBuffer[ii];
-                            done = true;
-                        }
-                        ii++;
-                    }
-                } else {
-                    minWidth = width0;
-                    maxWidth = width1;
-                }
-            }
-
-            //  out of bounds... min max far enough appart and minWidth is large enough
-            if (((maxWidth - minWidth) < 6) || (minWidth < 6)) // min 8 +/-
-                continue;
-
-            // At this point we should have
-            // - a min of 6 samples
-            // - the 0 and 1 sample widths
-            // - min 0 and min separations (worst case)
-            // No max checks done (yet) as have seen samples > then specs in use.
-
-            // Check first bit.
-
-            // Long leading 0
-            if (have_data == false && (APPROX_EQ(pulseBuffer[0], 136 + minWidth, tolerance) && APPROX_EQ(pulseBuffer[1], maxWidth, tolerance))) {
-                // printf ("Long Leading 0 - not yet handled | have 1 First bit | Min : %-3d - Max : %-3d : diff : %d\n",minWidth,maxWidth, maxWidth-minWidth);
-                continue;
-            }
-
-            // Fixed bit - Default
-            if (have_data == false && (APPROX_EQ(pulseBuffer[0], maxWidth, tolerance))) {
-                uint16_t dataLen = t55sniff_get_packet(pulseBuffer, data, minWidth, maxWidth, tolerance);
-
-                //   if ((dataLen == 39) )
-                //           printf ("Fixed | Data end of 80 samples | offset : %llu - datalen %-2d - data : %s  --- - Bit 0 width : %d\n",idx,dataLen,data,pulseBuffer[0]);
-
-                if (data[0] == '0') { // should never get here..
-                    data[0] = 0;
-                } else {
-
-                    // Default Read
-                    if (dataLen == 6) {
-                        t55sniff_trim_samples(pulseBuffer, &pulseIdx, 4); // left 1 or 2 samples seemed to help
-
-                        page = data[1] - '0';
-                        blockAddr = 0;
-                        for (uint8_t i = 3; i < 6; i++) {
-                            blockAddr <<= 1;
-                            if (data[i] == '1') {
-                                blockAddr |= 1;
-                            }
-                        }
-                        blockData = 0;
-                        have_data = true;
-                        modeText = "Default Read";
-                    }
-
-                    // Password Write
-                    if (dataLen == 70) {
-                        t55sniff_trim_samples(pulseBuffer, &pulseIdx, 70);
-
-                        page = data[1] - '0';
-                        usedPassword = 0;
-                        for (uint8_t i = 2; i <= 33; i++) {
-                            usedPassword <<= 1;
-                            if (data[i] == '1') {
-                                usedPassword |= 1;
-                            }
-                        }
-
-                        // Lock bit 34
-                        blockData = 0;
-                        for (uint8_t i = 35; i <= 66; i++) {
-                            blockData <<= 1;
-                            if (data[i] == '1') {
-                                blockData |= 1;
-                            }
-                        }
-
-                        blockAddr = 0;
-                        for (uint8_t i = 67; i <= 69; i++) {
-                            blockAddr <<= 1;
-                            if (data[i] == '1') {
-                                blockAddr |= 1;
-                            }
-                        }
-                        have_data = true;
-                        modeText = "Default pwd write";
-                        snprintf(pwdText, sizeof(pwdText), " %08X", usedPassword);
-                        snprintf(dataText, sizeof(dataText), "%08X", blockData);
-                    }
-
-                    // Default Write or password read ???
-                    // the most confusing command.
-                    // if the token is with a password - all is OK,
-                    // if not - read command with a password will lead to write the shifted password to the memory and:
-                    //    IF the most bit of the data is `1` ----> IT LEADS TO LOCK this block of the memory
-                    if (dataLen == 38) {
-                        t55sniff_trim_samples(pulseBuffer, &pulseIdx, 38);
-
-                        page = data[1] - '0';
-                        usedPassword = 0;
-                        blockData = 0;
-                        for (uint8_t i = 3; i <= 34; i++) {
-                            blockData <<= 1;
-                            if (data[i] == '1') {
-                                blockData |= 1;
-                            }
-                        }
-
-                        for (uint8_t i = 2; i <= 33; i++) {
-                            usedPassword <<= 1;
-                            if (data[i] == '1') {
-                                usedPassword |= 1;
-                            }
-                        }
-
-                        blockAddr = 0;
-                        for (uint8_t i = 35; i <= 37; i++) {
-                            blockAddr <<= 1;
-                            if (data[i] == '1') {
-                                blockAddr |= 1;
-                            }
-                        }
-                        have_data = true;
-                        modeText = "Default write/pwd read";
-                        snprintf(pwdText, sizeof(pwdText), "[%08X]", usedPassword);
-                        snprintf(dataText, sizeof(dataText), "%08X", blockData);
-                    }
-                }
-            }
-
-            // Leading 0
-            if (have_data == false && (APPROX_EQ(pulseBuffer[0], minWidth, tolerance))) {
-                // leading 0 (should = 0 width)
-                // 1 of 4 (leads with 00)
-                uint16_t dataLen = t55sniff_get_packet(pulseBuffer, data, minWidth, maxWidth, tolerance);
-                // **** Should check to 0 to be actual 0 as well i.e. 01 .... data ....
-                if ((data[0] == '0') && (data[1] == '1')) {
-                    if (dataLen == 73) {
-                        t55sniff_trim_samples(pulseBuffer, &pulseIdx, 73);
-
-                        page = data[2] - '0';
-                        usedPassword = 0;
-                        for (uint8_t i = 5; i <= 36; i++) {
-                            usedPassword <<= 1;
-                            if (data[i] == '1') {
-                                usedPassword |= 1;
-                            }
-                        }
-
-                        blockData = 0;
-                        for (uint8_t i = 38; i <= 69; i++) {
-                            blockData <<= 1;
-                            if (data[i] == '1') {
-                                blockData |= 1;
-                            }
-                        }
-
-                        blockAddr = 0;
-                        for (uint8_t i = 70; i <= 72; i++) {
-                            blockAddr <<= 1;
-                            if (data[i] == '1') {
-                                blockAddr |= 1;
-                            }
-                        }
-
-                        have_data = true;
-                        modeText = "Leading 0 pwd write";
-                        snprintf(pwdText, sizeof(pwdText), " %08X", usedPassword);
-                        snprintf(dataText, sizeof(dataText), "%08X", blockData);
-                    }
-                }
-            }
-        }
-
-        // Print results
-        if (have_data) {
-            if (blockAddr == 7) {
-                PrintAndLogEx(SUCCESS, "%-22s  | "_GREEN_("%10s")" | "_YELLOW_("%8s")" |  "_YELLOW_("%d")"  |   "_GREEN_("%d")"  | %3d | %3d | %s"
-                              , modeText
-                              , pwdText
-                              , dataText
-                              , blockAddr
-                              , page
-                              , minWidth
-                              , maxWidth
-                              , data
-                             );
-            } else {
-                PrintAndLogEx(SUCCESS, "%-22s  | "_GREEN_("%10s")" | "_GREEN_("%8s")" |  "_GREEN_("%d")"  |   "_GREEN_("%d")"  | %3d | %3d | %s"
-                              , modeText
-                              , pwdText
-                              , dataText
-                              , blockAddr
-                              , page
-                              , minWidth
-                              , maxWidth
-                              , data
-                             );
-            }
-        }
+    lfsniff_opts_t opts = { .tolerance = tolerance, .width0 = width0, .width1 = width1 };
+    lfsniff_t *sniff = lfsniff_new(LFSNIFF_T55XX, &opts, t55sniff_print, NULL);
+    if (sniff == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
     }
+    lfsniff_feed(sniff, g_GraphBuffer, g_GraphTraceLen);
+    lfsniff_finish(sniff);
+    lfsniff_free(sniff);
 
     // footer
     PrintAndLogEx(SUCCESS, "-----------------------------------------------------------------------------------------------------------------------------------------------------");
@@ -89,8 +89,7 @@ int demodTI(bool verbose) {
         1, 1, 1, 1, 1, 1, 1, 1
     };
 
-    buffer_savestate_t saveState = save_bufferS32(g_GraphBuffer, g_GraphTraceLen);
-    saveState.offset = g_GridOffset;
+    graph_snapshot_t *snap = graphSnapshotTake();
 
     int lowLen = ARRAYLEN(LowTone);
     int highLen = ARRAYLEN(HighTone);
@@ -278,9 +277,9 @@ int demodTI(bool verbose) {
 
 out:
     if (retval != PM3_SUCCESS) {
-        restore_bufferS32(saveState, g_GraphBuffer);
-        g_GridOffset = saveState.offset;
+        graphSnapshotRestore(snap);
     }
+    graphSnapshotFree(snap);
 
     return retval;
 }
@@ -41,8 +41,7 @@ static int CmdHelp(const char *Cmd);
 // see ASKDemod for what args are accepted
 int demodzx(bool verbose) {
     (void) verbose; // unused so far
-    buffer_savestate_t saveState = save_bufferS32(g_GraphBuffer, g_GraphTraceLen);
-    saveState.offset = g_GridOffset;
+    graph_snapshot_t *snap = graphSnapshotTake();
 
     // CmdAskEdgeDetect("");
 
@@ -50,8 +49,8 @@ int demodzx(bool verbose) {
     bool st = true;
     if (ASKDemod_ext(64, 0, 0, 0, false, false, false, 1, &st) != PM3_SUCCESS) {
         PrintAndLogEx(DEBUG, "DEBUG: Error - ZX: ASK/Manchester Demod failed");
-        restore_bufferS32(saveState, g_GraphBuffer);
-        g_GridOffset = saveState.offset;
+        graphSnapshotRestore(snap);
+        graphSnapshotFree(snap);
         return PM3_ESOFT;
     }
     size_t size = g_DemodBufferLen;
@@ -66,8 +65,8 @@ int demodzx(bool verbose) {
         else
             PrintAndLogEx(DEBUG, "DEBUG: Error - ZX: ans: %d", ans);
 
-        restore_bufferS32(saveState, g_GraphBuffer);
-        g_GridOffset = saveState.offset;
+        graphSnapshotRestore(snap);
+        graphSnapshotFree(snap);
         return PM3_ESOFT;
     }
     setDemodBuff(g_DemodBuffer, 96, ans);
@@ -81,6 +80,7 @@ int demodzx(bool verbose) {
     // test checksums
 
     PrintAndLogEx(SUCCESS, "ZX8211 - Card " _GREEN_("%u"), raw1);
+    graphSnapshotFree(snap);
     return PM3_SUCCESS;
 }
 
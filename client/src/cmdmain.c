@@ -49,6 +49,7 @@
 #include "preferences.h"
 #include "cliparser.h"
 #include "cmdmqtt.h"
+#include "traceevent.h"
 
 static int CmdHelp(const char *Cmd);
 
@@ -370,7 +371,10 @@ static int CmdHelp(const char *Cmd) {
 // then presses Enter, which the full command line that they typed.
 //-----------------------------------------------------------------------------
 int CommandReceived(const char *Cmd) {
-    return CmdsParse(CommandTable, Cmd);
+    TRACE_SPAN("command", Cmd);
+    int res = CmdsParse(CommandTable, Cmd);
+    PrintAndLogFlush();
+    return res;
 }
 
 command_t *getTopLevelCommandTable(void) {
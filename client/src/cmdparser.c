@@ -223,6 +223,145 @@ void CmdsHelp(const command_t Commands[]) {
     PrintAndLogEx(NORMAL, "");
 }
 
+//-----------------------------------------------------------------------------
+// Command lookup
+//
+// Every command table gets a trie of its command names, built the first time
+// the table is parsed and kept for the rest of the session. Scripts running
+// the same commands over and over don't compare strings table by table.
+//-----------------------------------------------------------------------------
+
+#define CMD_TRIE_SLOTS   1024
+
+typedef struct {
+    char c;
+    int child;          // first child node, -1 if none
+    int sibling;        // next node with the same parent, -1 if none
+    int index;          // first command with exactly this name, -1 if none
+} cmd_trie_node_t;
+
+typedef struct {
+    const command_t *commands;
+    cmd_trie_node_t *nodes; // nodes[0] is the root, the empty name
+    int *same;              // next command with the same name, -1 if none
+    int count;              // commands in the table
+} cmd_trie_t;
+
+static cmd_trie_t cmd_tries[CMD_TRIE_SLOTS];
+static pthread_mutex_t cmd_tries_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int cmd_trie_child(const cmd_trie_node_t *nodes, int node, char c) {
+    for (int n = nodes[node].child; n != -1; n = nodes[n].sibling) {
+        if (nodes[n].c == c) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+// node of name, -1 if no command starts with it
+static int cmd_trie_find(const cmd_trie_t *trie, const char *name) {
+    int node = 0;
+    for (; *name && node != -1; name++) {
+        node = cmd_trie_child(trie->nodes, node, *name);
+    }
+    return node;
+}
+
+static bool cmd_trie_build(cmd_trie_t *trie, const command_t Commands[]) {
+
+    size_t n_nodes = 1;
+    int n_cmds = 0;
+    for (; Commands[n_cmds].Name; n_cmds++) {
+        n_nodes += strlen(Commands[n_cmds].Name);
+    }
+
+    cmd_trie_node_t *nodes = calloc(n_nodes, sizeof(cmd_trie_node_t));
+    int *same = calloc(n_cmds + 1, sizeof(int));
+    if (nodes == NULL || same == NULL) {
+        free(nodes);
+        free(same);
+        return false;
+    }
+
+    nodes[0] = (cmd_trie_node_t) { .c = 0, .child = -1, .sibling = -1, .index = -1 };
+    int used = 1;
+
+    for (int i = 0; i < n_cmds; i++) {
+        int node = 0;
+        for (const char *c = Commands[i].Name; *c; c++) {
+            int next = cmd_trie_child(nodes, node, *c);
+            if (next == -1) {
+                next = used++;
+                nodes[next] = (cmd_trie_node_t) { .c = *c, .child = -1, .sibling = nodes[node].child, .index = -1 };
+                nodes[node].child = next;
+            }
+            node = next;
+        }
+
+        // keep the table order among commands of the same name
+        same[i] = -1;
+        if (nodes[node].index == -1) {
+            nodes[node].index = i;
+        } else {
+            int last = nodes[node].index;
+            while (same[last] != -1) {
+                last = same[last];
+            }
+            same[last] = i;
+        }
+    }
+
+    trie->nodes = nodes;
+    trie->same = same;
+    trie->count = n_cmds;
+    return true;
+}
+
+// The trie of a command table, NULL if it can't be had
+static const cmd_trie_t *cmd_trie_get(const command_t Commands[]) {
+    size_t slot = ((uintptr_t)Commands >> 4) % CMD_TRIE_SLOTS;
+
+    for (size_t i = 0; i < CMD_TRIE_SLOTS; i++) {
+        cmd_trie_t *trie = &cmd_tries[(slot + i) % CMD_TRIE_SLOTS];
+        const command_t *key = __atomic_load_n(&trie->commands, __ATOMIC_ACQUIRE);
+        if (key == Commands) {
+            return trie;
+        }
+        if (key != NULL) {
+            continue;
+        }
+
+        // first time this table is parsed
+        pthread_mutex_lock(&cmd_tries_lock);
+        const cmd_trie_t *res = NULL;
+        if (trie->commands == Commands) {
+            res = trie;
+        } else if (trie->commands == NULL && cmd_trie_build(trie, Commands)) {
+            __atomic_store_n(&trie->commands, Commands, __ATOMIC_RELEASE);
+            res = trie;
+        }
+        pthread_mutex_unlock(&cmd_tries_lock);
+        if (res != NULL || trie->commands == NULL) {
+            return res;
+        }
+    }
+    return NULL;
+}
+
+// Counts the available commands whose names start at node, stops at two
+static void cmd_trie_prefix(const cmd_trie_t *trie, const command_t Commands[], int node, int *matches, int *last_match) {
+    for (int i = trie->nodes[node].index; i != -1 && *matches < 2; i = trie->same[i]) {
+        if (Commands[i].IsAvailable()) {
+            *last_match = i;
+            (*matches)++;
+        }
+    }
+    for (int n = trie->nodes[node].child; n != -1 && *matches < 2; n = trie->nodes[n].sibling) {
+        cmd_trie_prefix(trie, Commands, n, matches, last_match);
+    }
+}
+
 static int execute_system_command(const char *command) {
 
     pthread_spinlock_t sycmd_spinlock;
@@ -330,30 +469,42 @@ int CmdsParse(const command_t Commands[], const char *Cmd) {
 
     bool request_help = (strcmp(Cmd + tmplen, "-h") == 0) || (strcmp(Cmd + tmplen, "--help") == 0);
 
+    const cmd_trie_t *trie = cmd_trie_get(Commands);
+    int node = -1;
+
     int i = 0;
-    while (Commands[i].Name) {
-        if (0 == strcmp(Commands[i].Name, cmd_name)) {
-            if ((Commands[i].Help[0] == '{') ||  // always allow parsing categories
-                    request_help ||              // always allow requesting help
-                    Commands[i].IsAvailable()) {
-                break;
-            } else {
-                PrintAndLogEx(WARNING, "This command is " _YELLOW_("not available") " in this mode");
-                return PM3_ENOTIMPL;
-            }
+    if (trie) {
+        // end of the table if there is no such command
+        node = cmd_trie_find(trie, cmd_name);
+        i = (node != -1 && trie->nodes[node].index != -1) ? trie->nodes[node].index : trie->count;
+    } else {
+        while (Commands[i].Name && strcmp(Commands[i].Name, cmd_name) != 0) {
+            ++i;
         }
-        ++i;
     }
 
-    /* try to find exactly one prefix-match */
-    if (!Commands[i].Name) {
+    if (Commands[i].Name) {
+        if ((Commands[i].Help[0] != '{') &&  // always allow parsing categories
+                (request_help == false) &&   // always allow requesting help
+                (Commands[i].IsAvailable() == false)) {
+            PrintAndLogEx(WARNING, "This command is " _YELLOW_("not available") " in this mode");
+            return PM3_ENOTIMPL;
+        }
+    } else {
+        /* try to find exactly one prefix-match */
         int last_match = 0;
         int matches = 0;
 
-        for (i = 0; Commands[i].Name; i++) {
-            if (!strncmp(Commands[i].Name, cmd_name, strlen(cmd_name)) && Commands[i].IsAvailable()) {
-                last_match = i;
-                matches++;
+        if (trie) {
+            if (node != -1) {
+                cmd_trie_prefix(trie, Commands, node, &matches, &last_match);
+            }
+        } else {
+            for (i = 0; Commands[i].Name; i++) {
+                if (!strncmp(Commands[i].Name, cmd_name, strlen(cmd_name)) && Commands[i].IsAvailable()) {
+                    last_match = i;
+                    matches++;
+                }
             }
         }
         if (matches == 1) {
@@ -110,6 +110,12 @@ bool ImportTraceBuffer(const uint8_t *trace_src, uint16_t trace_len) {
     return (true);
 }
 
+// The client trace buffer, as loaded or downloaded by the last trace command
+const uint8_t *GetTraceBuffer(size_t *trace_len) {
+    *trace_len = (gs_trace) ? gs_traceLen : 0;
+    return gs_trace;
+}
+
 static uint8_t extract_uid[10] = {0};
 static uint8_t extract_uidlen = 0;
 static uint8_t extract_epurse[8] = {0};
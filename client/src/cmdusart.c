@@ -227,6 +227,7 @@ static int CmdUsartBtFactory(const char *Cmd) {
     PrintAndLogEx(WARNING, "Is the add-on blue light blinking? (Say 'n' if you want to abort) [y/n]");
 
     char input[3];
+    PrintAndLogFlush();
     if ((fgets(input, sizeof(input), stdin) == NULL) || (strncmp(input, "y\n", sizeof(input)) != 0)) {
         PrintAndLogEx(NORMAL, "");
         PrintAndLogEx(FAILED, "Aborting.");
@@ -30,6 +30,8 @@
 #include "wiegand_formats.h"
 #include "wiegand_formatutils.h"
 #include "util.h"
+#include "util_posix.h"         // msclock
+#include "fileutils.h"          // FILE_PATH_SIZE
 
 static int CmdHelp(const char *Cmd);
 
@@ -151,13 +153,206 @@ int CmdWiegandEncode(const char *Cmd) {
     return PM3_SUCCESS;
 }
 
+// bulk decoding, one raw hex credential per line like --raw
+#define WIEGAND_FILE_LINE  128
+
+static int hex_nibble(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static bool wiegand_hex_line(const char *line, wiegand_message_t *packed) {
+    uint32_t top = 0, mid = 0, bot = 0;
+    int n = 0;
+    for (; line[n]; n++) {
+        int v = hex_nibble(line[n]);
+        if (v < 0) {
+            break;
+        }
+        top = (top << 4) | (mid >> 28);
+        mid = (mid << 4) | (bot >> 28);
+        bot = (bot << 4) | v;
+    }
+    // trailing whitespace / line end only
+    for (int i = n; line[i]; i++) {
+        if (isspace((unsigned char)line[i]) == 0) {
+            return false;
+        }
+    }
+    if (n == 0) {
+        return false;
+    }
+    *packed = initialize_message_object(top, mid, bot, 0);
+    return true;
+}
+
+static int wiegand_decode_file(const char *filename, const char *outname) {
+
+    FILE *f = fopen(filename, "r");
+    if (f == NULL) {
+        PrintAndLogEx(ERR, "Failed to open " _YELLOW_("%s"), filename);
+        return PM3_EFILE;
+    }
+
+    size_t cap = 1024, n = 0, bad = 0, lineno = 0;
+    wiegand_message_t *packed = calloc(cap, sizeof(wiegand_message_t));
+    if (packed == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        fclose(f);
+        return PM3_EMALLOC;
+    }
+
+    char line[WIEGAND_FILE_LINE];
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+            continue;
+        }
+        if (n == cap) {
+            cap *= 2;
+            wiegand_message_t *tmp = realloc(packed, cap * sizeof(wiegand_message_t));
+            if (tmp == NULL) {
+                PrintAndLogEx(WARNING, "Failed to allocate memory");
+                free(packed);
+                fclose(f);
+                return PM3_EMALLOC;
+            }
+            packed = tmp;
+        }
+        if (wiegand_hex_line(line, &packed[n]) == false) {
+            if (bad++ < 5) {
+                PrintAndLogEx(WARNING, "line %zu, not a hex credential, skipped", lineno);
+            }
+            continue;
+        }
+        n++;
+    }
+    fclose(f);
+
+    wiegand_result_t *results = calloc(MAX(n, 1), sizeof(wiegand_result_t));
+    if (results == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(packed);
+        return PM3_EMALLOC;
+    }
+
+    uint64_t t1 = msclock();
+    HIDTryUnpackBatch(packed, n, results, 0);
+
+    // like decode_wiegand, try again with a preamble bit what didn't decode
+    size_t retry = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (results[i].valid == 0) {
+            retry++;
+        }
+    }
+    if (retry) {
+        wiegand_message_t *again = calloc(retry, sizeof(wiegand_message_t));
+        wiegand_result_t *again_res = calloc(retry, sizeof(wiegand_result_t));
+        if (again && again_res) {
+            size_t j = 0;
+            for (size_t i = 0; i < n; i++) {
+                if (results[i].valid == 0) {
+                    again[j] = packed[i];
+                    again[j].Length += 1;
+                    j++;
+                }
+            }
+            HIDTryUnpackBatch(again, retry, again_res, 0);
+            j = 0;
+            for (size_t i = 0; i < n; i++) {
+                if (results[i].valid == 0) {
+                    if (again_res[j].valid || (results[i].matches == 0 && again_res[j].matches)) {
+                        packed[i] = again[j];
+                        results[i] = again_res[j];
+                    }
+                    j++;
+                }
+            }
+        }
+        free(again);
+        free(again_res);
+    }
+    t1 = msclock() - t1;
+
+    size_t valid = 0, parity_fail = 0;
+    uint32_t per_format[256] = {0};
+    for (size_t i = 0; i < n; i++) {
+        if (results[i].valid) {
+            valid++;
+            per_format[results[i].format_idx & 0xFF]++;
+        } else if (results[i].matches) {
+            parity_fail++;
+        }
+    }
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "------------------------- " _CYAN_("Wiegand") " ---------------------------");
+    PrintAndLogEx(SUCCESS, "credentials...... " _YELLOW_("%zu") " in " _YELLOW_("%" PRIu64) " ms", n, t1);
+    PrintAndLogEx(SUCCESS, "decoded.......... " _GREEN_("%zu"), valid);
+    PrintAndLogEx(SUCCESS, "parity failed.... %zu", parity_fail);
+    PrintAndLogEx(SUCCESS, "unknown.......... %zu", n - valid - parity_fail);
+    if (bad) {
+        PrintAndLogEx(SUCCESS, "skipped lines.... %zu", bad);
+    }
+    for (int i = 0; i < 256; i++) {
+        if (per_format[i]) {
+            cardformat_t fmt = HIDGetCardFormat(i);
+            PrintAndLogEx(SUCCESS, "   " _YELLOW_("%-10s") " %-32s %u", fmt.Name, fmt.Description, per_format[i]);
+        }
+    }
+
+    int ret = PM3_SUCCESS;
+    if (outname) {
+        FILE *out = fopen(outname, "w");
+        if (out == NULL) {
+            PrintAndLogEx(ERR, "Failed to create " _YELLOW_("%s"), outname);
+            ret = PM3_EFILE;
+        } else {
+            fprintf(out, "raw,bits,format,fc,cn,issue,oem,parity\n");
+            for (size_t i = 0; i < n; i++) {
+                const wiegand_message_t *p = &packed[i];
+                const wiegand_result_t *r = &results[i];
+                if (p->Top) {
+                    fprintf(out, "%X%08X%08X,%u,", p->Top, p->Mid, p->Bot, p->Length);
+                } else {
+                    fprintf(out, "%X%08X,%u,", p->Mid, p->Bot, p->Length);
+                }
+                if (r->format_idx < 0) {
+                    fprintf(out, ",,,,,\n");
+                    continue;
+                }
+                cardformat_t fmt = HIDGetCardFormat(r->format_idx);
+                fprintf(out, "%s,%u,%" PRIu64 ",%u,%u,%s\n"
+                        , fmt.Name
+                        , r->card.FacilityCode
+                        , r->card.CardNumber
+                        , r->card.IssueLevel
+                        , r->card.OEM
+                        , (r->valid) ? "ok" : "fail"
+                       );
+            }
+            fclose(out);
+            PrintAndLogEx(SUCCESS, "saved " _YELLOW_("%zu") " rows to " _YELLOW_("%s"), n, outname);
+        }
+    }
+    PrintAndLogEx(NORMAL, "");
+
+    free(results);
+    free(packed);
+    return ret;
+}
+
 int CmdWiegandDecode(const char *Cmd) {
 
     CLIParserContext *ctx;
     CLIParserInit(&ctx, "wiegand decode",
                   "Decode raw hex or binary to wiegand format",
                   "wiegand decode --raw 2006F623AE\n"
-                  "wiegand decode --new 06BD88EB80   -> 4..8 bytes, new padded format "
+                  "wiegand decode --new 06BD88EB80   -> 4..8 bytes, new padded format\n"
+                  "wiegand decode -f creds.txt -o creds.csv  -> one raw hex per line, decoded to csv"
                  );
 
     void *argtable[] = {
@@ -165,6 +360,8 @@ int CmdWiegandDecode(const char *Cmd) {
         arg_str0("r", "raw", "<hex>", "raw hex to be decoded"),
         arg_str0("b", "bin", "<bin>", "binary string to be decoded"),
         arg_str0("n", "new", "<hex>", "new padded pacs as raw hex to be decoded"),
+        arg_str0("f", "file", "<fn>", "file with one raw hex per line to be decoded"),
+        arg_str0("o", "out", "<fn>", "save the decoded file as csv"),
         arg_param_end
     };
     CLIExecWithReturn(ctx, Cmd, argtable, false);
@@ -180,6 +377,14 @@ int CmdWiegandDecode(const char *Cmd) {
     uint8_t phex[8] = {0};
     res = CLIParamHexToBuf(arg_get_str(ctx, 3), phex, sizeof(phex), &plen);
 
+    int fnlen = 0;
+    char filename[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 4), (uint8_t *)filename, FILE_PATH_SIZE, &fnlen);
+
+    int outlen = 0;
+    char outname[FILE_PATH_SIZE] = {0};
+    CLIParamStrToBuf(arg_get_str(ctx, 5), (uint8_t *)outname, FILE_PATH_SIZE, &outlen);
+
     CLIParserFree(ctx);
 
     if (res) {
@@ -187,6 +392,10 @@ int CmdWiegandDecode(const char *Cmd) {
         return PM3_EINVARG;
     }
 
+    if (fnlen) {
+        return wiegand_decode_file(filename, (outlen) ? outname : NULL);
+    }
+
     uint32_t top = 0, mid = 0, bot = 0;
 
     if (hlen) {
@@ -26,59 +26,247 @@
 #include "uart/uart.h"
 #include "ui.h"
 #include "crc16.h"
+#include "lz4chunk.h"
 #include "util.h" // g_pendingPrompt
 #include "util_posix.h" // msclock
 #include "util_darwin.h" // en/dis-ableNapp();
 #include "usart_defs.h"
+#include "traceevent.h"
 
 // #define COMMS_DEBUG
 // #define COMMS_DEBUG_RAW
 
-// Serial port that we are communicating with the PM3 on.
-static serial_port sp = NULL;
+// Transmit queue entry, see pm3_comms_s
+typedef struct {
+    union {
+        PacketCommandNGTaggedRaw ng;
+        PacketCommandOLD old;
+    } frame;
+    size_t len;          // bytes on the wire
+    uint16_t cmd;
+    bool old;            // OLD frames, e.g. for the bootloader, are always sent on their own
+} tx_packet_t;
+
+// Outstanding pipelined commands, completed by PacketResponseReceived
+struct pm3_future_s {
+    pm3_comms_t *comms;
+    bool used;
+    bool done;
+    bool tagged;         // matched by seq, else by the first reply with its cmd
+    uint16_t seq;
+    uint16_t cmd;
+    uint64_t order;      // untagged ones complete in the order they were sent
+    uint32_t wtx;        // waiting time extensions the device asked for, ms
+    PacketResponseNG resp;
+};
+
+// Everything it takes to talk to one device. Shared by its communication thread
+// and the threads working with it
+struct pm3_comms_s {
+    communication_arg_t conn;
+    capabilities_t capabilities;
+
+    // the CLI session, or one of its own for devices opened by the library
+    session_arg_t *session;
+    session_arg_t own_session;
+
+    // Serial port that we are communicating with the PM3 on.
+    serial_port sp;
+
+    pthread_t communication_thread;
+    pthread_t reconnect_thread;
+
+    bool reconnect_ok;
+
+    bool comm_thread_dead;
+    bool comm_raw_mode;
+    uint8_t *comm_raw_data;
+    size_t comm_raw_len;
+    size_t comm_raw_pos;
+    bool comm_raw_wrap;
+
+    // Transmit queue, filled by any thread and drained in order by the communication thread.
+    // Senders block while it is full. Queued NG / MIX frames go out with a single uart_send
+    // when the device announces coalesced_frames, older firmware loses frames sharing a USB packet.
+    tx_packet_t txQueue[TX_QUEUE_LEN];
+    size_t txQueue_head;  // oldest packet
+    size_t txQueue_count;
+    uint8_t txSendBuf[TX_QUEUE_LEN * sizeof(PacketCommandOLD)];
+    pthread_mutex_t txQueueMutex;
+    pthread_cond_t txQueueNotFull;
+    pthread_cond_t txQueueNotEmpty;
+
+    pm3_future_t futures[PM3_MAX_IN_FLIGHT];
+    uint16_t futures_seq;
+    uint64_t futures_order;
+    pthread_mutex_t futuresMutex;
+
+    // Used by PacketResponseReceived as a ring buffer for messages that are yet to be
+    // processed by a command handler (WaitForResponse{,Timeout})
+    PacketResponseNG rxBuffer[CMD_BUFFER_SIZE];
+
+    // Points to the next empty position to write to
+    int cmd_head;
+
+    // Points to the position of the last unread command
+    int cmd_tail;
+
+    // to lock rxBuffer operations from different threads
+    pthread_mutex_t rxBufferMutex;
+
+    // Start time for WaitForResponseTimeout & dl_it, so we can reset timeout when we get packets
+    // as sending lot of these packets can slow down things wuite a lot on slow links (e.g. hw status or lf read at 9600)
+    uint64_t timeout_start_time;
+
+    uint64_t last_packet_time;
+
+    dl_lz4_mode_t dl_lz4_mode;
+};
+
+// The device of the CLI, always there, connected or not
+static pm3_comms_t cli_comms;
+static pm3_device_t cli_device = {
+    .conn = &cli_comms.conn,
+    .script_embedded = 0,
+    .comms = &cli_comms,
+};
+
+static session_arg_t cli_session = {
+    .current_device = &cli_device,
+    .print_and_log = PRINTANDLOG_PRINT | PRINTANDLOG_LOG,
+};
+
+static pm3_comms_t cli_comms = {
+    .session = &cli_session,
+    .txQueueMutex = PTHREAD_MUTEX_INITIALIZER,
+    .txQueueNotFull = PTHREAD_COND_INITIALIZER,
+    .txQueueNotEmpty = PTHREAD_COND_INITIALIZER,
+    .futuresMutex = PTHREAD_MUTEX_INITIALIZER,
+    .rxBufferMutex = PTHREAD_MUTEX_INITIALIZER,
+    .dl_lz4_mode = DL_LZ4_AUTO,
+};
+
+// NULL while the thread works with the device of the CLI session
+static __thread pm3_device_t *thread_device = NULL;
+
+pm3_device_t *SetThreadDevice(pm3_device_t *dev) {
+    pm3_device_t *prev = thread_device;
+    thread_device = dev;
+    return prev;
+}
 
-communication_arg_t g_conn;
-capabilities_t g_pm3_capabilities;
+session_arg_t *GetSession(void) {
+    return (thread_device) ? thread_device->comms->session : &cli_session;
+}
 
-static pthread_t communication_thread;
-static pthread_t reconnect_thread;
+pm3_device_t *GetCurrentDevice(void) {
+    if (thread_device) {
+        return thread_device;
+    }
+    return (cli_session.current_device) ? cli_session.current_device : &cli_device;
+}
 
-static bool reconnect_ok = false;
+static pm3_comms_t *current_comms(void) {
+    return GetCurrentDevice()->comms;
+}
 
-static bool comm_thread_dead = false;
-static bool comm_raw_mode = false;
-static uint8_t *comm_raw_data = NULL;
-static size_t comm_raw_len = 0;
-static size_t comm_raw_pos = 0;
+communication_arg_t *GetCommunicationArg(void) {
+    return &current_comms()->conn;
+}
 
-// Transmit buffer.
-static PacketCommandOLD txBuffer;
-static PacketCommandNGRaw txBufferNG;
-static size_t txBufferNGLen;
-static bool txBuffer_pending = false;
-static pthread_mutex_t txBufferMutex = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t txBufferSig = PTHREAD_COND_INITIALIZER;
+capabilities_t *GetCapabilities(void) {
+    return &current_comms()->capabilities;
+}
 
-// Used by PacketResponseReceived as a ring buffer for messages that are yet to be
-// processed by a command handler (WaitForResponse{,Timeout})
-static PacketResponseNG rxBuffer[CMD_BUFFER_SIZE];
+static char *strdup_or_null(const char *s) {
+    return (s) ? strdup(s) : NULL;
+}
 
-// Points to the next empty position to write to
-static int cmd_head = 0;
+// A device with a session of its own, starting out with the preferences of the CLI one
+static pm3_device_t *NewDevice(void) {
+    pm3_device_t *dev = calloc(1, sizeof(pm3_device_t));
+    pm3_comms_t *comms = calloc(1, sizeof(pm3_comms_t));
+    if (dev == NULL || comms == NULL) {
+        free(dev);
+        free(comms);
+        return NULL;
+    }
 
-// Points to the position of the last unread command
-static int cmd_tail = 0;
+    pthread_mutex_init(&comms->txQueueMutex, NULL);
+    pthread_cond_init(&comms->txQueueNotFull, NULL);
+    pthread_cond_init(&comms->txQueueNotEmpty, NULL);
+    pthread_mutex_init(&comms->futuresMutex, NULL);
+    pthread_mutex_init(&comms->rxBufferMutex, NULL);
+    comms->dl_lz4_mode = DL_LZ4_AUTO;
+
+    session_arg_t *session = &comms->own_session;
+    memcpy(session, &cli_session, sizeof(session_arg_t));
+    for (int i = 0; i < spItemCount; i++) {
+        session->defaultPaths[i] = strdup_or_null(cli_session.defaultPaths[i]);
+    }
+    session->history_path = strdup_or_null(cli_session.history_path);
+    session->mqtt_server = strdup_or_null(cli_session.mqtt_server);
+    session->mqtt_port = strdup_or_null(cli_session.mqtt_port);
+    session->mqtt_topic = strdup_or_null(cli_session.mqtt_topic);
+    memset(&session->grabbed_output, 0, sizeof(grabbed_output));
+    session->pm3_present = false;
+    session->current_device = dev;
+    comms->session = session;
+
+    dev->conn = &comms->conn;
+    dev->comms = comms;
+    return dev;
+}
 
-// to lock rxBuffer operations from different threads
-static pthread_mutex_t rxBufferMutex = PTHREAD_MUTEX_INITIALIZER;
+void FreeProxmark(pm3_device_t *dev) {
+    if (dev == NULL || dev == &cli_device) {
+        return;
+    }
+    if (thread_device == dev) {
+        thread_device = NULL;
+    }
 
-// Global start time for WaitForResponseTimeout & dl_it, so we can reset timeout when we get packets
-// as sending lot of these packets can slow down things wuite a lot on slow links (e.g. hw status or lf read at 9600)
-static uint64_t timeout_start_time;
+    pm3_comms_t *comms = dev->comms;
+    session_arg_t *session = &comms->own_session;
+    for (int i = 0; i < spItemCount; i++) {
+        free(session->defaultPaths[i]);
+    }
+    free(session->history_path);
+    free(session->mqtt_server);
+    free(session->mqtt_port);
+    free(session->mqtt_topic);
+    free(session->grabbed_output.ptr);
+    free(dev->eml);
+
+    pthread_mutex_destroy(&comms->txQueueMutex);
+    pthread_cond_destroy(&comms->txQueueNotFull);
+    pthread_cond_destroy(&comms->txQueueNotEmpty);
+    pthread_mutex_destroy(&comms->futuresMutex);
+    pthread_mutex_destroy(&comms->rxBufferMutex);
+    free(comms);
+    free(dev);
+}
 
-static uint64_t last_packet_time;
+static bool dl_it(pm3_comms_t *comms, uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd, bool lz4, download_progress_t progress, void *ctx);
 
-static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd);
+// Slot behind the last queued packet, waits for the communication thread while the queue is full.
+// Call with txQueueMutex held, then fill the slot and txQueue_push() it.
+static tx_packet_t *txQueue_reserve(pm3_comms_t *comms) {
+    /**
+    This causes hangups at times, when the pm3 unit is unresponsive or disconnected. The main console thread is alive,
+    but comm thread just spins here. Not good.../holiman
+    **/
+    while (comms->txQueue_count == TX_QUEUE_LEN) {
+        pthread_cond_wait(&comms->txQueueNotFull, &comms->txQueueMutex);
+    }
+    return &comms->txQueue[(comms->txQueue_head + comms->txQueue_count) % TX_QUEUE_LEN];
+}
+
+static void txQueue_push(pm3_comms_t *comms) {
+    comms->txQueue_count++;
+    // tell communication thread that a new command can be send
+    pthread_cond_signal(&comms->txQueueNotEmpty);
+}
 
 // Simple alias to track usages linked to the Bootloader, these commands must not be migrated.
 // - commands sent to enter bootloader mode as we might have to talk to old firmwares
@@ -89,7 +277,9 @@ void SendCommandBL(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, vo
 
 void SendCommandOLD(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len) {
 
+    pm3_comms_t *comms = current_comms();
     PacketCommandOLD c = {CMD_UNKNOWN, {0, 0, 0}, {{0}}};
+    TRACE_SPAN_ARG("comms", "send", "cmd", cmd);
 
     if (len > PM3_CMD_DATA_SIZE) {
         PrintAndLogEx(WARNING, "Sending " _RED_("%zu") " bytes of payload is too much for OLD frames, abort", len);
@@ -115,101 +305,92 @@ void SendCommandOLD(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, c
     print_hex_break((uint8_t *)&c.d, sizeof(c.d), 32);
 #endif
 
-    if (g_session.pm3_present == false) {
+    if (comms->session->pm3_present == false) {
         PrintAndLogEx(WARNING, "Sending bytes to Proxmark3 failed ( " _RED_("offline") " )");
         return;
     }
 
-    pthread_mutex_lock(&txBufferMutex);
-    /**
-    This causes hangups at times, when the pm3 unit is unresponsive or disconnected. The main console thread is alive,
-    but comm thread just spins here. Not good.../holiman
-    **/
-    while (txBuffer_pending) {
-        // wait for communication thread to complete sending a previous command
-        pthread_cond_wait(&txBufferSig, &txBufferMutex);
-    }
+    pthread_mutex_lock(&comms->txQueueMutex);
 
-    txBuffer = c;
-    txBuffer_pending = true;
+    tx_packet_t *tx = txQueue_reserve(comms);
+    tx->frame.old = c;
+    tx->len = sizeof(PacketCommandOLD);
+    tx->cmd = cmd;
+    tx->old = true;
+    txQueue_push(comms);
 
-    // tell communication thread that a new command can be send
-    pthread_cond_signal(&txBufferSig);
-
-    pthread_mutex_unlock(&txBufferMutex);
+    pthread_mutex_unlock(&comms->txQueueMutex);
 
 //__atomic_test_and_set(&txcmd_pending, __ATOMIC_SEQ_CST);
 }
 
-static void SendCommandNG_internal(uint16_t cmd, uint8_t *data, size_t len, bool ng) {
+// seq != 0 sends a tagged NG frame, the device must have announced tagged_frames
+static bool SendCommandNG_internal(pm3_comms_t *comms, uint16_t cmd, const uint8_t *data, size_t len, bool ng, uint16_t seq) {
+    // queueing only, a full queue makes the sender wait
+    TRACE_SPAN_ARG("comms", "send", "cmd", cmd);
 #ifdef COMMS_DEBUG
     PrintAndLogEx(INFO, "Sending %s", ng ? "NG" : "MIX");
 #endif
 
-    if (!g_session.pm3_present) {
+    if (!comms->session->pm3_present) {
         PrintAndLogEx(INFO, "Sending bytes to proxmark failed - offline");
-        return;
+        return false;
     }
     if (len > PM3_CMD_DATA_SIZE) {
         PrintAndLogEx(WARNING, "Sending " _RED_("%zu") " bytes of payload is too much, abort", len);
-        return;
+        return false;
     }
 
-    PacketCommandNGPostamble *tx_post = (PacketCommandNGPostamble *)((uint8_t *)&txBufferNG + sizeof(PacketCommandNGPreamble) + len);
+    size_t taglen = (seq) ? PM3_NG_TAG_SIZE : 0;
 
-    pthread_mutex_lock(&txBufferMutex);
-    /**
-    This causes hangups at times, when the pm3 unit is unresponsive or disconnected. The main console thread is alive,
-    but comm thread just spins here. Not good.../holiman
-    **/
-    while (txBuffer_pending) {
-        // wait for communication thread to complete sending a previous command
-        pthread_cond_wait(&txBufferSig, &txBufferMutex);
-    }
+    pthread_mutex_lock(&comms->txQueueMutex);
+
+    tx_packet_t *tx = txQueue_reserve(comms);
+    PacketCommandNGTaggedRaw *txng = &tx->frame.ng;
+    PacketCommandNGPostamble *tx_post = (PacketCommandNGPostamble *)(txng->body + taglen + len);
 
-    txBufferNG.pre.magic = COMMANDNG_PREAMBLE_MAGIC;
-    txBufferNG.pre.ng = ng;
-    txBufferNG.pre.length = len;
-    txBufferNG.pre.cmd = cmd;
+    txng->pre.magic = (seq) ? COMMANDNG_TAGGED_MAGIC : COMMANDNG_PREAMBLE_MAGIC;
+    txng->pre.ng = ng;
+    txng->pre.length = len;
+    txng->pre.cmd = cmd;
+    if (taglen) {
+        memcpy(txng->body, &seq, taglen);
+    }
     if (len > 0 && data) {
-        memcpy(&txBufferNG.data, data, len);
+        memcpy(txng->body + taglen, data, len);
     }
 
-    if ((g_conn.send_via_fpc_usart && g_conn.send_with_crc_on_fpc) || ((!g_conn.send_via_fpc_usart) && g_conn.send_with_crc_on_usb)) {
+    if ((comms->conn.send_via_fpc_usart && comms->conn.send_with_crc_on_fpc) || ((!comms->conn.send_via_fpc_usart) && comms->conn.send_with_crc_on_usb)) {
         uint8_t first = 0, second = 0;
-        compute_crc(CRC_14443_A, (uint8_t *)&txBufferNG, sizeof(PacketCommandNGPreamble) + len, &first, &second);
+        compute_crc(CRC_14443_A, (uint8_t *)txng, sizeof(PacketCommandNGPreamble) + taglen + len, &first, &second);
         tx_post->crc = (first << 8) + second;
     } else {
         tx_post->crc = COMMANDNG_POSTAMBLE_MAGIC;
     }
 
-    txBufferNGLen = sizeof(PacketCommandNGPreamble) + len + sizeof(PacketCommandNGPostamble);
+    tx->len = sizeof(PacketCommandNGPreamble) + taglen + len + sizeof(PacketCommandNGPostamble);
+    tx->cmd = cmd;
+    tx->old = false;
 
 #ifdef COMMS_DEBUG_RAW
-    print_hex_break((uint8_t *)&txBufferNG.pre, sizeof(PacketCommandNGPreamble), 32);
+    print_hex_break((uint8_t *)&txng->pre, sizeof(PacketCommandNGPreamble), 32);
     if (ng) {
-        print_hex_break((uint8_t *)&txBufferNG.data, len, 32);
+        print_hex_break(txng->body, taglen + len, 32);
     } else {
-        print_hex_break((uint8_t *)&txBufferNG.data, 3 * sizeof(uint64_t), 32);
-        print_hex_break((uint8_t *)&txBufferNG.data + 3 * sizeof(uint64_t), len - 3 * sizeof(uint64_t), 32);
+        print_hex_break(txng->body, taglen + 3 * sizeof(uint64_t), 32);
+        print_hex_break(txng->body + taglen + 3 * sizeof(uint64_t), len - 3 * sizeof(uint64_t), 32);
     }
     print_hex_break((uint8_t *)tx_post, sizeof(PacketCommandNGPostamble), 32);
 #endif
-    txBuffer_pending = true;
-
-    // tell communication thread that a new command can be send
-    pthread_cond_signal(&txBufferSig);
+    txQueue_push(comms);
 
-    pthread_mutex_unlock(&txBufferMutex);
+    pthread_mutex_unlock(&comms->txQueueMutex);
 
 //__atomic_test_and_set(&txcmd_pending, __ATOMIC_SEQ_CST);
+    return true;
 }
 
-void SendCommandNG(uint16_t cmd, uint8_t *data, size_t len) {
-    SendCommandNG_internal(cmd, data, len, true);
-}
-
-void SendCommandMIX(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len) {
+static void SendCommandMIX_internal(pm3_comms_t *comms, uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len) {
     uint64_t arg[3] = {arg0, arg1, arg2};
     if (len > PM3_CMD_DATA_SIZE_MIX) {
         PrintAndLogEx(WARNING, "Sending " _RED_("%zu") " bytes of payload is too much for MIX frames, abort", len);
@@ -219,7 +400,23 @@ void SendCommandMIX(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, c
     memcpy(cmddata, arg, sizeof(arg));
     if (len && data)
         memcpy(cmddata + sizeof(arg), data, len);
-    SendCommandNG_internal(cmd, cmddata, len + sizeof(arg), false);
+    SendCommandNG_internal(comms, cmd, cmddata, len + sizeof(arg), false, 0);
+}
+
+void SendCommandNG(uint16_t cmd, uint8_t *data, size_t len) {
+    SendCommandNG_internal(current_comms(), cmd, data, len, true, 0);
+}
+
+void SendCommandMIX(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len) {
+    SendCommandMIX_internal(current_comms(), cmd, arg0, arg1, arg2, data, len);
+}
+
+void SendCommandNGDev(pm3_device_t *dev, uint16_t cmd, const uint8_t *data, size_t len) {
+    SendCommandNG_internal(dev->comms, cmd, data, len, true, 0);
+}
+
+void SendCommandMIXDev(pm3_device_t *dev, uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len) {
+    SendCommandMIX_internal(dev->comms, cmd, arg0, arg1, arg2, data, len);
 }
 
 
@@ -229,70 +426,117 @@ void SendCommandMIX(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, c
  *  A better method could have been to have explicit command-ACKS, so we can know which ACK goes to which
  *  operation. Right now we'll just have to live with this.
  */
-void clearCommandBuffer(void) {
+static void clearCommandBuffer_internal(pm3_comms_t *comms) {
     //This is a very simple operation
-    pthread_mutex_lock(&rxBufferMutex);
-    cmd_tail = cmd_head;
-    pthread_mutex_unlock(&rxBufferMutex);
+    pthread_mutex_lock(&comms->rxBufferMutex);
+    comms->cmd_tail = comms->cmd_head;
+    pthread_mutex_unlock(&comms->rxBufferMutex);
+}
+
+void clearCommandBuffer(void) {
+    clearCommandBuffer_internal(current_comms());
+}
+
+void clearCommandBufferDev(pm3_device_t *dev) {
+    clearCommandBuffer_internal(dev->comms);
 }
 /**
  * @brief storeCommand stores a USB command in a circular buffer
  * @param UC
  */
-static void storeReply(const PacketResponseNG *packet) {
-    pthread_mutex_lock(&rxBufferMutex);
-    if ((cmd_head + 1) % CMD_BUFFER_SIZE == cmd_tail) {
+static void storeReply(pm3_comms_t *comms, const PacketResponseNG *packet) {
+    pthread_mutex_lock(&comms->rxBufferMutex);
+    if ((comms->cmd_head + 1) % CMD_BUFFER_SIZE == comms->cmd_tail) {
         //If these two are equal, we're about to overwrite in the
         // circular buffer.
         PrintAndLogEx(FAILED, "WARNING: Command buffer about to overwrite command! This needs to be fixed!");
         fflush(stdout);
     }
     //Store the command at the 'head' location
-    PacketResponseNG *destination = &rxBuffer[cmd_head];
+    PacketResponseNG *destination = &comms->rxBuffer[comms->cmd_head];
     memcpy(destination, packet, sizeof(PacketResponseNG));
 
     //increment head and wrap
-    cmd_head = (cmd_head + 1) % CMD_BUFFER_SIZE;
-    pthread_mutex_unlock(&rxBufferMutex);
+    comms->cmd_head = (comms->cmd_head + 1) % CMD_BUFFER_SIZE;
+    pthread_mutex_unlock(&comms->rxBufferMutex);
 }
 /**
  * @brief getCommand gets a command from an internal circular buffer.
  * @param response location to write command
  * @return 1 if response was returned, 0 if nothing has been received
  */
-static int getReply(PacketResponseNG *packet) {
-    pthread_mutex_lock(&rxBufferMutex);
+static int getReply(pm3_comms_t *comms, PacketResponseNG *packet) {
+    pthread_mutex_lock(&comms->rxBufferMutex);
     //If head == tail, there's nothing to read, or if we just got initialized
-    if (cmd_head == cmd_tail)  {
-        pthread_mutex_unlock(&rxBufferMutex);
+    if (comms->cmd_head == comms->cmd_tail)  {
+        pthread_mutex_unlock(&comms->rxBufferMutex);
         return 0;
     }
 
     //Pick out the next unread command
-    memcpy(packet, &rxBuffer[cmd_tail], sizeof(PacketResponseNG));
+    memcpy(packet, &comms->rxBuffer[comms->cmd_tail], sizeof(PacketResponseNG));
 
     //Increment tail - this is a circular buffer, so modulo buffer size
-    cmd_tail = (cmd_tail + 1) % CMD_BUFFER_SIZE;
+    comms->cmd_tail = (comms->cmd_tail + 1) % CMD_BUFFER_SIZE;
 
-    pthread_mutex_unlock(&rxBufferMutex);
+    pthread_mutex_unlock(&comms->rxBufferMutex);
     return 1;
 }
 
+// true when packet is the reply an outstanding pipelined command waits for
+static bool CompleteFuture(pm3_comms_t *comms, const PacketResponseNG *packet) {
+    pm3_future_t *match = NULL;
+
+    pthread_mutex_lock(&comms->futuresMutex);
+    for (size_t i = 0; i < PM3_MAX_IN_FLIGHT; i++) {
+        pm3_future_t *f = &comms->futures[i];
+        if (f->used == false || f->done || f->tagged != (packet->seq != 0)) {
+            continue;
+        }
+        if (f->tagged) {
+            if (f->seq != packet->seq) {
+                continue;
+            }
+            if (packet->cmd == CMD_WTX && packet->length == sizeof(uint16_t)) {
+                f->wtx += packet->data.asDwords[0] & 0xFFFF;
+                break;
+            }
+        }
+        if (f->cmd != packet->cmd) {
+            continue;
+        }
+        if (match == NULL || f->order < match->order) {
+            match = f;
+        }
+    }
+    if (match) {
+        memcpy(&match->resp, packet, sizeof(PacketResponseNG));
+        match->done = true;
+    }
+    pthread_mutex_unlock(&comms->futuresMutex);
+    return (match != NULL);
+}
+
 //-----------------------------------------------------------------------------
 // Entry point into our code: called whenever we received a packet over USB
 // that we weren't necessarily expecting, for example a debug print.
 //-----------------------------------------------------------------------------
-static void PacketResponseReceived(PacketResponseNG *packet) {
+static void PacketResponseReceived(pm3_comms_t *comms, PacketResponseNG *packet) {
+    TRACE_SPAN_ARG("comms", "receive", "cmd", packet->cmd);
 
     // we got a packet, reset WaitForResponseTimeout timeout
-    uint64_t prev_clk = __atomic_load_n(&last_packet_time, __ATOMIC_SEQ_CST);
+    uint64_t prev_clk = __atomic_load_n(&comms->last_packet_time, __ATOMIC_SEQ_CST);
     uint64_t clk = msclock();
-    __atomic_store_n(&timeout_start_time,  clk, __ATOMIC_SEQ_CST);
-    __atomic_store_n(&last_packet_time, clk, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&comms->timeout_start_time,  clk, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&comms->last_packet_time, clk, __ATOMIC_SEQ_CST);
     (void) prev_clk;
 //    PrintAndLogEx(NORMAL, "[%07"PRIu64"] RECV %s magic %08x length %04x status %04x crc %04x cmd %04x",
 //                clk - prev_clk, packet->ng ? "NG" : "OLD", packet->magic, packet->length, packet->status, packet->crc, packet->cmd);
 
+    if (CompleteFuture(comms, packet)) {
+        return;
+    }
+
     switch (packet->cmd) {
         // First check if we are handling a debug message
         case CMD_DEBUG_PRINT_STRING: {
@@ -351,7 +595,7 @@ static void PacketResponseReceived(PacketResponseNG *packet) {
         // CMD_DOWNLOAD_BIGBUF packages which is not dealt with. I wonder if simply ignoring them will
         // work. lets try it.
         default: {
-            storeReply(packet);
+            storeReply(comms, packet);
             break;
         }
     }
@@ -361,7 +605,10 @@ static void PacketResponseReceived(PacketResponseNG *packet) {
 // When communication thread is dead,   start up and try to start it again
 void *uart_reconnect(void *targ) {
 
-    const communication_arg_t *connection = (communication_arg_t *)targ;
+    pm3_device_t *dev = (pm3_device_t *)targ;
+    SetThreadDevice(dev);
+    pm3_comms_t *comms = dev->comms;
+    const communication_arg_t *connection = &comms->conn;
 
 #if defined(__MACH__) && defined(__APPLE__)
     disableAppNap("Proxmark3 polling UART");
@@ -375,12 +622,12 @@ void *uart_reconnect(void *targ) {
     while (1) {
         // throttle
         msleep(200);
-        if (OpenProxmarkSilent(&g_session.current_device, connection->serial_port_name, speed) == false) {
+        if (OpenProxmarkSilent(&comms->session->current_device, connection->serial_port_name, speed) == false) {
             continue;
         }
 
-        if (g_session.pm3_present && (TestProxmark(g_session.current_device) != PM3_SUCCESS)) {
-            CloseProxmark(g_session.current_device);
+        if (comms->session->pm3_present && (TestProxmark(comms->session->current_device) != PM3_SUCCESS)) {
+            CloseProxmark(comms->session->current_device);
         } else {
             break;
         }
@@ -391,18 +638,20 @@ void *uart_reconnect(void *targ) {
     enableAppNap();
 #endif
 
-    __atomic_test_and_set(&reconnect_ok, __ATOMIC_SEQ_CST);
+    __atomic_test_and_set(&comms->reconnect_ok, __ATOMIC_SEQ_CST);
 
     pthread_exit(NULL);
     return NULL;
 }
 
 void StartReconnectProxmark(void) {
-    pthread_create(&reconnect_thread, NULL, &uart_reconnect, &g_conn);
+    pm3_device_t *dev = GetCurrentDevice();
+    pthread_create(&dev->comms->reconnect_thread, NULL, &uart_reconnect, dev);
 }
 
 bool IsReconnectedOk(void) {
-    bool ret = __atomic_load_n(&reconnect_ok, __ATOMIC_SEQ_CST);
+    pm3_comms_t *comms = current_comms();
+    bool ret = __atomic_load_n(&comms->reconnect_ok, __ATOMIC_SEQ_CST);
     return ret;
 }
 
@@ -416,11 +665,16 @@ __attribute__((force_align_arg_pointer))
 #endif
 #endif
 *uart_communication(void *targ) {
-    const communication_arg_t *connection = (communication_arg_t *)targ;
+    // everything this thread prints or stores goes to the session of its device
+    pm3_device_t *dev = (pm3_device_t *)targ;
+    SetThreadDevice(dev);
+    traceevent_thread_name("comms");
+    pm3_comms_t *comms = dev->comms;
+    const communication_arg_t *connection = &comms->conn;
     uint32_t rxlen;
     bool commfailed = false;
     PacketResponseNG rx;
-    PacketResponseNGRaw rx_raw;
+    PacketResponseNGTaggedRaw rx_raw;
     // Stash the last state of is_receiving_raw, to detect if state changed
     bool is_receiving_raw_last = false;
 
@@ -438,30 +692,33 @@ __attribute__((force_align_arg_pointer))
         // Signal to main thread that communications seems off.
         // main thread will kill and restart this thread.
         if (commfailed) {
-            if (g_conn.last_command != CMD_HARDWARE_RESET &&
-                    g_conn.last_command != CMD_START_FLASH) {
+            if (comms->conn.last_command != CMD_HARDWARE_RESET &&
+                    comms->conn.last_command != CMD_START_FLASH) {
                 PrintAndLogEx(WARNING, "\nCommunicating with Proxmark3 device " _RED_("failed"));
             }
-            __atomic_test_and_set(&comm_thread_dead, __ATOMIC_SEQ_CST);
+            __atomic_test_and_set(&comms->comm_thread_dead, __ATOMIC_SEQ_CST);
             break;
         }
 
-        bool is_receiving_raw = __atomic_load_n(&comm_raw_mode, __ATOMIC_SEQ_CST);
+        bool is_receiving_raw = __atomic_load_n(&comms->comm_raw_mode, __ATOMIC_SEQ_CST);
 
         if (is_receiving_raw) {
-            uint8_t *bufferData = __atomic_load_n(&comm_raw_data, __ATOMIC_SEQ_CST); // read only
-            size_t bufferLen = __atomic_load_n(&comm_raw_len, __ATOMIC_SEQ_CST); // read only
-            size_t bufferPos = __atomic_load_n(&comm_raw_pos, __ATOMIC_SEQ_CST); // read and write
-            if (bufferPos < bufferLen) {
-                size_t rxMaxLen = bufferLen - bufferPos;
+            uint8_t *bufferData = __atomic_load_n(&comms->comm_raw_data, __ATOMIC_SEQ_CST); // read only
+            size_t bufferLen = __atomic_load_n(&comms->comm_raw_len, __ATOMIC_SEQ_CST); // read only
+            size_t bufferPos = __atomic_load_n(&comms->comm_raw_pos, __ATOMIC_SEQ_CST); // read and write
+            bool bufferWrap = __atomic_load_n(&comms->comm_raw_wrap, __ATOMIC_SEQ_CST); // read only
+            // a wrapping buffer is a ring, pos keeps counting all received bytes
+            size_t bufferAt = (bufferWrap) ? bufferPos % bufferLen : bufferPos;
+            if (bufferWrap || bufferPos < bufferLen) {
+                size_t rxMaxLen = bufferLen - bufferAt;
 
                 rxMaxLen = MIN(COMM_RAW_RECEIVE_LEN, rxMaxLen);
 
-                res = uart_receive(sp, bufferData + bufferPos, rxMaxLen, &rxlen);
+                res = uart_receive(comms->sp, bufferData + bufferAt, rxMaxLen, &rxlen);
                 if (res == PM3_SUCCESS) {
                     uint64_t clk = msclock();
-                    __atomic_store_n(&timeout_start_time,  clk, __ATOMIC_SEQ_CST);
-                    __atomic_store_n(&comm_raw_pos, bufferPos + rxlen, __ATOMIC_SEQ_CST);
+                    __atomic_store_n(&comms->timeout_start_time,  clk, __ATOMIC_SEQ_CST);
+                    __atomic_store_n(&comms->comm_raw_pos, bufferPos + rxlen, __ATOMIC_SEQ_CST);
                 } else if (res != PM3_ENODATA) {
                     PrintAndLogEx(WARNING, "Error when reading raw data: %zu/%zu, %d", bufferPos, bufferLen, res);
                     error = true;
@@ -473,7 +730,7 @@ __attribute__((force_align_arg_pointer))
                 // Ignore data when bufferPos >= bufferLen and is_receiving_raw has not been set to false
                 uint8_t dummyData[64];
                 uint32_t dummyLen;
-                uart_receive(sp, dummyData, sizeof(dummyData), &dummyLen);
+                uart_receive(comms->sp, dummyData, sizeof(dummyData), &dummyLen);
             }
         } else {
             if (is_receiving_raw_last) {
@@ -481,9 +738,9 @@ __attribute__((force_align_arg_pointer))
 
                 // Set the buffer as undefined
                 // comm_raw_data == NULL is used in SetCommunicationReceiveMode()
-                __atomic_store_n(&comm_raw_data, NULL, __ATOMIC_SEQ_CST);
+                __atomic_store_n(&comms->comm_raw_data, NULL, __ATOMIC_SEQ_CST);
             }
-            res = uart_receive(sp, (uint8_t *)&rx_raw.pre, sizeof(PacketResponseNGPreamble), &rxlen);
+            res = uart_receive(comms->sp, (uint8_t *)&rx_raw.pre, sizeof(PacketResponseNGPreamble), &rxlen);
 
             if ((res == PM3_SUCCESS) && (rxlen == sizeof(PacketResponseNGPreamble))) {
 
@@ -493,81 +750,79 @@ __attribute__((force_align_arg_pointer))
                 rx.status = rx_raw.pre.status;
                 rx.reason = rx_raw.pre.reason;
                 rx.cmd = rx_raw.pre.cmd;
+                rx.seq = 0;
+
+                if (rx.magic == RESPONSENG_PREAMBLE_MAGIC || rx.magic == RESPONSENG_TAGGED_MAGIC) { // New style NG reply
 
-                if (rx.magic == RESPONSENG_PREAMBLE_MAGIC) { // New style NG reply
+                    // a tagged reply has the tag of its command in front of the payload
+                    size_t taglen = (rx.magic == RESPONSENG_TAGGED_MAGIC) ? PM3_NG_TAG_SIZE : 0;
+                    const uint8_t *payload = rx_raw.body + taglen;
+                    PacketResponseNGPostamble post = {0};
 
                     if (length > PM3_CMD_DATA_SIZE) {
                         PrintAndLogEx(WARNING, "Received packet frame with incompatible length: 0x%04x", length);
                         error = true;
                     }
 
-                    if ((!error) && (length > 0)) { // Get the variable length payload
-
-                        res = uart_receive(sp, (uint8_t *)&rx_raw.data, length, &rxlen);
-
-                        if ((res != PM3_SUCCESS) || (rxlen != length)) {
+                    if ((!error) && (length == 0) && (rx.ng == false)) { // old frames can't be empty
+                        PrintAndLogEx(WARNING, "Received empty MIX packet frame (length: 0x00)");
+                        error = true;
+                    }
 
-                            PrintAndLogEx(WARNING, "Received packet frame with variable part too short? %d/%d", rxlen, length);
+                    if (!error) { // Get the tag, the variable length payload and the postamble right behind it, in one go
+                        res = uart_receive(comms->sp, rx_raw.body, taglen + length + sizeof(PacketResponseNGPostamble), &rxlen);
+                        if (rxlen < taglen + length) {
+                            PrintAndLogEx(WARNING, "Received packet frame with variable part too short? %d/%zu", rxlen, taglen + length);
+                            error = true;
+                        } else if ((res != PM3_SUCCESS) || (rxlen != taglen + length + sizeof(PacketResponseNGPostamble))) {
+                            PrintAndLogEx(WARNING, "Received packet frame without postamble");
                             error = true;
-
                         } else {
+                            memcpy(&rx.seq, rx_raw.body, taglen);
+                            memcpy(&post, payload + length, sizeof(PacketResponseNGPostamble));
+                        }
+                    }
 
-                            if (rx.ng) {      // Received a valid NG frame
-
-                                memcpy(&rx.data, &rx_raw.data, length);
-                                rx.length = length;
-                                if ((rx.cmd == g_conn.last_command) && (rx.status == PM3_SUCCESS)) {
-                                    ACK_received = true;
-                                }
-
-                            } else {
-                                uint64_t arg[3];
-                                if (length < sizeof(arg)) {
-                                    PrintAndLogEx(WARNING, "Received MIX packet frame with incompatible length: 0x%04x", length);
-                                    error = true;
-                                }
+                    if (!error) {
 
-                                if (!error) { // Received a valid MIX frame
+                        if (rx.ng) {      // Received a valid NG frame
 
-                                    memcpy(arg, &rx_raw.data, sizeof(arg));
-                                    rx.oldarg[0] = arg[0];
-                                    rx.oldarg[1] = arg[1];
-                                    rx.oldarg[2] = arg[2];
-                                    memcpy(&rx.data, ((uint8_t *)&rx_raw.data) + sizeof(arg), length - sizeof(arg));
-                                    rx.length = length - sizeof(arg);
+                            memcpy(&rx.data, payload, length);
+                            rx.length = length;
+                            if ((rx.cmd == comms->conn.last_command) && (rx.status == PM3_SUCCESS)) {
+                                ACK_received = true;
+                            }
 
-                                    if (rx.cmd == CMD_ACK) {
-                                        ACK_received = true;
-                                    }
-                                }
+                        } else {
+                            uint64_t arg[3];
+                            if (length < sizeof(arg)) {
+                                PrintAndLogEx(WARNING, "Received MIX packet frame with incompatible length: 0x%04x", length);
+                                error = true;
                             }
-                        }
-                    } else if ((!error) && (length == 0)) { // we received an empty frame
 
-                        if (rx.ng) {
-                            rx.length = 0; // set received length to 0
-                        } else {  // old frames can't be empty
-                            PrintAndLogEx(WARNING, "Received empty MIX packet frame (length: 0x00)");
-                            error = true;
-                        }
+                            if (!error) { // Received a valid MIX frame
 
-                    }
+                                memcpy(arg, payload, sizeof(arg));
+                                rx.oldarg[0] = arg[0];
+                                rx.oldarg[1] = arg[1];
+                                rx.oldarg[2] = arg[2];
+                                memcpy(&rx.data, payload + sizeof(arg), length - sizeof(arg));
+                                rx.length = length - sizeof(arg);
 
-                    if (!error) {                        // Get the postamble
-                        res = uart_receive(sp, (uint8_t *)&rx_raw.foopost, sizeof(PacketResponseNGPostamble), &rxlen);
-                        if ((res != PM3_SUCCESS) || (rxlen != sizeof(PacketResponseNGPostamble))) {
-                            PrintAndLogEx(WARNING, "Received packet frame without postamble");
-                            error = true;
+                                if (rx.cmd == CMD_ACK) {
+                                    ACK_received = true;
+                                }
+                            }
                         }
                     }
 
                     if (!error) {                        // Check CRC, accept MAGIC as placeholder
-                        rx.crc = rx_raw.foopost.crc;
+                        rx.crc = post.crc;
 
                         if (rx.crc != RESPONSENG_POSTAMBLE_MAGIC) {
 
                             uint8_t first, second;
-                            compute_crc(CRC_14443_A, (uint8_t *)&rx_raw, sizeof(PacketResponseNGPreamble) + length, &first, &second);
+                            compute_crc(CRC_14443_A, (uint8_t *)&rx_raw, sizeof(PacketResponseNGPreamble) + taglen + length, &first, &second);
 
                             if ((first << 8) + second != rx.crc) {
                                 PrintAndLogEx(WARNING, "Received packet frame with invalid CRC %02X%02X <> %04X", first, second, rx.crc);
@@ -581,16 +836,16 @@ __attribute__((force_align_arg_pointer))
 #endif
 #ifdef COMMS_DEBUG_RAW
                         print_hex_break((uint8_t *)&rx_raw.pre, sizeof(PacketResponseNGPreamble), 32);
-                        print_hex_break((uint8_t *)&rx_raw.data, rx_raw.pre.length, 32);
-                        print_hex_break((uint8_t *)&rx_raw.foopost, sizeof(PacketResponseNGPostamble), 32);
+                        print_hex_break(rx_raw.body, taglen + length, 32);
+                        print_hex_break((uint8_t *)&post, sizeof(PacketResponseNGPostamble), 32);
 #endif
-                        PacketResponseReceived(&rx);
+                        PacketResponseReceived(comms, &rx);
                     }
                 } else {                               // Old style reply
                     PacketResponseOLD rx_old;
                     memcpy(&rx_old, &rx_raw.pre, sizeof(PacketResponseNGPreamble));
 
-                    res = uart_receive(sp, ((uint8_t *)&rx_old) + sizeof(PacketResponseNGPreamble), sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble), &rxlen);
+                    res = uart_receive(comms->sp, ((uint8_t *)&rx_old) + sizeof(PacketResponseNGPreamble), sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble), &rxlen);
                     if ((res != PM3_SUCCESS) || (rxlen != sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble))) {
                         PrintAndLogEx(WARNING, "Received packet OLD frame with payload too short? %d/%zu", rxlen, sizeof(PacketResponseOLD) - sizeof(PacketResponseNGPreamble));
                         error = true;
@@ -608,13 +863,14 @@ __attribute__((force_align_arg_pointer))
                         rx.magic = 0;
                         rx.status = 0;
                         rx.crc = 0;
+                        rx.seq = 0;
                         rx.cmd = rx_old.cmd;
                         rx.oldarg[0] = rx_old.arg[0];
                         rx.oldarg[1] = rx_old.arg[1];
                         rx.oldarg[2] = rx_old.arg[2];
                         rx.length = PM3_CMD_DATA_SIZE;
                         memcpy(&rx.data, &rx_old.d, rx.length);
-                        PacketResponseReceived(&rx);
+                        PacketResponseReceived(comms, &rx);
                         if (rx.cmd == CMD_ACK) {
                             ACK_received = true;
                         }
@@ -634,7 +890,7 @@ __attribute__((force_align_arg_pointer))
         is_receiving_raw_last = is_receiving_raw;
         // TODO if error, shall we resync ?
 
-        pthread_mutex_lock(&txBufferMutex);
+        pthread_mutex_lock(&comms->txQueueMutex);
 
         if (connection->block_after_ACK) {
             // if we just received an ACK, wait here until a new command is to be transmitted
@@ -643,43 +899,54 @@ __attribute__((force_align_arg_pointer))
 #ifdef COMMS_DEBUG
                 PrintAndLogEx(NORMAL, "Received ACK, fast TX mode: ignoring other RX till TX");
 #endif
-                while (!txBuffer_pending) {
-                    pthread_cond_wait(&txBufferSig, &txBufferMutex);
+                while (comms->txQueue_count == 0) {
+                    pthread_cond_wait(&comms->txQueueNotEmpty, &comms->txQueueMutex);
                 }
             }
         }
 
-        if (txBuffer_pending) {
-
-            if (txBufferNGLen) { // NG packet
-                res = uart_send(sp, (uint8_t *) &txBufferNG, txBufferNGLen);
-                if (res == PM3_EIO) {
-                    commfailed = true;
-                }
-                g_conn.last_command = txBufferNG.pre.cmd;
-                txBufferNGLen = 0;
-            } else {
-                res = uart_send(sp, (uint8_t *) &txBuffer, sizeof(PacketCommandOLD));
-                if (res == PM3_EIO) {
-                    commfailed = true;
-                }
-                g_conn.last_command = txBuffer.cmd;
+        // take the queued packets in order, up to the first OLD frame
+        size_t txlen = 0;
+        size_t txcount = 0;
+        uint16_t txcmd = 0;
+        bool coalesce = comms->capabilities.coalesced_frames;
+        while (txcount < comms->txQueue_count) {
+            const tx_packet_t *tx = &comms->txQueue[(comms->txQueue_head + txcount) % TX_QUEUE_LEN];
+            if (tx->old && txcount) {
+                break;
+            }
+            memcpy(comms->txSendBuf + txlen, &tx->frame, tx->len);
+            txlen += tx->len;
+            txcmd = tx->cmd;
+            txcount++;
+            if (tx->old || coalesce == false) {
+                break;
             }
+        }
 
-            txBuffer_pending = false;
+        if (txcount) {
+            comms->txQueue_head = (comms->txQueue_head + txcount) % TX_QUEUE_LEN;
+            comms->txQueue_count -= txcount;
+            // tell senders there is room again
+            pthread_cond_broadcast(&comms->txQueueNotFull);
+        }
 
-            // main thread doesn't know send failed...
+        pthread_mutex_unlock(&comms->txQueueMutex);
 
-            // tell main thread that txBuffer is empty
-            pthread_cond_signal(&txBufferSig);
+        if (txcount) {
+            TRACE_SPAN_ARG("comms", "write", "bytes", txlen);
+            res = uart_send(comms->sp, comms->txSendBuf, txlen);
+            if (res == PM3_EIO) {
+                commfailed = true;
+            }
+            // main thread doesn't know send failed...
+            comms->conn.last_command = txcmd;
         }
-
-        pthread_mutex_unlock(&txBufferMutex);
     }
 
     // when thread dies, we close the serial port.
-    uart_close(sp);
-    sp = NULL;
+    uart_close(comms->sp);
+    comms->sp = NULL;
 
 #if defined(__MACH__) && defined(__APPLE__)
     enableAppNap();
@@ -690,7 +957,8 @@ __attribute__((force_align_arg_pointer))
 }
 
 bool IsCommunicationThreadDead(void) {
-    bool ret = __atomic_load_n(&comm_thread_dead, __ATOMIC_SEQ_CST);
+    pm3_comms_t *comms = current_comms();
+    bool ret = __atomic_load_n(&comms->comm_thread_dead, __ATOMIC_SEQ_CST);
     return ret;
 }
 
@@ -709,145 +977,188 @@ bool IsCommunicationThreadDead(void) {
 // SetCommunicationReceiveMode(false) to stop the raw receiving process.
 // 2. If the received size >= len used in SetCommunicationRawReceiveBuffer(),
 // The receiving thread will ignore the incoming data to prevent overflow.
+// With SetCommunicationRawReceiveBufferEx(..., wrap = true) it starts over at
+// the beginning of the buffer instead, and the receive count keeps growing.
 // 3. Normally you only need WaitForRawDataTimeout() rather than the
 // low level functions like SetCommunicationReceiveMode(),
 // SetCommunicationRawReceiveBuffer() and GetCommunicationRawReceiveNum()
 
 bool SetCommunicationReceiveMode(bool isRawMode) {
+    pm3_comms_t *comms = current_comms();
     if (isRawMode) {
-        const uint8_t *buffer = __atomic_load_n(&comm_raw_data, __ATOMIC_SEQ_CST);
+        const uint8_t *buffer = __atomic_load_n(&comms->comm_raw_data, __ATOMIC_SEQ_CST);
         if (buffer == NULL) {
             PrintAndLogEx(ERR, "Buffer for raw data is not set");
             return false;
         }
     }
-    __atomic_store_n(&comm_raw_mode, isRawMode, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&comms->comm_raw_mode, isRawMode, __ATOMIC_SEQ_CST);
     return true;
 }
 
 void SetCommunicationRawReceiveBuffer(uint8_t *buffer, size_t len) {
-    __atomic_store_n(&comm_raw_data,  buffer, __ATOMIC_SEQ_CST);
-    __atomic_store_n(&comm_raw_len,  len, __ATOMIC_SEQ_CST);
-    __atomic_store_n(&comm_raw_pos,  0, __ATOMIC_SEQ_CST);
+    SetCommunicationRawReceiveBufferEx(buffer, len, false);
+}
+
+void SetCommunicationRawReceiveBufferEx(uint8_t *buffer, size_t len, bool wrap) {
+    pm3_comms_t *comms = current_comms();
+    __atomic_store_n(&comms->comm_raw_data,  buffer, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&comms->comm_raw_len,  len, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&comms->comm_raw_pos,  0, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&comms->comm_raw_wrap,  wrap, __ATOMIC_SEQ_CST);
 }
 
 size_t GetCommunicationRawReceiveNum(void) {
-    return __atomic_load_n(&comm_raw_pos, __ATOMIC_SEQ_CST);
+    pm3_comms_t *comms = current_comms();
+    return __atomic_load_n(&comms->comm_raw_pos, __ATOMIC_SEQ_CST);
+}
+
+int SetCommunicationTimeout(uint32_t ms) {
+    return uart_reconfigure_timeouts(current_comms()->sp, ms);
+}
+
+uint32_t GetCommunicationTimeout(void) {
+    return uart_get_timeouts(current_comms()->sp);
+}
+
+// A NULL *dev opens another device, with a session of its own
+static pm3_device_t *OpenDevice(pm3_device_t **dev, bool *allocated) {
+    *allocated = false;
+    if (*dev == NULL) {
+        *dev = NewDevice();
+        if (*dev == NULL) {
+            PrintAndLogEx(ERR, "Failed to allocate memory for pm3_device_t");
+            return NULL;
+        }
+        *allocated = true;
+    }
+    return *dev;
+}
+
+static void OpenDeviceFailed(pm3_device_t **dev, bool allocated) {
+    if (allocated) {
+        FreeProxmark(*dev);
+        *dev = NULL;
+    }
+}
+
+// uart_open() fills in the connection of the current device
+static serial_port OpenDevicePort(pm3_device_t *dev, const char *port, uint32_t speed, bool slient) {
+    pm3_device_t *prev = SetThreadDevice(dev);
+    serial_port sp = uart_open(port, speed, slient);
+    SetThreadDevice(prev);
+    return sp;
 }
 
 bool OpenProxmarkSilent(pm3_device_t **dev, const char *port, uint32_t speed) {
 
-    sp = uart_open(port, speed, true);
+    bool allocated;
+    if (OpenDevice(dev, &allocated) == NULL) {
+        return false;
+    }
+    pm3_comms_t *comms = (*dev)->comms;
+
+    comms->sp = OpenDevicePort(*dev, port, speed, true);
 
     // check result of uart opening
-    if (sp == INVALID_SERIAL_PORT) {
-        sp = NULL;
+    if (comms->sp == INVALID_SERIAL_PORT) {
+        comms->sp = NULL;
+        OpenDeviceFailed(dev, allocated);
         return false;
-    } else if (sp == CLAIMED_SERIAL_PORT) {
-        sp = NULL;
+    } else if (comms->sp == CLAIMED_SERIAL_PORT) {
+        comms->sp = NULL;
+        OpenDeviceFailed(dev, allocated);
         return false;
     } else {
         // start the communication thread
-        if (port != g_conn.serial_port_name) {
+        if (port != comms->conn.serial_port_name) {
             uint16_t len = MIN(strlen(port), FILE_PATH_SIZE - 1);
-            memset(g_conn.serial_port_name, 0, FILE_PATH_SIZE);
-            memcpy(g_conn.serial_port_name, port, len);
+            memset(comms->conn.serial_port_name, 0, FILE_PATH_SIZE);
+            memcpy(comms->conn.serial_port_name, port, len);
         }
-        g_conn.run = true;
-        g_conn.block_after_ACK = false;
+        comms->conn.run = true;
+        comms->conn.block_after_ACK = false;
         // Flags to tell where to add CRC on sent replies
-        g_conn.send_with_crc_on_usb = false;
-        g_conn.send_with_crc_on_fpc = true;
+        comms->conn.send_with_crc_on_usb = false;
+        comms->conn.send_with_crc_on_fpc = true;
         // "Session" flag, to tell via which interface next msgs should be sent: USB or FPC USART
-        g_conn.send_via_fpc_usart = false;
+        comms->conn.send_via_fpc_usart = false;
 
-        pthread_create(&communication_thread, NULL, &uart_communication, &g_conn);
-        __atomic_clear(&comm_thread_dead, __ATOMIC_SEQ_CST);
-        __atomic_clear(&reconnect_ok, __ATOMIC_SEQ_CST);
+        pthread_create(&comms->communication_thread, NULL, &uart_communication, *dev);
+        __atomic_clear(&comms->comm_thread_dead, __ATOMIC_SEQ_CST);
+        __atomic_clear(&comms->reconnect_ok, __ATOMIC_SEQ_CST);
 
-        g_session.pm3_present = true; // TODO support for multiple devices
+        comms->session->pm3_present = true;
 
         fflush(stdout);
-        if (*dev == NULL) {
-            *dev = calloc(sizeof(pm3_device_t), sizeof(uint8_t));
-            if (*dev == NULL) {
-                PrintAndLogEx(ERR, "Failed to allocate memory for pm3_device_t");
-                uart_close(sp);
-                sp = NULL;
-                return false;
-            }
-        }
-        (*dev)->g_conn = &g_conn; // TODO g_conn shouldn't be global
         return true;
     }
 }
 
 bool OpenProxmark(pm3_device_t **dev, const char *port, bool wait_for_port, int timeout, bool flash_mode, uint32_t speed) {
 
+    bool allocated;
+    if (OpenDevice(dev, &allocated) == NULL) {
+        return false;
+    }
+    pm3_comms_t *comms = (*dev)->comms;
+
     if (wait_for_port == false) {
         PrintAndLogEx(SUCCESS, "Using UART port " _GREEN_("%s"), port);
-        sp = uart_open(port, speed, false);
+        comms->sp = OpenDevicePort(*dev, port, speed, false);
     } else {
         PrintAndLogEx(SUCCESS, "Waiting for Proxmark3 to appear on " _YELLOW_("%s"), port);
         fflush(stdout);
         int openCount = 0;
         PrintAndLogEx(INPLACE, "% 3i", timeout);
         do {
-            sp = uart_open(port, speed, false);
+            comms->sp = OpenDevicePort(*dev, port, speed, false);
             msleep(500);
             PrintAndLogEx(INPLACE, "% 3i", timeout - openCount - 1);
 
-        } while (++openCount < timeout && (sp == INVALID_SERIAL_PORT || sp == CLAIMED_SERIAL_PORT));
+        } while (++openCount < timeout && (comms->sp == INVALID_SERIAL_PORT || comms->sp == CLAIMED_SERIAL_PORT));
     }
 
     // check result of uart opening
-    if (sp == INVALID_SERIAL_PORT) {
+    if (comms->sp == INVALID_SERIAL_PORT) {
         PrintAndLogEx(WARNING, "\n" _RED_("ERROR:") " invalid serial port " _YELLOW_("%s"), port);
         PrintAndLogEx(HINT, "Hint: Try the shell script `" _YELLOW_("`./pm3 --list") "` to get a list of possible serial ports");
-        sp = NULL;
+        comms->sp = NULL;
+        OpenDeviceFailed(dev, allocated);
         return false;
-    } else if (sp == CLAIMED_SERIAL_PORT) {
+    } else if (comms->sp == CLAIMED_SERIAL_PORT) {
         PrintAndLogEx(WARNING, "\n" _RED_("ERROR:") " serial port " _YELLOW_("%s") " is claimed by another process", port);
         PrintAndLogEx(HINT, "Hint: Try the shell script `" _YELLOW_("./pm3 --list") "` to get a list of possible serial ports");
 
-        sp = NULL;
+        comms->sp = NULL;
+        OpenDeviceFailed(dev, allocated);
         return false;
     } else {
         // start the communication thread
-        if (port != g_conn.serial_port_name) {
+        if (port != comms->conn.serial_port_name) {
             uint16_t len = MIN(strlen(port), FILE_PATH_SIZE - 1);
-            memset(g_conn.serial_port_name, 0, FILE_PATH_SIZE);
-            memcpy(g_conn.serial_port_name, port, len);
+            memset(comms->conn.serial_port_name, 0, FILE_PATH_SIZE);
+            memcpy(comms->conn.serial_port_name, port, len);
         }
-        g_conn.run = true;
-        g_conn.block_after_ACK = flash_mode;
+        comms->conn.run = true;
+        comms->conn.block_after_ACK = flash_mode;
         // Flags to tell where to add CRC on sent replies
-        g_conn.send_with_crc_on_usb = false;
-        g_conn.send_with_crc_on_fpc = true;
+        comms->conn.send_with_crc_on_usb = false;
+        comms->conn.send_with_crc_on_fpc = true;
         // "Session" flag, to tell via which interface next msgs should be sent: USB or FPC USART
-        g_conn.send_via_fpc_usart = false;
+        comms->conn.send_via_fpc_usart = false;
 
-        pthread_create(&communication_thread, NULL, &uart_communication, &g_conn);
-        __atomic_clear(&comm_thread_dead, __ATOMIC_SEQ_CST);
-        g_session.pm3_present = true; // TODO support for multiple devices
+        pthread_create(&comms->communication_thread, NULL, &uart_communication, *dev);
+        __atomic_clear(&comms->comm_thread_dead, __ATOMIC_SEQ_CST);
+        comms->session->pm3_present = true;
 
         fflush(stdout);
-        if (*dev == NULL) {
-            *dev = calloc(1, sizeof(pm3_device_t));
-            if (*dev == NULL) {
-                PrintAndLogEx(ERR, "Failed to allocate memory for pm3_device_t");
-                uart_close(sp);
-                sp = NULL;
-                return false;
-            }
-        }
-        (*dev)->g_conn = &g_conn; // TODO g_conn shouldn't be global
         return true;
     }
 }
 
-// check if we can communicate with Pm3
-int TestProxmark(pm3_device_t *dev) {
+// check if we can communicate with Pm3, which is the current device here
+static int TestProxmark_internal(pm3_comms_t *comms) {
 
     uint16_t len = 32;
     uint8_t data[len];
@@ -855,7 +1166,7 @@ int TestProxmark(pm3_device_t *dev) {
         data[i] = i & 0xFF;
     }
 
-    __atomic_store_n(&last_packet_time,  msclock(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&comms->last_packet_time,  msclock(), __ATOMIC_SEQ_CST);
     clearCommandBuffer();
     SendCommandNG(CMD_PING, data, len);
 
@@ -885,37 +1196,37 @@ int TestProxmark(pm3_device_t *dev) {
         return PM3_ETIMEOUT;
     }
 
-    if ((resp.length != sizeof(g_pm3_capabilities)) || (resp.data.asBytes[0] != CAPABILITIES_VERSION)) {
+    if ((resp.length != sizeof(comms->capabilities)) || (resp.data.asBytes[0] != CAPABILITIES_VERSION)) {
         PrintAndLogEx(ERR, _RED_("Capabilities structure version sent by Proxmark3 is not the same as the one used by the client!"));
         PrintAndLogEx(ERR, _RED_("Please flash the Proxmark3 with the same version as the client."));
         return PM3_EDEVNOTSUPP;
     }
 
-    memcpy(&g_pm3_capabilities, resp.data.asBytes, sizeof(capabilities_t));
-    g_conn.send_via_fpc_usart = g_pm3_capabilities.via_fpc;
-    g_conn.uart_speed = g_pm3_capabilities.baudrate;
+    memcpy(&comms->capabilities, resp.data.asBytes, sizeof(capabilities_t));
+    comms->conn.send_via_fpc_usart = comms->capabilities.via_fpc;
+    comms->conn.uart_speed = comms->capabilities.baudrate;
 
-    bool is_tcp_conn = (g_conn.send_via_ip == PM3_TCPv4 || g_conn.send_via_ip == PM3_TCPv6);
-    bool is_bt_conn = (memcmp(g_conn.serial_port_name, "bt:", 3) == 0);
-    bool is_udp_conn = (g_conn.send_via_ip == PM3_UDPv4 || g_conn.send_via_ip == PM3_UDPv6);
+    bool is_tcp_conn = (comms->conn.send_via_ip == PM3_TCPv4 || comms->conn.send_via_ip == PM3_TCPv6);
+    bool is_bt_conn = (memcmp(comms->conn.serial_port_name, "bt:", 3) == 0);
+    bool is_udp_conn = (comms->conn.send_via_ip == PM3_UDPv4 || comms->conn.send_via_ip == PM3_UDPv6);
 
     PrintAndLogEx(SUCCESS, "Communicating with PM3 over %s%s%s%s",
-                  (g_conn.send_via_fpc_usart) ? _GREEN_("FPC UART") : _GREEN_("USB-CDC"),
+                  (comms->conn.send_via_fpc_usart) ? _GREEN_("FPC UART") : _GREEN_("USB-CDC"),
                   (is_tcp_conn) ? " over " _GREEN_("TCP") : "",
                   (is_bt_conn) ? " over " _GREEN_("BT") : "",
                   (is_udp_conn) ? " over " _GREEN_("UDP") : ""
                  );
-    if (g_conn.send_via_fpc_usart) {
-        PrintAndLogEx(SUCCESS, "PM3 UART serial baudrate: " _GREEN_("%u") "\n", g_conn.uart_speed);
+    if (comms->conn.send_via_fpc_usart) {
+        PrintAndLogEx(SUCCESS, "PM3 UART serial baudrate: " _GREEN_("%u") "\n", comms->conn.uart_speed);
     } else {
         int res;
-        if (g_conn.send_via_local_ip) {
+        if (comms->conn.send_via_local_ip) {
             // (g_conn.send_via_local_ip == true) -> ((is_tcp_conn || is_udp_conn) == true)
-            res = uart_reconfigure_timeouts(is_tcp_conn ? UART_TCP_LOCAL_CLIENT_RX_TIMEOUT_MS : UART_UDP_LOCAL_CLIENT_RX_TIMEOUT_MS);
+            res = uart_reconfigure_timeouts(comms->sp, is_tcp_conn ? UART_TCP_LOCAL_CLIENT_RX_TIMEOUT_MS : UART_UDP_LOCAL_CLIENT_RX_TIMEOUT_MS);
         } else if (is_tcp_conn || is_udp_conn) {
-            res = uart_reconfigure_timeouts(UART_NET_CLIENT_RX_TIMEOUT_MS);
+            res = uart_reconfigure_timeouts(comms->sp, UART_NET_CLIENT_RX_TIMEOUT_MS);
         } else {
-            res = uart_reconfigure_timeouts(UART_USB_CLIENT_RX_TIMEOUT_MS);
+            res = uart_reconfigure_timeouts(comms->sp, UART_USB_CLIENT_RX_TIMEOUT_MS);
         }
         if (res != PM3_SUCCESS) {
             return res;
@@ -924,32 +1235,47 @@ int TestProxmark(pm3_device_t *dev) {
     return PM3_SUCCESS;
 }
 
+int TestProxmark(pm3_device_t *dev) {
+    pm3_device_t *prev = SetThreadDevice(dev);
+    int res = TestProxmark_internal(dev->comms);
+    SetThreadDevice(prev);
+    return res;
+}
+
 void CloseProxmark(pm3_device_t *dev) {
-    dev->g_conn->run = false;
+    pm3_comms_t *comms = dev->comms;
+    dev->conn->run = false;
 
 #ifdef __BIONIC__
-    if (communication_thread != 0) {
-        pthread_join(communication_thread, NULL);
+    if (comms->communication_thread != 0) {
+        pthread_join(comms->communication_thread, NULL);
     }
 #else
-    pthread_join(communication_thread, NULL);
+    pthread_join(comms->communication_thread, NULL);
 #endif
 
-    if (sp) {
-        uart_close(sp);
+    if (comms->sp) {
+        uart_close(comms->sp);
     }
 
     // Clean up our state
-    sp = NULL;
+    comms->sp = NULL;
 #ifdef __BIONIC__
-    if (communication_thread != 0) {
-        memset(&communication_thread, 0, sizeof(pthread_t));
+    if (comms->communication_thread != 0) {
+        memset(&comms->communication_thread, 0, sizeof(pthread_t));
     }
 #else
-    memset(&communication_thread, 0, sizeof(pthread_t));
+    memset(&comms->communication_thread, 0, sizeof(pthread_t));
 #endif
 
-    g_session.pm3_present = false;
+    // whatever is still queued was meant for this connection
+    pthread_mutex_lock(&comms->txQueueMutex);
+    comms->txQueue_head = 0;
+    comms->txQueue_count = 0;
+    pthread_cond_broadcast(&comms->txQueueNotFull);
+    pthread_mutex_unlock(&comms->txQueueMutex);
+
+    comms->session->pm3_present = false;
 }
 
 // Gives a rough estimate of the communication delay based on channel & baudrate
@@ -961,10 +1287,10 @@ void CloseProxmark(pm3_device_t *dev) {
 //   9600 -> 1100..1150ms
 //           ~ = 12000000 / USART_BAUD_RATE
 // Let's take 2x (maybe we need more for BT link?)
-static size_t communication_delay(void) {
+static size_t communication_delay(pm3_comms_t *comms) {
     // needed also for Windows USB USART??
-    if (g_conn.send_via_fpc_usart) {
-        return 2 * (12000000 / g_conn.uart_speed);
+    if (comms->conn.send_via_fpc_usart) {
+        return 2 * (12000000 / comms->conn.uart_speed);
     }
     return 0;
 }
@@ -980,20 +1306,28 @@ static size_t communication_delay(void) {
  * @return the number of received bytes
  */
 size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, bool show_process) {
+    return WaitForRawDataTimeoutEx(buffer, len, len, ms_timeout, show_process, NULL, NULL);
+}
+
+// Waits for want bytes. When want > len, buffer is used as a ring and progress
+// has to consume the data before it is overwritten, it is called about every 10 ms
+// with the total received so far. Returns the total received.
+size_t WaitForRawDataTimeoutEx(uint8_t *buffer, size_t len, size_t want, size_t ms_timeout, bool show_process, download_progress_t progress, void *ctx) {
+    pm3_comms_t *comms = current_comms();
     uint8_t print_counter = 0;
     size_t last_pos = 0;
 
     // Add delay depending on the communication channel & speed
     if (ms_timeout != (size_t) - 1) {
-        ms_timeout += communication_delay();
+        ms_timeout += communication_delay(comms);
     }
-    __atomic_store_n(&timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&comms->timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
 
-    SetCommunicationRawReceiveBuffer(buffer, len);
+    SetCommunicationRawReceiveBufferEx(buffer, len, (want > len));
     SetCommunicationReceiveMode(true);
 
     size_t pos = 0;
-    while (pos < len) {
+    while (pos < want) {
 
         if (kbd_enter_pressed()) {
             // Send anything to stop the transfer
@@ -1007,11 +1341,11 @@ size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, boo
             }
         }
 
-        pos = __atomic_load_n(&comm_raw_pos, __ATOMIC_SEQ_CST);
+        pos = __atomic_load_n(&comms->comm_raw_pos, __ATOMIC_SEQ_CST);
 
         // Check the timeout if pos is not updated
         if (last_pos == pos) {
-            uint64_t tmp_clk = __atomic_load_n(&timeout_start_time, __ATOMIC_SEQ_CST);
+            uint64_t tmp_clk = __atomic_load_n(&comms->timeout_start_time, __ATOMIC_SEQ_CST);
             // If ms_timeout == -1, the loop can only be breaked by pressing Enter or receiving enough data
             if ((ms_timeout != (size_t) - 1) && (msclock() - tmp_clk > ms_timeout)) {
                 break;
@@ -1019,7 +1353,10 @@ size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, boo
         } else {
             // Print process when (print_counter % 64) == 0
             if (show_process && (print_counter & 0x3F) == 0) {
-                PrintAndLogEx(INFO, "[%zu/%zu]", pos, len);
+                PrintAndLogEx(INFO, "[%zu/%zu]", pos, want);
+            }
+            if (progress) {
+                progress(buffer, (uint32_t)pos, ctx);
             }
         }
 
@@ -1027,7 +1364,7 @@ size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, boo
         last_pos = pos;
         msleep(10);
     }
-    if (pos == len && (ms_timeout != (size_t) - 1)) {
+    if (pos >= want && (ms_timeout != (size_t) - 1)) {
         // If ms_timeout != -1, when the desired data is received, tell the arm side
         // to stop the current process, and wait for some time to make sure the process
         // has been stopped.
@@ -1037,7 +1374,10 @@ size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, boo
         msleep(ms_timeout);
     }
     SetCommunicationReceiveMode(false);
-    pos = __atomic_load_n(&comm_raw_pos, __ATOMIC_SEQ_CST);
+    pos = __atomic_load_n(&comms->comm_raw_pos, __ATOMIC_SEQ_CST);
+    if (progress && pos != last_pos) {
+        progress(buffer, (uint32_t)pos, ctx);
+    }
     return pos;
 }
 
@@ -1051,7 +1391,8 @@ size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, boo
  * @param show_warning display message after 3 seconds
  * @return true if command was returned, otherwise false
  */
-bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
+static bool WaitForResponseTimeout_internal(pm3_comms_t *comms, uint32_t cmd, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
+    TRACE_SPAN_ARG("comms", "wait", "cmd", cmd);
 
     // init to ZERO
     PacketResponseNG resp;
@@ -1063,20 +1404,20 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
 
     // Add delay depending on the communication channel & speed
     if (ms_timeout != (size_t) - 1) {
-        ms_timeout += communication_delay();
+        ms_timeout += communication_delay(comms);
     }
 
-    __atomic_store_n(&timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+    __atomic_store_n(&comms->timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
 
     // Wait until the command is received
     while (true) {
 
         // if device gets disconnected or resets,  break out of this loop
-        if (IsCommunicationThreadDead()) {
+        if (__atomic_load_n(&comms->comm_thread_dead, __ATOMIC_SEQ_CST)) {
             break;
         }
 
-        while (getReply(response)) {
+        while (getReply(comms, response)) {
 
             if (cmd == CMD_UNKNOWN || response->cmd == cmd) {
                 return true;
@@ -1091,7 +1432,7 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
             }
         }
 
-        uint64_t tmp_clk = __atomic_load_n(&timeout_start_time, __ATOMIC_SEQ_CST);
+        uint64_t tmp_clk = __atomic_load_n(&comms->timeout_start_time, __ATOMIC_SEQ_CST);
         if ((ms_timeout != (size_t) - 1) && (msclock() - tmp_clk > ms_timeout)) {
             break;
         }
@@ -1107,6 +1448,142 @@ bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms
     return false;
 }
 
+bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
+    return WaitForResponseTimeout_internal(current_comms(), cmd, response, ms_timeout, show_warning);
+}
+
+bool WaitForResponseTimeoutDev(pm3_device_t *dev, uint32_t cmd, PacketResponseNG *response, size_t ms_timeout) {
+    return WaitForResponseTimeout_internal(dev->comms, cmd, response, ms_timeout, false);
+}
+
+// Commands the device answers straight from its main loop. Anything else may run a loop
+// which stops as soon as data_available(), the next frame would cancel it.
+static bool IsPipelinable(uint16_t cmd) {
+    switch (cmd) {
+        case CMD_PING:
+        case CMD_CAPABILITIES:
+        case CMD_VERSION:
+        case CMD_GET_DBGMODE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+pm3_future_t *SendCommandAsync(uint16_t cmd, const uint8_t *data, size_t len) {
+
+    pm3_comms_t *comms = current_comms();
+    pm3_future_t *future = NULL;
+    bool busy = false;
+
+    pthread_mutex_lock(&comms->futuresMutex);
+    for (size_t i = 0; i < PM3_MAX_IN_FLIGHT; i++) {
+        pm3_future_t *f = &comms->futures[i];
+        if (f->used == false) {
+            if (future == NULL) {
+                future = f;
+            }
+        } else if (f->done == false && IsPipelinable(f->cmd) == false) {
+            busy = true;
+        }
+    }
+    if (busy) {
+        PrintAndLogEx(DEBUG, "SendCommandAsync: " _YELLOW_("0x%04x") " refused, a command which can't be pipelined is outstanding", cmd);
+        future = NULL;
+    }
+    if (future == NULL) {
+        pthread_mutex_unlock(&comms->futuresMutex);
+        return NULL;
+    }
+
+    memset(future, 0, sizeof(pm3_future_t));
+    future->comms = comms;
+    future->used = true;
+    future->cmd = cmd;
+    future->order = ++comms->futures_order;
+    future->tagged = comms->capabilities.tagged_frames;
+    if (future->tagged) {
+        // 0 means untagged
+        if (++comms->futures_seq == 0) {
+            comms->futures_seq = 1;
+        }
+        future->seq = comms->futures_seq;
+    }
+    uint16_t seq = future->seq;
+    pthread_mutex_unlock(&comms->futuresMutex);
+
+    // registered first, the reply may well arrive before we are back here
+    if (SendCommandNG_internal(comms, cmd, data, len, true, seq) == false) {
+        pthread_mutex_lock(&comms->futuresMutex);
+        future->used = false;
+        pthread_mutex_unlock(&comms->futuresMutex);
+        return NULL;
+    }
+    return future;
+}
+
+bool IsFutureDone(pm3_future_t *future) {
+    if (future == NULL) {
+        return false;
+    }
+    pm3_comms_t *comms = future->comms;
+    pthread_mutex_lock(&comms->futuresMutex);
+    bool done = future->done;
+    pthread_mutex_unlock(&comms->futuresMutex);
+    return done;
+}
+
+bool WaitForFuture(pm3_future_t *future, PacketResponseNG *response, size_t ms_timeout) {
+
+    if (future == NULL) {
+        return false;
+    }
+    pm3_comms_t *comms = future->comms;
+    TRACE_SPAN_ARG("comms", "wait future", "cmd", future->cmd);
+
+    // Add delay depending on the communication channel & speed
+    if (ms_timeout != (size_t) - 1) {
+        ms_timeout += communication_delay(comms);
+    }
+
+    uint64_t start = msclock();
+    bool done = false;
+    while (true) {
+
+        pthread_mutex_lock(&comms->futuresMutex);
+        done = future->done;
+        uint32_t wtx = future->wtx;
+        if (done && response) {
+            memcpy(response, &future->resp, sizeof(PacketResponseNG));
+        }
+        pthread_mutex_unlock(&comms->futuresMutex);
+
+        if (done) {
+            break;
+        }
+
+        // if device gets disconnected or resets,  break out of this loop
+        if (__atomic_load_n(&comms->comm_thread_dead, __ATOMIC_SEQ_CST)) {
+            break;
+        }
+
+        // any packet from the device restarts the timeout, as for WaitForResponseTimeout
+        uint64_t tmp_clk = MAX(start, __atomic_load_n(&comms->timeout_start_time, __ATOMIC_SEQ_CST));
+        if ((ms_timeout != (size_t) - 1) && (msclock() - tmp_clk > ms_timeout + wtx)) {
+            break;
+        }
+
+        // just to avoid CPU busy loop:
+        msleep(1);
+    }
+
+    // a late reply no longer matches, it goes to the reply buffer
+    pthread_mutex_lock(&comms->futuresMutex);
+    future->used = false;
+    pthread_mutex_unlock(&comms->futuresMutex);
+    return done;
+}
+
 bool WaitForResponseTimeout(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout) {
     return WaitForResponseTimeoutW(cmd, response, ms_timeout, true);
 }
@@ -1131,6 +1608,12 @@ bool WaitForResponse(uint32_t cmd, PacketResponseNG *response) {
 * @return true if command was returned, otherwise false
 */
 bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t *data, uint32_t datalen, PacketResponseNG *response, size_t ms_timeout, bool show_warning) {
+    return GetFromDeviceEx(memtype, dest, bytes, start_index, data, datalen, response, ms_timeout, show_warning, NULL, NULL);
+}
+
+// progress lets the caller work on the received part of dest while the
+// communication thread keeps reading the rest of the transfer
+bool GetFromDeviceEx(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t *data, uint32_t datalen, PacketResponseNG *response, size_t ms_timeout, bool show_warning, download_progress_t progress, void *ctx) {
 
     if (dest == NULL) {
         return false;
@@ -1146,58 +1629,74 @@ bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint3
 
     if (bytes == 0) return true;
 
+    pm3_comms_t *comms = current_comms();
+    TRACE_SPAN_ARG("comms", "download", "bytes", bytes);
 
     // clear
-    clearCommandBuffer();
+    clearCommandBuffer_internal(comms);
+
+    bool lz4 = false;
+    if (comms->capabilities.compressed_download) {
+        lz4 = (comms->dl_lz4_mode == DL_LZ4_ON) || (comms->dl_lz4_mode == DL_LZ4_AUTO && comms->capabilities.via_usb == false);
+    }
 
     switch (memtype) {
         case BIG_BUF: {
-            SendCommandMIX(CMD_DOWNLOAD_BIGBUF, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_BIGBUF);
+            SendCommandMIX(CMD_DOWNLOAD_BIGBUF, start_index, bytes, (lz4) ? DOWNLOAD_FLAG_LZ4 : 0, NULL, 0);
+            return dl_it(comms, dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_BIGBUF, lz4, progress, ctx);
         }
         case BIG_BUF_EML: {
-            SendCommandMIX(CMD_DOWNLOAD_EML_BIGBUF, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_EML_BIGBUF);
+            SendCommandMIX(CMD_DOWNLOAD_EML_BIGBUF, start_index, bytes, (lz4) ? DOWNLOAD_FLAG_LZ4 : 0, NULL, 0);
+            return dl_it(comms, dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_EML_BIGBUF, lz4, progress, ctx);
         }
         case SPIFFS: {
             SendCommandMIX(CMD_SPIFFS_DOWNLOAD, start_index, bytes, 0, data, datalen);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_SPIFFS_DOWNLOADED);
+            return dl_it(comms, dest, bytes, response, ms_timeout, show_warning, CMD_SPIFFS_DOWNLOADED, false, progress, ctx);
         }
         case FLASH_MEM: {
             SendCommandMIX(CMD_FLASHMEM_DOWNLOAD, start_index, bytes, 0, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_FLASHMEM_DOWNLOADED);
+            return dl_it(comms, dest, bytes, response, ms_timeout, show_warning, CMD_FLASHMEM_DOWNLOADED, false, progress, ctx);
         }
         case SIM_MEM: {
             //SendCommandMIX(CMD_DOWNLOAD_SIM_MEM, start_index, bytes, 0, NULL, 0);
-            //return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_SIMMEM);
+            //return dl_it(comms, dest, bytes, response, ms_timeout, show_warning, CMD_DOWNLOADED_SIMMEM, false, progress, ctx);
             return false;
         }
         case FPGA_MEM: {
             SendCommandNG(CMD_FPGAMEM_DOWNLOAD, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_FPGAMEM_DOWNLOADED);
+            return dl_it(comms, dest, bytes, response, ms_timeout, show_warning, CMD_FPGAMEM_DOWNLOADED, false, progress, ctx);
         }
         case MCU_FLASH:
         case MCU_MEM: {
             uint32_t flags = (memtype == MCU_MEM) ? READ_MEM_DOWNLOAD_FLAG_RAW : 0;
             SendCommandBL(CMD_READ_MEM_DOWNLOAD, start_index, bytes, flags, NULL, 0);
-            return dl_it(dest, bytes, response, ms_timeout, show_warning, CMD_READ_MEM_DOWNLOADED);
+            return dl_it(comms, dest, bytes, response, ms_timeout, show_warning, CMD_READ_MEM_DOWNLOADED, false, progress, ctx);
         }
     }
     return false;
 }
 
-static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd) {
+dl_lz4_mode_t SetDownloadCompression(dl_lz4_mode_t mode) {
+    pm3_comms_t *comms = current_comms();
+    dl_lz4_mode_t prev = comms->dl_lz4_mode;
+    comms->dl_lz4_mode = mode;
+    return prev;
+}
+
+static bool dl_it(pm3_comms_t *comms, uint8_t *dest, uint32_t bytes, PacketResponseNG *response, size_t ms_timeout, bool show_warning, uint32_t rec_cmd, bool lz4, download_progress_t progress, void *ctx) {
 
     uint32_t bytes_completed = 0;
-    __atomic_store_n(&timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
+    // chunks normally come in order, received is the end of the gapless part
+    uint32_t received = 0;
+    __atomic_store_n(&comms->timeout_start_time,  msclock(), __ATOMIC_SEQ_CST);
 
     // Add delay depending on the communication channel & speed
     if (ms_timeout != (size_t) - 1)
-        ms_timeout += communication_delay();
+        ms_timeout += communication_delay(comms);
 
     while (true) {
 
-        if (getReply(response)) {
+        if (getReply(comms, response)) {
 
             if (response->cmd == CMD_ACK)
                 return true;
@@ -1211,7 +1710,30 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
             // arg0 = offset in transfer. Startindex of this chunk
             // arg1 = length bytes to transfer
             // arg2 = bigbuff tracelength (?)
-            if (response->cmd == rec_cmd) {
+            if (response->cmd == rec_cmd && lz4) {
+
+                // LZ4 chunk, decompressed straight into dest. arg1 = bytes it stands for
+                uint32_t offset = response->oldarg[0];
+                uint32_t raw_bytes = response->oldarg[1];
+
+                if (raw_bytes > bytes || offset > bytes - raw_bytes) {
+                    PrintAndLogEx(FAILED, "ERROR: Out of bounds when downloading from device,  offset %u | len %u | total len %u > buf_size %u", offset, raw_bytes, offset + raw_bytes, bytes);
+                    break;
+                }
+
+                if (lz4chunk_unpack(response->data.asBytes, response->length, dest + offset, raw_bytes) < 0) {
+                    PrintAndLogEx(FAILED, "ERROR: Corrupt compressed data when downloading from device, offset %u", offset);
+                    break;
+                }
+                bytes_completed += raw_bytes;
+
+                if (offset <= received && offset + raw_bytes > received) {
+                    received = offset + raw_bytes;
+                    if (progress) {
+                        progress(dest, received, ctx);
+                    }
+                }
+            } else if (response->cmd == rec_cmd) {
 
                 uint32_t offset = response->oldarg[0];
                 uint32_t copy_bytes = MIN(bytes - bytes_completed, response->oldarg[1]);
@@ -1229,6 +1751,13 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
 
                 memcpy(dest + offset, response->data.asBytes, copy_bytes);
                 bytes_completed += copy_bytes;
+
+                if (offset <= received && offset + copy_bytes > received) {
+                    received = offset + copy_bytes;
+                    if (progress) {
+                        progress(dest, received, ctx);
+                    }
+                }
             } else if (response->cmd == CMD_WTX && response->length == sizeof(uint16_t)) {
                 uint16_t wtx = response->data.asDwords[0] & 0xFFFF;
                 PrintAndLogEx(DEBUG, "Got Waiting Time eXtension request %i ms", wtx);
@@ -1237,7 +1766,7 @@ static bool dl_it(uint8_t *dest, uint32_t bytes, PacketResponseNG *response, siz
             }
         }
 
-        uint64_t tmp_clk = __atomic_load_n(&timeout_start_time, __ATOMIC_SEQ_CST);
+        uint64_t tmp_clk = __atomic_load_n(&comms->timeout_start_time, __ATOMIC_SEQ_CST);
         if (msclock() - tmp_clk > ms_timeout) {
             PrintAndLogEx(FAILED, "Timed out while trying to download data from device");
             break;
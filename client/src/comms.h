@@ -45,8 +45,18 @@ extern "C" {
 #define CMD_BUFFER_SIZE 100
 #endif
 
+//For commands waiting to be sent to the device
+#ifndef TX_QUEUE_LEN
+#define TX_QUEUE_LEN 32
+#endif
+
 #define COMM_RAW_RECEIVE_LEN (1024)
 
+//Pipelined commands waiting for their reply, see SendCommandAsync()
+#ifndef PM3_MAX_IN_FLIGHT
+#define PM3_MAX_IN_FLIGHT 8
+#endif
+
 typedef enum {
     BIG_BUF,
     BIG_BUF_EML,
@@ -84,13 +94,30 @@ typedef struct {
     char serial_port_name[FILE_PATH_SIZE];
 } communication_arg_t;
 
-extern communication_arg_t g_conn;
+// Comms and session state of a device, see comms.c
+typedef struct pm3_comms_s pm3_comms_t;
 
 typedef struct pm3_device {
-    communication_arg_t *g_conn;
+    communication_arg_t *conn;
     int script_embedded;
+    pm3_comms_t *comms;
+    uint8_t *eml;       // emulator memory, as last downloaded for pm3_eml_get()
 } pm3_device_t;
 
+// Each thread works with a current device, by default the one of the CLI.
+// A thread driving another device selects it first, the communication thread of
+// a device has it selected. Returns the previously selected one, NULL for the default
+pm3_device_t *SetThreadDevice(pm3_device_t *dev);
+pm3_device_t *GetCurrentDevice(void);
+// Devices other than the one of the CLI, once closed
+void FreeProxmark(pm3_device_t *dev);
+
+// Shims for the globals the CLI was written against, they refer to the current device
+communication_arg_t *GetCommunicationArg(void);
+capabilities_t *GetCapabilities(void);
+#define g_conn              (*GetCommunicationArg())
+#define g_pm3_capabilities  (*GetCapabilities())
+
 
 void *uart_reconnect(void *targ);
 
@@ -101,13 +128,23 @@ void SendCommandNG(uint16_t cmd, uint8_t *data, size_t len);
 void SendCommandMIX(uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len);
 void clearCommandBuffer(void);
 
+// The same for a given device, whichever the current one is
+void SendCommandNGDev(pm3_device_t *dev, uint16_t cmd, const uint8_t *data, size_t len);
+void SendCommandMIXDev(pm3_device_t *dev, uint64_t cmd, uint64_t arg0, uint64_t arg1, uint64_t arg2, const void *data, size_t len);
+void clearCommandBufferDev(pm3_device_t *dev);
+bool WaitForResponseTimeoutDev(pm3_device_t *dev, uint32_t cmd, PacketResponseNG *response, size_t ms_timeout);
+
 #define FLASHMODE_SPEED 460800
 
 bool IsReconnectedOk(void);
 bool IsCommunicationThreadDead(void);
 bool SetCommunicationReceiveMode(bool isRawMode);
 void SetCommunicationRawReceiveBuffer(uint8_t *buffer, size_t len);
+void SetCommunicationRawReceiveBufferEx(uint8_t *buffer, size_t len, bool wrap);
 size_t GetCommunicationRawReceiveNum(void);
+// Receive timeout (ms) of the port of the current device, 0 without one
+int SetCommunicationTimeout(uint32_t ms);
+uint32_t GetCommunicationTimeout(void);
 
 bool OpenProxmarkSilent(pm3_device_t **dev, const char *port, uint32_t speed);
 bool OpenProxmark(pm3_device_t **dev, const char *port, bool wait_for_port, int timeout, bool flash_mode, uint32_t speed);
@@ -115,14 +152,44 @@ int TestProxmark(pm3_device_t *dev);
 void CloseProxmark(pm3_device_t *dev);
 void StartReconnectProxmark(void);
 
-size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, bool show_process);
 bool WaitForResponseTimeoutW(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
 bool WaitForResponseTimeout(uint32_t cmd, PacketResponseNG *response, size_t ms_timeout);
 bool WaitForResponse(uint32_t cmd, PacketResponseNG *response);
 
+// Pipelined NG commands. Up to PM3_MAX_IN_FLIGHT can be outstanding, their replies may come in any order.
+// With a device announcing tagged_frames a reply is matched by its sequence tag, else by the cmd
+// of the commands in the order they were sent. Replies going to a future never reach WaitForResponse.
+typedef struct pm3_future_s pm3_future_t;
+// Only CMD_PING, CMD_CAPABILITIES, CMD_VERSION and CMD_GET_DBGMODE pipeline. Any other command may
+// run a loop on the device (sniff, sim, brute force) which stops at the next incoming frame, it is
+// sent alone: while it is outstanding further async sends are refused.
+// NULL when offline, when PM3_MAX_IN_FLIGHT commands are outstanding or when one of them can't be
+// pipelined, wait for them first
+pm3_future_t *SendCommandAsync(uint16_t cmd, const uint8_t *data, size_t len);
+bool IsFutureDone(pm3_future_t *future);
+// true with the reply in response, false on timeout. Releases future in both cases
+bool WaitForFuture(pm3_future_t *future, PacketResponseNG *response, size_t ms_timeout);
+
 //bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
 bool GetFromDevice(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t *data, uint32_t datalen, PacketResponseNG *response, size_t ms_timeout, bool show_warning);
 
+// called while a download is in progress, received = bytes at the start of dest that have arrived
+typedef void (*download_progress_t)(const uint8_t *dest, uint32_t received, void *ctx);
+bool GetFromDeviceEx(DeviceMemType_t memtype, uint8_t *dest, uint32_t bytes, uint32_t start_index, uint8_t *data, uint32_t datalen, PacketResponseNG *response, size_t ms_timeout, bool show_warning, download_progress_t progress, void *ctx);
+
+// LZ4 compressed BigBuf / emulator memory downloads, if the device supports them.
+// By default only on the slow links (FPC USART, Bluetooth), where they pay off.
+// Returns the previous mode
+typedef enum {
+    DL_LZ4_AUTO,
+    DL_LZ4_OFF,
+    DL_LZ4_ON,
+} dl_lz4_mode_t;
+dl_lz4_mode_t SetDownloadCompression(dl_lz4_mode_t mode);
+
+size_t WaitForRawDataTimeout(uint8_t *buffer, size_t len, size_t ms_timeout, bool show_process);
+size_t WaitForRawDataTimeoutEx(uint8_t *buffer, size_t len, size_t want, size_t ms_timeout, bool show_process, download_progress_t progress, void *ctx);
+
 #ifdef __cplusplus
 }
 #endif
@@ -29,6 +29,8 @@
 #include "cmdhficlass.h"  // pagemap
 #include "iclass_cmd.h"
 #include "iso15.h"
+#include "pm3z.h"
+#include "traceevent.h"
 
 #ifdef _WIN32
 #include "scandir.h"
@@ -37,6 +39,10 @@
 
 #define PATH_MAX_LENGTH 200
 
+// a copy of the last dump saved by pm3_save_dump / pm3_save_mf_dump
+static uint8_t *gs_last_dump = NULL;
+static size_t gs_last_dump_len = 0;
+
 struct wave_info_t {
     char signature[4];
     uint32_t filesize;
@@ -267,6 +273,7 @@ int saveFile(const char *preferredName, const char *suffix, const void *data, si
     return saveFileEx(preferredName, suffix, data, datalen, spDefault);
 }
 int saveFileEx(const char *preferredName, const char *suffix, const void *data, size_t datalen, savePaths_t e_save_path) {
+    TRACE_SPAN("file", "saveFileEx");
     if (data == NULL || datalen == 0) {
         return PM3_EINVARG;
     }
@@ -294,6 +301,7 @@ int saveFileEx(const char *preferredName, const char *suffix, const void *data,
 }
 
 int saveFileTXT(const char *preferredName, const char *suffix, const void *data, size_t datalen, savePaths_t e_save_path) {
+    TRACE_SPAN("file", "saveFileTXT");
     if (data == NULL || datalen == 0) {
         return PM3_EINVARG;
     }
@@ -805,6 +813,7 @@ int saveFileJSON(const char *preferredName, JSONFileType ftype, uint8_t *data, s
 }
 
 int saveFileJSONex(const char *preferredName, JSONFileType ftype, uint8_t *data, size_t datalen, bool verbose, void (*callback)(json_t *), savePaths_t e_save_path) {
+    TRACE_SPAN("file", "saveFileJSONex");
 
     int retval = PM3_SUCCESS;
 
@@ -823,6 +832,7 @@ int saveFileJSONroot(const char *preferredName, void *root, size_t flags, bool v
 }
 
 int saveFileJSONrootEx(const char *preferredName, const void *root, size_t flags, bool verbose, bool overwrite, savePaths_t e_save_path) {
+    TRACE_SPAN("file", "saveFileJSONrootEx");
     if (root == NULL) {
         return PM3_EINVARG;
     }
@@ -864,6 +874,7 @@ char *sprintJSON(JSONFileType ftype, uint8_t *data, size_t datalen, bool verbose
 
 // wave file of trace,
 int saveFileWAVE(const char *preferredName, const int *data, size_t datalen) {
+    TRACE_SPAN("file", "saveFileWAVE");
 
     if (data == NULL || datalen == 0) {
         return PM3_EINVARG;
@@ -917,6 +928,7 @@ out:
 
 // Signal trace file, PM3
 int saveFilePM3(const char *preferredName, int *data, size_t datalen) {
+    TRACE_SPAN("file", "saveFilePM3");
 
     if (data == NULL || datalen == 0) {
         return PM3_EINVARG;
@@ -949,6 +961,27 @@ out:
     return retval;
 }
 
+int saveFilePM3Z(const char *preferredName, const int *data, size_t datalen, const sample_config *config) {
+    TRACE_SPAN("file", "saveFilePM3Z");
+
+    if (data == NULL || datalen == 0) {
+        return PM3_EINVARG;
+    }
+
+    char *fileName = newfilenamemcopyEx(preferredName, ".pm3z", spTrace);
+    if (fileName == NULL) {
+        return PM3_EMALLOC;
+    }
+
+    int retval = pm3z_write(fileName, data, datalen, config, true);
+    if (retval == PM3_SUCCESS) {
+        PrintAndLogEx(SUCCESS, "Saved " _YELLOW_("%zu") " samples to PM3Z file `" _YELLOW_("%s") "`", datalen, fileName);
+    }
+
+    free(fileName);
+    return retval;
+}
+
 // key file dump
 int createMfcKeyDump(const char *preferredName, uint8_t sectorsCnt, const sector_t *e_sector) {
 
@@ -997,6 +1030,7 @@ int loadFile_safe(const char *preferredName, const char *suffix, void **pdata, s
     return loadFile_safeEx(preferredName, suffix, pdata, datalen, true);
 }
 int loadFile_safeEx(const char *preferredName, const char *suffix, void **pdata, size_t *datalen, bool verbose) {
+    TRACE_SPAN("file", "loadFile_safeEx");
 
     char *path;
     int res = searchFile(&path, RESOURCES_SUBDIR, preferredName, suffix, false);
@@ -1049,6 +1083,7 @@ int loadFile_safeEx(const char *preferredName, const char *suffix, void **pdata,
 }
 
 int loadFile_TXTsafe(const char *preferredName, const char *suffix, void **pdata, size_t *datalen, bool verbose) {
+    TRACE_SPAN("file", "loadFile_TXTsafe");
 
     char *path;
     int res = searchFile(&path, RESOURCES_SUBDIR, preferredName, suffix, false);
@@ -1101,6 +1136,7 @@ int loadFile_TXTsafe(const char *preferredName, const char *suffix, void **pdata
 }
 
 int loadFileEML_safe(const char *preferredName, void **pdata, size_t *datalen) {
+    TRACE_SPAN("file", "loadFileEML_safe");
     char *path;
     int res = searchFile(&path, RESOURCES_SUBDIR, preferredName, "", false);
     if (res != PM3_SUCCESS) {
@@ -1188,6 +1224,7 @@ int loadFileEML_safe(const char *preferredName, void **pdata, size_t *datalen) {
 }
 
 int loadFileNFC_safe(const char *preferredName, void *data, size_t maxdatalen, size_t *datalen, nfc_df_e ft) {
+    TRACE_SPAN("file", "loadFileNFC_safe");
 
     if (data == NULL) {
         return PM3_EINVARG;
@@ -1424,6 +1461,7 @@ int loadFileNFC_safe(const char *preferredName, void *data, size_t maxdatalen, s
 }
 
 int loadFileMCT_safe(const char *preferredName, void **pdata, size_t *datalen) {
+    TRACE_SPAN("file", "loadFileMCT_safe");
     char *path;
     int res = searchFile(&path, RESOURCES_SUBDIR, preferredName, "", false);
     if (res != PM3_SUCCESS) {
@@ -1527,6 +1565,7 @@ int loadFileJSON(const char *preferredName, void *data, size_t maxdatalen, size_
     return loadFileJSONex(preferredName, data, maxdatalen, datalen, true, callback);
 }
 int loadFileJSONex(const char *preferredName, void *data, size_t maxdatalen, size_t *datalen, bool verbose, void (*callback)(json_t *)) {
+    TRACE_SPAN("file", "loadFileJSONex");
 
     if (data == NULL) {
         return PM3_EINVARG;
@@ -2257,6 +2296,7 @@ out:
 }
 
 int loadFileJSONroot(const char *preferredName, void **proot, bool verbose) {
+    TRACE_SPAN("file", "loadFileJSONroot");
     char *path;
     int res = searchFile(&path, RESOURCES_SUBDIR, preferredName, ".json", false);
     if (res != PM3_SUCCESS) {
@@ -2309,6 +2349,7 @@ int loadFileDICTIONARY(const char *preferredName, void *data, size_t *datalen, u
 // using start position and end position parameters.
 int loadFileDICTIONARYEx(const char *preferredName, void *data, size_t maxdatalen, size_t *datalen, uint8_t keylen, uint32_t *keycnt,
                          size_t startFilePosition, size_t *endFilePosition, bool verbose) {
+    TRACE_SPAN("file", "loadFileDICTIONARYEx");
 
     if (data == NULL) {
         return PM3_EINVARG;
@@ -2419,6 +2460,7 @@ int loadFileDICTIONARY_safe(const char *preferredName, void **pdata, uint8_t key
 }
 
 int loadFileDICTIONARY_safe_ex(const char *preferredName, const char *suffix, void **pdata, uint8_t keylen, uint32_t *keycnt, bool verbose) {
+    TRACE_SPAN("file", "loadFileDICTIONARY_safe_ex");
 
     int retval = PM3_SUCCESS;
 
@@ -2534,6 +2576,7 @@ out:
 }
 
 int loadFileBinaryKey(const char *preferredName, const char *suffix, void **keya, void **keyb, size_t *alen, size_t *blen, bool verbose) {
+    TRACE_SPAN("file", "loadFileBinaryKey");
 
     char *path;
     int res = searchFile(&path, RESOURCES_SUBDIR, preferredName, suffix, false);
@@ -3133,6 +3176,7 @@ out:
 }
 
 int searchFile(char **foundpath, const char *pm3dir, const char *searchname, const char *suffix, bool silent) {
+    TRACE_SPAN("file", "searchFile");
 
     if (foundpath == NULL) {
         return PM3_EINVARG;
@@ -3243,6 +3287,7 @@ int insert_line_if_not_exists(const char *preferredName, const char *keystr) {
 }
 
 int pm3_load_dump(const char *fn, void **pdump, size_t *dumplen, size_t maxdumplen) {
+    TRACE_SPAN("file", "pm3_load_dump");
 
     int res = PM3_SUCCESS;
     DumpFileType_t dt = get_filetype(fn);
@@ -3333,7 +3378,23 @@ int pm3_load_dump(const char *fn, void **pdump, size_t *dumplen, size_t maxdumpl
     return res;
 }
 
+static void remember_dump(const uint8_t *d, size_t n) {
+    uint8_t *tmp = realloc(gs_last_dump, n);
+    if (tmp == NULL) {
+        return;
+    }
+    memcpy(tmp, d, n);
+    gs_last_dump = tmp;
+    gs_last_dump_len = n;
+}
+
+const uint8_t *pm3_last_dump(size_t *n) {
+    *n = gs_last_dump_len;
+    return gs_last_dump;
+}
+
 int pm3_save_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft) {
+    TRACE_SPAN("file", "pm3_save_dump");
     if (fn == NULL || strlen(fn) == 0) {
         return PM3_EINVARG;
     }
@@ -3342,6 +3403,7 @@ int pm3_save_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft) {
         return PM3_EINVARG;
     }
 
+    remember_dump(d, n);
     saveFile(fn, ".bin", d, n);
     saveFileJSON(fn, jsft, d, n, NULL);
     return PM3_SUCCESS;
@@ -3353,6 +3415,7 @@ int pm3_save_mf_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft) {
         PrintAndLogEx(INFO, "No data to save, skipping...");
         return PM3_EINVARG;
     }
+    remember_dump(d, n);
     saveFileEx(fn, ".bin", d, n, spDump);
 
     iso14a_mf_extdump_t jd = {0};
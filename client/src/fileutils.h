@@ -24,6 +24,7 @@
 #include <sys/stat.h>
 #include <stdarg.h>
 #include "ui.h"
+#include "pm3_cmd.h"        // sample_config
 #include "emv/emvjson.h"
 #include "mifare/mifare4.h"
 #include "mifare/mifarehost.h"
@@ -189,6 +190,20 @@ int saveFileWAVE(const char *preferredName, const int *data, size_t datalen);
  */
 int saveFilePM3(const char *preferredName, int *data, size_t datalen);
 
+/**
+ * @brief Utility function to save PM3 data to a LZ4 compressed binary file, see pm3z.h.
+ * This method takes a preferred name, but if that file already exists, it tries with
+ * another name until it finds something suitable.
+ * E.g. dump_trace.pm3z
+ *
+ * @param preferredName
+ * @param data The samples to write to the file
+ * @param datalen the number of samples
+ * @param config sampling config stored in the header, NULL when unknown
+ * @return 0 for ok
+ */
+int saveFilePM3Z(const char *preferredName, const int *data, size_t datalen, const sample_config *config);
+
 /**
  * @brief Utility function to save a keydump into a binary file.
  *
@@ -409,6 +424,14 @@ int pm3_save_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft);
  */
 int pm3_save_mf_dump(const char *fn, uint8_t *d, size_t n, JSONFileType jsft);
 
+/**
+ * @brief The data of the last dump saved by pm3_save_dump() or pm3_save_mf_dump()
+ *
+ * @param n set to the length of the data, 0 when nothing was saved yet
+ * @return the data, valid until the next dump is saved
+ */
+const uint8_t *pm3_last_dump(size_t *n);
+
 /** STUB
  * @brief Utility function to save FM11RF08S recovery data.
  *
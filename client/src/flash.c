@@ -701,10 +701,13 @@ int flash_write(flash_file_t *ctx) {
             if (blocks < 50) {
                 PrintAndLogEx(SUCCESS, "" NOLF);
             } else {
+                PrintAndLogFlush();
                 fprintf(stdout, "\n\n");
             }
         }
 
+        // progress below is written directly
+        PrintAndLogFlush();
         fflush(stdout);
         int block = 0;
         uint8_t *data = seg->data;
@@ -16,6 +16,7 @@
 // Graph utilities
 //-----------------------------------------------------------------------------
 #include "graph.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "ui.h"
@@ -24,11 +25,22 @@
 #include "lfdemod.h"
 #include "cmddata.h"        // for g_debugmode
 #include "commonutil.h"     // Uint4bytetomemle
-
-
-int32_t g_GraphBuffer[MAX_GRAPH_TRACE_LEN];
-int32_t g_OperationBuffer[MAX_GRAPH_TRACE_LEN];
-int32_t g_OverlayBuffer[MAX_GRAPH_TRACE_LEN];
+#include <pthread.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// the first chunk is static so the buffers are never NULL
+static int32_t s_graph_first[3][GRAPH_CHUNK_LEN];
+static size_t s_graph_capacity = GRAPH_CHUNK_LEN;    // of all three buffers
+static size_t s_graph_buf_capacity[3] = {GRAPH_CHUNK_LEN, GRAPH_CHUNK_LEN, GRAPH_CHUNK_LEN};
+static FILE *s_graph_backing[3] = {NULL, NULL, NULL};
+
+int32_t *g_GraphBuffer = s_graph_first[0];
+int32_t *g_OperationBuffer = s_graph_first[1];
+int32_t *g_OverlayBuffer = s_graph_first[2];
 bool    g_useOverlays = false;
 size_t  g_GraphTraceLen;
 buffer_savestate_t g_saveState_gb;
@@ -36,6 +48,131 @@ marker_t g_MarkerA, g_MarkerB, g_MarkerC, g_MarkerD;
 marker_t *g_TempMarkers;
 uint8_t g_TempMarkerSize = 0;
 
+// see graphGeneration()
+static uint64_t s_graph_generation = 0;
+
+// Held by the GUI while it paints or edits the graph, the buffers only move under it
+static pthread_mutex_t s_graph_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void graphLock(void) {
+    pthread_mutex_lock(&s_graph_lock);
+}
+
+void graphUnlock(void) {
+    pthread_mutex_unlock(&s_graph_lock);
+}
+
+// copy one graph buffer to a new one of newcap samples, new samples are zero.
+// The old buffer stays valid, see graph_release(). Returns NULL on failure.
+static int32_t *graph_grow(const int32_t *buf, FILE **backing, size_t oldcap, size_t newcap) {
+
+#ifndef _WIN32
+    if (newcap >= GRAPH_MMAP_LEN) {
+        bool fresh = (*backing == NULL);
+        if (fresh) {
+            *backing = tmpfile();
+        }
+
+        if (*backing != NULL) {
+            int fd = fileno(*backing);
+            void *p = MAP_FAILED;
+            if (ftruncate(fd, newcap * sizeof(int32_t)) == 0) {
+                p = mmap(NULL, newcap * sizeof(int32_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+
+            if (p != MAP_FAILED) {
+                // a mapped buffer already lives in the file, only the mapping moves
+                if (fresh) {
+                    memcpy(p, buf, oldcap * sizeof(int32_t));
+                }
+                return p;
+            }
+
+            if (fresh == false) {
+                return NULL;
+            }
+
+            PrintAndLogEx(DEBUG, "graph: no file backing, using heap");
+            fclose(*backing);
+            *backing = NULL;
+        }
+    }
+#endif
+
+    int32_t *p = malloc(newcap * sizeof(int32_t));
+    if (p != NULL) {
+        memcpy(p, buf, oldcap * sizeof(int32_t));
+        memset(p + oldcap, 0x00, (newcap - oldcap) * sizeof(int32_t));
+    }
+    return p;
+}
+
+// frees a buffer replaced by graph_grow(), mapped = it lived in the backing file
+static void graph_release(int32_t *buf, bool mapped, size_t cap) {
+    if (buf >= s_graph_first[0] && buf < s_graph_first[3]) {
+        return;
+    }
+#ifndef _WIN32
+    if (mapped) {
+        munmap(buf, cap * sizeof(int32_t));
+        return;
+    }
+#else
+    (void) mapped;
+    (void) cap;
+#endif
+    free(buf);
+}
+
+bool reserveGraphBuffer(size_t len) {
+    if (len < s_graph_capacity) {
+        return true;
+    }
+
+    if (len >= GRAPH_TRACE_LEN_LIMIT) {
+        PrintAndLogEx(DEBUG, "graph: %zu samples is over the limit of %u", len, GRAPH_TRACE_LEN_LIMIT);
+        return false;
+    }
+
+    // double, rounded up to whole chunks, keeping one sample of headroom past len
+    size_t newcap = s_graph_capacity * 2;
+    if (newcap <= len) {
+        newcap = len + 1;
+    }
+    newcap = (newcap + GRAPH_CHUNK_LEN - 1) / GRAPH_CHUNK_LEN * GRAPH_CHUNK_LEN;
+    if (newcap > GRAPH_TRACE_LEN_LIMIT) {
+        newcap = GRAPH_TRACE_LEN_LIMIT;
+    }
+
+    int32_t **bufs[3] = {&g_GraphBuffer, &g_OperationBuffer, &g_OverlayBuffer};
+    for (int i = 0; i < 3; i++) {
+        // grown already by an earlier call which failed on a later buffer
+        if (s_graph_buf_capacity[i] >= newcap) {
+            continue;
+        }
+        bool mapped = (s_graph_backing[i] != NULL);
+        int32_t *old = *bufs[i];
+        int32_t *p = graph_grow(old, &s_graph_backing[i], s_graph_buf_capacity[i], newcap);
+        if (p == NULL) {
+            PrintAndLogEx(DEBUG, "graph: failed to grow to %zu samples", newcap);
+            return false;
+        }
+        // the plot may be painting from the old one
+        graphLock();
+        *bufs[i] = p;
+        graphUnlock();
+        graph_release(old, mapped, s_graph_buf_capacity[i]);
+        s_graph_buf_capacity[i] = newcap;
+    }
+
+    s_graph_capacity = newcap;
+    return true;
+}
+
+size_t getGraphBufferCapacity(void) {
+    return s_graph_capacity;
+}
+
 /* write a manchester bit to the graph
 */
 void AppendGraph(bool redraw, uint16_t clock, int bit) {
@@ -43,18 +180,16 @@ void AppendGraph(bool redraw, uint16_t clock, int bit) {
     uint16_t end = clock;
     uint16_t i;
 
-    // overflow/underflow safe checks ... Assumptions:
-    //     _Assert(g_GraphTraceLen >= 0);
-    //     _Assert(g_GraphTraceLen <= MAX_GRAPH_TRACE_LEN);
-    // If this occurs, allow partial rendering, up to the last sample...
-    if ((MAX_GRAPH_TRACE_LEN - g_GraphTraceLen) < half) {
-        PrintAndLogEx(DEBUG, "WARNING: AppendGraph() - Request exceeds max graph length");
-        end = MAX_GRAPH_TRACE_LEN - g_GraphTraceLen;
-        half = end;
-    }
-    if ((MAX_GRAPH_TRACE_LEN - g_GraphTraceLen) < end) {
+    // If the graph can't grow, allow partial rendering, up to the last sample...
+    if (reserveGraphBuffer(g_GraphTraceLen + end) == false) {
+        size_t room = getGraphBufferCapacity() - 1 - g_GraphTraceLen;
         PrintAndLogEx(DEBUG, "WARNING: AppendGraph() - Request exceeds max graph length");
-        end = MAX_GRAPH_TRACE_LEN - g_GraphTraceLen;
+        if (room < end) {
+            end = room;
+        }
+        if (room < half) {
+            half = room;
+        }
     }
 
     //set first half the clock bit (all 1's or 0's for a 0 or 1 bit)
@@ -75,10 +210,11 @@ void AppendGraph(bool redraw, uint16_t clock, int bit) {
 // clear out our graph window and all the buffers associated with it
 size_t ClearGraph(bool redraw) {
     size_t gtl = g_GraphTraceLen;
+    s_graph_generation++;
 
-    memset(g_GraphBuffer, 0x00, g_GraphTraceLen);
-    memset(g_OperationBuffer, 0x00, g_GraphTraceLen);
-    memset(g_OverlayBuffer, 0x00, g_GraphTraceLen);
+    memset(g_GraphBuffer, 0x00, g_GraphTraceLen * sizeof(int32_t));
+    memset(g_OperationBuffer, 0x00, g_GraphTraceLen * sizeof(int32_t));
+    memset(g_OverlayBuffer, 0x00, g_GraphTraceLen * sizeof(int32_t));
 
     g_GraphTraceLen = 0;
     g_GraphStart = 0;
@@ -106,8 +242,9 @@ void setGraphBuffer(const uint8_t *src, size_t size) {
 
     ClearGraph(false);
 
-    if (size > MAX_GRAPH_TRACE_LEN) {
-        size = MAX_GRAPH_TRACE_LEN;
+    if (reserveGraphBuffer(size) == false) {
+        size = getGraphBufferCapacity() - 1;
+        PrintAndLogEx(WARNING, "graph truncated to " _YELLOW_("%zu") " samples", size);
     }
 
     for (size_t i = 0; i < size; ++i) {
@@ -251,7 +388,7 @@ int GetAskClock(const char *str, bool verbose) {
 
     // Auto-detect clock
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    uint8_t *bits = calloc(GRAPH_SCRATCH_LEN,  sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return -1;
@@ -288,7 +425,7 @@ int GetPskCarrier(bool verbose) {
         return -1;
     }
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    uint8_t *bits = calloc(GRAPH_SCRATCH_LEN,  sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return -1;
@@ -332,7 +469,7 @@ int GetPskClock(const char *str, bool verbose) {
     }
 
     // Auto-detect clock
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    uint8_t *bits = calloc(GRAPH_SCRATCH_LEN,  sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return -1;
@@ -374,7 +511,7 @@ int GetNrzClock(const char *str, bool verbose) {
     }
 
     // Auto-detect clock
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    uint8_t *bits = calloc(GRAPH_SCRATCH_LEN,  sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return -1;
@@ -435,7 +572,7 @@ bool fskClocks(uint8_t *fc1, uint8_t *fc2, uint8_t *rf1, int *firstClockEdge) {
         return false;
     }
 
-    uint8_t *bits = calloc(MAX_GRAPH_TRACE_LEN,  sizeof(uint8_t));
+    uint8_t *bits = calloc(GRAPH_SCRATCH_LEN,  sizeof(uint8_t));
     if (bits == NULL) {
         PrintAndLogEx(WARNING, "Failed to allocate memory");
         return false;
@@ -648,3 +785,274 @@ size_t restore_buffer8(buffer_savestate_t saveState, uint8_t *dest) {
 
     return index;
 }
+
+//-----------------------------------------------------------------------------
+// Graph snapshots and undo / redo
+//
+// Samples are kept in chunks of GRAPH_SNAP_CHUNK_LEN.  Commands write the graph
+// buffer directly, so a new snapshot finds the unchanged chunks by comparing with
+// the last snapshot taken, and shares them instead of copying.
+//-----------------------------------------------------------------------------
+typedef struct {
+    uint32_t refs;
+    int32_t samples[GRAPH_SNAP_CHUNK_LEN];
+} graph_chunk_t;
+
+struct graph_snapshot_s {
+    size_t len;
+    double grid_offset;
+    size_t chunk_cnt;
+    graph_chunk_t **chunks;
+};
+
+// shares its chunks with the most recent snapshot
+static graph_snapshot_t *s_snap_last = NULL;
+
+static graph_snapshot_t *s_undo[GRAPH_HISTORY_DEPTH];
+static graph_snapshot_t *s_redo[GRAPH_HISTORY_DEPTH];
+static size_t s_undo_cnt = 0;
+static size_t s_redo_cnt = 0;
+
+static size_t snap_chunk_len(const graph_snapshot_t *snap, size_t c) {
+    size_t left = snap->len - (c * GRAPH_SNAP_CHUNK_LEN);
+    return (left < GRAPH_SNAP_CHUNK_LEN) ? left : GRAPH_SNAP_CHUNK_LEN;
+}
+
+static graph_snapshot_t *snap_alloc(size_t len) {
+    graph_snapshot_t *snap = calloc(1, sizeof(graph_snapshot_t));
+    if (snap == NULL) {
+        return NULL;
+    }
+    snap->len = len;
+    snap->chunk_cnt = (len + GRAPH_SNAP_CHUNK_LEN - 1) / GRAPH_SNAP_CHUNK_LEN;
+    snap->chunks = calloc(snap->chunk_cnt + 1, sizeof(graph_chunk_t *));
+    if (snap->chunks == NULL) {
+        free(snap);
+        return NULL;
+    }
+    return snap;
+}
+
+// another handle on the same chunks
+static graph_snapshot_t *snap_share(const graph_snapshot_t *src) {
+    graph_snapshot_t *snap = snap_alloc(src->len);
+    if (snap == NULL) {
+        return NULL;
+    }
+    snap->grid_offset = src->grid_offset;
+    for (size_t c = 0; c < snap->chunk_cnt; c++) {
+        snap->chunks[c] = src->chunks[c];
+        snap->chunks[c]->refs++;
+    }
+    return snap;
+}
+
+// true when chunk c holds the same samples as the live graph
+static bool snap_chunk_live(const graph_snapshot_t *snap, size_t c) {
+    size_t n = snap_chunk_len(snap, c);
+    size_t start = c * GRAPH_SNAP_CHUNK_LEN;
+    if (start + n > g_GraphTraceLen) {
+        return false;
+    }
+    return memcmp(snap->chunks[c]->samples, g_GraphBuffer + start, n * sizeof(int32_t)) == 0;
+}
+
+static bool snap_is_live(const graph_snapshot_t *snap) {
+    if (snap->len != g_GraphTraceLen) {
+        return false;
+    }
+    for (size_t c = 0; c < snap->chunk_cnt; c++) {
+        if (snap_chunk_live(snap, c) == false) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void graphSnapshotFree(graph_snapshot_t *snap) {
+    if (snap == NULL) {
+        return;
+    }
+    for (size_t c = 0; c < snap->chunk_cnt; c++) {
+        if (snap->chunks[c] != NULL && --snap->chunks[c]->refs == 0) {
+            free(snap->chunks[c]);
+        }
+    }
+    free(snap->chunks);
+    free(snap);
+}
+
+graph_snapshot_t *graphSnapshotTake(void) {
+    graph_snapshot_t *snap = snap_alloc(g_GraphTraceLen);
+    if (snap == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return NULL;
+    }
+    snap->grid_offset = g_GridOffset;
+
+    const graph_snapshot_t *ref = s_snap_last;
+    for (size_t c = 0; c < snap->chunk_cnt; c++) {
+        size_t n = snap_chunk_len(snap, c);
+
+        if (ref != NULL && c < ref->chunk_cnt && snap_chunk_len(ref, c) == n && snap_chunk_live(ref, c)) {
+            snap->chunks[c] = ref->chunks[c];
+            snap->chunks[c]->refs++;
+            continue;
+        }
+
+        graph_chunk_t *chunk = malloc(sizeof(graph_chunk_t));
+        if (chunk == NULL) {
+            PrintAndLogEx(WARNING, "Failed to allocate memory");
+            graphSnapshotFree(snap);
+            return NULL;
+        }
+        chunk->refs = 1;
+        memcpy(chunk->samples, g_GraphBuffer + (c * GRAPH_SNAP_CHUNK_LEN), n * sizeof(int32_t));
+        snap->chunks[c] = chunk;
+    }
+
+    graph_snapshot_t *last = snap_share(snap);
+    if (last != NULL) {
+        graphSnapshotFree(s_snap_last);
+        s_snap_last = last;
+    }
+    return snap;
+}
+
+bool graphSnapshotRestore(const graph_snapshot_t *snap) {
+    if (snap == NULL) {
+        return false;
+    }
+
+    if (reserveGraphBuffer(snap->len) == false) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return false;
+    }
+
+    for (size_t c = 0; c < snap->chunk_cnt; c++) {
+        if (snap_chunk_live(snap, c) == false) {
+            memcpy(g_GraphBuffer + (c * GRAPH_SNAP_CHUNK_LEN), snap->chunks[c]->samples, snap_chunk_len(snap, c) * sizeof(int32_t));
+        }
+    }
+
+    g_GraphTraceLen = snap->len;
+    g_GridOffset = snap->grid_offset;
+    return true;
+}
+
+// bytes held by a stack of snapshots, shared chunks counted once.
+// Chunks are only shared at the same position, so each holder adds its part of a chunk
+static double snap_stack_bytes(graph_snapshot_t **stack, size_t cnt) {
+    double bytes = 0;
+    for (size_t i = 0; i < cnt; i++) {
+        for (size_t c = 0; c < stack[i]->chunk_cnt; c++) {
+            const graph_chunk_t *chunk = stack[i]->chunks[c];
+            uint32_t refs = chunk->refs;
+            if (s_snap_last != NULL && c < s_snap_last->chunk_cnt && s_snap_last->chunks[c] == chunk) {
+                refs--;
+            }
+            bytes += (double)sizeof(graph_chunk_t) / refs;
+        }
+    }
+    return bytes;
+}
+
+static void snap_stack_push(graph_snapshot_t **stack, size_t *cnt, graph_snapshot_t *snap) {
+    if (*cnt == GRAPH_HISTORY_DEPTH) {
+        graphSnapshotFree(stack[0]);
+        memmove(stack, stack + 1, (GRAPH_HISTORY_DEPTH - 1) * sizeof(graph_snapshot_t *));
+        (*cnt)--;
+    }
+    stack[(*cnt)++] = snap;
+}
+
+static void snap_stack_clear(graph_snapshot_t **stack, size_t *cnt) {
+    while (*cnt) {
+        graphSnapshotFree(stack[--(*cnt)]);
+    }
+}
+
+uint64_t graphGeneration(void) {
+    return s_graph_generation;
+}
+
+void graphHistoryPush(void) {
+    s_graph_generation++;
+    snap_stack_clear(s_redo, &s_redo_cnt);
+
+    // nested commands, or an earlier command that restored the graph itself
+    if (s_undo_cnt && snap_is_live(s_undo[s_undo_cnt - 1])) {
+        return;
+    }
+
+    graph_snapshot_t *snap = graphSnapshotTake();
+    if (snap == NULL) {
+        return;
+    }
+    snap_stack_push(s_undo, &s_undo_cnt, snap);
+
+    // keep the newest level even when it alone is over budget
+    while (s_undo_cnt > 1 && snap_stack_bytes(s_undo, s_undo_cnt) > GRAPH_HISTORY_BUDGET) {
+        graphSnapshotFree(s_undo[0]);
+        memmove(s_undo, s_undo + 1, (s_undo_cnt - 1) * sizeof(graph_snapshot_t *));
+        s_undo_cnt--;
+    }
+}
+
+// restore the top of from, the live graph goes to the top of to
+static bool history_step(graph_snapshot_t **from, size_t *from_cnt, graph_snapshot_t **to, size_t *to_cnt) {
+    // levels matching the live graph would look like a no-op
+    while (*from_cnt && snap_is_live(from[*from_cnt - 1])) {
+        graphSnapshotFree(from[--(*from_cnt)]);
+    }
+
+    if (*from_cnt == 0) {
+        return false;
+    }
+
+    graph_snapshot_t *cur = graphSnapshotTake();
+    if (cur == NULL) {
+        return false;
+    }
+
+    if (graphSnapshotRestore(from[*from_cnt - 1]) == false) {
+        graphSnapshotFree(cur);
+        return false;
+    }
+
+    graphSnapshotFree(from[--(*from_cnt)]);
+    snap_stack_push(to, to_cnt, cur);
+    s_graph_generation++;
+    return true;
+}
+
+bool graphHistoryUndo(void) {
+    return history_step(s_undo, &s_undo_cnt, s_redo, &s_redo_cnt);
+}
+
+bool graphHistoryRedo(void) {
+    return history_step(s_redo, &s_redo_cnt, s_undo, &s_undo_cnt);
+}
+
+void graphHistoryClear(void) {
+    snap_stack_clear(s_undo, &s_undo_cnt);
+    snap_stack_clear(s_redo, &s_redo_cnt);
+    graphSnapshotFree(s_snap_last);
+    s_snap_last = NULL;
+}
+
+void graphHistoryStats(size_t *undo, size_t *redo, size_t *bytes) {
+    if (undo) {
+        *undo = s_undo_cnt;
+    }
+    if (redo) {
+        *redo = s_redo_cnt;
+    }
+    if (bytes) {
+        // both stacks together, so chunks shared between them count once
+        graph_snapshot_t *all[2 * GRAPH_HISTORY_DEPTH];
+        memcpy(all, s_undo, s_undo_cnt * sizeof(graph_snapshot_t *));
+        memcpy(all + s_undo_cnt, s_redo, s_redo_cnt * sizeof(graph_snapshot_t *));
+        *bytes = snap_stack_bytes(all, s_undo_cnt + s_redo_cnt);
+    }
+}
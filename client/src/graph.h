@@ -67,13 +67,48 @@ size_t restore_buffer32(buffer_savestate_t saveState, uint32_t *dest);
 size_t restore_bufferS32(buffer_savestate_t saveState, int32_t *dest);
 size_t restore_buffer8(buffer_savestate_t saveState, uint8_t *dest);
 
+// Graph snapshots keep the GraphBuffer (and grid offset) in reference counted chunks.
+// A snapshot shares every chunk that is unchanged since the previous one and restoring
+// only writes the chunks that differ from the live graph.
+typedef struct graph_snapshot_s graph_snapshot_t;
+
+graph_snapshot_t *graphSnapshotTake(void);
+bool graphSnapshotRestore(const graph_snapshot_t *snap);
+void graphSnapshotFree(graph_snapshot_t *snap);
+
+// undo / redo of graph operations, commands call graphHistoryPush() before changing the graph
+void graphHistoryPush(void);
+bool graphHistoryUndo(void);
+bool graphHistoryRedo(void);
+void graphHistoryClear(void);
+void graphHistoryStats(size_t *undo, size_t *redo, size_t *bytes);
+// changes whenever the graph is edited (graphHistoryPush), undone / redone or cleared
+uint64_t graphGeneration(void);
+
+// The graph buffers grow on demand, in GRAPH_CHUNK_LEN steps, up to GRAPH_TRACE_LEN_LIMIT samples.
+// Past GRAPH_MMAP_LEN samples they are backed by unlinked temp files mapped into memory.
+// MAX_GRAPH_TRACE_LEN is the old fixed size, scratch buffers never get smaller than that.
 #define MAX_GRAPH_TRACE_LEN (40000 * 32)
+#define GRAPH_CHUNK_LEN (64 * 1024)
+#define GRAPH_MMAP_LEN (16 * 1024 * 1024)
+#define GRAPH_TRACE_LEN_LIMIT (64 * 1024 * 1024)
+#define GRAPH_SCRATCH_LEN ((g_GraphTraceLen > MAX_GRAPH_TRACE_LEN) ? g_GraphTraceLen : MAX_GRAPH_TRACE_LEN)
+#define GRAPH_SNAP_CHUNK_LEN 4096
+#define GRAPH_HISTORY_DEPTH 16
+#define GRAPH_HISTORY_BUDGET (256 * 1024 * 1024)
 #define GRAPH_SAVE 1
 #define GRAPH_RESTORE 0
 
-extern int32_t g_GraphBuffer[MAX_GRAPH_TRACE_LEN];
-extern int32_t g_OperationBuffer[MAX_GRAPH_TRACE_LEN];
-extern int32_t g_OverlayBuffer[MAX_GRAPH_TRACE_LEN];
+// make room for len samples (plus one) in all graph buffers, false if over the limit or out of memory
+bool reserveGraphBuffer(size_t len);
+size_t getGraphBufferCapacity(void);
+// Growing moves the buffers. Other threads reading them (the plot) hold this lock meanwhile
+void graphLock(void);
+void graphUnlock(void);
+
+extern int32_t *g_GraphBuffer;
+extern int32_t *g_OperationBuffer;
+extern int32_t *g_OverlayBuffer;
 extern bool    g_useOverlays;
 extern size_t  g_GraphTraceLen;
 
@@ -0,0 +1,365 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Live demodulation of LF realtime samples
+//-----------------------------------------------------------------------------
+
+#include "lflive.h"
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lfdemod.h"
+#include "ui.h"
+
+// an ID not seen for this many samples is reported again when it comes back
+#define LF_LIVE_GONE        (4 * LF_LIVE_WINDOW)
+// windows without a decode after which an unconfirmed ID is forgotten
+#define LF_LIVE_CONFIRM     4
+// shortest tail end of a capture worth a demod attempt
+#define LF_LIVE_MIN         4096
+
+typedef struct {
+    char name[48];
+    uint64_t last;
+    uint32_t count;
+} lf_live_id_t;
+
+struct lf_live_s {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool stop;
+
+    // feed side, packed bytes of an incomplete group of 8 samples
+    uint8_t bits;
+    uint8_t pending[8];
+    uint8_t pending_len;
+
+    // head / tail count samples since the start, the ring holds [tail, head)
+    uint8_t *ring;
+    uint64_t head;
+    uint64_t tail;
+    uint64_t dropped;
+
+    // demod thread only
+    uint8_t *window;
+    uint8_t *work;
+    uint64_t windows;
+    int ask_clk;            // clock of the last EM 410x decode, 0 to detect
+    int ask_invert;
+    char candidate[48];     // last decode, until confirmed by the next one
+    uint8_t candidate_age;  // windows since the last decode
+    lf_live_id_t ids[LF_LIVE_MAX_IDS];
+    size_t ids_len;
+    uint32_t ids_lost;
+};
+
+static void live_push(lf_live_t *live, const uint8_t *s, size_t n) {
+    pthread_mutex_lock(&live->lock);
+
+    if (n > LF_LIVE_RING) {
+        live->dropped += n - LF_LIVE_RING;
+        live->tail += n - LF_LIVE_RING;
+        live->head += n - LF_LIVE_RING;
+        s += n - LF_LIVE_RING;
+        n = LF_LIVE_RING;
+    }
+
+    // demod thread can't keep up, forget the oldest samples
+    uint64_t used = live->head - live->tail;
+    if (used + n > LF_LIVE_RING) {
+        live->dropped += used + n - LF_LIVE_RING;
+        live->tail += used + n - LF_LIVE_RING;
+    }
+
+    size_t at = live->head % LF_LIVE_RING;
+    size_t first = MIN(n, LF_LIVE_RING - at);
+    memcpy(live->ring + at, s, first);
+    memcpy(live->ring, s + first, n - first);
+    live->head += n;
+
+    pthread_cond_signal(&live->cond);
+    pthread_mutex_unlock(&live->lock);
+}
+
+void lf_live_feed(lf_live_t *live, const uint8_t *data, size_t len) {
+    if (live == NULL || len == 0) {
+        return;
+    }
+
+    if (live->bits == 8) {
+        live_push(live, data, len);
+        return;
+    }
+
+    // 8 samples per group of bits bytes, msb first, like the graph unpacking
+    uint8_t out[1024];
+    size_t n = 0;
+    uint8_t shift = 8 - live->bits;
+    uint8_t mask = (1 << live->bits) - 1;
+
+    for (size_t i = 0; i < len; i++) {
+        live->pending[live->pending_len++] = data[i];
+        if (live->pending_len < live->bits) {
+            continue;
+        }
+
+        uint64_t w = 0;
+        for (int k = 0; k < live->bits; k++) {
+            w = (w << 8) | live->pending[k];
+        }
+        for (int k = 7; k >= 0; k--, w >>= live->bits) {
+            out[n + k] = (w & mask) << shift;
+        }
+        n += 8;
+        live->pending_len = 0;
+
+        if (n == sizeof(out)) {
+            live_push(live, out, n);
+            n = 0;
+        }
+    }
+    live_push(live, out, n);
+}
+
+static void live_report(lf_live_t *live, const char *name, uint64_t pos) {
+
+    // two decodes close to each other must agree, a glitch can decode to a bogus ID
+    live->candidate_age = 0;
+    if (strcmp(live->candidate, name) != 0) {
+        snprintf(live->candidate, sizeof(live->candidate), "%s", name);
+        return;
+    }
+
+    for (size_t i = 0; i < live->ids_len; i++) {
+        lf_live_id_t *id = &live->ids[i];
+        if (strcmp(id->name, name) == 0) {
+            bool back = (pos > id->last + LF_LIVE_GONE);
+            id->last = pos;
+            id->count++;
+            if (back) {
+                PrintAndLogEx(SUCCESS, "sample %12" PRIu64 "  %s " _CYAN_("(again)"), pos, name);
+            }
+            return;
+        }
+    }
+
+    PrintAndLogEx(SUCCESS, "sample %12" PRIu64 "  " _GREEN_("%s"), pos, name);
+
+    if (live->ids_len == LF_LIVE_MAX_IDS) {
+        live->ids_lost++;
+        return;
+    }
+    lf_live_id_t *id = &live->ids[live->ids_len++];
+    snprintf(id->name, sizeof(id->name), "%s", name);
+    id->last = pos;
+    id->count = 1;
+}
+
+// clock the way ASKDemod_ext() finds it, DetectST() sees RF/32 and RF/64 where
+// DetectASKClock() alone can give up
+static int live_ask_clock(lf_live_t *live, const uint8_t *s, size_t n) {
+    memcpy(live->work, s, n);
+    size_t size = n, ststart = 0, stend = 0;
+    int clk = 0;
+    DetectST(live->work, &size, &clk, &ststart, &stend);
+    return (clk == 32 || clk == 64) ? clk : 0;
+}
+
+static bool live_em410x(lf_live_t *live, const uint8_t *s, size_t n, uint64_t pos) {
+
+    // the tracked clock first, detect it again when that doesn't decode
+    int detected = -1;
+    for (int attempt = 0; attempt < 3; attempt++) {
+
+        int clk = live->ask_clk;
+        int invert = (attempt == 0) ? live->ask_invert : attempt - 1;
+        if (attempt == 0 && clk == 0) {
+            continue;
+        }
+        if (attempt > 0) {
+            if (detected < 0) {
+                detected = live_ask_clock(live, s, n);
+            }
+            clk = detected;
+        }
+
+        memcpy(live->work, s, n);
+        size_t size = n;
+        int start = 0;
+        int err = askdemod_ext(live->work, &size, &clk, &invert, 100, 0, 1, &start);
+        if (err < 0 || err > 100 || size < 64) {
+            continue;
+        }
+
+        size_t idx = 0;
+        uint32_t hi = 0;
+        uint64_t lo = 0;
+        int type = Em410xDecode(live->work, &size, &idx, &hi, &lo);
+        if (type < 0 || (hi == 0 && lo == 0)) {
+            continue;
+        }
+
+        live->ask_clk = clk;
+        live->ask_invert = invert;
+
+        char name[48];
+        if (type & 0x2) {
+            snprintf(name, sizeof(name), "EM 410x XL ID %06X%016" PRIX64, hi, lo);
+        } else if (type & 0x4) {
+            snprintf(name, sizeof(name), "EM 410x ID %010" PRIX64, ((uint64_t)hi << 16) | (lo >> 48));
+        } else {
+            snprintf(name, sizeof(name), "EM 410x ID %010" PRIX64, lo);
+        }
+        live_report(live, name, pos);
+        return true;
+    }
+
+    live->ask_clk = 0;
+    return false;
+}
+
+static bool live_hid(lf_live_t *live, const uint8_t *s, size_t n, uint64_t pos) {
+    memcpy(live->work, s, n);
+    size_t size = n;
+    uint32_t hi2 = 0, hi = 0, lo = 0;
+    int idx = 0;
+    if (HIDdemodFSK(live->work, &size, &hi2, &hi, &lo, &idx) < 0) {
+        return false;
+    }
+    if (hi2 == 0 && hi == 0 && lo == 0) {
+        return false;
+    }
+
+    char name[48];
+    snprintf(name, sizeof(name), "HID Prox raw %08x%08x%08x", hi2, hi, lo);
+    live_report(live, name, pos);
+    return true;
+}
+
+static void live_demod(lf_live_t *live, size_t n, uint64_t pos) {
+    live->windows++;
+
+    computeSignalProperties(live->window, n);
+    if (getSignalProperties()->isnoise == false) {
+        if (live_em410x(live, live->window, n, pos)) {
+            return;
+        }
+        if (live_hid(live, live->window, n, pos)) {
+            return;
+        }
+    }
+    if (++live->candidate_age > LF_LIVE_CONFIRM) {
+        live->candidate[0] = 0;
+    }
+}
+
+static void *live_thread(void *arg) {
+    lf_live_t *live = (lf_live_t *)arg;
+
+    pthread_mutex_lock(&live->lock);
+    while (true) {
+        while (live->stop == false && live->head - live->tail < LF_LIVE_WINDOW) {
+            pthread_cond_wait(&live->cond, &live->lock);
+        }
+
+        size_t n = MIN(live->head - live->tail, LF_LIVE_WINDOW);
+        if (n < LF_LIVE_WINDOW) {
+            // stopping, only the part the last window didn't cover is new
+            size_t covered = (live->windows) ? LF_LIVE_WINDOW - LF_LIVE_HOP : 0;
+            if (n <= covered || n < LF_LIVE_MIN) {
+                break;
+            }
+        }
+
+        uint64_t pos = live->tail;
+        size_t at = pos % LF_LIVE_RING;
+        size_t first = MIN(n, LF_LIVE_RING - at);
+        memcpy(live->window, live->ring + at, first);
+        memcpy(live->window + first, live->ring, n - first);
+        live->tail += (n == LF_LIVE_WINDOW) ? LF_LIVE_HOP : n;
+
+        pthread_mutex_unlock(&live->lock);
+        live_demod(live, n, pos);
+        pthread_mutex_lock(&live->lock);
+    }
+    pthread_mutex_unlock(&live->lock);
+    return NULL;
+}
+
+static void live_free(lf_live_t *live) {
+    free(live->ring);
+    free(live->window);
+    free(live->work);
+    free(live);
+}
+
+lf_live_t *lf_live_start(uint8_t bits_per_sample) {
+
+    lf_live_t *live = calloc(1, sizeof(lf_live_t));
+    if (live == NULL) {
+        return NULL;
+    }
+
+    live->bits = (bits_per_sample == 0 || bits_per_sample > 8) ? 8 : bits_per_sample;
+    live->ring = calloc(LF_LIVE_RING, sizeof(uint8_t));
+    live->window = calloc(LF_LIVE_WINDOW, sizeof(uint8_t));
+    live->work = calloc(LF_LIVE_WINDOW, sizeof(uint8_t));
+    if (live->ring == NULL || live->window == NULL || live->work == NULL) {
+        live_free(live);
+        return NULL;
+    }
+
+    pthread_mutex_init(&live->lock, NULL);
+    pthread_cond_init(&live->cond, NULL);
+
+    if (pthread_create(&live->thread, NULL, live_thread, live) != 0) {
+        pthread_cond_destroy(&live->cond);
+        pthread_mutex_destroy(&live->lock);
+        live_free(live);
+        return NULL;
+    }
+    return live;
+}
+
+void lf_live_stop(lf_live_t *live) {
+    if (live == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&live->lock);
+    live->stop = true;
+    pthread_cond_signal(&live->cond);
+    pthread_mutex_unlock(&live->lock);
+    pthread_join(live->thread, NULL);
+
+    PrintAndLogEx(INFO, "Live demod: %" PRIu64 " samples, %" PRIu64 " windows, %zu ID(s)", live->head, live->windows, live->ids_len);
+    if (live->dropped) {
+        PrintAndLogEx(WARNING, "Live demod fell behind, skipped %" PRIu64 " samples", live->dropped);
+    }
+    for (size_t i = 0; i < live->ids_len; i++) {
+        PrintAndLogEx(SUCCESS, "   %-42s seen %u time(s)", live->ids[i].name, live->ids[i].count);
+    }
+    if (live->ids_lost) {
+        PrintAndLogEx(INFO, "   ... and %u more", live->ids_lost);
+    }
+
+    pthread_cond_destroy(&live->cond);
+    pthread_mutex_destroy(&live->lock);
+    live_free(live);
+}
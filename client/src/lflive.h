@@ -0,0 +1,43 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Live demodulation of LF realtime samples
+//
+// Samples handed to lf_live_feed() go through a fixed size ring to a thread
+// that demodulates overlapping windows and prints tag IDs as they show up.
+// The thread uses the lfdemod globals (signal properties, clock cache), the
+// caller must not demodulate anything itself until lf_live_stop() returns.
+//-----------------------------------------------------------------------------
+
+#ifndef LFLIVE_H__
+#define LFLIVE_H__
+
+#include "common.h"
+
+#define LF_LIVE_RING        (256 * 1024)    // samples waiting for the demod thread
+#define LF_LIVE_WINDOW      (16 * 1024)     // samples per demod attempt
+#define LF_LIVE_HOP         (8 * 1024)      // windows overlap by WINDOW - HOP samples
+#define LF_LIVE_MAX_IDS     32              // distinct IDs kept for the summary
+#define LF_LIVE_CAPTURE_LEN (8 * 1024 * 1024) // bytes of a live capture kept for the graph
+
+typedef struct lf_live_s lf_live_t;
+
+lf_live_t *lf_live_start(uint8_t bits_per_sample);
+// packed sample bytes, as the device sends them, in order
+void lf_live_feed(lf_live_t *live, const uint8_t *data, size_t len);
+// demodulates what is left, stops the thread, prints a summary and frees live
+void lf_live_stop(lf_live_t *live);
+
+#endif
@@ -0,0 +1,541 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Streaming decoders for sniffed LF downlink (reader to tag) commands
+//-----------------------------------------------------------------------------
+
+#include "lfsniff.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// if the difference between a and b is less than or eq to d  i.e. does a = b +/- d
+#define APPROX_EQ(a, b, d) ((abs(a - b) <= d) ? true : false)
+
+#define T55_PULSES      80      // max should be 73 +/-
+#define EM_BITS_LEN     128
+
+typedef enum {
+    EM_HIGH = 0,    // waiting for the field to go high
+    EM_LOW,         // waiting for the gap
+    EM_RISE,        // counting samples up to the sharp rise after the gap
+} em_phase_t;
+
+typedef enum {
+    EM_IDLE = 0,
+    EM_ZERO,        // first bit seen, the next one gives the width of a 0
+    EM_BITS,
+} em_state_t;
+
+struct lfsniff_s {
+    lfsniff_proto_t proto;
+    lfsniff_opts_t opts;
+    lfsniff_cb_t cb;
+    void *ctx;
+    uint64_t pos;           // samples seen so far
+
+    // t55xx, a pulse is a run of positive samples
+    int run;
+    uint64_t run_at;
+    int pulses[T55_PULSES];
+    uint64_t pulses_at[T55_PULSES];
+    int pulses_len;
+
+    // em4x05, a bit starts at the sharp rise after a gap
+    em_phase_t phase;
+    int rise_prev;
+    uint64_t rise_at;
+    size_t rise_len;
+    em_state_t state;
+    uint64_t last_at;
+    uint64_t pkt_at;
+    int zero_width;
+    char bits[EM_BITS_LEN];
+    size_t bits_len;
+};
+
+static void record_init(lfsniff_record_t *rec, lfsniff_proto_t proto, uint64_t offset) {
+    memset(rec, 0, sizeof(lfsniff_record_t));
+    rec->proto = proto;
+    rec->offset = offset;
+    rec->page = -1;
+    rec->block = -1;
+}
+
+static uint32_t bits_value(const char *bits, uint8_t from, uint8_t to) {
+    uint32_t value = 0;
+    for (uint8_t i = from; i <= to; i++) {
+        value <<= 1;
+        if (bits[i] == '1') {
+            value |= 1;
+        }
+    }
+    return value;
+}
+
+/*
+        Notes:
+                T55xx packet lengths  (1 of 4 needs to be checked)
+                                     -----------------------------------------------
+                                    |  Default  |    LL 0   | Leading 0 |   1 of 4  |
+                    ----------------------------------------------------------------|
+                   | Standard Write |     38    |     39    |    39     |    40     |
+                   | Protect Write  |     70    |     71    |    73     |    74     |
+                   | AOR            |     34    |     35    |    37     |    38     |
+                   | Standard Read  |      5    |      6    |     7     |     8     |
+                   | Protect Read   |     38    |     39    |    41     |    42     |
+                   | Regular Read   |      2    |      3    |     3     |     4     |
+                   | Reset          |      2    |      3    |     3     |     4     |
+                    ----------------------------------------------------------------
+
+                T55xx bit widths (decimation 1) - Expected, but may vary a little
+                Reference 0 for LL0 and Leading 0 can be longer
+                         -----------------------------------------------
+                        |  Default  |    LL 0   | Leading 0 |   1 of 4  |
+                    ----------------------------------------------------|
+                   | 0  |  16 - 32  |   9 - 33  |   5 - 80  |   tbc     |
+                   | 1  |  48 - 64  |  41 - 72  |  21 - 96  |   tbc     |
+                    ----------------------------------------------------
+                                                             00 01 10 11
+*/
+
+static uint8_t t55_get_packet(const int *pulses, int pulses_len, char *data, uint8_t width0, uint8_t width1, uint8_t tolerance) {
+    int i = 0;
+    bool ok = true;
+    uint8_t len = 0;
+
+    while (ok && (i < MIN(pulses_len, 73))) { // 70 bits max Fixed bit packet
+        if (APPROX_EQ(width0, pulses[i], tolerance))  {
+            data[len++] = '0';
+            i++;
+            continue;
+        }
+        if (APPROX_EQ(width1, pulses[i], tolerance)) {
+            data[len++] = '1';
+            i++;
+            continue;
+        }
+
+        ok = false;
+    }
+    data[len] = 0x00;
+    return len;
+}
+
+static void t55_trim(lfsniff_t *s, uint8_t len) {
+    memmove(s->pulses, s->pulses + len, (T55_PULSES - len) * sizeof(int));
+    memmove(s->pulses_at, s->pulses_at + len, (T55_PULSES - len) * sizeof(uint64_t));
+    s->pulses_len -= len;
+}
+
+// looks for a command at the start of the pulses. A command is only taken
+// once a pulse that isn't a 0 or a 1 ends it, or when there are no more samples,
+// so the first bits of a long command aren't mistaken for a short one.
+static void t55_command(lfsniff_t *s, bool last) {
+
+    const uint8_t tolerance = s->opts.tolerance;
+    const int *pulses = s->pulses;
+
+    // Check Samples for valid packets;
+    // We should find (outside of leading bits) we have a packet of "1" and "0" at same widths.
+    int minWidth = 1000;
+    int maxWidth = 0;
+    if (s->pulses_len >= 6) { // min size for a read - ignoring 1of4 10 0 <adr>
+
+        // We auto find widths
+        if ((s->opts.width0 == 0) && (s->opts.width1 == 0)) {
+            // We ignore bit 0 for the moment as it may be a ref. pulse, so check last
+            int ii = 2;
+            minWidth = pulses[1];
+            maxWidth = pulses[1];
+            bool done = false;
+
+            while ((done == false) && (ii < s->pulses_len) && ((maxWidth <= minWidth) || (APPROX_EQ(minWidth, maxWidth, tolerance)))) { // min should be 8, 16-32 more normal
+                if (pulses[ii] + 3 < minWidth) {
+                    minWidth = pulses[ii];
+                    done = true;
+                }
+                if (pulses[ii] - 1 > maxWidth) {
+                    maxWidth = pulses[ii];
+                    done = true;
+                }
+                ii++;
+            }
+        } else {
+            minWidth = s->opts.width0;
+            maxWidth = s->opts.width1;
+        }
+    }
+
+    //  out of bounds... min max far enough appart and minWidth is large enough
+    if (((maxWidth - minWidth) < 6) || (minWidth < 6)) { // min 8 +/-
+        return;
+    }
+
+    // At this point we should have
+    // - a min of 6 samples
+    // - the 0 and 1 sample widths
+    // - min 0 and min separations (worst case)
+    // No max checks done (yet) as have seen samples > then specs in use.
+
+    lfsniff_record_t rec;
+    record_init(&rec, LFSNIFF_T55XX, s->pulses_at[0]);
+    rec.width0 = minWidth;
+    rec.width1 = maxWidth;
+    char *data = rec.bits;
+
+    // Long leading 0
+    if (APPROX_EQ(pulses[0], 136 + minWidth, tolerance) && APPROX_EQ(pulses[1], maxWidth, tolerance)) {
+        // not yet handled
+        return;
+    }
+
+    // Fixed bit - Default
+    if (APPROX_EQ(pulses[0], maxWidth, tolerance)) {
+        uint8_t len = t55_get_packet(pulses, s->pulses_len, data, minWidth, maxWidth, tolerance);
+
+        if (data[0] == '1' && (len < s->pulses_len || last)) {
+
+            // Default Read
+            if (len == 6) {
+                t55_trim(s, 4); // left 1 or 2 samples seemed to help
+                rec.cmd = "Default Read";
+                rec.page = data[1] - '0';
+                rec.block = bits_value(data, 3, 5);
+            }
+
+            // Password Write, lock bit 34
+            if (len == 70) {
+                t55_trim(s, 70);
+                rec.cmd = "Default pwd write";
+                rec.page = data[1] - '0';
+                rec.has_password = true;
+                rec.password = bits_value(data, 2, 33);
+                rec.has_data = true;
+                rec.data = bits_value(data, 35, 66);
+                rec.block = bits_value(data, 67, 69);
+            }
+
+            // Default Write or password read ???
+            // the most confusing command.
+            // if the token is with a password - all is OK,
+            // if not - read command with a password will lead to write the shifted password to the memory and:
+            //    IF the most bit of the data is `1` ----> IT LEADS TO LOCK this block of the memory
+            if (len == 38) {
+                t55_trim(s, 38);
+                rec.cmd = "Default write/pwd read";
+                rec.page = data[1] - '0';
+                rec.has_password = true;
+                rec.password_guess = true;
+                rec.password = bits_value(data, 2, 33);
+                rec.has_data = true;
+                rec.data = bits_value(data, 3, 34);
+                rec.block = bits_value(data, 35, 37);
+            }
+
+            if (rec.cmd) {
+                s->cb(&rec, s->ctx);
+                return;
+            }
+        }
+    }
+
+    // Leading 0
+    if (APPROX_EQ(pulses[0], minWidth, tolerance)) {
+        // leading 0 (should = 0 width)
+        // 1 of 4 (leads with 00)
+        uint8_t len = t55_get_packet(pulses, s->pulses_len, data, minWidth, maxWidth, tolerance);
+        // **** Should check to 0 to be actual 0 as well i.e. 01 .... data ....
+        if ((data[0] == '0') && (data[1] == '1') && (len == 73) && (len < s->pulses_len || last)) {
+            t55_trim(s, 73);
+            rec.cmd = "Leading 0 pwd write";
+            rec.page = data[2] - '0';
+            rec.has_password = true;
+            rec.password = bits_value(data, 5, 36);
+            rec.has_data = true;
+            rec.data = bits_value(data, 38, 69);
+            rec.block = bits_value(data, 70, 72);
+            s->cb(&rec, s->ctx);
+        }
+    }
+}
+
+static void t55_pulse(lfsniff_t *s, int width, uint64_t at) {
+    s->pulses[s->pulses_len] = width;
+    s->pulses_at[s->pulses_len] = at;
+    s->pulses_len++;
+    if (s->pulses_len > T55_PULSES - 1) { // make room for next sample - if not used by now, it won't be.
+        t55_trim(s, 1);
+    }
+    t55_command(s, false);
+}
+
+static void t55_feed(lfsniff_t *s, const int *samples, size_t len) {
+    for (size_t i = 0; i < len; i++, s->pos++) {
+        // the first sample never counted towards a pulse
+        if (s->pos == 0) {
+            continue;
+        }
+
+        if (samples[i] > 0) {
+            if (s->run == 0) {
+                s->run_at = s->pos;
+            }
+            s->run++;
+            continue;
+        }
+
+        if (s->run) {
+            t55_pulse(s, s->run, s->run_at);
+            s->run = 0;
+        }
+    }
+}
+
+// 4 bytes, each followed by an even parity bit
+static uint32_t em_get_block(const char *bits, bool fwd, bool *parity_error) {
+    uint32_t value = 0;
+
+    for (uint8_t i = 0; i < 4; i++) {
+        const char *byte = bits + (i * 9);
+        uint8_t parity = 0;
+        for (uint8_t j = 0; j < 8; j++) {
+            value <<= 1;
+            value += (byte[j] - '0');
+            parity += (byte[j] - '0');
+        }
+        if ((parity % 2) != (byte[8] - '0')) {
+            *parity_error = true;
+        }
+    }
+
+    if (fwd == false) {
+        uint32_t t1 = value;
+        value = 0;
+        for (uint8_t i = 0; i < 32; i++) {
+            value |= (((t1 >> i) & 1) << (31 - i));
+        }
+    }
+    return value;
+}
+
+static void em_bits_add(lfsniff_t *s, char c) {
+    if (s->bits_len < EM_BITS_LEN - 1) {
+        s->bits[s->bits_len] = c;
+    }
+    s->bits_len++;
+}
+
+static void em_command(lfsniff_t *s) {
+
+    char *bits = s->bits;
+    bits[MIN(s->bits_len, EM_BITS_LEN - 1)] = 0;
+
+    lfsniff_record_t rec;
+    record_init(&rec, LFSNIFF_EM4X05, s->pkt_at);
+
+    // EM4305 command lengths
+    // Login        0011 <pwd>          => 4 +     45 => 49
+    // Write Word   0101 <adr> <data>   => 4 + 7 + 45 => 56
+    // Read Word    1001 <adr>          => 4 + 7      => 11
+    // Protect      1100       <data>   => 4 +     45 => 49
+    // Disable      1010       <data>   => 4 +     45 => 49
+    // -> disable 1010 11111111 0 11111111 0 11111111 0 11111111 0 00000000 0
+
+    // Check to see if we got the leading 0
+    if (((strncmp(bits, "00011", 5) == 0) && (s->bits_len == 50)) ||
+            ((strncmp(bits, "00101", 5) == 0) && (s->bits_len == 57)) ||
+            ((strncmp(bits, "01001", 5) == 0) && (s->bits_len == 12)) ||
+            ((strncmp(bits, "01100", 5) == 0) && (s->bits_len == 50)) ||
+            ((strncmp(bits, "01010", 5) == 0) && (s->bits_len == 50))) {
+        memmove(bits, bits + 1, s->bits_len);
+        s->bits_len--;
+        rec.trimmed = true;
+    }
+
+    const size_t len = s->bits_len;
+
+    // logon
+    if ((strncmp(bits, "0011", 4) == 0) && (len == 49)) {
+        rec.cmd = "Logon";
+        rec.has_password = true;
+        rec.password = em_get_block(bits + 4, s->opts.fwd, &rec.parity_error);
+    }
+
+    // write
+    if ((strncmp(bits, "0101", 4) == 0) && (len == 56)) {
+        rec.cmd = "Write";
+        rec.block = (bits[4] - '0') + ((bits[5] - '0') << 1) + ((bits[6] - '0') << 2)  + ((bits[7] - '0') << 3);
+        rec.has_data = true;
+        rec.data = em_get_block(bits + 11, s->opts.fwd, &rec.parity_error);
+        if (rec.block == 2) {
+            rec.has_password = true;
+            rec.password = rec.data;
+        }
+    }
+
+    // read
+    if ((strncmp(bits, "1001", 4) == 0) && (len == 11)) {
+        rec.cmd = "Read";
+        rec.block = (bits[4] - '0') + ((bits[5] - '0') << 1) + ((bits[6] - '0') << 2)  + ((bits[7] - '0') << 3);
+    }
+
+    // protect
+    if ((strncmp(bits, "1100", 4) == 0) && (len == 49)) {
+        rec.cmd = "Protect";
+        rec.has_data = true;
+        rec.data = em_get_block(bits + 11, s->opts.fwd, &rec.parity_error);
+    }
+
+    // disable
+    if ((strncmp(bits, "1010", 4) == 0) && (len == 49)) {
+        rec.cmd = "Disable";
+        rec.has_data = true;
+        rec.data = em_get_block(bits + 11, s->opts.fwd, &rec.parity_error);
+    }
+
+    if (rec.cmd) {
+        memcpy(rec.bits, bits, len + 1);
+        s->cb(&rec, s->ctx);
+    }
+}
+
+static void em_bit_start(lfsniff_t *s, uint64_t at, size_t rise_len) {
+
+    switch (s->state) {
+        case EM_IDLE:
+            if (rise_len >= 10) { // Should be 18 so a bit less to allow for processing
+                s->pkt_at = at;
+                s->state = EM_ZERO;
+            }
+            break;
+
+        case EM_ZERO:
+            // Use first bit to get "0" bit samples as a reference
+            s->zero_width = at - s->pkt_at;
+            s->state = EM_IDLE;
+            if (s->zero_width <= 50) {
+                s->pkt_at -= s->zero_width;
+                s->bits_len = 0;
+                s->state = EM_BITS;
+            }
+            break;
+
+        case EM_BITS: {
+            int width = at - s->last_at;
+            if ((width > 300) || (width < (s->zero_width - 5))) { // to long or too short
+                em_bits_add(s, '0');   // Append last zero from the last bit find
+                em_command(s);
+                s->state = EM_IDLE;
+                break;
+            }
+
+            em_bits_add(s, '0');
+            for (int i = (width - s->zero_width) / 28; i > 0; i--) {
+                em_bits_add(s, '1');
+            }
+            break;
+        }
+    }
+    s->last_at = at;
+}
+
+static void em_feed(lfsniff_t *s, const int *samples, size_t len) {
+    for (size_t i = 0; i < len; i++, s->pos++) {
+        int x = samples[i];
+
+        if (s->phase == EM_RISE) {
+            if (x - s->rise_prev < 10) {
+                s->rise_len++;
+                s->rise_at = s->pos;
+                s->rise_prev = x;
+                continue;
+            }
+            em_bit_start(s, s->rise_at, s->rise_len);
+            s->phase = EM_HIGH;
+        }
+
+        if (s->phase == EM_HIGH) {
+            if (x <= 10) {
+                continue;
+            }
+            s->phase = EM_LOW;
+        }
+
+        // it SHOULD be a small clk around 0, but white seems to extend a bit.
+        if (s->phase == EM_LOW && x <= -10) {
+            s->phase = EM_RISE;
+            s->rise_at = s->pos;
+            s->rise_prev = x;
+            s->rise_len = 0;
+        }
+    }
+}
+
+lfsniff_t *lfsniff_new(lfsniff_proto_t proto, const lfsniff_opts_t *opts, lfsniff_cb_t cb, void *ctx) {
+    if (cb == NULL) {
+        return NULL;
+    }
+
+    lfsniff_t *s = calloc(1, sizeof(lfsniff_t));
+    if (s == NULL) {
+        return NULL;
+    }
+    s->proto = proto;
+    if (opts) {
+        s->opts = *opts;
+    }
+    s->cb = cb;
+    s->ctx = ctx;
+    return s;
+}
+
+void lfsniff_feed(lfsniff_t *sniff, const int *samples, size_t len) {
+    if (sniff == NULL || samples == NULL) {
+        return;
+    }
+
+    if (sniff->proto == LFSNIFF_T55XX) {
+        t55_feed(sniff, samples, len);
+    } else {
+        em_feed(sniff, samples, len);
+    }
+}
+
+void lfsniff_finish(lfsniff_t *sniff) {
+    if (sniff == NULL) {
+        return;
+    }
+
+    if (sniff->proto == LFSNIFF_T55XX) {
+        if (sniff->run) {
+            t55_pulse(sniff, sniff->run, sniff->run_at);
+            sniff->run = 0;
+        }
+        t55_command(sniff, true);
+    } else {
+        // no further bit, the gap up to the end of the capture closes the command
+        if (sniff->state == EM_BITS) {
+            em_bit_start(sniff, sniff->pos, 0);
+        }
+        sniff->state = EM_IDLE;
+        sniff->phase = EM_HIGH;
+    }
+}
+
+void lfsniff_free(lfsniff_t *sniff) {
+    free(sniff);
+}
@@ -0,0 +1,73 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Streaming decoders for sniffed LF downlink (reader to tag) commands
+//
+// Samples, as found in the graph buffer, can be handed over in chunks of any
+// size. Each sample is looked at once, the decoders keep the pulses of the
+// command in progress between calls and report every command they recognize
+// through a callback.
+//-----------------------------------------------------------------------------
+
+#ifndef LFSNIFF_H__
+#define LFSNIFF_H__
+
+#include "common.h"
+
+#define LFSNIFF_BITS_LEN    80      // longest command, t55xx leading 0 pwd write is 73 bits
+
+typedef enum {
+    LFSNIFF_T55XX = 0,
+    LFSNIFF_EM4X05,
+} lfsniff_proto_t;
+
+typedef struct {
+    // t55xx
+    uint8_t tolerance;      // samples a pulse may be off
+    uint8_t width0;         // samples of a 0 / 1 pulse, both 0 to detect
+    uint8_t width1;
+    // em4x05
+    bool fwd;               // keep data blocks in the bit order they were sent
+} lfsniff_opts_t;
+
+typedef struct {
+    lfsniff_proto_t proto;
+    const char *cmd;        // "Default Read", "Logon", ...
+    uint64_t offset;        // sample the command starts at
+    int8_t page;            // -1 when the command has none
+    int8_t block;
+    bool has_password;
+    bool password_guess;    // t55xx 38 bit command, a write or a password read
+    uint32_t password;
+    bool has_data;
+    uint32_t data;
+    int width0;             // t55xx, pulse widths the command was decoded with
+    int width1;
+    bool trimmed;           // em4x05, leading 0 dropped
+    bool parity_error;      // em4x05, data block
+    char bits[LFSNIFF_BITS_LEN];
+} lfsniff_record_t;
+
+typedef void (*lfsniff_cb_t)(const lfsniff_record_t *rec, void *ctx);
+
+typedef struct lfsniff_s lfsniff_t;
+
+lfsniff_t *lfsniff_new(lfsniff_proto_t proto, const lfsniff_opts_t *opts, lfsniff_cb_t cb, void *ctx);
+void lfsniff_feed(lfsniff_t *sniff, const int *samples, size_t len);
+// no more samples, decodes a command the end of the capture cut short
+void lfsniff_finish(lfsniff_t *sniff);
+void lfsniff_free(lfsniff_t *sniff);
+
+#endif
@@ -19,6 +19,7 @@
 #include "mfkey.h"
 
 #include "crapto1/crapto1.h"
+#include "traceevent.h"
 
 // MIFARE
 int inline compare_uint64(const void *a, const void *b) {
@@ -98,6 +99,7 @@ uint32_t nonce2key(uint32_t uid, uint32_t nt, uint32_t nr, uint32_t ar, uint64_t
 
 // recover key from 2 different reader responses on same tag challenge
 bool mfkey32(nonces_t *data, uint64_t *outputkey) {
+    TRACE_SPAN("crack", "mfkey32");
     struct Crypto1State *s, *t;
     uint64_t outkey = 0;
     uint64_t key = 0;     // recovered key
@@ -130,6 +132,7 @@ bool mfkey32(nonces_t *data, uint64_t *outputkey) {
 // recover key from 2 reader responses on 2 different tag challenges
 // skip "several found keys".  Only return true if ONE key is found
 bool mfkey32_moebius(nonces_t *data, uint64_t *outputkey) {
+    TRACE_SPAN("crack", "mfkey32_moebius");
     struct Crypto1State *s, *t;
     uint64_t outkey  = 0;
     uint64_t key     = 0; // recovered key
@@ -163,6 +166,7 @@ bool mfkey32_moebius(nonces_t *data, uint64_t *outputkey) {
 // recover key from 2 reader responses on 2 different tag challenges
 // skip "several found keys".  Only return true if ONE key is found
 bool mfkey32_nested(nonces_t *data, uint64_t *outputkey) {
+    TRACE_SPAN("crack", "mfkey32_nested");
     struct Crypto1State *s, *t;
     uint64_t key     = 0; // recovered key
     bool isSuccess = false;
@@ -194,6 +198,7 @@ bool mfkey32_nested(nonces_t *data, uint64_t *outputkey) {
 
 // recover key from reader response and tag response of one authentication sequence
 int mfkey64(nonces_t *data, uint64_t *outputkey) {
+    TRACE_SPAN("crack", "mfkey64");
     uint64_t key = 0;  // recovered key
     uint32_t ks2;      // keystream used to encrypt reader response
     uint32_t ks3;      // keystream used to encrypt tag response
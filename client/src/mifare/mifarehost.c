@@ -45,8 +45,10 @@
 #include "parity.h"
 #include "pmflash.h"
 #include "preferences.h"        // setDeviceDebugLevel
+#include "traceevent.h"
 
 int mf_dark_side(uint8_t blockno, uint8_t key_type, uint64_t *key) {
+    TRACE_SPAN("crack", "darkside");
     uint32_t uid = 0;
     uint32_t nt = 0, nr = 0, ar = 0;
     uint64_t par_list = 0, ks_list = 0;
@@ -211,6 +213,7 @@ int mf_dark_side(uint8_t blockno, uint8_t key_type, uint64_t *key) {
 }
 
 int mf_check_keys(uint8_t blockNo, uint8_t keyType, bool clear_trace, uint8_t keycnt, uint8_t *keyBlock, uint64_t *key) {
+    TRACE_SPAN("crack", "check keys");
 
     if (key) {
         *key = -1;
@@ -258,6 +261,7 @@ int mf_check_keys(uint8_t blockNo, uint8_t keyType, bool clear_trace, uint8_t ke
 int mf_check_keys_fast_ex(uint8_t sectorsCnt, uint8_t firstChunk, uint8_t lastChunk, uint8_t strategy,
                           uint32_t size, uint8_t *keyBlock, sector_t *e_sector, bool use_flashmemory,
                           bool verbose, bool quiet, uint16_t singleSectorParams) {
+    TRACE_SPAN("crack", "check keys fast");
 
     uint64_t t2 = msclock();
 
@@ -507,6 +511,7 @@ __attribute__((force_align_arg_pointer))
 *nested_worker_thread(void *arg) {
     struct Crypto1State *p1;
     StateList_t *statelist = arg;
+    TRACE_SPAN("crack", "lfsr_recovery32");
     statelist->head.slhead = lfsr_recovery32(statelist->ks1, statelist->nt_enc ^ statelist->uid);
 
     for (p1 = statelist->head.slhead; p1->odd | p1->even; p1++) {};
@@ -520,6 +525,7 @@ __attribute__((force_align_arg_pointer))
 }
 
 int mf_nested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey, bool calibrate) {
+    TRACE_SPAN("crack", "nested");
 
     uint32_t uid = 0;
     StateList_t statelists[2];
@@ -726,6 +732,7 @@ out:
 }
 
 int mf_static_nested(uint8_t blockNo, uint8_t keyType, uint8_t *key, uint8_t trgBlockNo, uint8_t trgKeyType, uint8_t *resultKey) {
+    TRACE_SPAN("crack", "static nested");
 
     uint32_t uid = 0;
     StateList_t statelists[2];
@@ -27,10 +27,37 @@
 #include "util_posix.h"
 #include "comms.h"
 #include "preferences.h"
+#include "graph.h"
+#include "cmddata.h"
+#include "cmdtrace.h"
+#include "fileutils.h"
 
+// The first device opened is the one of the CLI session. Any other one gets a
+// session of its own, starting out with the preferences loaded for the first.
+// Each device can be driven from its own thread.
 pm3_device_t *pm3_open(const char *port) {
-    pm3_init();
-    preferences_load();
+    static bool initialized = false;
+    if (initialized == false) {
+        pm3_init();
+        preferences_load();
+        initialized = true;
+    }
+
+    if (g_session.pm3_present) {
+        // end the session of this device before its port goes
+        pm3_device_t *dev = NULL;
+        if (OpenProxmark(&dev, port, false, 20, false, USART_BAUD_RATE) == false) {
+            return NULL;
+        }
+        if (TestProxmark(dev) != PM3_SUCCESS) {
+            PrintAndLogEx(ERR, _RED_("ERROR:") " cannot communicate with the Proxmark3\n");
+            CloseProxmark(dev);
+            FreeProxmark(dev);
+            return NULL;
+        }
+        return dev;
+    }
+
     OpenProxmark(&g_session.current_device, port, false, 20, false, USART_BAUD_RATE);
     if (g_session.pm3_present && (TestProxmark(g_session.current_device) != PM3_SUCCESS)) {
         PrintAndLogEx(ERR, _RED_("ERROR:") " cannot communicate with the Proxmark3\n");
@@ -43,24 +70,27 @@ pm3_device_t *pm3_open(const char *port) {
     if (!g_session.pm3_present) {
         PrintAndLogEx(INFO, _RED_("OFFLINE") " mode");
     }
-    // For now, there is no real device context:
     return g_session.current_device;
 }
 
 void pm3_close(pm3_device_t *dev) {
+    pm3_device_t *prev = SetThreadDevice(dev);
     // Clean up the port
     if (g_session.pm3_present) {
+        // end the session of this device before its port goes
         clearCommandBuffer();
         SendCommandNG(CMD_QUIT_SESSION, NULL, 0);
         msleep(100); // Make sure command is sent before killing client
         CloseProxmark(dev);
     }
     free_grabber();
+    SetThreadDevice(prev);
+    FreeProxmark(dev);
 }
 
 int pm3_console(pm3_device_t *dev, const char *cmd, bool capture, bool quiet) {
-    // For now, there is no real device context:
-    (void) dev;
+    // the command runs against dev, whichever device this thread had before
+    pm3_device_t *prev = SetThreadDevice(dev);
     uint8_t prev_printAndLog = g_printAndLog;
     if (capture) {
         g_printAndLog |= PRINTANDLOG_GRAB;
@@ -70,25 +100,75 @@ int pm3_console(pm3_device_t *dev, const char *cmd, bool capture, bool quiet) {
     }
     int ret = CommandReceived(cmd);
     g_printAndLog = prev_printAndLog;
+    SetThreadDevice(prev);
     return ret;
 }
 
 const char *pm3_name_get(pm3_device_t *dev) {
-    return dev->g_conn->serial_port_name;
+    return dev->conn->serial_port_name;
 }
 
 const char *pm3_grabbed_output_get(pm3_device_t *dev) {
+    pm3_device_t *prev = SetThreadDevice(dev);
+    const char *ret = "";
     if (g_grabbed_output.ptr != NULL) {
         char *tmp = g_grabbed_output.ptr;
         tmp[g_grabbed_output.size] = 0;
         g_grabbed_output.idx = 0;
         g_grabbed_output.size = 0;
-        return tmp;
-    } else {
-        return "";
+        ret = tmp;
     }
+    SetThreadDevice(prev);
+    return ret;
 }
 
 pm3_device_t *pm3_get_current_dev(void) {
-    return g_session.current_device;
+    return GetCurrentDevice();
+}
+
+// The client side buffers are not per device yet, dev only matters for the emulator memory.
+// No copies: the graph, trace and dump buffers are reallocated by later commands
+pm3_buffer_t pm3_graph_get(pm3_device_t *dev) {
+    (void) dev;
+    pm3_buffer_t buf = {g_GraphBuffer, g_GraphTraceLen, sizeof(int32_t)};
+    return buf;
+}
+
+pm3_buffer_t pm3_demod_get(pm3_device_t *dev) {
+    (void) dev;
+    pm3_buffer_t buf = {g_DemodBuffer, g_DemodBufferLen, sizeof(uint8_t)};
+    return buf;
+}
+
+pm3_buffer_t pm3_trace_get(pm3_device_t *dev) {
+    (void) dev;
+    pm3_buffer_t buf = {NULL, 0, sizeof(uint8_t)};
+    buf.data = GetTraceBuffer(&buf.len);
+    return buf;
+}
+
+pm3_buffer_t pm3_dump_get(pm3_device_t *dev) {
+    (void) dev;
+    pm3_buffer_t buf = {NULL, 0, sizeof(uint8_t)};
+    buf.data = pm3_last_dump(&buf.len);
+    return buf;
+}
+
+pm3_buffer_t pm3_eml_get(pm3_device_t *dev) {
+    pm3_buffer_t buf = {NULL, 0, sizeof(uint8_t)};
+
+    if (dev->eml == NULL) {
+        dev->eml = calloc(MIFARE_4K_MAX_BYTES, sizeof(uint8_t));
+        if (dev->eml == NULL) {
+            return buf;
+        }
+    }
+
+    pm3_device_t *prev = SetThreadDevice(dev);
+    if (g_session.pm3_present && GetFromDevice(BIG_BUF_EML, dev->eml, MIFARE_4K_MAX_BYTES, 0, NULL, 0, NULL, 2500, false)) {
+        buf.data = dev->eml;
+        buf.len = MIFARE_4K_MAX_BYTES;
+    }
+    SetThreadDevice(prev);
+    return buf;
 }
@@ -3,11 +3,33 @@
 /* Include the header in the wrapper code */
 #include "pm3.h"
 #include "comms.h"
+
+#ifdef SWIGPYTHON
+// A read only memoryview of a copy of the buffer. A view straight into client
+// memory can't be kept alive: later commands reallocate the graph, trace and dump
+static PyObject *pm3_buffer_copy(pm3_buffer_t buf) {
+    Py_ssize_t len = (buf.data) ? (Py_ssize_t)(buf.len * buf.itemsize) : 0;
+    PyObject *bytes = PyBytes_FromStringAndSize((const char *)buf.data, len);
+    if (bytes == NULL) {
+        return NULL;
+    }
+    // the view holds the only reference to the copy
+    PyObject *view = PyMemoryView_FromObject(bytes);
+    Py_DECREF(bytes);
+    if (view == NULL || buf.itemsize != sizeof(int32_t)) {
+        return view;
+    }
+    PyObject *items = PyObject_CallMethod(view, "cast", "s", "i");
+    Py_DECREF(view);
+    return items;
+}
+#endif
 %}
 
 /* Strip "pm3_" from API functions for SWIG */
 %rename("%(strip:[pm3_])s") "";
 %feature("immutable","1") pm3_current_dev;
+%naturalvar pm3_buffer_t;
 
 #ifdef PYWRAP
     #include <Python.h>
@@ -18,6 +40,17 @@
         $1 = Py_True;
     }
 #endif
+#ifdef SWIGPYTHON
+    %typemap(out) pm3_buffer_t {
+        $result = pm3_buffer_copy($1);
+    }
+#endif
+#ifdef SWIGLUA
+    // no buffer views in Lua, binary strings come closest: string.byte / string.unpack
+    %typemap(out) pm3_buffer_t {
+        lua_pushlstring(L, (const char *)$1.data, $1.len * $1.itemsize); SWIG_arg++;
+    }
+#endif
 typedef struct {
     %extend {
         pm3() {
@@ -43,6 +76,13 @@ typedef struct {
         int console(char *cmd, bool capture = true, bool quiet = true);
         char const * const name;
         char const * const grabbed_output;
+        // Copies of the client buffers as they are now, in Python read only memoryviews
+        // (int32 for the graph), in Lua binary strings. Read them again after a command
+        pm3_buffer_t const graph;
+        pm3_buffer_t const demod;
+        pm3_buffer_t const trace;
+        pm3_buffer_t const dump;
+        pm3_buffer_t const eml;
     }
 } pm3;
 //%nodefaultctor device;
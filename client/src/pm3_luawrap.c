@@ -2667,6 +2667,27 @@ static swig_module_info swig_module = {swig_types, 1, 0, 0, 0, 0};
 #include "pm3.h"
 #include "comms.h"
 
+#ifdef SWIGPYTHON
+// A read only memoryview of a copy of the buffer. A view straight into client
+// memory can't be kept alive: later commands reallocate the graph, trace and dump
+static PyObject *pm3_buffer_copy(pm3_buffer_t buf) {
+    Py_ssize_t len = (buf.data) ? (Py_ssize_t)(buf.len * buf.itemsize) : 0;
+    PyObject *bytes = PyBytes_FromStringAndSize((const char *)buf.data, len);
+    if (bytes == NULL) {
+        return NULL;
+    }
+    // the view holds the only reference to the copy
+    PyObject *view = PyMemoryView_FromObject(bytes);
+    Py_DECREF(bytes);
+    if (view == NULL || buf.itemsize != sizeof(int32_t)) {
+        return view;
+    }
+    PyObject *items = PyObject_CallMethod(view, "cast", "s", "i");
+    Py_DECREF(view);
+    return items;
+}
+#endif
+
 SWIGINTERN pm3 *new_pm3__SWIG_0(void) {
 //            printf("SWIG pm3 constructor, get current pm3\n");
     pm3_device_t *p = pm3_get_current_dev();
@@ -2849,6 +2870,136 @@ fail:
 }
 
 
+static int _wrap_pm3_graph_get(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    pm3_buffer_t result;
+
+    SWIG_check_num_args("pm3::graph", 1, 1)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::graph", 1, "pm3 *");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_graph_get", 1, SWIGTYPE_p_pm3);
+    }
+
+    result = pm3_graph_get(arg1);
+    {
+        lua_pushlstring(L, (const char *)result.data, result.len * result.itemsize);
+        SWIG_arg++;
+    }
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
+static int _wrap_pm3_demod_get(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    pm3_buffer_t result;
+
+    SWIG_check_num_args("pm3::demod", 1, 1)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::demod", 1, "pm3 *");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_demod_get", 1, SWIGTYPE_p_pm3);
+    }
+
+    result = pm3_demod_get(arg1);
+    {
+        lua_pushlstring(L, (const char *)result.data, result.len * result.itemsize);
+        SWIG_arg++;
+    }
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
+static int _wrap_pm3_trace_get(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    pm3_buffer_t result;
+
+    SWIG_check_num_args("pm3::trace", 1, 1)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::trace", 1, "pm3 *");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_trace_get", 1, SWIGTYPE_p_pm3);
+    }
+
+    result = pm3_trace_get(arg1);
+    {
+        lua_pushlstring(L, (const char *)result.data, result.len * result.itemsize);
+        SWIG_arg++;
+    }
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
+static int _wrap_pm3_dump_get(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    pm3_buffer_t result;
+
+    SWIG_check_num_args("pm3::dump", 1, 1)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::dump", 1, "pm3 *");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_dump_get", 1, SWIGTYPE_p_pm3);
+    }
+
+    result = pm3_dump_get(arg1);
+    {
+        lua_pushlstring(L, (const char *)result.data, result.len * result.itemsize);
+        SWIG_arg++;
+    }
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
+static int _wrap_pm3_eml_get(lua_State *L) {
+    int SWIG_arg = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    pm3_buffer_t result;
+
+    SWIG_check_num_args("pm3::eml", 1, 1)
+    if (!SWIG_isptrtype(L, 1)) SWIG_fail_arg("pm3::eml", 1, "pm3 *");
+
+    if (!SWIG_IsOK(SWIG_ConvertPtr(L, 1, (void **)&arg1, SWIGTYPE_p_pm3, 0))) {
+        SWIG_fail_ptr("pm3_eml_get", 1, SWIGTYPE_p_pm3);
+    }
+
+    result = pm3_eml_get(arg1);
+    {
+        lua_pushlstring(L, (const char *)result.data, result.len * result.itemsize);
+        SWIG_arg++;
+    }
+    return SWIG_arg;
+
+fail:
+    SWIGUNUSED;
+    lua_error(L);
+    return 0;
+}
+
+
 static void swig_delete_pm3(void *obj) {
     pm3 *arg1 = (pm3 *) obj;
     delete_pm3(arg1);
@@ -2864,6 +3015,11 @@ static int _proxy__wrap_new_pm3(lua_State *L) {
 static swig_lua_attribute swig_pm3_attributes[] = {
     { "name", _wrap_pm3_name_get, SWIG_Lua_set_immutable },
     { "grabbed_output", _wrap_pm3_grabbed_output_get, SWIG_Lua_set_immutable },
+    { "graph", _wrap_pm3_graph_get, SWIG_Lua_set_immutable },
+    { "demod", _wrap_pm3_demod_get, SWIG_Lua_set_immutable },
+    { "trace", _wrap_pm3_trace_get, SWIG_Lua_set_immutable },
+    { "dump", _wrap_pm3_dump_get, SWIG_Lua_set_immutable },
+    { "eml", _wrap_pm3_eml_get, SWIG_Lua_set_immutable },
     {0, 0, 0}
 };
 static swig_lua_method swig_pm3_methods[] = {
@@ -3146,6 +3146,27 @@ static swig_module_info swig_module = {swig_types, 2, 0, 0, 0, 0};
 #include "pm3.h"
 #include "comms.h"
 
+#ifdef SWIGPYTHON
+// A read only memoryview of a copy of the buffer. A view straight into client
+// memory can't be kept alive: later commands reallocate the graph, trace and dump
+static PyObject *pm3_buffer_copy(pm3_buffer_t buf) {
+    Py_ssize_t len = (buf.data) ? (Py_ssize_t)(buf.len * buf.itemsize) : 0;
+    PyObject *bytes = PyBytes_FromStringAndSize((const char *)buf.data, len);
+    if (bytes == NULL) {
+        return NULL;
+    }
+    // the view holds the only reference to the copy
+    PyObject *view = PyMemoryView_FromObject(bytes);
+    Py_DECREF(bytes);
+    if (view == NULL || buf.itemsize != sizeof(int32_t)) {
+        return view;
+    }
+    PyObject *items = PyObject_CallMethod(view, "cast", "s", "i");
+    Py_DECREF(view);
+    return items;
+}
+#endif
+
 SWIGINTERN pm3 *new_pm3__SWIG_0(void) {
 //            printf("SWIG pm3 constructor, get current pm3\n");
     pm3_device_t *p = pm3_get_current_dev();
@@ -3644,6 +3665,136 @@ fail:
 }
 
 
+SWIGINTERN PyObject *_wrap_pm3_graph_get(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    PyObject *swig_obj[1] ;
+    pm3_buffer_t result;
+
+    (void)self;
+    if (!args) SWIG_fail;
+    swig_obj[0] = args;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_graph_get" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    result = pm3_graph_get(arg1);
+    {
+        resultobj = pm3_buffer_copy(result);
+    }
+    return resultobj;
+fail:
+    return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_pm3_demod_get(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    PyObject *swig_obj[1] ;
+    pm3_buffer_t result;
+
+    (void)self;
+    if (!args) SWIG_fail;
+    swig_obj[0] = args;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_demod_get" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    result = pm3_demod_get(arg1);
+    {
+        resultobj = pm3_buffer_copy(result);
+    }
+    return resultobj;
+fail:
+    return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_pm3_trace_get(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    PyObject *swig_obj[1] ;
+    pm3_buffer_t result;
+
+    (void)self;
+    if (!args) SWIG_fail;
+    swig_obj[0] = args;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_trace_get" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    result = pm3_trace_get(arg1);
+    {
+        resultobj = pm3_buffer_copy(result);
+    }
+    return resultobj;
+fail:
+    return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_pm3_dump_get(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    PyObject *swig_obj[1] ;
+    pm3_buffer_t result;
+
+    (void)self;
+    if (!args) SWIG_fail;
+    swig_obj[0] = args;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_dump_get" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    result = pm3_dump_get(arg1);
+    {
+        resultobj = pm3_buffer_copy(result);
+    }
+    return resultobj;
+fail:
+    return NULL;
+}
+
+
+SWIGINTERN PyObject *_wrap_pm3_eml_get(PyObject *self, PyObject *args) {
+    PyObject *resultobj = 0;
+    pm3 *arg1 = (pm3 *) 0 ;
+    void *argp1 = 0 ;
+    int res1 = 0 ;
+    PyObject *swig_obj[1] ;
+    pm3_buffer_t result;
+
+    (void)self;
+    if (!args) SWIG_fail;
+    swig_obj[0] = args;
+    res1 = SWIG_ConvertPtr(swig_obj[0], &argp1, SWIGTYPE_p_pm3, 0 |  0);
+    if (!SWIG_IsOK(res1)) {
+        SWIG_exception_fail(SWIG_ArgError(res1), "in method '" "pm3_eml_get" "', argument " "1"" of type '" "pm3 *""'");
+    }
+    arg1 = (pm3 *)(argp1);
+    result = pm3_eml_get(arg1);
+    {
+        resultobj = pm3_buffer_copy(result);
+    }
+    return resultobj;
+fail:
+    return NULL;
+}
+
+
 SWIGINTERN PyObject *pm3_swigregister(PyObject *SWIGUNUSEDPARM(self), PyObject *args) {
     PyObject *obj;
     if (!SWIG_Python_UnpackTuple(args, "swigregister", 1, 1, &obj)) return NULL;
@@ -3661,6 +3812,11 @@ static PyMethodDef SwigMethods[] = {
     { "pm3_console", _wrap_pm3_console, METH_VARARGS, NULL},
     { "pm3_name_get", _wrap_pm3_name_get, METH_O, NULL},
     { "pm3_grabbed_output_get", _wrap_pm3_grabbed_output_get, METH_O, NULL},
+    { "pm3_graph_get", _wrap_pm3_graph_get, METH_O, NULL},
+    { "pm3_demod_get", _wrap_pm3_demod_get, METH_O, NULL},
+    { "pm3_trace_get", _wrap_pm3_trace_get, METH_O, NULL},
+    { "pm3_dump_get", _wrap_pm3_dump_get, METH_O, NULL},
+    { "pm3_eml_get", _wrap_pm3_eml_get, METH_O, NULL},
     { "pm3_swigregister", pm3_swigregister, METH_O, NULL},
     { "pm3_swiginit", pm3_swiginit, METH_VARARGS, NULL},
     { NULL, NULL, 0, NULL }
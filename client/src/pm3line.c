@@ -31,6 +31,7 @@
 #include "pm3_cmd.h"
 #include "ui.h"                          // g_session
 #include "util.h"                        // str_ndup
+#include "fileutils.h"                   // fileExists
 
 #if defined(HAVE_READLINE)
 
@@ -180,6 +181,8 @@ void pm3line_init(void) {
 }
 
 char *pm3line_read(const char *s) {
+    // whatever is queued goes before the prompt
+    PrintAndLogFlush();
 #if defined(HAVE_READLINE)
     return readline(s);
 #elif defined(HAVE_LINENOISE)
@@ -212,8 +215,62 @@ void pm3line_update_prompt(const char *prompt) {
 #endif
 }
 
-int pm3line_load_history(const char *path) {
 #if defined(HAVE_READLINE)
+// the history file wasn't read, see pm3line_load_history()
+static bool history_append_only = false;
+
+// Appends the lines of this session, but not a first one the file ends with already
+static void history_append(const char *path) {
+    int n = history_length;
+    HIST_ENTRY *first = history_get(history_base);
+    if (n == 0 || first == NULL) {
+        return;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (f != NULL) {
+        char tail[1024] = {0};
+        size_t len = 0;
+        long off = 0;
+        if (fseek(f, 0, SEEK_END) == 0) {
+            long size = ftell(f);
+            off = (size > (long)sizeof(tail) - 1) ? size - ((long)sizeof(tail) - 1) : 0;
+            if (fseek(f, off, SEEK_SET) == 0) {
+                len = fread(tail, 1, sizeof(tail) - 1, f);
+            }
+        }
+        fclose(f);
+
+        while (len > 0 && (tail[len - 1] == '\n' || tail[len - 1] == '\r')) {
+            tail[--len] = 0;
+        }
+        char *last = strrchr(tail, '\n');
+        if (last != NULL) {
+            last++;
+        } else if (off == 0) {
+            last = tail;
+        }
+        if (last != NULL && strcmp(last, first->line) == 0) {
+            n--;
+        }
+    }
+
+    if (n > 0) {
+        append_history(n, path);
+    }
+}
+#endif
+
+int pm3line_load_history(const char *path, bool append_only) {
+#if !defined(HAVE_READLINE)
+    (void) append_only;
+#endif
+#if defined(HAVE_READLINE)
+    // only worth reading for line editing, an existing file can be appended to
+    if (append_only && fileExists(path)) {
+        history_append_only = true;
+        return PM3_SUCCESS;
+    }
     if (read_history(path) == 0) {
         return PM3_SUCCESS;
     } else {
@@ -249,7 +306,11 @@ void pm3line_add_history(const char *line) {
 void pm3line_flush_history(void) {
     if (g_session.history_path) {
 #if defined(HAVE_READLINE)
-        write_history(g_session.history_path);
+        if (history_append_only) {
+            history_append(g_session.history_path);
+        } else {
+            write_history(g_session.history_path);
+        }
 #elif defined(HAVE_LINENOISE)
         linenoiseHistorySave(g_session.history_path);
 #endif // HAVE_READLINE
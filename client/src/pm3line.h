@@ -19,12 +19,15 @@
 #ifndef PM3LINE_H__
 #define PM3LINE_H__
 
+#include "common.h"
+
 void pm3line_init(void);
 void pm3line_install_signals(void);
 char *pm3line_read(const char *s);
 void pm3line_free(void *ref);
 void pm3line_update_prompt(const char *prompt);
-int pm3line_load_history(const char *path);
+// append_only: the file isn't read, lines of this session are appended to it in the end
+int pm3line_load_history(const char *path, bool append_only);
 void pm3line_add_history(const char *line);
 void pm3line_flush_history(void);
 void pm3line_check(int (check)(void));
@@ -0,0 +1,374 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// .pm3z - binary, LZ4 compressed signal trace files
+//-----------------------------------------------------------------------------
+#include "pm3z.h"
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <lz4.h>
+#include "ui.h"
+
+struct pm3z_file_s {
+    FILE *f;
+    pm3z_header_t hdr;
+    uint64_t *index;        // file offset per block
+    uint8_t *cbuf;          // compressed block
+    uint8_t *rbuf;          // decompressed block
+    int64_t rbuf_block;     // block held in rbuf, -1 for none
+};
+
+bool pm3z_is_pm3z(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return false;
+    }
+    char magic[4] = {0};
+    bool res = (fread(magic, 1, sizeof(magic), f) == sizeof(magic)) && (memcmp(magic, PM3Z_MAGIC, sizeof(magic)) == 0);
+    fclose(f);
+    return res;
+}
+
+// narrowest width that holds every sample
+static uint8_t pm3z_width(const int32_t *data, size_t len) {
+    int32_t min = 0, max = 0;
+    for (size_t i = 0; i < len; i++) {
+        min = (data[i] < min) ? data[i] : min;
+        max = (data[i] > max) ? data[i] : max;
+    }
+    if (min >= INT8_MIN && max <= INT8_MAX) {
+        return 1;
+    }
+    if (min >= INT16_MIN && max <= INT16_MAX) {
+        return 2;
+    }
+    return 4;
+}
+
+static void pm3z_narrow(const int32_t *src, size_t n, uint8_t width, uint8_t *dst) {
+    if (width == 1) {
+        int8_t *d = (int8_t *)dst;
+        for (size_t i = 0; i < n; i++) {
+            d[i] = src[i];
+        }
+    } else if (width == 2) {
+        int16_t *d = (int16_t *)dst;
+        for (size_t i = 0; i < n; i++) {
+            d[i] = src[i];
+        }
+    } else {
+        memcpy(dst, src, n * sizeof(int32_t));
+    }
+}
+
+static void pm3z_widen(const uint8_t *src, size_t n, uint8_t width, int32_t *dst) {
+    if (width == 1) {
+        const int8_t *s = (const int8_t *)src;
+        for (size_t i = 0; i < n; i++) {
+            dst[i] = s[i];
+        }
+    } else if (width == 2) {
+        const int16_t *s = (const int16_t *)src;
+        for (size_t i = 0; i < n; i++) {
+            dst[i] = s[i];
+        }
+    } else {
+        memcpy(dst, src, n * sizeof(int32_t));
+    }
+}
+
+int pm3z_write(const char *path, const int32_t *data, size_t len, const sample_config *config, bool with_index) {
+    if (path == NULL || data == NULL || len == 0) {
+        return PM3_EINVARG;
+    }
+
+    pm3z_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, PM3Z_MAGIC, sizeof(hdr.magic));
+    hdr.version = PM3Z_VERSION;
+    hdr.header_size = sizeof(pm3z_header_t);
+    hdr.samples = len;
+    hdr.block_samples = PM3Z_BLOCK_SAMPLES;
+    hdr.blocks = (len + PM3Z_BLOCK_SAMPLES - 1) / PM3Z_BLOCK_SAMPLES;
+    hdr.width = pm3z_width(data, len);
+    if (config != NULL) {
+        hdr.bits_per_sample = config->bits_per_sample;
+        hdr.decimation = config->decimation;
+        hdr.averaging = config->averaging;
+        hdr.divisor = config->divisor;
+        hdr.trigger_threshold = config->trigger_threshold;
+        hdr.samples_to_skip = config->samples_to_skip;
+    }
+
+    size_t rmax = (size_t)PM3Z_BLOCK_SAMPLES * hdr.width;
+    int cmax = LZ4_compressBound(rmax);
+    uint8_t *rbuf = calloc(rmax, sizeof(uint8_t));
+    uint8_t *cbuf = calloc(cmax, sizeof(uint8_t));
+    uint64_t *index = calloc(hdr.blocks, sizeof(uint64_t));
+    if (rbuf == NULL || cbuf == NULL || index == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        free(rbuf);
+        free(cbuf);
+        free(index);
+        return PM3_EMALLOC;
+    }
+
+    int res = PM3_SUCCESS;
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        PrintAndLogEx(WARNING, "file not found or locked `" _YELLOW_("%s") "`", path);
+        res = PM3_EFILE;
+        goto out;
+    }
+
+    // header is written again once the index offset is known
+    uint64_t pos = sizeof(hdr);
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1) {
+        res = PM3_EFILE;
+        goto out;
+    }
+
+    for (uint32_t b = 0; b < hdr.blocks; b++) {
+        size_t first = (size_t)b * PM3Z_BLOCK_SAMPLES;
+        size_t n = (len - first < PM3Z_BLOCK_SAMPLES) ? len - first : PM3Z_BLOCK_SAMPLES;
+
+        pm3z_block_t blk = { .rsize = n * hdr.width };
+        pm3z_narrow(data + first, n, hdr.width, rbuf);
+
+        int csize = LZ4_compress_default((const char *)rbuf, (char *)cbuf, blk.rsize, cmax);
+        const uint8_t *payload = cbuf;
+        if (csize <= 0 || (uint32_t)csize >= blk.rsize) {
+            // incompressible, stored as is
+            csize = blk.rsize;
+            payload = rbuf;
+        }
+        blk.csize = csize;
+
+        index[b] = pos;
+        if (fwrite(&blk, sizeof(blk), 1, f) != 1 || fwrite(payload, 1, blk.csize, f) != blk.csize) {
+            res = PM3_EFILE;
+            goto out;
+        }
+        pos += sizeof(blk) + blk.csize;
+    }
+
+    if (with_index) {
+        hdr.index_offset = pos;
+        if (fwrite(index, sizeof(uint64_t), hdr.blocks, f) != hdr.blocks) {
+            res = PM3_EFILE;
+            goto out;
+        }
+        if (fseek(f, 0, SEEK_SET) != 0 || fwrite(&hdr, sizeof(hdr), 1, f) != 1) {
+            res = PM3_EFILE;
+        }
+    }
+
+out:
+    if (f != NULL) {
+        fclose(f);
+    }
+    if (res == PM3_EFILE && f != NULL) {
+        PrintAndLogEx(WARNING, "failed to write `" _YELLOW_("%s") "`", path);
+    }
+    free(rbuf);
+    free(cbuf);
+    free(index);
+    return res;
+}
+
+void pm3z_close(pm3z_file_t *file) {
+    if (file == NULL) {
+        return;
+    }
+    if (file->f != NULL) {
+        fclose(file->f);
+    }
+    free(file->index);
+    free(file->cbuf);
+    free(file->rbuf);
+    free(file);
+}
+
+// files without index are walked block by block once
+static bool pm3z_build_index(pm3z_file_t *file) {
+    uint64_t pos = file->hdr.header_size;
+    for (uint32_t b = 0; b < file->hdr.blocks; b++) {
+        pm3z_block_t blk;
+        if (fseek(file->f, pos, SEEK_SET) != 0 || fread(&blk, sizeof(blk), 1, file->f) != 1) {
+            return false;
+        }
+        file->index[b] = pos;
+        pos += sizeof(blk) + blk.csize;
+    }
+    return true;
+}
+
+int pm3z_open(const char *path, pm3z_file_t **file) {
+    *file = NULL;
+
+    pm3z_file_t *p = calloc(1, sizeof(pm3z_file_t));
+    if (p == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        return PM3_EMALLOC;
+    }
+    p->rbuf_block = -1;
+
+    p->f = fopen(path, "rb");
+    if (p->f == NULL) {
+        PrintAndLogEx(WARNING, "couldn't open `" _YELLOW_("%s") "`", path);
+        pm3z_close(p);
+        return PM3_EFILE;
+    }
+
+    // older, shorter headers read as zero for the missing fields
+    pm3z_header_t *hdr = &p->hdr;
+    size_t got = fread(hdr, 1, sizeof(pm3z_header_t), p->f);
+    if (got < offsetof(pm3z_header_t, width) + 1 || memcmp(hdr->magic, PM3Z_MAGIC, sizeof(hdr->magic)) != 0) {
+        PrintAndLogEx(WARNING, "`" _YELLOW_("%s") "` is not a pm3z file", path);
+        pm3z_close(p);
+        return PM3_EFILE;
+    }
+    if (hdr->header_size < sizeof(pm3z_header_t)) {
+        memset((uint8_t *)hdr + hdr->header_size, 0, sizeof(pm3z_header_t) - hdr->header_size);
+    }
+
+    if (hdr->version > PM3Z_VERSION) {
+        PrintAndLogEx(WARNING, "pm3z version %u is newer than supported version %u", hdr->version, PM3Z_VERSION);
+        pm3z_close(p);
+        return PM3_ENOTIMPL;
+    }
+
+    // every block takes at least its pm3z_block_t in the file
+    uint64_t fsize = UINT64_MAX;
+    if (fseek(p->f, 0, SEEK_END) == 0) {
+        long end = ftell(p->f);
+        fsize = (end >= 0) ? (uint64_t)end : UINT64_MAX;
+    }
+
+    if ((hdr->width != 1 && hdr->width != 2 && hdr->width != 4) ||
+            hdr->block_samples == 0 || hdr->block_samples > PM3Z_MAX_BLOCK_SAMPLES ||
+            hdr->blocks != hdr->samples / hdr->block_samples + ((hdr->samples % hdr->block_samples) ? 1 : 0) ||
+            (uint64_t)hdr->blocks * sizeof(pm3z_block_t) > fsize) {
+        PrintAndLogEx(WARNING, "`" _YELLOW_("%s") "` has a corrupt header", path);
+        pm3z_close(p);
+        return PM3_ESOFT;
+    }
+
+    size_t rmax = (size_t)hdr->block_samples * hdr->width;
+    p->index = calloc((size_t)hdr->blocks + 1, sizeof(uint64_t));
+    p->rbuf = calloc(rmax, sizeof(uint8_t));
+    p->cbuf = calloc(rmax, sizeof(uint8_t));
+    if (p->index == NULL || p->rbuf == NULL || p->cbuf == NULL) {
+        PrintAndLogEx(WARNING, "Failed to allocate memory");
+        pm3z_close(p);
+        return PM3_EMALLOC;
+    }
+
+    bool indexed = false;
+    if (hdr->index_offset) {
+        indexed = (fseek(p->f, hdr->index_offset, SEEK_SET) == 0) &&
+                  (fread(p->index, sizeof(uint64_t), hdr->blocks, p->f) == hdr->blocks);
+    }
+    if (indexed == false && pm3z_build_index(p) == false) {
+        PrintAndLogEx(WARNING, "`" _YELLOW_("%s") "` is truncated", path);
+        pm3z_close(p);
+        return PM3_EFILE;
+    }
+
+    *file = p;
+    return PM3_SUCCESS;
+}
+
+const pm3z_header_t *pm3z_header(const pm3z_file_t *file) {
+    return &file->hdr;
+}
+
+void pm3z_get_config(const pm3z_file_t *file, sample_config *config) {
+    memset(config, 0, sizeof(sample_config));
+    config->bits_per_sample = file->hdr.bits_per_sample;
+    config->decimation = file->hdr.decimation;
+    config->averaging = file->hdr.averaging;
+    config->divisor = file->hdr.divisor;
+    config->trigger_threshold = file->hdr.trigger_threshold;
+    config->samples_to_skip = file->hdr.samples_to_skip;
+}
+
+// decompress block b into dst, which holds rsize bytes
+static bool pm3z_load_block(pm3z_file_t *file, uint32_t b, uint8_t *dst, uint32_t rsize) {
+    pm3z_block_t blk;
+    if (fseek(file->f, file->index[b], SEEK_SET) != 0 || fread(&blk, sizeof(blk), 1, file->f) != 1) {
+        return false;
+    }
+
+    if (blk.rsize != rsize || blk.csize > rsize) {
+        return false;
+    }
+
+    if (blk.csize == blk.rsize) {
+        return fread(dst, 1, rsize, file->f) == rsize;
+    }
+
+    if (fread(file->cbuf, 1, blk.csize, file->f) != blk.csize) {
+        return false;
+    }
+    return LZ4_decompress_safe((const char *)file->cbuf, (char *)dst, blk.csize, rsize) == (int)rsize;
+}
+
+size_t pm3z_read(pm3z_file_t *file, uint64_t first, size_t count, int32_t *dest) {
+    const pm3z_header_t *hdr = &file->hdr;
+    if (first >= hdr->samples) {
+        return 0;
+    }
+    if (count > hdr->samples - first) {
+        count = hdr->samples - first;
+    }
+
+    size_t done = 0;
+    while (done < count) {
+        uint64_t s = first + done;
+        uint32_t b = s / hdr->block_samples;
+        size_t bfirst = (size_t)b * hdr->block_samples;
+        size_t bn = (hdr->samples - bfirst < hdr->block_samples) ? hdr->samples - bfirst : hdr->block_samples;
+        size_t off = s - bfirst;
+        size_t n = (bn - off < count - done) ? bn - off : count - done;
+        uint32_t rsize = bn * hdr->width;
+
+        // whole int32 blocks go straight to the destination
+        if (hdr->width == 4 && off == 0 && n == bn) {
+            if (pm3z_load_block(file, b, (uint8_t *)(dest + done), rsize) == false) {
+                break;
+            }
+        } else {
+            if (file->rbuf_block != b) {
+                file->rbuf_block = -1;
+                if (pm3z_load_block(file, b, file->rbuf, rsize) == false) {
+                    break;
+                }
+                file->rbuf_block = b;
+            }
+            pm3z_widen(file->rbuf + off * hdr->width, n, hdr->width, dest + done);
+        }
+        done += n;
+    }
+
+    if (done < count) {
+        PrintAndLogEx(WARNING, "pm3z block %" PRIu64 " is corrupt", (first + done) / hdr->block_samples);
+    }
+    return done;
+}
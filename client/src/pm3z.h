@@ -0,0 +1,78 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// .pm3z - binary, LZ4 compressed signal trace files
+//
+// Layout, all little endian:
+//   pm3z_header_t
+//   blocks       pm3z_block_t followed by csize bytes, LZ4 compressed unless csize == rsize
+//   index        (optional) one uint64_t file offset per block, at header.index_offset
+//
+// Each block holds header.block_samples samples (the last one may hold less),
+// stored as int8, int16 or int32 depending on header.width.
+//-----------------------------------------------------------------------------
+
+#ifndef PM3Z_H__
+#define PM3Z_H__
+
+#include "common.h"
+#include "pm3_cmd.h"    // sample_config
+
+#define PM3Z_MAGIC          "PM3Z"
+#define PM3Z_VERSION        1
+#define PM3Z_BLOCK_SAMPLES  (64 * 1024)
+// largest block a reader accepts, keeps a corrupt header from asking for huge buffers
+#define PM3Z_MAX_BLOCK_SAMPLES  (1024 * 1024)
+
+typedef struct {
+    char     magic[4];
+    uint16_t version;
+    uint16_t header_size;       // newer versions may append fields
+    uint64_t samples;
+    uint32_t block_samples;
+    uint32_t blocks;
+    uint8_t  width;             // bytes per sample, 1 / 2 / 4
+    uint8_t  reserved[3];
+    // sampling config of the trace, bits_per_sample 0 when unknown
+    int8_t   bits_per_sample;
+    int8_t   decimation;
+    int8_t   averaging;
+    int8_t   reserved2;
+    int16_t  divisor;
+    int16_t  trigger_threshold;
+    int32_t  samples_to_skip;
+    uint64_t index_offset;      // 0 when the file has no index
+} PACKED pm3z_header_t;
+
+typedef struct {
+    uint32_t csize;
+    uint32_t rsize;
+} PACKED pm3z_block_t;
+
+typedef struct pm3z_file_s pm3z_file_t;
+
+// true when path starts with the pm3z magic
+bool pm3z_is_pm3z(const char *path);
+
+int pm3z_write(const char *path, const int32_t *data, size_t len, const sample_config *config, bool with_index);
+
+int pm3z_open(const char *path, pm3z_file_t **file);
+const pm3z_header_t *pm3z_header(const pm3z_file_t *file);
+void pm3z_get_config(const pm3z_file_t *file, sample_config *config);
+// read count samples from sample first on, returns the number of samples read
+size_t pm3z_read(pm3z_file_t *file, uint64_t first, size_t count, int32_t *dest);
+void pm3z_close(pm3z_file_t *file);
+
+#endif
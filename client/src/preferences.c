@@ -34,7 +34,6 @@
 #include "emv/emvjson.h"
 #include "cmdparser.h"
 #include "cliparser.h"
-#include "uart/uart.h" // uart_reconfigure_timeouts
 
 static int CmdHelp(const char *Cmd);
 static int setCmdHelp(const char *Cmd);
@@ -101,7 +100,7 @@ int preferences_load(void) {
     // Set all defaults
     g_session.client_debug_level = cdbOFF;
     //  g_session.device_debug_level = ddbOFF;
-    g_session.timeout = uart_get_timeouts();
+    g_session.timeout = GetCommunicationTimeout();
 
     g_session.window_changed = false;
     g_session.plot.x = 10;
@@ -1058,7 +1057,7 @@ static int setCmdClientTimeout(const char *Cmd) {
     if (g_session.timeout != new_value) {
         showClientTimeoutState();
         g_session.timeout = new_value;
-        uart_reconfigure_timeouts(new_value);
+        SetCommunicationTimeout(new_value);
         showClientTimeoutState();
         preferences_save();
     } else {
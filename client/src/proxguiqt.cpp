@@ -334,10 +334,17 @@ void SliderWidget::moveEvent(QMoveEvent *event) {
     g_session.window_changed = true;
 }
 
+// the graph buffers can't move (grow) while this is alive
+struct GraphLocker {
+    GraphLocker() { graphLock(); }
+    ~GraphLocker() { graphUnlock(); }
+};
+
 //--------------------
 void ProxWidget::applyOperation() {
+    GraphLocker lock;
     //printf("ApplyOperation()");
-    //g_saveState_gb = save_bufferS32(g_GraphBuffer, g_GraphTraceLen);
+    graphHistoryPush();
     memcpy(g_GraphBuffer, g_OverlayBuffer, sizeof(int) * g_GraphTraceLen);
     RepaintGraphWindow();
 }
@@ -346,12 +353,14 @@ void ProxWidget::stickOperation() {
     //printf("stickOperation()");
 }
 void ProxWidget::vchange_autocorr(int v) {
+    GraphLocker lock;
     int ans = AutoCorrelate(g_GraphBuffer, g_OverlayBuffer, g_GraphTraceLen, v, true, false);
     if (g_debugMode) printf("vchange_autocorr(w:%d): %d\n", v, ans);
     g_useOverlays = true;
     RepaintGraphWindow();
 }
 void ProxWidget::vchange_askedge(int v) {
+    GraphLocker lock;
     //extern int AskEdgeDetect(const int *in, int *out, int len, int threshold);
     int ans = AskEdgeDetect(g_GraphBuffer, g_OverlayBuffer, g_GraphTraceLen, v);
     if (g_debugMode) printf("vchange_askedge(w:%d)%d\n", v, ans);
@@ -359,6 +368,7 @@ void ProxWidget::vchange_askedge(int v) {
     RepaintGraphWindow();
 }
 void ProxWidget::vchange_dthr_up(int v) {
+    GraphLocker lock;
     int down = opsController->horizontalSlider_dirthr_down->value();
     directionalThreshold(g_GraphBuffer, g_OverlayBuffer, g_GraphTraceLen, v, down);
     //printf("vchange_dthr_up(%d)", v);
@@ -366,6 +376,7 @@ void ProxWidget::vchange_dthr_up(int v) {
     RepaintGraphWindow();
 }
 void ProxWidget::vchange_dthr_down(int v) {
+    GraphLocker lock;
     //printf("vchange_dthr_down(%d)", v);
     int up = opsController->horizontalSlider_dirthr_up->value();
     directionalThreshold(g_GraphBuffer, g_OverlayBuffer, g_GraphTraceLen, v, up);
@@ -822,7 +833,7 @@ void Plot::drawAnnotations(QRect annotationRect, QPainter *painter) {
     uint32_t pos = 0, loc = 375;
     painter->setPen(WHITE);
 
-    if (g_MarkerA.pos > 0) {
+    if (g_MarkerA.pos > 0 && g_MarkerA.pos < g_GraphTraceLen) {
         free(annotation);
 
         length = (sizeof(markerText) + (sizeof(uint32_t) * 3) + sizeof(" ") + 1);
@@ -1001,6 +1012,7 @@ void Plot::plotOperations(int *buffer, size_t len, QPainter *painter, QRect plot
 #define WIDTH_AXES 80
 
 void Plot::paintEvent(QPaintEvent *event) {
+    GraphLocker lock;
     QPainter painter(this);
     QBrush brush(GREEN);
     QPen pen(GREEN);
@@ -1290,6 +1302,7 @@ void Plot::mouseMoveEvent(QMouseEvent *event) {
 }
 
 void Plot::keyPressEvent(QKeyEvent *event) {
+    GraphLocker lock;
     uint32_t offset; // Left/right movement offset (in sample size)
 
     if (event->modifiers() & Qt::ShiftModifier) {
@@ -1451,6 +1464,9 @@ void Plot::keyPressEvent(QKeyEvent *event) {
             break;
 
         case Qt::Key_Equal:
+            if (g_MarkerA.pos >= g_GraphTraceLen) {
+                break;
+            }
             if (event->modifiers() & Qt::ControlModifier) {
                 g_OperationBuffer[g_MarkerA.pos] += 5;
             } else {
@@ -1461,6 +1477,9 @@ void Plot::keyPressEvent(QKeyEvent *event) {
             break;
 
         case Qt::Key_Minus:
+            if (g_MarkerA.pos >= g_GraphTraceLen) {
+                break;
+            }
             if (event->modifiers() & Qt::ControlModifier) {
                 g_OperationBuffer[g_MarkerA.pos] -= 5;
             } else {
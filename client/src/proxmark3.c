@@ -36,6 +36,7 @@
 #include "flash.h"
 #include "preferences.h"
 #include "commonutil.h"
+#include "traceevent.h"
 
 #ifndef _WIN32
 #include <locale.h>
@@ -44,6 +45,55 @@
 static int mainret = PM3_SUCCESS;
 
 #ifndef LIBPM3
+// --startup-profile, time spent in each phase until the first command runs
+#define STARTUP_PHASES_MAX  16
+
+typedef struct {
+    const char *name;
+    uint64_t us;
+} startup_phase_t;
+
+static startup_phase_t startup_phases[STARTUP_PHASES_MAX];
+static int startup_phases_count = 0;
+static uint64_t startup_start = 0;
+static uint64_t startup_last = 0;
+static clock_t startup_cpu = 0;
+static bool startup_profile = false;
+
+static void startup_begin(void) {
+    // cpu time of the dynamic loader and static constructors, before main() got to run
+    startup_cpu = clock();
+    startup_start = usclock();
+    startup_last = startup_start;
+}
+
+// ends the phase which started with the previous call
+static void startup_phase(const char *name) {
+    uint64_t now = usclock();
+    if (startup_phases_count < STARTUP_PHASES_MAX) {
+        startup_phases[startup_phases_count].name = name;
+        startup_phases[startup_phases_count].us = now - startup_last;
+        startup_phases_count++;
+    }
+    startup_last = now;
+}
+
+static void startup_report(void) {
+    if (startup_profile == false) {
+        return;
+    }
+    startup_profile = false;
+
+    PrintAndLogEx(NORMAL, "");
+    PrintAndLogEx(INFO, "--- " _CYAN_("Startup profile") " --------------------------");
+    PrintAndLogEx(INFO, "  %-22s %9.3f ms ( cpu )", "before main", (double)startup_cpu * 1000 / CLOCKS_PER_SEC);
+    for (int i = 0; i < startup_phases_count; i++) {
+        PrintAndLogEx(INFO, "  %-22s %9.3f ms", startup_phases[i].name, (double)startup_phases[i].us / 1000);
+    }
+    PrintAndLogEx(INFO, "  %-22s " _GREEN_("%9.3f") " ms", "total", (double)(startup_last - startup_start) / 1000);
+    PrintAndLogEx(NORMAL, "");
+}
+
 #define BANNERMSG1 ""
 #define BANNERMSG2 ""
 #define BANNERMSG3 ""
@@ -388,6 +438,7 @@ main_loop(const char *script_cmds_file, char *script_cmd, bool stayInCommandLoop
     } else {
         pm3_version_short();
     }
+    startup_phase("version");
 
     if (script_cmds_file) {
 
@@ -411,11 +462,15 @@ main_loop(const char *script_cmds_file, char *script_cmd, bool stayInCommandLoop
             g_session.history_path = NULL;
             PrintAndLogEx(ERR, "No history will be recorded");
         } else {
-            if (pm3line_load_history(g_session.history_path) != PM3_SUCCESS) {
+            // nothing to edit when the client exits after its commands
+            bool interactive = (stdinOnPipe == false) && ((execCommand == false && script_cmds_file == NULL) || stayInCommandLoop);
+            if (pm3line_load_history(g_session.history_path, interactive == false) != PM3_SUCCESS) {
                 PrintAndLogEx(INFO, "No previous history could be loaded");
             }
         }
     }
+    startup_phase("history");
+    startup_report();
 
     // loops every time enter is pressed...
     while (1) {
@@ -736,6 +791,8 @@ static void show_help(bool showFullHelp, char *exec_name) {
         PrintAndLogEx(NORMAL, "      -i/--interactive                    enter interactive mode after executing the script or the command");
         PrintAndLogEx(NORMAL, "      --incognito                         do not use history, prefs file nor log files");
         PrintAndLogEx(NORMAL, "      --ncpu <num_cores>                  override number of CPU cores");
+        PrintAndLogEx(NORMAL, "      --startup-profile                   print the time taken by each part of the startup");
+        PrintAndLogEx(NORMAL, "      --trace-events <file>               record a Chrome / Perfetto trace of comms, commands, file I/O, demod and cracking");
         PrintAndLogEx(NORMAL, "\nOptions in flasher mode:");
         PrintAndLogEx(NORMAL, "      --flash                             flash Proxmark3, requires at least one --image");
         PrintAndLogEx(NORMAL, "      --reboot-to-bootloader              reboot Proxmark3 into bootloader mode");
@@ -848,7 +905,7 @@ static int dumpmem_pm3(char *serial_port_name, const char *filename, uint32_t ad
 finish2:
     clearCommandBuffer();
     if (in_bootloader) {
-        g_session.current_device->g_conn->run = false;
+        g_session.current_device->conn->run = false;
         SendCommandOLD(CMD_PING, 0, 0, 0, NULL, 0);
     } else {
         SendCommandNG(CMD_QUIT_SESSION, NULL, 0);
@@ -1000,11 +1057,19 @@ void pm3_init(void) {
     // set global variables soon enough to get the log path
     set_my_executable_path();
     set_my_user_directory();
+
+    // trace events can be asked for without touching the command line, e.g. under libpm3
+    const char *trace_events = getenv("PM3_TRACE_EVENTS");
+    if (trace_events != NULL && trace_events[0] != '\0') {
+        traceevent_open(trace_events);
+    }
 }
 
 #ifndef LIBPM3
 int main(int argc, char *argv[]) {
+    startup_begin();
     pm3_init();
+    startup_phase("paths");
     bool waitCOMPort = false;
     bool addScriptExec = false;
     bool stayInCommandLoop = false;
@@ -1014,6 +1079,7 @@ int main(int argc, char *argv[]) {
     uint32_t speed = 0;
 
     pm3line_init();
+    startup_phase("line editor");
 
     char exec_name[100] = {0};
     strncpy(exec_name, basename(argv[0]), sizeof(exec_name) - 1);
@@ -1226,6 +1292,25 @@ int main(int argc, char *argv[]) {
             continue;
         }
 
+        // print how long each part of the startup took
+        if (strcmp(argv[i], "--startup-profile") == 0) {
+            startup_profile = true;
+            continue;
+        }
+
+        // record trace events
+        if (strcmp(argv[i], "--trace-events") == 0) {
+            if (i + 1 == argc) {
+                PrintAndLogEx(ERR, _RED_("ERROR:") " missing file specification after --trace-events\n");
+                show_help(false, exec_name);
+                return 1;
+            }
+            if (traceevent_open(argv[++i]) != PM3_SUCCESS) {
+                return 1;
+            }
+            continue;
+        }
+
         // do not use history nor log files
         if (strcmp(argv[i], "--incognito") == 0) {
             g_session.incognito = true;
@@ -1332,6 +1417,9 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    startup_phase("arguments");
+    traceevent_thread_name("main");
+
     // Load Settings and assign
     // This will allow the command line to override the settings.json values
     preferences_load();
@@ -1368,6 +1456,8 @@ int main(int argc, char *argv[]) {
         exit(EXIT_SUCCESS);
     }
 
+    startup_phase("preferences");
+
     if (script_cmd) {
         while (script_cmd[strlen(script_cmd) - 1] == ' ') {
             script_cmd[strlen(script_cmd) - 1] = 0x00;
@@ -1408,6 +1498,8 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
+    startup_phase("device");
+
     if (g_session.pm3_present == false) {
         PrintAndLogEx(INFO, _YELLOW_("OFFLINE") " mode. Check " _YELLOW_("\"%s -h\"") " if it's not what you want.\n", exec_name);
     }
@@ -1437,16 +1529,24 @@ int main(int argc, char *argv[]) {
             PrintAndLogEx(WARNING,"Proxmark3 not ready to set debug level");
     }
     */
+    startup_phase("banner, first prefs");
 
 #ifdef HAVE_GUI
 
+    // Qt is only started for sessions which stay, its windows would be gone right away otherwise
+    bool use_gui = stayInCommandLoop || ((script_cmds_file == NULL) && (script_cmd == NULL));
+
 #  if defined(_WIN32) || (defined(__MACH__) && defined(__APPLE__))
-    InitGraphics(argc, argv, script_cmds_file, script_cmd, stayInCommandLoop);
-    MainGraphics();
+    if (use_gui) {
+        InitGraphics(argc, argv, script_cmds_file, script_cmd, stayInCommandLoop);
+        MainGraphics();
+    } else {
+        main_loop(script_cmds_file, script_cmd, stayInCommandLoop);
+    }
 #  else
     // for *nix distro's,  check environment variable to verify a display
     const char *display = getenv("DISPLAY");
-    if (display && strlen(display) > 1) {
+    if (use_gui && display && strlen(display) > 1) {
         InitGraphics(argc, argv, script_cmds_file, script_cmd, stayInCommandLoop);
         MainGraphics();
     } else {
@@ -0,0 +1,165 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Trace events, where the time of a session goes
+//-----------------------------------------------------------------------------
+
+#include "traceevent.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>         // getpid
+#include "util_posix.h"     // usclock
+#include "ui.h"             // PrintAndLogEx
+
+#define TRACEEVENT_BUFFER_SIZE  (1024 * 1024)
+
+bool g_traceevent_enabled = false;
+
+static FILE *trace_file = NULL;
+static uint64_t trace_start = 0;
+static int trace_pid = 0;
+static int trace_next_tid = 0;
+static __thread int trace_tid = 0;
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int trace_thread_id(void) {
+    if (trace_tid == 0) {
+        trace_tid = __atomic_add_fetch(&trace_next_tid, 1, __ATOMIC_SEQ_CST);
+    }
+    return trace_tid;
+}
+
+// names are command lines and the like, anything JSON doesn't take as is gets escaped
+static void trace_write_string(const char *s) {
+    fputc('"', trace_file);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char) * s;
+        if (c == '"' || c == '\\') {
+            fputc('\\', trace_file);
+            fputc(c, trace_file);
+        } else if (c < 0x20) {
+            fprintf(trace_file, "\\u%04x", c);
+        } else {
+            fputc(c, trace_file);
+        }
+    }
+    fputc('"', trace_file);
+}
+
+// call with trace_lock held
+static void trace_write_event(const char *ph, const char *cat, const char *name, uint64_t ts, int64_t dur, const char *arg_name, int64_t arg) {
+    fprintf(trace_file, ",\n{\"ph\":\"%s\",\"cat\":", ph);
+    trace_write_string(cat);
+    fprintf(trace_file, ",\"name\":");
+    trace_write_string(name);
+    fprintf(trace_file, ",\"pid\":%d,\"tid\":%d,\"ts\":%" PRIu64, trace_pid, trace_thread_id(), ts - trace_start);
+    if (dur >= 0) {
+        fprintf(trace_file, ",\"dur\":%" PRId64, dur);
+    }
+    if (ph[0] == 'i') {
+        fprintf(trace_file, ",\"s\":\"t\"");
+    }
+    if (arg_name != NULL) {
+        fprintf(trace_file, ",\"args\":{");
+        trace_write_string(arg_name);
+        fprintf(trace_file, ":%" PRId64 "}", arg);
+    }
+    fputc('}', trace_file);
+}
+
+uint64_t traceevent_now(void) {
+    // 0 stands for a span which isn't recorded
+    return usclock() | 1;
+}
+
+int traceevent_open(const char *filename) {
+    traceevent_close();
+
+    FILE *f = fopen(filename, "w");
+    if (f == NULL) {
+        PrintAndLogEx(ERR, "could not open trace events file " _YELLOW_("%s"), filename);
+        return PM3_EFILE;
+    }
+    setvbuf(f, NULL, _IOFBF, TRACEEVENT_BUFFER_SIZE);
+
+    static bool registered = false;
+    if (registered == false) {
+        atexit(traceevent_close);
+        registered = true;
+    }
+
+    pthread_mutex_lock(&trace_lock);
+    trace_file = f;
+    trace_start = traceevent_now();
+    trace_pid = (int)getpid();
+    // the array is opened by a metadata event, every event after it starts with a comma
+    fprintf(trace_file, "[\n{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"proxmark3\"}}", trace_pid);
+    __atomic_store_n(&g_traceevent_enabled, true, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&trace_lock);
+
+    PrintAndLogEx(INFO, "Recording trace events to " _YELLOW_("%s"), filename);
+    return PM3_SUCCESS;
+}
+
+void traceevent_close(void) {
+    pthread_mutex_lock(&trace_lock);
+    __atomic_store_n(&g_traceevent_enabled, false, __ATOMIC_SEQ_CST);
+    if (trace_file != NULL) {
+        fprintf(trace_file, "\n]\n");
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
+
+void traceevent_thread_name(const char *name) {
+    if (g_traceevent_enabled == false) {
+        return;
+    }
+
+    pthread_mutex_lock(&trace_lock);
+    if (trace_file != NULL) {
+        fprintf(trace_file, ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", trace_pid, trace_thread_id());
+        trace_write_string(name);
+        fprintf(trace_file, "}}");
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
+
+void traceevent_instant(const char *cat, const char *name, const char *arg_name, int64_t arg) {
+    if (g_traceevent_enabled == false) {
+        return;
+    }
+
+    uint64_t now = traceevent_now();
+    pthread_mutex_lock(&trace_lock);
+    if (trace_file != NULL) {
+        trace_write_event("i", cat, name, now, -1, arg_name, arg);
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
+
+void traceevent_span_write(const traceevent_span_t *span) {
+    uint64_t now = traceevent_now();
+    pthread_mutex_lock(&trace_lock);
+    // spans which started before the file was opened again are dropped
+    if (trace_file != NULL && span->start >= trace_start) {
+        trace_write_event("X", span->cat, span->name, span->start, now - span->start, span->arg_name, span->arg);
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
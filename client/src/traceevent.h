@@ -0,0 +1,80 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Trace events, where the time of a session goes
+//
+// Spans are written as Chrome trace event JSON, to be opened in
+// chrome://tracing or https://ui.perfetto.dev. Recording is off unless the
+// client runs with --trace-events <file> or PM3_TRACE_EVENTS=<file>, then a
+// span costs a flag test.
+//
+//   TRACE_SPAN("comms", "wait");                // until the end of the scope
+//   TRACE_SPAN_ARG("comms", "send", "cmd", cmd);
+//
+// Names are not copied, they have to live until the span ends.
+//-----------------------------------------------------------------------------
+
+#ifndef TRACEEVENT_H__
+#define TRACEEVENT_H__
+
+#include "common.h"
+
+typedef struct {
+    const char *cat;
+    const char *name;
+    const char *arg_name;   // NULL if the span has no argument
+    int64_t arg;
+    uint64_t start;         // us, 0 if not recording
+} traceevent_span_t;
+
+extern bool g_traceevent_enabled;
+
+// Starts recording to a file, the old one is closed
+int traceevent_open(const char *filename);
+void traceevent_close(void);
+
+// Name of the calling thread in the viewer
+void traceevent_thread_name(const char *name);
+
+// Something which happened at one point in time
+void traceevent_instant(const char *cat, const char *name, const char *arg_name, int64_t arg);
+
+void traceevent_span_write(const traceevent_span_t *span);
+uint64_t traceevent_now(void);
+
+static inline traceevent_span_t traceevent_span_begin(const char *cat, const char *name, const char *arg_name, int64_t arg) {
+    traceevent_span_t span = { cat, name, arg_name, arg, 0 };
+    if (g_traceevent_enabled) {
+        span.start = traceevent_now();
+    }
+    return span;
+}
+
+static inline void traceevent_span_end(traceevent_span_t *span) {
+    if (span->start) {
+        traceevent_span_write(span);
+    }
+}
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#define TRACE_SPAN_ARG(cat, name, arg_name, arg) \
+    traceevent_span_t TRACE_CONCAT(trace_span_, __LINE__) __attribute__((cleanup(traceevent_span_end))) = \
+        traceevent_span_begin((cat), (name), (arg_name), (arg))
+
+#define TRACE_SPAN(cat, name) TRACE_SPAN_ARG((cat), (name), NULL, 0)
+
+#endif
@@ -1,5 +1,6 @@
 #include "ringbuffer.h"
 #include <stdlib.h>
+#include <string.h>
 
 RingBuffer *RingBuf_create(int capacity) {
     RingBuffer *buffer = (RingBuffer *)calloc(sizeof(RingBuffer), sizeof(uint8_t));
@@ -52,39 +53,48 @@ bool RingBuf_dequeue(RingBuffer *buffer, uint8_t *value) {
 }
 
 int RingBuf_enqueueBatch(RingBuffer *buffer, const uint8_t *values, int count) {
-    int processed = 0;
 
     if (RingBuf_getAvailableSize(buffer) < count) {
         count = RingBuf_getAvailableSize(buffer);
     }
 
-    for (int i = 0; i < count; i++) {
-        buffer->data[buffer->rear] = values[i];
-        buffer->rear = (buffer->rear + 1) % buffer->capacity;
-        processed++;
+    // at most two copies, up to the end of the storage and from its start
+    int first = buffer->capacity - buffer->rear;
+    if (first > count) {
+        first = count;
     }
+    memcpy(buffer->data + buffer->rear, values, first);
+    memcpy(buffer->data, values + first, count - first);
 
-    buffer->size += processed;
+    buffer->rear = (buffer->rear + count) % buffer->capacity;
+    buffer->size += count;
 
-    return processed;
+    return count;
 }
 
 int RingBuf_dequeueBatch(RingBuffer *buffer, uint8_t *values, int count) {
-    int processed = 0;
 
     if (buffer->size < count) {
         count = buffer->size;
     }
 
-    for (int i = 0; i < count; i++) {
-        values[i] = buffer->data[buffer->front];
-        buffer->front = (buffer->front + 1) % buffer->capacity;
-        processed++;
+    int first = buffer->capacity - buffer->front;
+    if (first > count) {
+        first = count;
     }
+    memcpy(values, buffer->data + buffer->front, first);
+    memcpy(values + first, buffer->data, count - first);
 
-    buffer->size -= processed;
+    buffer->front = (buffer->front + count) % buffer->capacity;
+    buffer->size -= count;
+
+    // once drained, start over so the next direct write gets the whole storage
+    if (buffer->size == 0) {
+        buffer->front = 0;
+        buffer->rear = 0;
+    }
 
-    return processed;
+    return count;
 }
 
 inline int RingBuf_getUsedSize(RingBuffer *buffer) {
@@ -36,6 +36,11 @@ typedef void *serial_port;
  */
 #define CLAIMED_SERIAL_PORT (void*)(~2)
 
+/* Bytes uart_receive may read ahead of what it was asked for, they are handed
+ * out by the next calls. Holds a whole UDP datagram.
+ */
+#define UART_RX_BUFFER_SIZE (64 * 1024)
+
 /* Given a user-specified port name, connect to the port and return a structure
  * used for future references to that port.
  *
@@ -76,13 +81,13 @@ bool uart_set_speed(serial_port sp, const uint32_t uiPortSpeed);
  */
 uint32_t uart_get_speed(const serial_port sp);
 
-/* Reconfigure timeouts (ms)
+/* Reconfigure timeouts (ms) of a port, applied by its next receive
  */
-int uart_reconfigure_timeouts(uint32_t value);
+int uart_reconfigure_timeouts(serial_port sp, uint32_t value);
 
-/* Get timeouts (ms)
+/* Get timeouts (ms) of a port, 0 without one
  */
-uint32_t uart_get_timeouts(void);
+uint32_t uart_get_timeouts(const serial_port sp);
 
 /* Specify the outbound address and port for TCP/UDP connections
  */
@@ -59,27 +59,30 @@ typedef struct {
     int fd;           // Serial port file descriptor
     term_info tiOld;  // Terminal info before using the port
     term_info tiNew;  // Terminal info during the transaction
-    RingBuffer *udpBuffer;
+    bool udp;         // a read must take the whole datagram
+    RingBuffer *rxBuffer; // bytes read ahead of what was asked for
+    struct timeval timeout;     // see pm3_cmd.h
+    uint32_t newtimeout_value;  // taken over by the next receive, on the thread of the port
+    bool newtimeout_pending;
+    uint8_t rx_empty_counter;   // readable but empty in a row, a lost TCP connection
 } serial_port_unix_t_t;
 
-// see pm3_cmd.h
-struct timeval timeout = {
-    .tv_sec  = 0, // 0 second
-    .tv_usec = UART_FPC_CLIENT_RX_TIMEOUT_MS * 1000
-};
-
-static uint32_t newtimeout_value = 0;
-static bool newtimeout_pending = false;
-static uint8_t rx_empty_counter = 0;
-
-int uart_reconfigure_timeouts(uint32_t value) {
-    newtimeout_value = value;
-    newtimeout_pending = true;
+int uart_reconfigure_timeouts(serial_port sp, uint32_t value) {
+    serial_port_unix_t_t *spu = (serial_port_unix_t_t *)sp;
+    if (spu == NULL) {
+        return PM3_EINVARG;
+    }
+    __atomic_store_n(&spu->newtimeout_value, value, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&spu->newtimeout_pending, true, __ATOMIC_SEQ_CST);
     return PM3_SUCCESS;
 }
 
-uint32_t uart_get_timeouts(void) {
-    return newtimeout_value;
+uint32_t uart_get_timeouts(const serial_port sp) {
+    const serial_port_unix_t_t *spu = (const serial_port_unix_t_t *)sp;
+    if (spu == NULL) {
+        return 0;
+    }
+    return __atomic_load_n(&spu->newtimeout_value, __ATOMIC_SEQ_CST);
 }
 
 serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
@@ -90,10 +93,11 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
         return INVALID_SERIAL_PORT;
     }
 
-    sp->udpBuffer = NULL;
-    rx_empty_counter = 0;
+    sp->rxBuffer = NULL;
+    sp->rx_empty_counter = 0;
     // init timeouts
-    timeout.tv_usec = UART_FPC_CLIENT_RX_TIMEOUT_MS * 1000;
+    sp->timeout.tv_sec = 0;
+    sp->timeout.tv_usec = UART_FPC_CLIENT_RX_TIMEOUT_MS * 1000;
     g_conn.send_via_local_ip = false;
     g_conn.send_via_ip = PM3_NONE;
 
@@ -133,7 +137,7 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
             return INVALID_SERIAL_PORT;
         }
 
-        timeout.tv_usec = UART_NET_CLIENT_RX_TIMEOUT_MS * 1000;
+        sp->timeout.tv_usec = UART_NET_CLIENT_RX_TIMEOUT_MS * 1000;
 
         // find the "bind" option
         char *bindAddrPortStr = strstr(addrPortStr, ",bind=");
@@ -252,7 +256,7 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
                 return INVALID_SERIAL_PORT;
             }
         } else if (isUDP) {
-            sp->udpBuffer = RingBuf_create(MAX(sizeof(PacketResponseNGRaw), sizeof(PacketResponseOLD)) * 30);
+            sp->udp = true;
         }
 
         return sp;
@@ -321,7 +325,7 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
         free(prefix);
 
         // we must use max timeout!
-        timeout.tv_usec = UART_NET_CLIENT_RX_TIMEOUT_MS * 1000;
+        sp->timeout.tv_usec = UART_NET_CLIENT_RX_TIMEOUT_MS * 1000;
 
         size_t servernameLen = (strlen(pcPortName) - 7) + 1;
         char serverNameBuf[servernameLen];
@@ -467,7 +471,7 @@ void uart_close(const serial_port sp) {
         //silent error message as it can be called from uart_open failing modes, e.g. when waiting for port to appear
         //PrintAndLogEx(ERR, "UART error while closing port");
     }
-    RingBuf_destroy(spu->udpBuffer);
+    RingBuf_destroy(spu->rxBuffer);
     close(spu->fd);
     free(sp);
 }
@@ -476,38 +480,36 @@ int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uin
     uint32_t byteCount;  // FIONREAD returns size on 32b
     fd_set rfds;
     struct timeval tv;
-    const serial_port_unix_t_t *spu = (serial_port_unix_t_t *)sp;
+    serial_port_unix_t_t *spu = (serial_port_unix_t_t *)sp;
+
+    if (__atomic_exchange_n(&spu->newtimeout_pending, false, __ATOMIC_SEQ_CST)) {
+        spu->timeout.tv_usec = ((suseconds_t)__atomic_load_n(&spu->newtimeout_value, __ATOMIC_SEQ_CST)) * 1000;
+    }
 
-    if (newtimeout_pending) {
-        timeout.tv_usec = ((suseconds_t)newtimeout_value) * 1000;
-        newtimeout_pending = false;
+    // Whatever the OS has is read at once, a frame is asked for in pieces (preamble, payload)
+    // and the pieces of the next frames are then served from here without a syscall
+    if (spu->rxBuffer == NULL) {
+        spu->rxBuffer = RingBuf_create(UART_RX_BUFFER_SIZE);
+        if (spu->rxBuffer == NULL) {
+            return PM3_EMALLOC;
+        }
     }
+
     // Reset the output count
     *pszRxLen = 0;
     do {
-        int res;
-        if (spu->udpBuffer != NULL) {
-            // for UDP connection, try to use the data from the buffer
-
-            byteCount = RingBuf_getAvailableSize(spu->udpBuffer);
-            // Cap the number of bytes, so we don't overrun the buffer
-            if (pszMaxRxLen - (*pszRxLen) < byteCount) {
-//                PrintAndLogEx(ERR, "UART:: RX prevent overrun (have %u, need %u)", pszMaxRxLen - (*pszRxLen), byteCount);
-                byteCount = pszMaxRxLen - (*pszRxLen);
-            }
-            res = RingBuf_dequeueBatch(spu->udpBuffer, pbtRx + (*pszRxLen), byteCount);
-            *pszRxLen += res;
+        int res = RingBuf_dequeueBatch(spu->rxBuffer, pbtRx + (*pszRxLen), pszMaxRxLen - (*pszRxLen));
+        *pszRxLen += res;
 
-            if (*pszRxLen == pszMaxRxLen) {
-                // We have all the data we wanted.
-                return PM3_SUCCESS;
-            }
+        if (*pszRxLen == pszMaxRxLen) {
+            // We have all the data we wanted.
+            return PM3_SUCCESS;
         }
 
         // Reset file descriptor
         FD_ZERO(&rfds);
         FD_SET(spu->fd, &rfds);
-        tv = timeout;
+        tv = spu->timeout;
         res = select(spu->fd + 1, &rfds, NULL, NULL, &tv);
 
         // Read error
@@ -537,39 +539,35 @@ int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uin
             // select() > 0 && byteCount > 0 ===> data available
             // select() > 0 && byteCount always equals to 0 ===> maybe disconnected
             // This happens when TCP connection is lost
-            rx_empty_counter++;
-            if (rx_empty_counter > 3) {
+            spu->rx_empty_counter++;
+            if (spu->rx_empty_counter > 3) {
                 return PM3_ENOTTY;
             }
         } else {
-            rx_empty_counter = 0;
+            spu->rx_empty_counter = 0;
         }
 
-        // For UDP connection, put the incoming data into the buffer and handle them in the next round
-        if (spu->udpBuffer != NULL) {
-            if (RingBuf_getContinousAvailableSize(spu->udpBuffer) >= byteCount) {
-                // write to the buffer directly
-                res = read(spu->fd, RingBuf_getRearPtr(spu->udpBuffer), RingBuf_getAvailableSize(spu->udpBuffer));
-                if (res >= 0) {
-                    RingBuf_postEnqueueBatch(spu->udpBuffer, res);
-                }
-            } else {
-                // use transit buffer
-                uint8_t transitBuf[MAX(sizeof(PacketResponseNGRaw), sizeof(PacketResponseOLD)) * 30];
-                res = read(spu->fd, transitBuf, RingBuf_getAvailableSize(spu->udpBuffer));
-                RingBuf_enqueueBatch(spu->udpBuffer, transitBuf, res);
-            }
+        // The buffer is drained by now, so its whole storage is one continuous block
+        if (spu->udp) {
+            // a datagram goes in whole, handle it in the next round
+            res = read(spu->fd, RingBuf_getRearPtr(spu->rxBuffer), RingBuf_getContinousAvailableSize(spu->rxBuffer));
             // Stop if the OS has some troubles reading the data
             if (res < 0) {
                 return PM3_EIO;
             }
+            RingBuf_postEnqueueBatch(spu->rxBuffer, res);
             continue;
         }
 
-        // Cap the number of bytes, so we don't overrun the buffer
-        if (pszMaxRxLen - (*pszRxLen) < byteCount) {
-//            PrintAndLogEx(ERR, "UART:: RX prevent overrun (have %u, need %u)", pszMaxRxLen - (*pszRxLen), byteCount);
-            byteCount = pszMaxRxLen - (*pszRxLen);
+        if (byteCount > pszMaxRxLen - (*pszRxLen)) {
+            // more than asked for, read all of it ahead and handle it in the next round
+            byteCount = MIN(byteCount, (uint32_t)RingBuf_getContinousAvailableSize(spu->rxBuffer));
+            res = read(spu->fd, RingBuf_getRearPtr(spu->rxBuffer), byteCount);
+            if (res <= 0) {
+                return PM3_EIO;
+            }
+            RingBuf_postEnqueueBatch(spu->rxBuffer, res);
+            continue;
         }
 
         // There is something available, read the data
@@ -601,7 +599,7 @@ int uart_send(const serial_port sp, const uint8_t *pbtTx, const uint32_t len) {
         // Reset file descriptor
         FD_ZERO(&rfds);
         FD_SET(spu->fd, &rfds);
-        tv = timeout;
+        tv = spu->timeout;
         int res = select(spu->fd + 1, NULL, &rfds, NULL, &tv);
 
         // Write error
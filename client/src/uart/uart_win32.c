@@ -38,40 +38,43 @@ typedef struct {
     DCB dcb;               // Device control settings
     COMMTIMEOUTS ct;       // Serial port time-out configuration
     SOCKET hSocket;        // Socket handle
-    RingBuffer *udpBuffer; // Buffer for UDP
+    bool udp;              // a recv must take the whole datagram
+    RingBuffer *rxBuffer;  // bytes read ahead of what was asked for, sockets only
+    struct timeval timeout;     // this is for TCP connection
+    uint32_t newtimeout_value;  // taken over by the next receive, on the thread of the port
+    bool newtimeout_pending;
+    uint8_t rx_empty_counter;   // readable but empty in a row, a lost TCP connection
 } serial_port_windows_t;
 
-// this is for TCP connection
-struct timeval timeout = {
-    .tv_sec  = 0, // 0 second
-    .tv_usec = UART_NET_CLIENT_RX_TIMEOUT_MS * 1000
-};
-
-uint32_t newtimeout_value = 0;
-bool newtimeout_pending = false;
-uint8_t rx_empty_counter = 0;
-
-int uart_reconfigure_timeouts(uint32_t value) {
-    newtimeout_value = value;
-    newtimeout_pending = true;
+int uart_reconfigure_timeouts(serial_port sp, uint32_t value) {
+    serial_port_windows_t *spw = (serial_port_windows_t *)sp;
+    if (spw == NULL) {
+        return PM3_EINVARG;
+    }
+    __atomic_store_n(&spw->newtimeout_value, value, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&spw->newtimeout_pending, true, __ATOMIC_SEQ_CST);
     return PM3_SUCCESS;
 }
 
-uint32_t uart_get_timeouts(void) {
-    return newtimeout_value;
+uint32_t uart_get_timeouts(const serial_port sp) {
+    const serial_port_windows_t *spw = (const serial_port_windows_t *)sp;
+    if (spw == NULL) {
+        return 0;
+    }
+    return __atomic_load_n(&spw->newtimeout_value, __ATOMIC_SEQ_CST);
 }
 
 static int uart_reconfigure_timeouts_polling(serial_port sp) {
-    if (newtimeout_pending == false) {
+    serial_port_windows_t *spw = (serial_port_windows_t *)sp;
+    if (__atomic_exchange_n(&spw->newtimeout_pending, false, __ATOMIC_SEQ_CST) == false) {
         return PM3_SUCCESS;
     }
-    newtimeout_pending = false;
 
-    serial_port_windows_t *spw = (serial_port_windows_t *)sp;
-    spw->ct.ReadIntervalTimeout         = newtimeout_value;
+    uint32_t value = __atomic_load_n(&spw->newtimeout_value, __ATOMIC_SEQ_CST);
+    spw->ct.ReadIntervalTimeout         = value;
     spw->ct.ReadTotalTimeoutMultiplier  = 0;
-    spw->ct.ReadTotalTimeoutConstant    = newtimeout_value;
-    spw->ct.WriteTotalTimeoutMultiplier = newtimeout_value;
+    spw->ct.ReadTotalTimeoutConstant    = value;
+    spw->ct.WriteTotalTimeoutMultiplier = value;
     spw->ct.WriteTotalTimeoutConstant   = 0;
 
     if (!SetCommTimeouts(spw->hPort, &spw->ct)) {
@@ -93,8 +96,10 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
 
     sp->hSocket = INVALID_SOCKET; // default: serial port
 
-    sp->udpBuffer = NULL;
-    rx_empty_counter = 0;
+    sp->rxBuffer = NULL;
+    sp->rx_empty_counter = 0;
+    sp->timeout.tv_sec = 0;
+    sp->timeout.tv_usec = UART_NET_CLIENT_RX_TIMEOUT_MS * 1000;
     g_conn.send_via_local_ip = false;
     g_conn.send_via_ip = PM3_NONE;
 
@@ -128,7 +133,7 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
             return INVALID_SERIAL_PORT;
         }
 
-        timeout.tv_usec = UART_NET_CLIENT_RX_TIMEOUT_MS * 1000;
+        sp->timeout.tv_usec = UART_NET_CLIENT_RX_TIMEOUT_MS * 1000;
 
         // find the "bind" option
         char *bindAddrPortStr = strstr(addrPortStr, ",bind=");
@@ -264,7 +269,7 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
                 return INVALID_SERIAL_PORT;
             }
         } else if (isUDP) {
-            sp->udpBuffer = RingBuf_create(MAX(sizeof(PacketResponseNGRaw), sizeof(PacketResponseOLD)) * 30);
+            sp->udp = true;
         }
 
         return sp;
@@ -299,7 +304,7 @@ serial_port uart_open(const char *pcPortName, uint32_t speed, bool slient) {
         return INVALID_SERIAL_PORT;
     }
 
-    uart_reconfigure_timeouts(UART_FPC_CLIENT_RX_TIMEOUT_MS);
+    uart_reconfigure_timeouts(sp, UART_FPC_CLIENT_RX_TIMEOUT_MS);
     uart_reconfigure_timeouts_polling(sp);
 
     if (!uart_set_speed(sp, speed)) {
@@ -323,7 +328,7 @@ void uart_close(const serial_port sp) {
         closesocket(spw->hSocket);
         WSACleanup();
     }
-    RingBuf_destroy(spw->udpBuffer);
+    RingBuf_destroy(spw->rxBuffer);
     if (spw->hPort != INVALID_HANDLE_VALUE)
         CloseHandle(spw->hPort);
     free(sp);
@@ -366,7 +371,7 @@ uint32_t uart_get_speed(const serial_port sp) {
 }
 
 int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uint32_t *pszRxLen) {
-    const serial_port_windows_t *spw = (serial_port_windows_t *)sp;
+    serial_port_windows_t *spw = (serial_port_windows_t *)sp;
     if (spw->hSocket == INVALID_SOCKET) {
         // serial port
         uart_reconfigure_timeouts_polling(sp);
@@ -388,36 +393,33 @@ int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uin
         fd_set rfds;
         struct timeval tv;
 
-        if (newtimeout_pending) {
-            timeout.tv_usec = newtimeout_value * 1000;
-            newtimeout_pending = false;
+        if (__atomic_exchange_n(&spw->newtimeout_pending, false, __ATOMIC_SEQ_CST)) {
+            spw->timeout.tv_usec = __atomic_load_n(&spw->newtimeout_value, __ATOMIC_SEQ_CST) * 1000;
+        }
+
+        // Whatever the OS has is read at once, the pieces of the next frames are then served from here
+        if (spw->rxBuffer == NULL) {
+            spw->rxBuffer = RingBuf_create(UART_RX_BUFFER_SIZE);
+            if (spw->rxBuffer == NULL) {
+                return PM3_EMALLOC;
+            }
         }
+
         // Reset the output count
         *pszRxLen = 0;
         do {
-            int res;
-            if (spw->udpBuffer != NULL) {
-                // for UDP connection, try to use the data from the buffer
-
-                byteCount = RingBuf_getAvailableSize(spw->udpBuffer);
-                // Cap the number of bytes, so we don't overrun the buffer
-                if (pszMaxRxLen - (*pszRxLen) < byteCount) {
-                    // PrintAndLogEx(ERR, "UART:: RX prevent overrun (have %u, need %u)", pszMaxRxLen - (*pszRxLen), byteCount);
-                    byteCount = pszMaxRxLen - (*pszRxLen);
-                }
-                res = RingBuf_dequeueBatch(spw->udpBuffer, pbtRx + (*pszRxLen), byteCount);
-                *pszRxLen += res;
+            int res = RingBuf_dequeueBatch(spw->rxBuffer, pbtRx + (*pszRxLen), pszMaxRxLen - (*pszRxLen));
+            *pszRxLen += res;
 
-                if (*pszRxLen == pszMaxRxLen) {
-                    // We have all the data we wanted.
-                    return PM3_SUCCESS;
-                }
+            if (*pszRxLen == pszMaxRxLen) {
+                // We have all the data we wanted.
+                return PM3_SUCCESS;
             }
 
             // Reset file descriptor
             FD_ZERO(&rfds);
             FD_SET(spw->hSocket, &rfds);
-            tv = timeout;
+            tv = spw->timeout;
             // the first argument nfds is ignored in Windows
             res = select(0, &rfds, NULL, NULL, &tv);
 
@@ -448,39 +450,35 @@ int uart_receive(const serial_port sp, uint8_t *pbtRx, uint32_t pszMaxRxLen, uin
                 // select() > 0 && byteCount > 0 ===> data available
                 // select() > 0 && byteCount always equals to 0 ===> maybe disconnected
                 // This happens when TCP connection is lost
-                rx_empty_counter++;
-                if (rx_empty_counter > 3) {
+                spw->rx_empty_counter++;
+                if (spw->rx_empty_counter > 3) {
                     return PM3_ENOTTY;
                 }
             } else {
-                rx_empty_counter = 0;
+                spw->rx_empty_counter = 0;
             }
 
-            // For UDP connection, put the incoming data into the buffer and handle them in the next round
-            if (spw->udpBuffer != NULL) {
-                if (RingBuf_getContinousAvailableSize(spw->udpBuffer) >= byteCount) {
-                    // write to the buffer directly
-                    res = recv(spw->hSocket, (char *)RingBuf_getRearPtr(spw->udpBuffer), RingBuf_getAvailableSize(spw->udpBuffer), 0);
-                    if (res >= 0) {
-                        RingBuf_postEnqueueBatch(spw->udpBuffer, res);
-                    }
-                } else {
-                    // use transit buffer
-                    uint8_t transitBuf[MAX(sizeof(PacketResponseNGRaw), sizeof(PacketResponseOLD)) * 30];
-                    res = recv(spw->hSocket, (char *)transitBuf, RingBuf_getAvailableSize(spw->udpBuffer), 0);
-                    RingBuf_enqueueBatch(spw->udpBuffer, transitBuf, res);
-                }
+            // The buffer is drained by now, so its whole storage is one continuous block
+            if (spw->udp) {
+                // a datagram goes in whole, handle it in the next round
+                res = recv(spw->hSocket, (char *)RingBuf_getRearPtr(spw->rxBuffer), RingBuf_getContinousAvailableSize(spw->rxBuffer), 0);
                 // Stop if the OS has some troubles reading the data
                 if (res < 0) {
                     return PM3_EIO;
                 }
+                RingBuf_postEnqueueBatch(spw->rxBuffer, res);
                 continue;
             }
 
-            // Cap the number of bytes, so we don't overrun the buffer
-            if (pszMaxRxLen - (*pszRxLen) < byteCount) {
-                //            PrintAndLogEx(ERR, "UART:: RX prevent overrun (have %u, need %u)", pszMaxRxLen - (*pszRxLen), byteCount);
-                byteCount = pszMaxRxLen - (*pszRxLen);
+            if (byteCount > pszMaxRxLen - (*pszRxLen)) {
+                // more than asked for, read all of it ahead and handle it in the next round
+                byteCount = MIN(byteCount, (uint32_t)RingBuf_getContinousAvailableSize(spw->rxBuffer));
+                res = recv(spw->hSocket, (char *)RingBuf_getRearPtr(spw->rxBuffer), byteCount, 0);
+                if (res <= 0) { // includes 0(gracefully closed) and -1(SOCKET_ERROR)
+                    return PM3_EIO;
+                }
+                RingBuf_postEnqueueBatch(spw->rxBuffer, res);
+                continue;
             }
 
             // There is something available, read the data
@@ -525,7 +523,7 @@ int uart_send(const serial_port sp, const uint8_t *p_tx, const uint32_t len) {
             // Reset file descriptor
             FD_ZERO(&wfds);
             FD_SET(spw->hSocket, &wfds);
-            tv = timeout;
+            tv = spw->timeout;
             // the first argument nfds is ignored in Windows
             int res = select(0, NULL, &wfds, NULL, &tv);
 
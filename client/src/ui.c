@@ -43,9 +43,10 @@
 #endif
 
 #include <time.h>
+#include <sched.h>    // sched_yield
 #include "emojis.h"
 #include "emojis_alt.h"
-session_arg_t g_session;
+#include "util_posix.h"   // msleep
 
 double g_CursorScaleFactor = 1;
 char g_CursorScaleFactorUnit[11] = {0};
@@ -59,9 +60,17 @@ static bool flushAfterWrite = false;
 double g_GridOffset = 0;
 bool g_GridLocked = false;
 
+// held while writing output, see log_drain()
 pthread_mutex_t g_print_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static void fPrintAndLog(FILE *stream, const char *fmt, ...);
+static void log_enqueue(FILE *stream, const char *text, uint8_t flags);
+
+#define LOGREC_PRINT        0x01    // to stdout / stderr
+#define LOGREC_LOG          0x02    // to the logfile
+#define LOGREC_LINEFEED     0x04
+#define LOGREC_INPLACE      0x08    // overwrites the current line
+#define LOGREC_COLORS       0x10    // ansi colors are kept when printing
 
 #ifdef _WIN32
 #define MKDIR_CHK _mkdir(path)
@@ -355,12 +364,7 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
         if (level == INPLACE) {
             // ignore INPLACE if rest of output is grabbed
             if (!(g_printAndLog & PRINTANDLOG_GRAB)) {
-                char buffer3[sizeof(buffer2)] = {0};
-                char buffer4[sizeof(buffer2)] = {0};
-                memcpy_filter_ansi(buffer3, buffer2, sizeof(buffer2), !g_session.supports_colors);
-                memcpy_filter_emoji(buffer4, buffer3, sizeof(buffer3), g_session.emoji_mode);
-                fprintf(stream, "\r%s", buffer4);
-                fflush(stream);
+                log_enqueue(stream, buffer2, LOGREC_PRINT | LOGREC_INPLACE);
             }
         } else {
             fPrintAndLog(stream, "%s", buffer2);
@@ -368,21 +372,123 @@ void PrintAndLogEx(logLevel_t level, const char *fmt, ...) {
     }
 }
 
-static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
-    va_list argptr;
+//-----------------------------------------------------------------------------
+// Asynchronous output
+//
+// PrintAndLogEx formats in the calling thread and queues the result in a ring
+// of its own, no lock taken. A writer thread drains the rings in the order the
+// lines were queued, filters them and writes stdout and the logfile in batches.
+// PrintAndLogFlush() drains them right away, call it at command boundaries and
+// before writing to stdout directly.
+//-----------------------------------------------------------------------------
+
+// per thread, a power of 2
+#define LOG_RING_SIZE       (64 * 1024)
+#define LOG_ALIGN(x)        (((x) + 7) & ~(size_t)7)
+// record length of the marker at the end of the ring, the next record is at its start
+#define LOG_WRAP            UINT32_MAX
+
+typedef struct {
+    uint32_t len;           // text bytes which follow
+    uint8_t flags;          // LOGREC_*
+    uint8_t emoji_mode;
+    bool to_stderr;
+    uint64_t seq;           // order across the rings
+} log_record_t;
+
+typedef struct log_ring_s {
+    uint8_t buf[LOG_RING_SIZE];
+    uint64_t head;          // bytes queued so far, written by the owning thread
+    uint64_t tail;          // bytes drained so far, written under g_print_lock
+    bool orphaned;          // the thread is gone, freed once drained
+    struct log_ring_s *next;
+} log_ring_t;
+
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_key_t log_ring_key;
+static __thread log_ring_t *log_ring = NULL;
+// synchronous output, until the writer thread runs and again once the client exits
+static bool log_async = false;
+static uint64_t log_seq = 0;
+// next seq to write, under g_print_lock
+static uint64_t log_next_seq = 0;
+
+// list of all rings, they are added by their threads and removed when draining
+static log_ring_t *log_rings = NULL;
+static pthread_mutex_t log_rings_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// under log_wake_lock
+static bool log_writer_idle = false;
+static pthread_mutex_t log_wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_wake_cond = PTHREAD_COND_INITIALIZER;
+
+static void log_ring_release(void *ring) {
+    __atomic_store_n(&((log_ring_t *)ring)->orphaned, true, __ATOMIC_SEQ_CST);
+}
+
+static bool log_pending(void) {
+    bool pending = false;
+    pthread_mutex_lock(&log_rings_lock);
+    for (log_ring_t *r = log_rings; r != NULL && pending == false; r = r->next) {
+        pending = (__atomic_load_n(&r->head, __ATOMIC_ACQUIRE) != r->tail);
+    }
+    pthread_mutex_unlock(&log_rings_lock);
+    return pending;
+}
+
+static void log_wake_writer(void) {
+    pthread_mutex_lock(&log_wake_lock);
+    if (log_writer_idle) {
+        pthread_cond_signal(&log_wake_cond);
+    }
+    pthread_mutex_unlock(&log_wake_lock);
+}
+
+// Filters and writes one record, call with g_print_lock held
+static void log_write(const log_record_t *rec, const char *text) {
     static FILE *logfile = NULL;
     static int logging = 1;
-    char buffer[MAX_PRINT_BUFFER] = {0};
-    char buffer2[MAX_PRINT_BUFFER] = {0};
-    char buffer3[MAX_PRINT_BUFFER] = {0};
+    static char buffer[MAX_PRINT_BUFFER];
+    static char buffer2[MAX_PRINT_BUFFER];
 
-    bool linefeed = true;
+    // end of a batch
+    if (text == NULL) {
+        if (logfile != NULL) {
+            fflush(logfile);
+        }
+        return;
+    }
+
+    size_t n = MIN(rec->len, sizeof(buffer) - 1);
+    memcpy(buffer, text, n);
+    memset(buffer + n, 0, sizeof(buffer) - n);
+
+    bool linefeed = (rec->flags & LOGREC_LINEFEED);
+    FILE *stream = (rec->to_stderr) ? stderr : stdout;
 
-    if (logging && g_session.incognito) {
-        logging = 0;
+    if (rec->flags & LOGREC_PRINT) {
+        memcpy_filter_ansi(buffer2, buffer, sizeof(buffer), (rec->flags & LOGREC_COLORS) == 0);
+        memcpy_filter_emoji(buffer, buffer2, sizeof(buffer2), rec->emoji_mode);
+        if (rec->flags & LOGREC_INPLACE) {
+            fprintf(stream, "\r%s", buffer);
+            fflush(stream);
+            return;
+        }
+        fprintf(stream, "%s", buffer);
+        if (linefeed) {
+            fprintf(stream, "\n");
+        }
+        if (rec->flags & LOGREC_LOG) {
+            memcpy(buffer, text, n);
+            memset(buffer + n, 0, sizeof(buffer) - n);
+        }
     }
 
-    if ((g_printAndLog & PRINTANDLOG_LOG) && logging && !logfile) {
+    if ((rec->flags & LOGREC_LOG) == 0 || logging == 0) {
+        return;
+    }
+
+    if (logfile == NULL) {
         char *my_logfile_path = NULL;
         char filename[40];
         struct tm *timenow;
@@ -391,64 +497,119 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
         strftime(filename, sizeof(filename), PROXLOG, timenow);
 
         if (searchHomeFilePath(&my_logfile_path, LOGS_SUBDIR, filename, true) != PM3_SUCCESS) {
-
             printf(_YELLOW_("[-]") " Logging disabled!\n");
-            my_logfile_path = NULL;
             logging = 0;
+            return;
+        }
 
-        } else {
-
-            logfile = fopen(my_logfile_path, "a");
-            if (logfile == NULL) {
-                printf(_YELLOW_("[-]") " Can't open logfile %s, logging disabled!\n", my_logfile_path);
-                logging = 0;
-            } else {
-
-                if (g_session.supports_colors) {
-                    printf("["_YELLOW_("=")"] Session log " _YELLOW_("%s") "\n", my_logfile_path);
-                } else {
-                    printf("[=] Session log %s\n", my_logfile_path);
-                }
-
-            }
+        logfile = fopen(my_logfile_path, "a");
+        if (logfile == NULL) {
+            printf(_YELLOW_("[-]") " Can't open logfile %s, logging disabled!\n", my_logfile_path);
+            logging = 0;
             free(my_logfile_path);
+            return;
+        }
+
+        if (rec->flags & LOGREC_COLORS) {
+            printf("["_YELLOW_("=")"] Session log " _YELLOW_("%s") "\n", my_logfile_path);
+        } else {
+            printf("[=] Session log %s\n", my_logfile_path);
         }
+        free(my_logfile_path);
     }
 
-    // lock this section to avoid interlacing prints from different threads
-    pthread_mutex_lock(&g_print_lock);
+    memcpy_filter_emoji(buffer2, buffer, sizeof(buffer), EMO_ALTTEXT);
+    memcpy_filter_ansi(buffer, buffer2, sizeof(buffer2), true);
+    fprintf(logfile, "%s", buffer);
+    if (linefeed) {
+        fprintf(logfile, "\n");
+    }
+}
+
+// Writes everything queued so far, in order. Call with g_print_lock held.
+// Returns the number of records written
+static size_t log_drain(void) {
+    size_t count = 0;
 
 // If there is an incoming message from the hardware (eg: lf hid read) in
 // the background (while the prompt is displayed and accepting user input),
 // stash the prompt and bring it back later.
 #ifdef RL_STATE_READCMD
     // We are using GNU readline. libedit (OSX) doesn't support this flag.
-    int need_hack = (rl_readline_state & RL_STATE_READCMD) > 0;
+    int need_hack = 0;
     char *saved_line = NULL;
+#endif
 
-    if (need_hack) {
-        saved_line = rl_copy_text(0, rl_end);
-        rl_clear_visible_line();
-    }
+    pthread_mutex_lock(&log_rings_lock);
+    while (true) {
+
+        // the oldest record at the front of a ring
+        log_ring_t *oldest = NULL;
+        log_record_t rec = {0};
+        for (log_ring_t *r = log_rings; r != NULL; r = r->next) {
+            uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+            if (r->tail == head) {
+                continue;
+            }
+            uint32_t len;
+            memcpy(&len, r->buf + (r->tail & (LOG_RING_SIZE - 1)), sizeof(len));
+            if (len == LOG_WRAP) {
+                __atomic_store_n(&r->tail, (r->tail | (LOG_RING_SIZE - 1)) + 1, __ATOMIC_RELEASE);
+                if (r->tail == head) {
+                    continue;
+                }
+            }
+            log_record_t tmp;
+            memcpy(&tmp, r->buf + (r->tail & (LOG_RING_SIZE - 1)), sizeof(tmp));
+            if (oldest == NULL || tmp.seq < rec.seq) {
+                oldest = r;
+                rec = tmp;
+            }
+        }
+        if (oldest == NULL) {
+            break;
+        }
+        // a thread took an earlier seq but hasn't queued its record yet,
+        // it is a couple of memcpy away so wait for it rather than write out of order
+        if (rec.seq > log_next_seq) {
+            pthread_mutex_unlock(&log_rings_lock);
+            sched_yield();
+            pthread_mutex_lock(&log_rings_lock);
+            continue;
+        }
+
+#ifdef RL_STATE_READCMD
+        if (count == 0) {
+            need_hack = (rl_readline_state & RL_STATE_READCMD) > 0;
+            if (need_hack) {
+                saved_line = rl_copy_text(0, rl_end);
+                rl_clear_visible_line();
+            }
+        }
 #endif
-    va_start(argptr, fmt);
-    vsnprintf(buffer, sizeof(buffer), fmt, argptr);
-    va_end(argptr);
-    if (strlen(buffer) > 0 && buffer[strlen(buffer) - 1] == NOLF[0]) {
-        linefeed = false;
-        buffer[strlen(buffer) - 1] = 0;
+        log_write(&rec, (const char *)oldest->buf + (oldest->tail & (LOG_RING_SIZE - 1)) + sizeof(log_record_t));
+        __atomic_store_n(&oldest->tail, oldest->tail + LOG_ALIGN(sizeof(log_record_t) + rec.len), __ATOMIC_RELEASE);
+        log_next_seq = rec.seq + 1;
+        count++;
     }
 
-    bool filter_ansi = !g_session.supports_colors;
-    memcpy_filter_ansi(buffer2, buffer, sizeof(buffer), filter_ansi);
-
-    if ((g_printAndLog & PRINTANDLOG_PRINT) == PRINTANDLOG_PRINT) {
-        memcpy_filter_emoji(buffer3, buffer2, sizeof(buffer2), g_session.emoji_mode);
-        fprintf(stream, "%s", buffer3);
-        if (linefeed) {
-            fprintf(stream, "\n");
+    // rings of threads which are gone
+    log_ring_t **pr = &log_rings;
+    while (*pr != NULL) {
+        log_ring_t *r = *pr;
+        if (__atomic_load_n(&r->orphaned, __ATOMIC_SEQ_CST) && __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) == r->tail) {
+            *pr = r->next;
+            free(r);
+        } else {
+            pr = &r->next;
         }
-        fflush(stream);
+    }
+    pthread_mutex_unlock(&log_rings_lock);
+
+    if (count) {
+        log_write(NULL, NULL);
+        fflush(stdout);
+        fflush(stderr);
     }
 
 #ifdef RL_STATE_READCMD
@@ -459,50 +620,175 @@ static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
         free(saved_line);
     }
 #endif
+    return count;
+}
 
-    if (((g_printAndLog & PRINTANDLOG_LOG) && logging && logfile) ||
-            (g_printAndLog & PRINTANDLOG_GRAB)) {
+void PrintAndLogFlush(void) {
+    if (__atomic_load_n(&log_async, __ATOMIC_SEQ_CST) == false) {
+        return;
+    }
+    pthread_mutex_lock(&g_print_lock);
+    log_drain();
+    pthread_mutex_unlock(&g_print_lock);
+}
 
-        memcpy_filter_emoji(buffer3, buffer2, sizeof(buffer2), EMO_ALTTEXT);
+// at exit, whatever is queued and everything after that goes out right away
+static void log_stop(void) {
+    pthread_mutex_lock(&g_print_lock);
+    log_drain();
+    __atomic_store_n(&log_async, false, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&g_print_lock);
+}
 
-        if (filter_ansi == false) {
-            memcpy_filter_ansi(buffer, buffer3, sizeof(buffer3), true);
+static void *log_writer(void *arg) {
+    (void) arg;
+    while (true) {
+        pthread_mutex_lock(&g_print_lock);
+        size_t count = (__atomic_load_n(&log_async, __ATOMIC_SEQ_CST)) ? log_drain() : 0;
+        pthread_mutex_unlock(&g_print_lock);
+        if (count) {
+            continue;
+        }
+
+        pthread_mutex_lock(&log_wake_lock);
+        log_writer_idle = true;
+        if (log_pending() == false) {
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            ts.tv_nsec += 100 * 1000 * 1000;
+            if (ts.tv_nsec >= 1000 * 1000 * 1000) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000 * 1000 * 1000;
+            }
+            pthread_cond_timedwait(&log_wake_cond, &log_wake_lock, &ts);
         }
+        log_writer_idle = false;
+        pthread_mutex_unlock(&log_wake_lock);
     }
+    return NULL;
+}
 
-    if ((g_printAndLog & PRINTANDLOG_LOG) && logging && logfile) {
+static void log_start(void) {
+    if (pthread_key_create(&log_ring_key, log_ring_release) != 0) {
+        return;
+    }
+    pthread_t writer;
+    if (pthread_create(&writer, NULL, log_writer, NULL) != 0) {
+        return;
+    }
+    pthread_detach(writer);
+    atexit(log_stop);
+    __atomic_store_n(&log_async, true, __ATOMIC_SEQ_CST);
+}
 
-        if (filter_ansi) {
-            fprintf(logfile, "%s", buffer3);
-        } else {
-            fprintf(logfile, "%s", buffer);
+static log_ring_t *log_thread_ring(void) {
+    if (log_ring == NULL) {
+        log_ring = calloc(1, sizeof(log_ring_t));
+        if (log_ring == NULL) {
+            return NULL;
         }
+        pthread_setspecific(log_ring_key, log_ring);
+        pthread_mutex_lock(&log_rings_lock);
+        log_ring->next = log_rings;
+        log_rings = log_ring;
+        pthread_mutex_unlock(&log_rings_lock);
+    }
+    return log_ring;
+}
 
-        if (linefeed) {
-            fprintf(logfile, "\n");
-        }
-        fflush(logfile);
+static void log_enqueue(FILE *stream, const char *text, uint8_t flags) {
+
+    if (g_session.supports_colors) {
+        flags |= LOGREC_COLORS;
     }
 
-    if (g_printAndLog & PRINTANDLOG_GRAB) {
+    size_t len = MIN(strlen(text), MAX_PRINT_BUFFER - 1);
+    log_record_t rec = {
+        .len = len,
+        .flags = flags,
+        .emoji_mode = g_session.emoji_mode,
+        .to_stderr = (stream == stderr),
+    };
 
-        if (filter_ansi) {
-            fill_grabber(buffer3);
-        } else {
-            fill_grabber(buffer);
-        }
+    pthread_once(&log_once, log_start);
+    log_ring_t *ring = (__atomic_load_n(&log_async, __ATOMIC_SEQ_CST)) ? log_thread_ring() : NULL;
+    if (ring == NULL) {
+        pthread_mutex_lock(&g_print_lock);
+        log_drain();
+        log_write(&rec, text);
+        log_write(&rec, NULL);
+        fflush(stream);
+        pthread_mutex_unlock(&g_print_lock);
+        return;
+    }
 
-        if (linefeed) {
-            fill_grabber("\n");
+    size_t need = LOG_ALIGN(sizeof(log_record_t) + len);
+    size_t pos;
+    while (true) {
+        uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        pos = ring->head & (LOG_RING_SIZE - 1);
+        // a record doesn't wrap around, it starts over at the beginning of the ring
+        size_t skip = (LOG_RING_SIZE - pos < need) ? LOG_RING_SIZE - pos : 0;
+        if (LOG_RING_SIZE - (ring->head - tail) >= skip + need) {
+            if (skip) {
+                uint32_t wrap = LOG_WRAP;
+                memcpy(ring->buf + pos, &wrap, sizeof(wrap));
+                __atomic_store_n(&ring->head, ring->head + skip, __ATOMIC_RELEASE);
+                pos = 0;
+            }
+            break;
         }
+        // full, let the writer catch up
+        log_wake_writer();
+        msleep(1);
     }
 
+    rec.seq = __atomic_fetch_add(&log_seq, 1, __ATOMIC_SEQ_CST);
+    memcpy(ring->buf + pos, &rec, sizeof(rec));
+    memcpy(ring->buf + pos + sizeof(rec), text, len);
+    __atomic_store_n(&ring->head, ring->head + need, __ATOMIC_RELEASE);
+    log_wake_writer();
+
     if (flushAfterWrite) {
-        fflush(stdout);
+        PrintAndLogFlush();
     }
+}
 
-    //release lock
-    pthread_mutex_unlock(&g_print_lock);
+static void fPrintAndLog(FILE *stream, const char *fmt, ...) {
+    va_list argptr;
+    char buffer[MAX_PRINT_BUFFER] = {0};
+
+    va_start(argptr, fmt);
+    vsnprintf(buffer, sizeof(buffer), fmt, argptr);
+    va_end(argptr);
+
+    uint8_t flags = LOGREC_LINEFEED;
+    size_t len = strlen(buffer);
+    if (len > 0 && buffer[len - 1] == NOLF[0]) {
+        flags = 0;
+        buffer[len - 1] = 0;
+    }
+
+    if ((g_printAndLog & PRINTANDLOG_PRINT) == PRINTANDLOG_PRINT) {
+        flags |= LOGREC_PRINT;
+    }
+    if ((g_printAndLog & PRINTANDLOG_LOG) && g_session.incognito == false) {
+        flags |= LOGREC_LOG;
+    }
+    if (flags & (LOGREC_PRINT | LOGREC_LOG)) {
+        log_enqueue(stream, buffer, flags);
+    }
+
+    // grabbed output goes to the session of this thread, right away
+    if (g_printAndLog & PRINTANDLOG_GRAB) {
+        char buffer2[MAX_PRINT_BUFFER] = {0};
+        memcpy_filter_emoji(buffer2, buffer, sizeof(buffer), EMO_ALTTEXT);
+        memcpy_filter_ansi(buffer, buffer2, sizeof(buffer2), true);
+        fill_grabber(buffer);
+        if (flags & LOGREC_LINEFEED) {
+            fill_grabber("\n");
+        }
+    }
 }
 
 void SetFlushAfterWrite(bool value) {
@@ -757,6 +1043,8 @@ void print_progress(uint64_t count, uint64_t max, barMode_t style) {
         snprintf(cbar,  collen,  "%s", bar);
     }
 
+    // the bar is printed directly, anything queued goes first
+    PrintAndLogFlush();
     switch (style) {
         case STYLE_BAR: {
             printf("\b%c[2K\r[" _YELLOW_("=")"] %s", 27, cbar);
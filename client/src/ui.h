@@ -66,9 +66,16 @@ typedef struct {
     char *mqtt_server;
     char *mqtt_port;
     char *mqtt_topic;
+    // enable/disable printing/logging/grabbing, and what was grabbed
+    uint8_t print_and_log;
+    grabbed_output grabbed_output;
 } session_arg_t;
 
-extern session_arg_t g_session;
+// The session of the current device, see SetThreadDevice()
+session_arg_t *GetSession(void);
+#define g_session           (*GetSession())
+#define g_printAndLog       (g_session.print_and_log)
+#define g_grabbed_output    (g_session.grabbed_output)
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846264338327
@@ -78,6 +85,8 @@ extern session_arg_t g_session;
 #define PROMPT_CLEARLINE PrintAndLogEx(INPLACE, "                                          \r")
 void PrintAndLogOptions(const char *str[][2], size_t size, size_t space);
 void PrintAndLogEx(logLevel_t level, const char *fmt, ...);
+// writes out everything PrintAndLogEx queued so far
+void PrintAndLogFlush(void);
 void SetFlushAfterWrite(bool value);
 bool GetFlushAfterWrite(void);
 void memcpy_filter_ansi(void *dest, const void *src, size_t n, bool filter);
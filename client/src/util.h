@@ -30,7 +30,6 @@
 #endif
 
 extern uint8_t g_debugMode;
-extern uint8_t g_printAndLog;
 extern bool g_pendingPrompt;
 extern int g_numCPUs;
 
@@ -39,7 +38,6 @@ typedef struct {
     size_t size;
     size_t idx;
 } grabbed_output;
-extern grabbed_output g_grabbed_output;
 
 #define PRINTANDLOG_PRINT 1
 #define PRINTANDLOG_LOG   2
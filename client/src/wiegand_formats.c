@@ -17,7 +17,9 @@
 //-----------------------------------------------------------------------------
 #include "wiegand_formats.h"
 #include <stdlib.h>
+#include <pthread.h>
 #include "commonutil.h"
+#include "util.h"          // num_CPUs
 
 static bool step_parity_check(wiegand_message_t *packed, int start, int length, bool even_parity) {
     bool parity = even_parity;
@@ -1499,6 +1501,30 @@ static const cardformat_t FormatTable[] = {
     {NULL, NULL, NULL, NULL, 0, {0, 0, 0, 0, 0, 0, 0, 0, 0}} // Must null terminate array
 };
 
+// FormatTable indices by message length, in table order, built on first use
+static uint8_t s_by_len[ARRAYLEN(FormatTable)];
+static uint8_t s_by_len_first[256];
+static uint8_t s_by_len_count[256];
+static bool s_by_len_ready = false;
+
+static void hid_index_formats(void) {
+    if (s_by_len_ready) {
+        return;
+    }
+
+    uint8_t n = 0;
+    for (int len = 0; len < 256; len++) {
+        s_by_len_first[len] = n;
+        for (int i = 0; FormatTable[i].Name; i++) {
+            if (FormatTable[i].Bits == len) {
+                s_by_len[n++] = i;
+            }
+        }
+        s_by_len_count[len] = n - s_by_len_first[len];
+    }
+    s_by_len_ready = true;
+}
+
 void HIDListFormats(void) {
     if (FormatTable[0].Name == NULL)
         return;
@@ -1596,12 +1622,16 @@ bool HIDTryUnpack(wiegand_message_t *packed) {
         return false;
     }
 
+    hid_index_formats();
+
     wiegand_card_t card;
     memset(&card, 0, sizeof(wiegand_card_t));
     uint8_t found_cnt = 0, found_invalid_par = 0;
 
-    int i = 0;
-    while (FormatTable[i].Name) {
+    // only formats of the message length can unpack it
+    const uint8_t *idx = s_by_len + s_by_len_first[packed->Length];
+    for (uint8_t j = 0; j < s_by_len_count[packed->Length]; j++) {
+        int i = idx[j];
         if (FormatTable[i].Unpack(packed, &card)) {
 
             found_cnt++;
@@ -1611,7 +1641,6 @@ bool HIDTryUnpack(wiegand_message_t *packed) {
                 found_invalid_par++;
             }
         }
-        ++i;
     }
 
     if (found_cnt) {
@@ -1630,6 +1659,89 @@ bool HIDTryUnpack(wiegand_message_t *packed) {
     return ((found_cnt - found_invalid_par) > 0);
 }
 
+static void hid_unpack_one(const wiegand_message_t *packed, wiegand_result_t *res) {
+    memset(res, 0, sizeof(wiegand_result_t));
+    res->format_idx = -1;
+
+    wiegand_message_t msg = *packed;
+    wiegand_card_t card;
+    const uint8_t *idx = s_by_len + s_by_len_first[msg.Length];
+    for (uint8_t j = 0; j < s_by_len_count[msg.Length]; j++) {
+        int i = idx[j];
+        if (FormatTable[i].Unpack(&msg, &card) == false) {
+            continue;
+        }
+
+        res->matches++;
+        bool valid = (FormatTable[i].Fields.hasParity == false) || card.ParityValid;
+        if (valid) {
+            res->valid++;
+        }
+        // the first format with good parity, else the first one that unpacked
+        if (res->format_idx == -1 || (valid && res->valid == 1)) {
+            res->format_idx = i;
+            res->card = card;
+        }
+    }
+}
+
+typedef struct {
+    const wiegand_message_t *packed;
+    wiegand_result_t *results;
+    size_t n;
+} hid_batch_t;
+
+static void *hid_batch_thread(void *arg) {
+    hid_batch_t *b = (hid_batch_t *)arg;
+    for (size_t i = 0; i < b->n; i++) {
+        hid_unpack_one(b->packed + i, b->results + i);
+    }
+    return NULL;
+}
+
+int HIDTryUnpackBatch(const wiegand_message_t *packed, size_t n, wiegand_result_t *results, int threads) {
+    if (packed == NULL || results == NULL) {
+        return PM3_EINVARG;
+    }
+
+    hid_index_formats();
+
+    if (threads <= 0) {
+        threads = num_CPUs();
+    }
+    // not worth a thread for less
+    threads = MIN(threads, (int)(n / 4096) + 1);
+    threads = MAX(threads, 1);
+
+    pthread_t tids[threads];
+    hid_batch_t batch[threads];
+    size_t per = n / threads;
+    size_t at = 0;
+
+    for (int i = 0; i < threads; i++) {
+        batch[i].packed = packed + at;
+        batch[i].results = results + at;
+        batch[i].n = (i == threads - 1) ? n - at : per;
+        at += batch[i].n;
+    }
+
+    int started = 1;
+    for (; started < threads; started++) {
+        if (pthread_create(&tids[started], NULL, hid_batch_thread, &batch[started]) != 0) {
+            break;
+        }
+    }
+    hid_batch_thread(&batch[0]);
+    // what didn't get a thread is done here
+    for (int i = started; i < threads; i++) {
+        hid_batch_thread(&batch[i]);
+    }
+    for (int i = 1; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    return PM3_SUCCESS;
+}
+
 void HIDUnpack(int idx, wiegand_message_t *packed) {
     wiegand_card_t card;
     memset(&card, 0, sizeof(wiegand_card_t));
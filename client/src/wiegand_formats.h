@@ -52,12 +52,22 @@ typedef struct {
     cardformatdescriptor_t Fields;
 } cardformat_t;
 
+// outcome of unpacking one message, see HIDTryUnpackBatch
+typedef struct {
+    int format_idx;         // first format with good parity, else the first that unpacked, -1 for none
+    uint8_t matches;        // formats of the message length that unpacked it
+    uint8_t valid;          // ... with good parity, or without parity
+    wiegand_card_t card;    // as unpacked by format_idx
+} wiegand_result_t;
+
 bool validate_card_limit(int format_idx, wiegand_card_t *card);
 void HIDListFormats(void);
 int HIDFindCardFormat(const char *format);
 cardformat_t HIDGetCardFormat(int idx);
 bool HIDPack(int format_idx, wiegand_card_t *card, wiegand_message_t *packed, bool preamble);
 bool HIDTryUnpack(wiegand_message_t *packed);
+// unpacks n messages without printing, spread over threads (0 for one per CPU)
+int HIDTryUnpackBatch(const wiegand_message_t *packed, size_t n, wiegand_result_t *results, int threads);
 void HIDPackTryAll(wiegand_card_t *card, bool preamble);
 void HIDUnpack(int idx, wiegand_message_t *packed);
 bool decode_wiegand(uint32_t top, uint32_t mid, uint32_t bot, int n);
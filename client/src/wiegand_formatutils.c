@@ -78,19 +78,45 @@ static void message_datacopy(wiegand_message_t *src, wiegand_message_t *dest) {
     dest->Top = src->Top;
     dest->Length = src->Length;
 }
-/**
- *
- * Yes, this is horribly inefficient for linear data.
- * The current code is a temporary measure to have a working function in place
- * until all the bugs shaken from the block/chunk version of the code.
- *
- */
+// len bits starting at ordinal position low (0 is the lowest bit of Bot), len <= 64
+static uint64_t get_ordinal_bits(const wiegand_message_t *data, uint8_t low, uint8_t len) {
+    uint64_t lo = ((uint64_t)data->Mid << 32) | data->Bot;
+    uint64_t hi = data->Top;
+    uint64_t result;
+
+    if (low > 95)
+        return 0;
+    else if (low > 63)
+        result = hi >> (low - 64);
+    else if (low == 0)
+        result = lo;
+    else
+        result = (lo >> low) | (hi << (64 - low));
+
+    if (len < 64)
+        result &= (1ULL << len) - 1;
+    return result;
+}
+
 uint64_t get_linear_field(wiegand_message_t *data, uint8_t firstBit, uint8_t length) {
-    uint64_t result = 0;
-    for (uint8_t i = 0; i < length; i++) {
-        result = (result << 1) | get_bit_by_position(data, firstBit + i);
+    if (length > 64) {
+        // only the low 64 bits survive, like shifting the field in bit by bit
+        firstBit += length - 64;
+        length = 64;
     }
-    return result;
+    if (length == 0 || firstBit >= data->Length) {
+        return 0;
+    }
+
+    // bits past the end of the message read as 0
+    uint8_t past = 0;
+    if (firstBit + length > data->Length) {
+        past = firstBit + length - data->Length;
+    }
+    uint8_t inside = length - past;
+
+    uint64_t result = get_ordinal_bits(data, data->Length - firstBit - inside, inside);
+    return (past < 64) ? result << past : 0;
 }
 bool set_linear_field(wiegand_message_t *data, uint64_t value, uint8_t firstBit, uint8_t length) {
     wiegand_message_t tmpdata;
@@ -21,19 +21,16 @@
 #include <stdlib.h>
 #include "parity.h"
 
+#if !defined LOWMEM && !defined _MSC_VER
+#include <pthread.h>
+#endif
+
 
 #if !defined LOWMEM
-#define CONSTRUCTOR
 static uint8_t filterlut[0x100000];
 static uint8_t uc_evenparity32_lut[0x10E100A];
 
-// GUNC
-#if defined __GNUC__
-#undef CONSTRUCTOR
-#define CONSTRUCTOR __attribute__((constructor))
-#endif
-
-static void CONSTRUCTOR init_lut(void) {
+static void init_lut(void) {
 
     for (uint32_t i = 0; i < 1 << 20; ++i) {
         filterlut[i] = filter(i);
@@ -51,10 +48,22 @@ typedef void(__cdecl *PF)(void);
 #pragma section(".CRT$XCG", read)
 __declspec(allocate(".CRT$XCG")) PF f[] = { init_lut };
 
+#define ensure_lut()
+#else
+
+// Filling the tables takes longer than the whole rest of the client startup,
+// they are filled the first time a key recovery needs them instead.
+static pthread_once_t lut_once = PTHREAD_ONCE_INIT;
+
+static inline void ensure_lut(void) {
+    pthread_once(&lut_once, init_lut);
+}
 #endif
 
 #define filter(x) (filterlut[(x) & 0xfffff])
 #define even32(x) (uc_evenparity32_lut[(x)])
+#else
+#define ensure_lut()
 #endif
 
 /** update_contribution helper,
@@ -166,6 +175,8 @@ struct Crypto1State *lfsr_recovery32(uint32_t ks2, uint32_t in) {
     uint32_t *even_head = 0, *even_tail = 0, eks = 0;
     register int i;
 
+    ensure_lut();
+
     // split the keystream into an odd and even part
     for (i = 31; i >= 0; i -= 2)
         oks = oks << 1 | BEBIT(ks2, i);
@@ -262,6 +273,8 @@ struct Crypto1State *lfsr_recovery64(uint32_t ks2, uint32_t ks3) {
     uint32_t *tail, table[1 << 16];
     int i, j;
 
+    ensure_lut();
+
     sl = statelist = calloc(1, sizeof(struct Crypto1State) << 4);
     if (!sl)
         return 0;
@@ -326,7 +339,7 @@ continue2:
 /** lfsr_rollback_bit
  * Rollback the shift register in order to get previous states
  */
-uint8_t lfsr_rollback_bit(struct Crypto1State *s, uint32_t in, int fb) {
+static inline uint8_t rollback_bit(struct Crypto1State *s, uint32_t in, int fb) {
     int out;
     uint8_t ret;
     uint32_t t;
@@ -343,64 +356,70 @@ uint8_t lfsr_rollback_bit(struct Crypto1State *s, uint32_t in, int fb) {
     s->even |= (evenparity32(out)) << 23;
     return ret;
 }
+uint8_t lfsr_rollback_bit(struct Crypto1State *s, uint32_t in, int fb) {
+    ensure_lut();
+    return rollback_bit(s, in, fb);
+}
 /** lfsr_rollback_byte
  * Rollback the shift register in order to get previous states
  */
 uint8_t lfsr_rollback_byte(struct Crypto1State *s, uint32_t in, int fb) {
+    ensure_lut();
     uint8_t ret = 0;
-    ret |= lfsr_rollback_bit(s, BIT(in, 7), fb) << 7;
-    ret |= lfsr_rollback_bit(s, BIT(in, 6), fb) << 6;
-    ret |= lfsr_rollback_bit(s, BIT(in, 5), fb) << 5;
-    ret |= lfsr_rollback_bit(s, BIT(in, 4), fb) << 4;
-    ret |= lfsr_rollback_bit(s, BIT(in, 3), fb) << 3;
-    ret |= lfsr_rollback_bit(s, BIT(in, 2), fb) << 2;
-    ret |= lfsr_rollback_bit(s, BIT(in, 1), fb) << 1;
-    ret |= lfsr_rollback_bit(s, BIT(in, 0), fb) << 0;
+    ret |= rollback_bit(s, BIT(in, 7), fb) << 7;
+    ret |= rollback_bit(s, BIT(in, 6), fb) << 6;
+    ret |= rollback_bit(s, BIT(in, 5), fb) << 5;
+    ret |= rollback_bit(s, BIT(in, 4), fb) << 4;
+    ret |= rollback_bit(s, BIT(in, 3), fb) << 3;
+    ret |= rollback_bit(s, BIT(in, 2), fb) << 2;
+    ret |= rollback_bit(s, BIT(in, 1), fb) << 1;
+    ret |= rollback_bit(s, BIT(in, 0), fb) << 0;
     return ret;
 }
 /** lfsr_rollback_word
  * Rollback the shift register in order to get previous states
  */
 uint32_t lfsr_rollback_word(struct Crypto1State *s, uint32_t in, int fb) {
+    ensure_lut();
 
     uint32_t ret = 0;
     // note: xor args have been swapped because some compilers emit a warning
     // for 10^x and 2^x as possible misuses for exponentiation. No comment.
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 31), fb) << (24 ^ 31);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 30), fb) << (24 ^ 30);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 29), fb) << (24 ^ 29);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 28), fb) << (24 ^ 28);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 27), fb) << (24 ^ 27);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 26), fb) << (24 ^ 26);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 25), fb) << (24 ^ 25);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 24), fb) << (24 ^ 24);
-
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 23), fb) << (24 ^ 23);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 22), fb) << (24 ^ 22);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 21), fb) << (24 ^ 21);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 20), fb) << (24 ^ 20);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 19), fb) << (24 ^ 19);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 18), fb) << (24 ^ 18);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 17), fb) << (24 ^ 17);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 16), fb) << (24 ^ 16);
-
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 15), fb) << (24 ^ 15);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 14), fb) << (24 ^ 14);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 13), fb) << (24 ^ 13);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 12), fb) << (24 ^ 12);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 11), fb) << (24 ^ 11);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 10), fb) << (24 ^ 10);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 9), fb) << (24 ^ 9);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 8), fb) << (24 ^ 8);
-
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 7), fb) << (24 ^ 7);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 6), fb) << (24 ^ 6);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 5), fb) << (24 ^ 5);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 4), fb) << (24 ^ 4);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 3), fb) << (24 ^ 3);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 2), fb) << (24 ^ 2);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 1), fb) << (24 ^ 1);
-    ret |= lfsr_rollback_bit(s, BEBIT(in, 0), fb) << (24 ^ 0);
+    ret |= rollback_bit(s, BEBIT(in, 31), fb) << (24 ^ 31);
+    ret |= rollback_bit(s, BEBIT(in, 30), fb) << (24 ^ 30);
+    ret |= rollback_bit(s, BEBIT(in, 29), fb) << (24 ^ 29);
+    ret |= rollback_bit(s, BEBIT(in, 28), fb) << (24 ^ 28);
+    ret |= rollback_bit(s, BEBIT(in, 27), fb) << (24 ^ 27);
+    ret |= rollback_bit(s, BEBIT(in, 26), fb) << (24 ^ 26);
+    ret |= rollback_bit(s, BEBIT(in, 25), fb) << (24 ^ 25);
+    ret |= rollback_bit(s, BEBIT(in, 24), fb) << (24 ^ 24);
+
+    ret |= rollback_bit(s, BEBIT(in, 23), fb) << (24 ^ 23);
+    ret |= rollback_bit(s, BEBIT(in, 22), fb) << (24 ^ 22);
+    ret |= rollback_bit(s, BEBIT(in, 21), fb) << (24 ^ 21);
+    ret |= rollback_bit(s, BEBIT(in, 20), fb) << (24 ^ 20);
+    ret |= rollback_bit(s, BEBIT(in, 19), fb) << (24 ^ 19);
+    ret |= rollback_bit(s, BEBIT(in, 18), fb) << (24 ^ 18);
+    ret |= rollback_bit(s, BEBIT(in, 17), fb) << (24 ^ 17);
+    ret |= rollback_bit(s, BEBIT(in, 16), fb) << (24 ^ 16);
+
+    ret |= rollback_bit(s, BEBIT(in, 15), fb) << (24 ^ 15);
+    ret |= rollback_bit(s, BEBIT(in, 14), fb) << (24 ^ 14);
+    ret |= rollback_bit(s, BEBIT(in, 13), fb) << (24 ^ 13);
+    ret |= rollback_bit(s, BEBIT(in, 12), fb) << (24 ^ 12);
+    ret |= rollback_bit(s, BEBIT(in, 11), fb) << (24 ^ 11);
+    ret |= rollback_bit(s, BEBIT(in, 10), fb) << (24 ^ 10);
+    ret |= rollback_bit(s, BEBIT(in, 9), fb) << (24 ^ 9);
+    ret |= rollback_bit(s, BEBIT(in, 8), fb) << (24 ^ 8);
+
+    ret |= rollback_bit(s, BEBIT(in, 7), fb) << (24 ^ 7);
+    ret |= rollback_bit(s, BEBIT(in, 6), fb) << (24 ^ 6);
+    ret |= rollback_bit(s, BEBIT(in, 5), fb) << (24 ^ 5);
+    ret |= rollback_bit(s, BEBIT(in, 4), fb) << (24 ^ 4);
+    ret |= rollback_bit(s, BEBIT(in, 3), fb) << (24 ^ 3);
+    ret |= rollback_bit(s, BEBIT(in, 2), fb) << (24 ^ 2);
+    ret |= rollback_bit(s, BEBIT(in, 1), fb) << (24 ^ 1);
+    ret |= rollback_bit(s, BEBIT(in, 0), fb) << (24 ^ 0);
     return ret;
 }
 
@@ -454,6 +473,8 @@ static uint32_t fastfwd[2][8] = {
  * only correct iff [NR_3] ^ NR_3 does not depend on Nr_3
  */
 uint32_t *lfsr_prefix_ks(const uint8_t ks[8], int isodd) {
+    ensure_lut();
+
     uint32_t *candidates = calloc(4 << 10, sizeof(uint8_t));
     if (!candidates) return 0;
 
@@ -485,10 +506,10 @@ static struct Crypto1State *check_pfx_parity(uint32_t prefix, uint32_t rresp, ui
         sl->odd = odd ^ fastfwd[1][c];
         sl->even = even ^ fastfwd[0][c];
 
-        lfsr_rollback_bit(sl, 0, 0);
-        lfsr_rollback_bit(sl, 0, 0);
+        rollback_bit(sl, 0, 0);
+        rollback_bit(sl, 0, 0);
 
-        uint32_t ks3 = lfsr_rollback_bit(sl, 0, 0);
+        uint32_t ks3 = rollback_bit(sl, 0, 0);
         uint32_t ks2 = lfsr_rollback_word(sl, 0, 0);
         uint32_t ks1 = lfsr_rollback_word(sl, prefix | c << 5, 1);
 
@@ -0,0 +1,875 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) 2010, Flavio D. Garcia, Peter van Rossum, Roel Verdult
+// and Ronny Wichers Schreur. Radboud University Nijmegen
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// SecureMemory key recovery from one sniffed authentication
+//-----------------------------------------------------------------------------
+#include "sma_recover.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "cryptolib.h"
+
+#define SMA_MAX_THREADS        256
+
+// right state scan, 2^25 states in 512 items
+#define SMA_RIGHT_STATES       0x2000000ull
+#define SMA_RIGHT_ITEM_BITS    16
+// left state scan, 2^35 states in 2048 items
+#define SMA_LEFT_STATES        0x800000000ull
+#define SMA_LEFT_ITEM_BITS     24
+
+// right states with less correct bits are ignored
+#define SMA_RIGHT_MIN_BITS     90
+
+// meet-in-the-middle, 2^20 values for Gc bytes 0..3
+#define SMA_MATCHBOX_SIZE      0x100000
+
+// a candidate packs the cipher state in the low 40 bits,
+// and the 5 bit Gc inputs of bytes 4..7 above it
+#define SMA_CAND_STATE_MASK    0xffffffffffull
+#define SMA_CAND_GC_SHIFT(i)   (40 + (5 * ((i) - 4)))
+
+#define SMA_OVERLAP_KEYS       0x10000
+
+#define BIT_ROL_MASK     ((1 << 5) - 1)
+#define BIT_ROL(a)       ((((a) << 1) | ((a) >> 4)) & BIT_ROL_MASK)
+#define BIT_ROR(a)       (((a) >> 1) | (((a) & 1) << 4))
+
+typedef struct {
+    uint8_t addition;
+    uint8_t out;
+} lookup_entry;
+
+typedef struct {
+    uint64_t *a;
+    uint64_t *b;
+    size_t a_cap;
+    size_t b_cap;
+} sma_worker_t;
+
+typedef struct sma_ctx_s sma_ctx_t;
+
+// processes one work item, returns false when out of memory
+typedef bool (*sma_work_fn)(sma_ctx_t *c, sma_worker_t *w, uint64_t item);
+
+struct sma_ctx_s {
+    lookup_entry lookup_left[0x100000];
+    lookup_entry lookup_right[0x8000];
+    uint8_t left_addition[0x100000];
+    uint8_t lookup_left_subtraction[0x400];
+    uint8_t lookup_right_subtraction[0x400];
+
+    uint8_t Ci[8];
+    uint8_t Q[8];
+    uint8_t Ch[8];
+    uint8_t Ci_1[8];
+    uint8_t ks[16];
+    uint8_t mask[16];
+    uint64_t rstate_before_gc;
+    uint64_t lstate_before_gc;
+
+    // sorted (lstate << 20) | counter, for Gc bytes 0..3 of the left side
+    uint64_t *lmatch;
+
+    // right candidates for the current right state, Gc bytes grouped by overlap key
+    uint64_t *rgc;
+    uint32_t *rgc_start;
+
+    // (bits << 56) | state, sorted with the most correct bits first
+    uint64_t *rstates;
+    size_t rstates_len;
+    size_t rstates_cap;
+    uint64_t *lstates;
+    size_t lstates_len;
+    size_t lstates_cap;
+
+    uint8_t key[8];
+    bool key_found;
+
+    // scheduler
+    sma_options_t opts;
+    sma_progress_t progress;
+    sma_worker_t workers[SMA_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t item_done;
+    sma_work_fn work;
+    uint64_t next_item;
+    bool stop;
+    bool cancelled;
+    bool emalloc;
+};
+
+static inline uint8_t mod(uint8_t a, uint8_t m) {
+    if (m == 0) {
+        return 0; // Actually, divide by zero error
+    }
+
+    // Just return the input when this is less or equal than the modular value
+    if (a < m) return a;
+
+    // Compute the modular value
+    a %= m;
+
+    // Return the funny value, when the output was now zero, return the modular value
+    return (a == 0) ? m : a;
+}
+
+static void init_lookups(sma_ctx_t *c) {
+    for (int i = 0; i < 0x400; i++) {
+        uint8_t b6 = i & 0x1f;
+        uint8_t b3 = (i >> 5) & 0x1f;
+        int index = (b3 << 15) | b6;
+
+        b6 = BIT_ROL(b6);
+
+        uint8_t temp = mod(b3 + b6, 0x1f);
+        c->left_addition[index] = temp;
+        c->lookup_left[index].addition = temp;
+        c->lookup_left[index].out = ((temp ^ b3) & 0x0f);
+    }
+
+    for (int i = 0; i < 0x400; i++) {
+        uint8_t b18 = i & 0x1f;
+        uint8_t b16 = (i >> 5) & 0x1f;
+        int index = (b16 << 10) | b18;
+
+        uint8_t temp = mod(b18 + b16, 0x1f);
+        c->lookup_right[index].addition = temp;
+        c->lookup_right[index].out = ((temp ^ b16) & 0x0f);
+    }
+
+    for (int index = 0; index < 0x400 ; index++) {
+        uint8_t b3 = (index >> 5 & 0x1f);
+        uint8_t bx = (index & 0x1f);
+        c->lookup_left_subtraction[index] = BIT_ROR(mod((bx + 0x1F) - b3, 0x1F));
+    }
+
+    for (int index = 0; index < 0x400 ; index++) {
+        int b16 = (index >> 5);
+        uint8_t bx = (index & 0x1f);
+        c->lookup_right_subtraction[index] = mod((bx + 0x1F) - b16, 0x1F);
+    }
+}
+
+static inline uint8_t next_left_fast(const sma_ctx_t *c, uint8_t in, uint64_t *left) {
+    if (in)
+        *left ^= ((in & 0x1f) << 20);
+
+    const lookup_entry *lookup = &(c->lookup_left[((*left) & 0xf801f)]);
+    *left = (((*left) >> 5) | ((uint64_t)lookup->addition << 30));
+    return lookup->out;
+}
+
+static inline uint8_t next_right_fast(const sma_ctx_t *c, uint8_t in, uint64_t *right) {
+    if (in) *right ^= ((in & 0xf8) << 12);
+    const lookup_entry *lookup = &(c->lookup_right[((*right) & 0x7c1f)]);
+    *right = (((*right) >> 5) | (lookup->addition << 20));
+    return lookup->out;
+}
+
+// Roll the left register back one input, returns the number of previous states (0..2)
+static inline int previous_left(const sma_ctx_t *c, uint64_t l, uint8_t in, uint64_t *out) {
+    uint8_t bx = (uint8_t)((l >> 30) & 0x1f);
+    unsigned b3 = (unsigned)(l >> 5) & 0x3e0;
+    l = (l << 5);
+
+    // Ignore impossible states
+    if (bx == 0) {
+        if (b3 != 0) {
+            return 0;
+        }
+        // We only need to consider b6=0
+        l &= 0x7ffffffe0ull;
+        out[0] = l ^ (((uint64_t)in & 0x1f) << 20);
+        return 1;
+    }
+
+    uint8_t b6 = c->lookup_left_subtraction[b3 | bx];
+    l = (l & 0x7ffffffe0ull) | b6;
+    l ^= (((uint64_t)in & 0x1f) << 20);
+    out[0] = l;
+
+    // Check if we have a second candidate
+    if (b6 == 0x1f) {
+        out[1] = l & 0x7ffffffe0ull;
+        return 2;
+    }
+    return 1;
+}
+
+// Roll the right register back one input, returns the number of previous states (0..2)
+static inline int previous_right(const sma_ctx_t *c, uint64_t r, uint8_t in, uint64_t *out) {
+    uint8_t bx = (uint8_t)((r >> 20) & 0x1f);
+    unsigned b16 = (unsigned)(r & 0x3e0);
+
+    r = (r << 5);
+
+    // Ignore impossible states
+    if (bx == 0) {
+        if (b16 != 0) {
+            return 0;
+        }
+        // We only need to consider b18=0
+        r &= 0x1ffffe0ull;
+        out[0] = r ^ (((uint64_t)in & 0xf8) << 12);
+        return 1;
+    }
+
+    uint8_t b18 = c->lookup_right_subtraction[b16 | bx];
+    r = (r & 0x1ffffe0ull) | b18;
+    r ^= (((uint64_t)in & 0xf8) << 12);
+    out[0] = r;
+
+    // Check if we have a second candidate
+    if (b18 == 0x1f) {
+        out[1] = r & 0x1ffffe0ull;
+        return 2;
+    }
+    return 1;
+}
+
+static bool reserve(uint64_t **buf, size_t *cap, size_t len) {
+    if (len <= *cap) {
+        return true;
+    }
+
+    size_t ncap = (*cap) ? *cap : 1024;
+    while (ncap < len) {
+        ncap *= 2;
+    }
+
+    uint64_t *n = realloc(*buf, ncap * sizeof(uint64_t));
+    if (n == NULL) {
+        return false;
+    }
+    *buf = n;
+    *cap = ncap;
+    return true;
+}
+
+// Rolls the candidates in w->a back one step into w->b and swaps them.
+// gc_index < 4 rolls back the known Q byte `in`, otherwise all 32 Gc inputs are tried.
+static bool previous_step(const sma_ctx_t *c, sma_worker_t *w, size_t *len, bool right, int gc_index, uint8_t in) {
+    uint8_t inputs = (gc_index < 4) ? 1 : 0x20;
+
+    if (reserve(&w->b, &w->b_cap, (*len) * inputs * 2) == false) {
+        return false;
+    }
+
+    size_t n = 0;
+    for (uint8_t bt = 0; bt < inputs; bt++) {
+        uint64_t gc = 0;
+        if (gc_index >= 4) {
+            in = right ? (uint8_t)(bt << 3) : bt;
+            gc = (uint64_t)bt << SMA_CAND_GC_SHIFT(gc_index);
+        }
+
+        for (size_t i = 0; i < *len; i++) {
+            uint64_t cand = w->a[i];
+            uint64_t prev[2];
+            int cnt = right
+                      ? previous_right(c, cand & SMA_CAND_STATE_MASK, in, prev)
+                      : previous_left(c, cand & SMA_CAND_STATE_MASK, in, prev);
+            for (int j = 0; j < cnt; j++) {
+                w->b[n++] = prev[j] | (cand & ~SMA_CAND_STATE_MASK) | gc;
+            }
+        }
+    }
+
+    uint64_t *t = w->a;
+    size_t tcap = w->a_cap;
+    w->a = w->b;
+    w->a_cap = w->b_cap;
+    w->b = t;
+    w->b_cap = tcap;
+    *len = n;
+    return true;
+}
+
+// All states (with Gc bytes 4..7) that lead to `state` after Gc[4..7] and Q[6..7]
+static bool expand_gc_4_to_7(const sma_ctx_t *c, sma_worker_t *w, uint64_t state, bool right, size_t *len) {
+    if (reserve(&w->a, &w->a_cap, 1) == false) {
+        return false;
+    }
+    w->a[0] = state;
+    *len = 1;
+
+    return previous_step(c, w, len, right, 0, c->Q[7])
+           && previous_step(c, w, len, right, 7, 0)
+           && previous_step(c, w, len, right, 6, 0)
+           && previous_step(c, w, len, right, 0, c->Q[6])
+           && previous_step(c, w, len, right, 5, 0)
+           && previous_step(c, w, len, right, 4, 0);
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_u64_desc(const void *a, const void *b) {
+    return cmp_u64(b, a);
+}
+
+// first index in sorted `box` with (box[i] >> 20) >= state
+static size_t matchbox_find(const uint64_t *box, uint64_t state) {
+    size_t lo = 0;
+    size_t hi = SMA_MATCHBOX_SIZE;
+    uint64_t needle = state << 20;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (box[mid] < needle) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static inline uint16_t overlap_key(const uint8_t *gc) {
+    // left and right candidates share 2 bits (0x18) of every Gc byte
+    uint16_t key = 0;
+    for (int pos = 0; pos < 8; pos++) {
+        key = (key << 2) | ((gc[pos] >> 3) & 0x03);
+    }
+    return key;
+}
+
+static inline uint64_t bytes_to_u64(const uint8_t *b) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) {
+        v = (v << 8) | b[i];
+    }
+    return v;
+}
+
+static bool append_states(sma_ctx_t *c, uint64_t **buf, size_t *len, size_t *cap, const uint64_t *states, size_t n) {
+    bool ok = true;
+    pthread_mutex_lock(&c->lock);
+    if (reserve(buf, cap, *len + n)) {
+        memcpy(*buf + *len, states, n * sizeof(uint64_t));
+        *len += n;
+        c->progress.found = *len;
+    } else {
+        ok = false;
+    }
+    pthread_mutex_unlock(&c->lock);
+    return ok;
+}
+
+static bool right_scan_item(sma_ctx_t *c, sma_worker_t *w, uint64_t item) {
+    (void)w;
+    uint64_t found[64];
+    size_t nfound = 0;
+    uint32_t topbits = 0;
+
+    uint64_t first = item << SMA_RIGHT_ITEM_BITS;
+    uint64_t last = first + (1ull << SMA_RIGHT_ITEM_BITS);
+    for (uint64_t counter = first; counter < last; counter++) {
+        uint32_t bits = 0;
+        uint64_t rstate = counter;
+
+        for (uint8_t pos = 0; pos < 16; pos++) {
+            next_right_fast(c, 0, &rstate);
+            uint8_t bt = next_right_fast(c, 0, &rstate) << 4;
+            next_right_fast(c, 0, &rstate);
+            bt |= next_right_fast(c, 0, &rstate);
+
+            // xor the bits with the keystream, when a bit is xored away (=zero), it was the same, so correct ;)
+            bt ^= c->ks[pos];
+            bits += 8 - __builtin_popcount(bt);
+        }
+
+        if (bits > topbits) {
+            topbits = bits;
+        }
+
+        // Ignore states under 90, make sure the bits are used for ordering
+        if (bits >= SMA_RIGHT_MIN_BITS) {
+            found[nfound++] = (((uint64_t)bits) << 56) | counter;
+            if (nfound == (sizeof(found) / sizeof(found[0]))) {
+                if (append_states(c, &c->rstates, &c->rstates_len, &c->rstates_cap, found, nfound) == false) {
+                    return false;
+                }
+                nfound = 0;
+            }
+        }
+    }
+
+    pthread_mutex_lock(&c->lock);
+    if (topbits > c->progress.right_topbits) {
+        c->progress.right_topbits = topbits;
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    return append_states(c, &c->rstates, &c->rstates_len, &c->rstates_cap, found, nfound);
+}
+
+static bool left_scan_item(sma_ctx_t *c, sma_worker_t *w, uint64_t item) {
+    (void)w;
+    uint64_t found[64];
+    size_t nfound = 0;
+    const uint8_t *ks = c->ks;
+    const uint8_t *mask = c->mask;
+
+    uint64_t first = item << SMA_LEFT_ITEM_BITS;
+    uint64_t last = first + (1ull << SMA_LEFT_ITEM_BITS);
+    for (uint64_t counter = first; counter < last; counter++) {
+        uint64_t lstate = counter;
+        uint8_t correct_bits[16];
+        size_t pos;
+
+        for (pos = 0; pos < 16; pos++) {
+            const lookup_entry *lookup;
+            uint8_t bt;
+
+            lstate = (((lstate) >> 5) | ((uint64_t)c->left_addition[((lstate) & 0xf801f)] << 30));
+            lookup = &(c->lookup_left[((lstate) & 0xf801f)]);
+            lstate = (((lstate) >> 5) | ((uint64_t)lookup->addition << 30));
+            bt = lookup->out << 4;
+            lstate = (((lstate) >> 5) | ((uint64_t)c->left_addition[((lstate) & 0xf801f)] << 30));
+            lookup = &(c->lookup_left[((lstate) & 0xf801f)]);
+            lstate = (((lstate) >> 5) | ((uint64_t)lookup->addition << 30));
+            bt |= lookup->out;
+
+            // xor the bits with the keystream and count the "correct" bits
+            bt ^= ks[pos];
+
+            // When the REQUIRED bits are NOT xored away (=zero), ignore this wrong state
+            if ((bt & mask[pos]) != 0) break;
+
+            // Save the correct bits for statistical information
+            correct_bits[pos] = bt;
+        }
+
+        // If we have parsed all 16 bytes of keystream, we have a valid CANDIDATE!
+        if (pos == 16) {
+            uint32_t bits = 0;
+            for (pos = 0; pos < 16; pos++) {
+                bits += 8 - __builtin_popcount(correct_bits[pos]);
+            }
+            found[nfound++] = (((uint64_t)bits) << 56) | counter;
+            if (nfound == (sizeof(found) / sizeof(found[0]))) {
+                if (append_states(c, &c->lstates, &c->lstates_len, &c->lstates_cap, found, nfound) == false) {
+                    return false;
+                }
+                nfound = 0;
+            }
+        }
+    }
+
+    return append_states(c, &c->lstates, &c->lstates_len, &c->lstates_cap, found, nfound);
+}
+
+// Left meet-in-the-middle for one left state, every left candidate is joined
+// with the right candidates sharing its overlap bits and verified right away.
+static bool candidates_item(sma_ctx_t *c, sma_worker_t *w, uint64_t item) {
+    size_t len = 0;
+    uint64_t checked = 0;
+    uint64_t lstate = c->lstates[item] & SMA_CAND_STATE_MASK;
+
+    if (expand_gc_4_to_7(c, w, lstate, false, &len) == false) {
+        return false;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        uint64_t cand = w->a[i];
+        uint64_t l = cand & SMA_CAND_STATE_MASK;
+        uint8_t lgc[8];
+
+        for (int idx = 4; idx < 8; idx++) {
+            lgc[idx] = (cand >> SMA_CAND_GC_SHIFT(idx)) & 0x1f;
+        }
+
+        for (size_t m = matchbox_find(c->lmatch, l); (m < SMA_MATCHBOX_SIZE) && ((c->lmatch[m] >> 20) == l); m++) {
+            uint32_t counter = c->lmatch[m] & 0xfffff;
+            lgc[0] = (counter >> 15) & 0x1f;
+            lgc[1] = (counter >> 10) & 0x1f;
+            lgc[2] = (counter >>  5) & 0x1f;
+            lgc[3] = counter & 0x1f;
+
+            uint16_t key = overlap_key(lgc);
+            for (uint32_t r = c->rgc_start[key]; r < c->rgc_start[key + 1]; r++) {
+                uint8_t Gc[8];
+                uint8_t Ch_chk[8];
+                uint8_t Ci_1_chk[8];
+                crypto_state_t ls;
+
+                uint64_t rgc = c->rgc[r];
+                for (int pos = 0; pos < 8; pos++) {
+                    Gc[pos] = lgc[pos] | (uint8_t)(rgc >> (8 * (7 - pos)));
+                }
+                checked++;
+
+                sm_auth(Gc, c->Ci, c->Q, Ch_chk, Ci_1_chk, &ls);
+                if ((memcmp(Ch_chk, c->Ch, 8) == 0) && (memcmp(Ci_1_chk, c->Ci_1, 8) == 0)) {
+                    pthread_mutex_lock(&c->lock);
+                    memcpy(c->key, Gc, 8);
+                    c->key_found = true;
+                    c->stop = true;
+                    c->progress.found += checked;
+                    pthread_mutex_unlock(&c->lock);
+                    return true;
+                }
+            }
+        }
+    }
+
+    pthread_mutex_lock(&c->lock);
+    c->progress.found += checked;
+    pthread_mutex_unlock(&c->lock);
+    return true;
+}
+
+// Right meet-in-the-middle for the right state after Gc, runs once per right state
+static bool right_candidates(sma_ctx_t *c, uint64_t rstate_after_gc, uint64_t *count) {
+    uint64_t *box = malloc(SMA_MATCHBOX_SIZE * sizeof(uint64_t));
+    if (box == NULL) {
+        return false;
+    }
+
+    // Generate 2^20 different (5 bits) values for the first 4 Gc bytes (0,1,2,3)
+    for (uint64_t counter = 0; counter < SMA_MATCHBOX_SIZE; counter++) {
+        uint64_t rstate = c->rstate_before_gc;
+        next_right_fast(c, (counter >> 12) & 0xf8, &rstate);
+        next_right_fast(c, (counter >> 7)  & 0xf8, &rstate);
+        next_right_fast(c, c->Q[4], &rstate);
+        next_right_fast(c, (counter >> 2) & 0xf8, &rstate);
+        next_right_fast(c, (counter << 3) & 0xf8, &rstate);
+        next_right_fast(c, c->Q[5], &rstate);
+        box[counter] = (rstate << 20) | counter;
+    }
+    qsort(box, SMA_MATCHBOX_SIZE, sizeof(uint64_t), cmp_u64);
+
+    // Generate 2^20(+splitting) different (5 bits) values for the last 4 Gc bytes (4,5,6,7)
+    sma_worker_t *w = &c->workers[0];
+    size_t len = 0;
+    if (expand_gc_4_to_7(c, w, rstate_after_gc, true, &len) == false) {
+        free(box);
+        return false;
+    }
+
+    // Take the intersection of the corresponding states ~2^15 values (40-25 = 15 bits),
+    // two passes to group the Gc bytes by overlap key
+    memset(c->rgc_start, 0, (SMA_OVERLAP_KEYS + 1) * sizeof(uint32_t));
+    uint64_t n = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t i = 0; i < len; i++) {
+            uint64_t cand = w->a[i];
+            uint64_t r = cand & SMA_CAND_STATE_MASK;
+            uint8_t gc[8];
+
+            for (int idx = 4; idx < 8; idx++) {
+                gc[idx] = ((cand >> SMA_CAND_GC_SHIFT(idx)) & 0x1f) << 3;
+            }
+
+            for (size_t m = matchbox_find(box, r); (m < SMA_MATCHBOX_SIZE) && ((box[m] >> 20) == r); m++) {
+                uint32_t counter = box[m] & 0xfffff;
+                gc[0] = (counter >> 12) & 0xf8;
+                gc[1] = (counter >>  7) & 0xf8;
+                gc[2] = (counter >>  2) & 0xf8;
+                gc[3] = (counter <<  3) & 0xf8;
+
+                uint16_t key = overlap_key(gc);
+                if (pass == 0) {
+                    c->rgc_start[key + 1]++;
+                    n++;
+                } else {
+                    c->rgc[c->rgc_start[key]++] = bytes_to_u64(gc);
+                }
+            }
+        }
+
+        if (pass == 0) {
+            uint64_t *rgc = realloc(c->rgc, (n ? n : 1) * sizeof(uint64_t));
+            if (rgc == NULL) {
+                free(box);
+                return false;
+            }
+            c->rgc = rgc;
+            for (uint32_t k = 0; k < SMA_OVERLAP_KEYS; k++) {
+                c->rgc_start[k + 1] += c->rgc_start[k];
+            }
+        }
+    }
+
+    // the second pass moved every start to the next group, shift them back
+    memmove(c->rgc_start + 1, c->rgc_start, SMA_OVERLAP_KEYS * sizeof(uint32_t));
+    c->rgc_start[0] = 0;
+
+    free(box);
+    *count = n;
+    return true;
+}
+
+static void left_mask(const sma_ctx_t *c, uint64_t rstate, uint8_t *mask) {
+    for (uint8_t pos = 0; pos < 16; pos++) {
+        next_right_fast(c, 0, &rstate);
+        uint8_t bt = next_right_fast(c, 0, &rstate) << 4;
+        next_right_fast(c, 0, &rstate);
+        bt |= next_right_fast(c, 0, &rstate);
+
+        // Save the mask for the left produced bits
+        mask[pos] = bt ^ c->ks[pos];
+    }
+}
+
+static bool report(sma_ctx_t *c) {
+    if (c->opts.progress == NULL) {
+        return true;
+    }
+
+    pthread_mutex_lock(&c->lock);
+    sma_progress_t p = c->progress;
+    pthread_mutex_unlock(&c->lock);
+
+    if (c->opts.progress(&p, c->opts.progress_ctx)) {
+        return true;
+    }
+
+    pthread_mutex_lock(&c->lock);
+    c->cancelled = true;
+    c->stop = true;
+    pthread_mutex_unlock(&c->lock);
+    return false;
+}
+
+typedef struct {
+    sma_ctx_t *c;
+    sma_worker_t *w;
+} sma_thread_arg_t;
+
+static void *sma_thread(void *arg) {
+    sma_thread_arg_t *t = (sma_thread_arg_t *)arg;
+    sma_ctx_t *c = t->c;
+
+    pthread_mutex_lock(&c->lock);
+    while ((c->stop == false) && (c->next_item < c->progress.total)) {
+        uint64_t item = c->next_item++;
+        pthread_mutex_unlock(&c->lock);
+
+        bool ok = c->work(c, t->w, item);
+
+        pthread_mutex_lock(&c->lock);
+        if (ok == false) {
+            c->emalloc = true;
+            c->stop = true;
+        }
+        c->progress.done++;
+        pthread_cond_signal(&c->item_done);
+    }
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+}
+
+// Runs `items` work items, idle threads pull the next one.  Progress is
+// reported while running, the caller reports the completed stage.
+// Returns false when the stage was stopped (key found, cancelled or out of memory).
+static bool run_stage(sma_ctx_t *c, sma_stage_t stage, uint64_t items, sma_work_fn work) {
+    c->work = work;
+    c->next_item = 0;
+    c->progress.stage = stage;
+    c->progress.done = 0;
+    c->progress.total = items;
+    c->progress.found = 0;
+
+    if (report(c) == false) {
+        return false;
+    }
+
+    uint32_t threads = c->opts.threads;
+    if (threads > SMA_MAX_THREADS) {
+        threads = SMA_MAX_THREADS;
+    }
+
+    pthread_t tids[SMA_MAX_THREADS];
+    sma_thread_arg_t args[SMA_MAX_THREADS];
+    uint32_t started = 0;
+    if (threads > 1) {
+        for (uint32_t i = 0; i < threads; i++) {
+            args[started].c = c;
+            args[started].w = &c->workers[started];
+            if (pthread_create(&tids[started], NULL, sma_thread, &args[started]) == 0) {
+                started++;
+            }
+        }
+    }
+
+    if (started == 0) {
+        // single threaded, on the calling thread
+        while ((c->stop == false) && (c->next_item < items)) {
+            if (work(c, &c->workers[0], c->next_item++) == false) {
+                c->emalloc = true;
+                c->stop = true;
+            }
+            c->progress.done++;
+            if (c->progress.done < items) {
+                report(c);
+            }
+        }
+        return (c->stop == false);
+    }
+
+    // callbacks are only ever invoked from the calling thread
+    uint64_t reported = 0;
+    pthread_mutex_lock(&c->lock);
+    while ((c->stop == false) && (c->progress.done < items)) {
+        while ((c->stop == false) && (c->progress.done == reported)) {
+            pthread_cond_wait(&c->item_done, &c->lock);
+        }
+        reported = c->progress.done;
+        if (reported < items) {
+            pthread_mutex_unlock(&c->lock);
+            report(c);
+            pthread_mutex_lock(&c->lock);
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(tids[i], NULL);
+    }
+    return (c->stop == false);
+}
+
+static void free_ctx(sma_ctx_t *c) {
+    for (int i = 0; i < SMA_MAX_THREADS; i++) {
+        free(c->workers[i].a);
+        free(c->workers[i].b);
+    }
+    free(c->lmatch);
+    free(c->rgc);
+    free(c->rgc_start);
+    free(c->rstates);
+    free(c->lstates);
+    pthread_cond_destroy(&c->item_done);
+    pthread_mutex_destroy(&c->lock);
+    free(c);
+}
+
+sma_result_t sma_recover(const uint8_t *Ci, const uint8_t *Q, const uint8_t *Ch, const uint8_t *Ci_1,
+                         const sma_options_t *opts, uint8_t *Gc) {
+
+    sma_ctx_t *c = calloc(1, sizeof(sma_ctx_t));
+    if (c == NULL) {
+        return SMA_EMALLOC;
+    }
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->item_done, NULL);
+
+    if (opts) {
+        c->opts = *opts;
+    }
+
+    memcpy(c->Ci, Ci, 8);
+    memcpy(c->Q, Q, 8);
+    memcpy(c->Ch, Ch, 8);
+    memcpy(c->Ci_1, Ci_1, 8);
+    for (int pos = 0; pos < 8; pos++) {
+        c->ks[2 * pos] = Ci_1[pos];
+        c->ks[(2 * pos) + 1] = Ch[pos];
+    }
+
+    init_lookups(c);
+
+    // Load in the ci (tag-nonce), together with the first half of Q (reader-nonce)
+    for (int pos = 0; pos < 4; pos++) {
+        next_right_fast(c, Ci[2 * pos], &c->rstate_before_gc);
+        next_right_fast(c, Ci[2 * pos + 1], &c->rstate_before_gc);
+        next_right_fast(c, Q[pos], &c->rstate_before_gc);
+
+        next_left_fast(c, Ci[2 * pos], &c->lstate_before_gc);
+        next_left_fast(c, Ci[2 * pos + 1], &c->lstate_before_gc);
+        next_left_fast(c, Q[pos], &c->lstate_before_gc);
+    }
+
+    c->lmatch = malloc(SMA_MATCHBOX_SIZE * sizeof(uint64_t));
+    c->rgc_start = malloc((SMA_OVERLAP_KEYS + 1) * sizeof(uint32_t));
+    if ((c->lmatch == NULL) || (c->rgc_start == NULL)) {
+        free_ctx(c);
+        return SMA_EMALLOC;
+    }
+
+    // Generate 2^20 different (5 bits) values for the first 4 left Gc bytes (0,1,2,3),
+    // they do not depend on the right state
+    for (uint64_t counter = 0; counter < SMA_MATCHBOX_SIZE; counter++) {
+        uint64_t lstate = c->lstate_before_gc;
+        next_left_fast(c, (counter >> 15) & 0x1f, &lstate);
+        next_left_fast(c, (counter >> 10) & 0x1f, &lstate);
+        next_left_fast(c, Q[4], &lstate);
+        next_left_fast(c, (counter >> 5) & 0x1f, &lstate);
+        next_left_fast(c, counter & 0x1f, &lstate);
+        next_left_fast(c, Q[5], &lstate);
+        c->lmatch[counter] = (lstate << 20) | counter;
+    }
+    qsort(c->lmatch, SMA_MATCHBOX_SIZE, sizeof(uint64_t), cmp_u64);
+
+    // Determine the right states that correspond to the keystream, best first
+    if (run_stage(c, SMA_STAGE_RIGHT, SMA_RIGHT_STATES >> SMA_RIGHT_ITEM_BITS, right_scan_item)) {
+        qsort(c->rstates, c->rstates_len, sizeof(uint64_t), cmp_u64_desc);
+        c->progress.right_count = (uint32_t)c->rstates_len;
+        report(c);
+    }
+
+    for (size_t ri = 0; (c->stop == false) && (ri < c->rstates_len); ri++) {
+        uint64_t rstate_after_gc = c->rstates[ri] & SMA_CAND_STATE_MASK;
+
+        c->progress.right_index = (uint32_t)ri;
+        c->progress.right_state = rstate_after_gc;
+        c->progress.right_candidates = 0;
+
+        if (right_candidates(c, rstate_after_gc, &c->progress.right_candidates) == false) {
+            c->emalloc = true;
+            break;
+        }
+        if (c->progress.right_candidates == 0) {
+            continue;
+        }
+
+        // Calculate left states using the (unknown bits) mask from the right state
+        left_mask(c, rstate_after_gc, c->mask);
+        c->lstates_len = 0;
+        if (run_stage(c, SMA_STAGE_LEFT, SMA_LEFT_STATES >> SMA_LEFT_ITEM_BITS, left_scan_item) == false) {
+            break;
+        }
+        qsort(c->lstates, c->lstates_len, sizeof(uint64_t), cmp_u64_desc);
+        report(c);
+
+        if (c->lstates_len == 0) {
+            continue;
+        }
+
+        run_stage(c, SMA_STAGE_CANDIDATES, c->lstates_len, candidates_item);
+        report(c);
+    }
+
+    sma_result_t res = SMA_KEY_NOT_FOUND;
+    if (c->key_found) {
+        memcpy(Gc, c->key, 8);
+        res = SMA_KEY_FOUND;
+    } else if (c->cancelled) {
+        res = SMA_CANCELLED;
+    } else if (c->emalloc) {
+        res = SMA_EMALLOC;
+    }
+
+    free_ctx(c);
+    return res;
+}
@@ -0,0 +1,80 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) 2010, Flavio D. Garcia, Peter van Rossum, Roel Verdult
+// and Ronny Wichers Schreur. Radboud University Nijmegen
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// SecureMemory key recovery from one sniffed authentication
+//
+// Used by tools/cryptorf/sma_multi and `hf cryptorf recover`.
+// Every stage is split into small work items that idle threads pull from a
+// shared counter, so no thread is left with a larger share than the others.
+// Left and right candidates are joined and verified as they are produced,
+// memory use is about 32 MB per thread whatever the trace.
+//-----------------------------------------------------------------------------
+
+#ifndef _SMA_RECOVER_H_
+#define _SMA_RECOVER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    SMA_STAGE_RIGHT = 0,   // right state scan, once
+    SMA_STAGE_LEFT,        // left state scan, for each right state
+    SMA_STAGE_CANDIDATES,  // left meet-in-the-middle, join and verify, for each right state
+} sma_stage_t;
+
+typedef struct {
+    sma_stage_t stage;
+    uint64_t done;            // work items done in this stage
+    uint64_t total;           // work items in this stage
+    uint64_t found;           // states (RIGHT, LEFT) or checked keys (CANDIDATES) so far
+    uint32_t right_index;     // right state in use, LEFT and CANDIDATES stages
+    uint32_t right_count;     // number of right states
+    uint64_t right_state;
+    uint32_t right_topbits;   // correct bits of the best right state
+    uint64_t right_candidates;// right meet-in-the-middle candidates for this right state
+} sma_progress_t;
+
+// Called from the thread that called sma_recover(), with done == 0 when a stage
+// starts and done == total when it is complete.  Return false to cancel.
+typedef bool (*sma_progress_fn)(const sma_progress_t *p, void *ctx);
+
+typedef struct {
+    uint32_t threads;         // 0 or 1 runs on the calling thread
+    sma_progress_fn progress; // optional
+    void *progress_ctx;
+} sma_options_t;
+
+typedef enum {
+    SMA_KEY_FOUND = 0,
+    SMA_KEY_NOT_FOUND,
+    SMA_CANCELLED,
+    SMA_EMALLOC,
+} sma_result_t;
+
+// Ci: card nonce, Q: reader nonce, Ch: reader challenge, Ci_1: card answer.
+// On SMA_KEY_FOUND, Gc holds the 8 byte secret seed.
+sma_result_t sma_recover(const uint8_t *Ci, const uint8_t *Q, const uint8_t *Ch, const uint8_t *Ci_1,
+                         const sma_options_t *opts, uint8_t *Gc);
+
+#ifdef __cplusplus
+}
+#endif
+#endif // _SMA_RECOVER_H_
@@ -49,6 +49,7 @@
 #include "parity.h"  // for parity test
 #include "pm3_cmd.h" // error codes
 #include "commonutil.h"  // Arraylen
+#include "lfdemod_simd.h"
 
 // **********************************************************************************************
 // ---------------------------------Utilities Section--------------------------------------------
@@ -93,11 +94,15 @@ static void printSignal(void) {
 }
 
 #ifndef ON_DEVICE
-static int cmp_uint8(const void *a, const void *b) {
-    if (*(const uint8_t *)a < * (const uint8_t *)b)
-        return -1;
-    else
-        return *(const uint8_t *)a > *(const uint8_t *)b;
+// k-th smallest sample, counting from zero
+static uint8_t histNth(const uint32_t *hist, uint32_t k) {
+    uint32_t cnt = 0;
+    for (int v = 0; v < 256; v++) {
+        cnt += hist[v];
+        if (cnt > k)
+            return v;
+    }
+    return 255;
 }
 #endif
 
@@ -110,23 +115,25 @@ void computeSignalProperties(const uint8_t *samples, uint32_t size) {
     uint32_t offset_size = size - SIGNAL_IGNORE_FIRST_SAMPLES;
 
 #ifndef ON_DEVICE
-    uint8_t tmp[offset_size];
-    memcpy(tmp, samples + SIGNAL_IGNORE_FIRST_SAMPLES, sizeof(tmp));
-    qsort(tmp, sizeof(tmp), sizeof(uint8_t), cmp_uint8);
+    // percentiles, extremes and the trimmed mean all come from the histogram
+    uint32_t hist[256];
+    lfsimd_histogram(samples + SIGNAL_IGNORE_FIRST_SAMPLES, offset_size, hist);
 
-    uint8_t low10 = 0.5 * (tmp[(int)(offset_size * 0.1)] + tmp[(int)((offset_size - 1) * 0.1)]);
-    uint8_t hi90 =  0.5 * (tmp[(int)(offset_size * 0.9)] + tmp[(int)((offset_size - 1) * 0.9)]);
+    uint8_t low10 = 0.5 * (histNth(hist, offset_size * 0.1) + histNth(hist, (offset_size - 1) * 0.1));
+    uint8_t hi90 =  0.5 * (histNth(hist, offset_size * 0.9) + histNth(hist, (offset_size - 1) * 0.9));
     uint32_t cnt = 0;
-    for (uint32_t i = SIGNAL_IGNORE_FIRST_SAMPLES; i < size; i++) {
+    for (int v = 0; v < 256; v++) {
+        if (hist[v] == 0)
+            continue;
 
-        if (samples[i] < signalprop.low) signalprop.low = samples[i];
-        if (samples[i] > signalprop.high) signalprop.high = samples[i];
+        if (v < signalprop.low) signalprop.low = v;
+        if (v > signalprop.high) signalprop.high = v;
 
-        if (samples[i] < low10 || samples[i] > hi90)
+        if (v < low10 || v > hi90)
             continue;
 
-        sum += samples[i];
-        cnt++;
+        sum += v * hist[v];
+        cnt += hist[v];
     }
     if (cnt > 0)
         signalprop.mean = sum / cnt;
@@ -161,20 +168,15 @@ void removeSignalOffset(uint8_t *samples, uint32_t size) {
 
 #ifndef ON_DEVICE
 
-    uint8_t tmp[offset_size];
-    memcpy(tmp, samples + SIGNAL_IGNORE_FIRST_SAMPLES, sizeof(tmp));
-    qsort(tmp, sizeof(tmp), sizeof(uint8_t), cmp_uint8);
+    uint32_t hist[256];
+    lfsimd_histogram(samples + SIGNAL_IGNORE_FIRST_SAMPLES, offset_size, hist);
 
-    uint8_t low10 = 0.5 * (tmp[(int)(offset_size * 0.05)] + tmp[(int)((offset_size - 1) * 0.05)]);
-    uint8_t hi90 =  0.5 * (tmp[(int)(offset_size * 0.95)] + tmp[(int)((offset_size - 1) * 0.95)]);
+    uint8_t low10 = 0.5 * (histNth(hist, offset_size * 0.05) + histNth(hist, (offset_size - 1) * 0.05));
+    uint8_t hi90 =  0.5 * (histNth(hist, offset_size * 0.95) + histNth(hist, (offset_size - 1) * 0.95));
     int32_t cnt = 0;
-    for (uint32_t i = SIGNAL_IGNORE_FIRST_SAMPLES; i < size; i++) {
-
-        if (samples[i] < low10 || samples[i] > hi90)
-            continue;
-
-        acc_off += samples[i] - 128;
-        cnt++;
+    for (int v = low10; v <= hi90; v++) {
+        acc_off += (v - 128) * (int32_t)hist[v];
+        cnt += hist[v];
     }
     if (cnt > 0)
         acc_off /= cnt;
@@ -188,14 +190,7 @@ void removeSignalOffset(uint8_t *samples, uint32_t size) {
 #endif
 
     // shift and saturate samples to center the mean
-    for (uint32_t i = 0; i < size; i++) {
-        if (acc_off > 0) {
-            samples[i] = (samples[i] >= acc_off) ? samples[i] - acc_off : 0;
-        }
-        if (acc_off < 0) {
-            samples[i] = (255 - samples[i] >=  -acc_off) ? samples[i] - acc_off : 255;
-        }
-    }
+    lfsimd_offset(samples, size, acc_off);
 }
 
 // get high and low values of a wave with passed in fuzz factor. also return noise test = 1 for passed or 0 for only noise
@@ -646,6 +641,138 @@ bool DetectCleanAskWave(const uint8_t *dest, size_t size, uint8_t high, uint8_t
 // -------------------Clock / Bitrate Detection Section------------------------------------------
 // **********************************************************************************************
 
+static clock_scores_t clockscores;
+static uint32_t clockscores_raw[CLOCK_SCORES_MAX];
+
+const clock_scores_t *getClockScores(void) {
+    return &clockscores;
+}
+
+static void resetClockScores(void) {
+    memset(&clockscores, 0, sizeof(clockscores));
+    memset(clockscores_raw, 0, sizeof(clockscores_raw));
+}
+
+static void addClockScore(uint16_t clk, uint32_t score) {
+    if (clockscores.count >= CLOCK_SCORES_MAX)
+        return;
+
+    clockscores.clock[clockscores.count] = clk;
+    clockscores_raw[clockscores.count++] = score;
+}
+
+// scale the raw scores, best candidate is 100
+static void finishClockScores(void) {
+    uint32_t max = 0;
+    for (uint8_t i = 0; i < clockscores.count; i++) {
+        if (clockscores_raw[i] > max)
+            max = clockscores_raw[i];
+    }
+
+    for (uint8_t i = 0; i < clockscores.count; i++) {
+        clockscores.confidence[i] = (max) ? ((uint64_t)clockscores_raw[i] * 100) / max : 0;
+    }
+}
+
+// Clock detection results are cached against the samples and signal properties
+// they were computed from, lf search and the demod wrappers ask for the clock
+// of the same samples over and over.  There is no repeated detection on device.
+typedef enum {
+    CLK_CACHE_ASK = 0,
+    CLK_CACHE_NRZ,
+    CLK_CACHE_PSK,
+    CLK_CACHE_FC,
+    CLK_CACHE_FSK,
+} clk_cache_kind_t;
+
+typedef struct {
+    int ret;
+    int out[3];
+} clk_cache_res_t;
+
+#ifndef ON_DEVICE
+
+#define CLK_CACHE_SLOTS 16
+
+typedef struct {
+    bool valid;
+    clk_cache_kind_t kind;
+    uint64_t hash;
+    size_t size;
+    signal_t sig;
+    int in[2];
+    clk_cache_res_t res;
+    clock_scores_t scores;
+} clk_cache_t;
+
+static clk_cache_t clkcache[CLK_CACHE_SLOTS];
+static uint8_t clkcache_next = 0;
+
+static uint64_t samplesHash(const uint8_t *samples, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ULL ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        memcpy(&w, samples + i, sizeof(w));
+        h = (h ^ w) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 32;
+    }
+    for (; i < size; i++) {
+        h = (h ^ samples[i]) * 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static bool clkCacheGet(clk_cache_kind_t kind, uint64_t hash, size_t size, int in0, int in1, clk_cache_res_t *res) {
+    // keep the debug output complete
+    if (g_debugMode == 2)
+        return false;
+
+    for (uint8_t i = 0; i < CLK_CACHE_SLOTS; i++) {
+        const clk_cache_t *c = &clkcache[i];
+        if (c->valid && c->kind == kind && c->hash == hash && c->size == size
+                && c->in[0] == in0 && c->in[1] == in1
+                && c->sig.low == signalprop.low && c->sig.high == signalprop.high
+                && c->sig.mean == signalprop.mean && c->sig.amplitude == signalprop.amplitude
+                && c->sig.isnoise == signalprop.isnoise) {
+            *res = c->res;
+            clockscores = c->scores;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void clkCachePut(clk_cache_kind_t kind, uint64_t hash, size_t size, int in0, int in1, const clk_cache_res_t *res) {
+    clk_cache_t *c = &clkcache[clkcache_next];
+    clkcache_next = (clkcache_next + 1) % CLK_CACHE_SLOTS;
+
+    c->valid = true;
+    c->kind = kind;
+    c->hash = hash;
+    c->size = size;
+    c->sig = signalprop;
+    c->in[0] = in0;
+    c->in[1] = in1;
+    c->res = *res;
+    c->scores = clockscores;
+}
+
+#else
+
+static uint64_t samplesHash(const uint8_t *samples, size_t size) {
+    return 0;
+}
+
+static bool clkCacheGet(clk_cache_kind_t kind, uint64_t hash, size_t size, int in0, int in1, clk_cache_res_t *res) {
+    return false;
+}
+
+static void clkCachePut(clk_cache_kind_t kind, uint64_t hash, size_t size, int in0, int in1, const clk_cache_res_t *res) {
+}
+
+#endif
+
 // to help detect clocks on heavily clipped samples
 // based on count of low to low
 int DetectStrongAskClock(uint8_t *dest, size_t size, int high, int low, int *clock) {
@@ -717,6 +844,7 @@ int DetectStrongAskClock(uint8_t *dest, size_t size, int high, int low, int *clo
     uint16_t second_shortest = 0;
     int second = 0;
     int max = 0;
+    resetClockScores();
     for (int j = 10; j > -1; j--) {
         if (g_debugMode == 2) {
             prnt("DEBUG, ASK,  clocks %u | hits %u | idx %u"
@@ -725,6 +853,7 @@ int DetectStrongAskClock(uint8_t *dest, size_t size, int high, int low, int *clo
                  , tmpclk[j][2]
                 );
         }
+        addClockScore(tmpclk[j][0], tmpclk[j][1]);
 
         if (max < tmpclk[j][1]) {
             second = *clock;
@@ -741,6 +870,7 @@ int DetectStrongAskClock(uint8_t *dest, size_t size, int high, int low, int *clo
         *clock = second;
         shortestWaveIdx = second_shortest;
     }
+    finishClockScores();
 
     if (*clock == 0)
         return -1;
@@ -748,10 +878,30 @@ int DetectStrongAskClock(uint8_t *dest, size_t size, int high, int low, int *clo
     return shortestWaveIdx;
 }
 
+// true when sample pos, nor its tol neighbours, is a peak
+static bool askNoPeak(const uint8_t *dest, size_t pos, uint8_t tol, int peak_hi, int peak_low) {
+    if (dest[pos] >= peak_hi || dest[pos] <= peak_low)
+        return false;
+    if (dest[pos - tol] >= peak_hi || dest[pos - tol] <= peak_low)
+        return false;
+    if (dest[pos + tol] >= peak_hi || dest[pos + tol] <= peak_low)
+        return false;
+    return true;
+}
+
+// bits to errors ratio of every tested clock
+static void askClockScores(const uint16_t *clk, const uint16_t *bestErr, uint8_t num_clks, size_t size) {
+    for (uint8_t k = 0; k < num_clks; k++) {
+        if (bestErr[k] != 1000)
+            addClockScore(clk[k], (size / clk[k]) / ((bestErr[k]) ? bestErr[k] : 1));
+    }
+    finishClockScores();
+}
+
 // not perfect especially with lower clocks or VERY good antennas (heavy wave clipping)
 // maybe somehow adjust peak trimming value based on samples to fix?
 // return start index of best starting position for that clock and return clock (by reference)
-int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
+static int askClockDetect(uint8_t *dest, size_t size, int *clock, int maxErr) {
 
     //don't need to loop through entire array. (cotag has clock of 384)
     uint16_t loopCnt = 1000;
@@ -805,6 +955,7 @@ int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
         }
     }
     // test for weak peaks
+    resetClockScores();
 
     // test clock if given as cmd parameter
     if (*clock > 0)
@@ -814,7 +965,7 @@ int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
     size_t j = 0;
     uint16_t bestErr[] = {1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000, 1000};
     uint8_t bestStart[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-    size_t errCnt, arrLoc, loopEnd;
+    size_t errCnt, loopEnd;
 
     if (found_clk) {
         clkCnt = found_clk;
@@ -842,33 +993,48 @@ int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
         getNextHigh(dest, size, peak_hi, &j);
         getNextLow(dest, size, peak_low, &j);
 
-        for (; j < loopCnt; j++) {
+        // start j tests the samples j + i * clk up to a last sample that is the
+        // same for j + clk, so the errors of j + clk are those of j less sample j.
+        // Only the first clk starts need a scan, one pass over the samples per clock.
+        size_t bestJ = 0;
+        for (size_t r = j; r < loopCnt && r < j + clk[clkCnt]; r++) {
+
+            size_t span = (size - r - tol) / clk[clkCnt];
+            loopEnd = (span) ? span - 1 : 0;
+
             errCnt = 0;
-            // now that we have the first one lined up test rest of wave array
-            loopEnd = ((size - j - tol) / clk[clkCnt]) - 1;
             for (i = 0; i < loopEnd; ++i) {
-                arrLoc = j + (i * clk[clkCnt]);
-                if (dest[arrLoc] >= peak_hi || dest[arrLoc] <= peak_low) {
-                } else if (dest[arrLoc - tol] >= peak_hi || dest[arrLoc - tol] <= peak_low) {
-                } else if (dest[arrLoc + tol] >= peak_hi || dest[arrLoc + tol] <= peak_low) {
-                } else {  //error no peak detected
+                if (askNoPeak(dest, r + (i * clk[clkCnt]), tol, peak_hi, peak_low))
                     errCnt++;
-                }
             }
-            // if we found no errors then we can stop here and a low clock (common clocks)
-            //  this is correct one - return this clock
-            // if (g_debugMode == 2) prnt("DEBUG ASK: clk %d, err %d, startpos %d, endpos %d", clk[clkCnt], errCnt, j, i);
-            if (errCnt == 0 && clkCnt < 7) {
-                if (!found_clk)
-                    *clock = clk[clkCnt];
-                return j;
-            }
-            // if we found errors see if it is lowest so far and save it as best run
-            if (errCnt < bestErr[clkCnt]) {
-                bestErr[clkCnt] = errCnt;
-                bestStart[clkCnt] = j;
+
+            // earliest start with the fewest errors, like a scan in start order
+            for (size_t jj = r; jj < loopCnt; jj += clk[clkCnt]) {
+                if (jj > r && loopEnd > 0) {
+                    if (askNoPeak(dest, jj - clk[clkCnt], tol, peak_hi, peak_low))
+                        errCnt--;
+                    loopEnd--;
+                }
+
+                if (errCnt < bestErr[clkCnt] || (errCnt == bestErr[clkCnt] && errCnt < 1000 && jj < bestJ)) {
+                    bestErr[clkCnt] = errCnt;
+                    bestStart[clkCnt] = jj;
+                    bestJ = jj;
+                }
             }
         }
+
+        if (j < loopCnt)
+            j = loopCnt;
+
+        // if we found no errors then we can stop here and a low clock (common clocks)
+        //  this is correct one - return this clock
+        if (bestErr[clkCnt] == 0 && clkCnt < 7) {
+            if (!found_clk)
+                *clock = clk[clkCnt];
+            askClockScores(clk, bestErr, clkCnt + 1, size);
+            return bestJ;
+        }
     }
 
     uint8_t k, best = 0;
@@ -884,6 +1050,8 @@ int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
         //if (g_debugMode == 2) prnt("DEBUG ASK: clk %d, # Errors %d, Current Best Clk %d, bestStart %d", clk[k], bestErr[k], clk[best], bestStart[best]);
     }
 
+    askClockScores(clk, bestErr, num_clks, size);
+
     bool chg = false;
     for (i = 0; i < ARRAYLEN(bestErr); i++) {
         chg = (bestErr[i] != 1000);
@@ -906,6 +1074,24 @@ int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
     return bestStart[best];
 }
 
+int DetectASKClock(uint8_t *dest, size_t size, int *clock, int maxErr) {
+    clk_cache_res_t res = {0};
+    uint64_t hash = samplesHash(dest, size);
+    if (clkCacheGet(CLK_CACHE_ASK, hash, size, *clock, maxErr, &res)) {
+        *clock = res.out[0];
+        return res.ret;
+    }
+
+    int in = *clock;
+    resetClockScores();
+    res.ret = askClockDetect(dest, size, clock, maxErr);
+    res.out[0] = *clock;
+    if (*clock <= 0)
+        resetClockScores();
+    clkCachePut(CLK_CACHE_ASK, hash, size, in, maxErr, &res);
+    return res.ret;
+}
+
 int DetectStrongNRZClk(const uint8_t *dest, size_t size, int peak, int low, bool *strong) {
     //find shortest transition from high to low
     *strong = false;
@@ -950,7 +1136,7 @@ int DetectStrongNRZClk(const uint8_t *dest, size_t size, int peak, int low, bool
 }
 
 // detect nrz clock by reading #peaks vs no peaks(or errors)
-int DetectNRZClock(uint8_t *dest, size_t size, int clock, size_t *clockStartIdx) {
+static int nrzClockDetect(uint8_t *dest, size_t size, int clock, size_t *clockStartIdx) {
     size_t i = 0;
     uint16_t clk[] = {8, 16, 32, 40, 50, 64, 100, 128, 255, 272, 384};
     size_t loopCnt = 4096;  //don't need to loop through entire array...
@@ -977,7 +1163,11 @@ int DetectNRZClock(uint8_t *dest, size_t size, int clock, size_t *clockStartIdx)
 
     bool strong = false;
     int lowestTransition = DetectStrongNRZClk(dest, size - 20, peak, low, &strong);
-    if (strong) return lowestTransition;
+    if (strong) {
+        addClockScore(lowestTransition, 1);
+        finishClockScores();
+        return lowestTransition;
+    }
     size_t ii;
     uint8_t clkCnt;
     uint8_t tol = 0;
@@ -1072,14 +1262,38 @@ int DetectNRZClock(uint8_t *dest, size_t size, int clock, size_t *clockStartIdx)
         }
         if (g_debugMode == 2) prnt("DEBUG NRZ: Clk: %d, peaks: %d, minPeak: %d, bestClk: %d, lowestTrs: %d", clk[m], peaksdet[m], minPeak, clk[best], lowestTransition);
     }
+
+    for (clkCnt = 0; clkCnt < ARRAYLEN(peaksdet); ++clkCnt) {
+        if (peaksdet[clkCnt] > 0)
+            addClockScore(clk[clkCnt], peaksdet[clkCnt]);
+    }
+    finishClockScores();
+
     *clockStartIdx = bestStart[best];
     return clk[best];
 }
 
+int DetectNRZClock(uint8_t *dest, size_t size, int clock, size_t *clockStartIdx) {
+    clk_cache_res_t res = {0};
+    uint64_t hash = samplesHash(dest, size);
+    if (clkCacheGet(CLK_CACHE_NRZ, hash, size, clock, 0, &res)) {
+        *clockStartIdx = res.out[0];
+        return res.ret;
+    }
+
+    resetClockScores();
+    res.ret = nrzClockDetect(dest, size, clock, clockStartIdx);
+    res.out[0] = *clockStartIdx;
+    if (res.ret <= 0)
+        resetClockScores();
+    clkCachePut(CLK_CACHE_NRZ, hash, size, clock, 0, &res);
+    return res.ret;
+}
+
 // countFC is to detect the field clock lengths.
 // counts and returns the 2 most common wave lengths
 // mainly used for FSK field clock detection
-uint16_t countFC(const uint8_t *bits, size_t size, bool fskAdj) {
+static uint16_t fcCount(const uint8_t *bits, size_t size, bool fskAdj) {
     uint8_t fcLens[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint16_t fcCnts[] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
     uint8_t fcLensFnd = 0;
@@ -1168,9 +1382,21 @@ uint16_t countFC(const uint8_t *bits, size_t size, bool fskAdj) {
     return (uint16_t)fcLens[best2] << 8 | fcLens[best1];
 }
 
+uint16_t countFC(const uint8_t *bits, size_t size, bool fskAdj) {
+    clk_cache_res_t res = {0};
+    uint64_t hash = samplesHash(bits, size);
+    if (clkCacheGet(CLK_CACHE_FC, hash, size, fskAdj, 0, &res)) {
+        return res.ret;
+    }
+
+    res.ret = fcCount(bits, size, fskAdj);
+    clkCachePut(CLK_CACHE_FC, hash, size, fskAdj, 0, &res);
+    return res.ret;
+}
+
 // detect psk clock by reading each phase shift
 // a phase shift is determined by measuring the sample length of each wave
-int DetectPSKClock(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShift, uint8_t *curPhase, uint8_t *fc) {
+static int pskClockDetect(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShift, uint8_t *curPhase, uint8_t *fc) {
     uint16_t clk[] = {255, 16, 32, 40, 50, 64, 100, 128, 256, 272, 384}; // 255 is not a valid clock
     uint16_t loopCnt = 4096;  // don't need to loop through entire array...
 
@@ -1178,7 +1404,7 @@ int DetectPSKClock(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShif
     // size must be larger than 20 here, and 160 later on.
     if (size < loopCnt) loopCnt = size - 20;
 
-    uint16_t fcs = countFC(dest, size, 0);
+    uint16_t fcs = fcCount(dest, size, 0);
 
     *fc = fcs & 0xFF;
 
@@ -1250,9 +1476,15 @@ int DetectPSKClock(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShif
                 }
             }
         }
-        if (errCnt == 0) return clk[clkCnt];
+        if (errCnt == 0) {
+            addClockScore(clk[clkCnt], 1);
+            finishClockScores();
+            return clk[clkCnt];
+        }
         if (errCnt <= bestErr[clkCnt]) bestErr[clkCnt] = errCnt;
         if (peakcnt > peaksdet[clkCnt]) peaksdet[clkCnt] = peakcnt;
+        // clocks without errors return above, score the others below that
+        addClockScore(clk[clkCnt], 0);
     }
     //all tested with errors
     //return the highest clk with the most peaks found
@@ -1263,11 +1495,41 @@ int DetectPSKClock(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShif
 
         if (g_debugMode == 2) prnt("DEBUG PSK: Clk: %d, peaks: %d, errs: %d, bestClk: %d", clk[i], peaksdet[i], bestErr[i], clk[best]);
     }
+
+    resetClockScores();
+    for (i = 9; i >= 1; i--) {
+        if (peaksdet[i] > 0)
+            addClockScore(clk[i], peaksdet[i]);
+    }
+    finishClockScores();
     return clk[best];
 }
 
+int DetectPSKClock(uint8_t *dest, size_t size, int clock, size_t *firstPhaseShift, uint8_t *curPhase, uint8_t *fc) {
+    clk_cache_res_t res = {0};
+    uint64_t hash = samplesHash(dest, size);
+    // curPhase is in/out, the phase found depends on the one it starts from
+    int startPhase = *curPhase;
+    if (clkCacheGet(CLK_CACHE_PSK, hash, size, clock, startPhase, &res)) {
+        *firstPhaseShift = res.out[0];
+        *curPhase = res.out[1];
+        *fc = res.out[2];
+        return res.ret;
+    }
+
+    resetClockScores();
+    res.ret = pskClockDetect(dest, size, clock, firstPhaseShift, curPhase, fc);
+    res.out[0] = *firstPhaseShift;
+    res.out[1] = *curPhase;
+    res.out[2] = *fc;
+    if (res.ret <= 0)
+        resetClockScores();
+    clkCachePut(CLK_CACHE_PSK, hash, size, clock, startPhase, &res);
+    return res.ret;
+}
+
 // detects the bit clock for FSK given the high and low Field Clocks
-uint8_t detectFSKClk(const uint8_t *bits, size_t size, uint8_t fcHigh, uint8_t fcLow, int *firstClockEdge) {
+static uint8_t fskClockDetect(const uint8_t *bits, size_t size, uint8_t fcHigh, uint8_t fcLow, int *firstClockEdge) {
 
     if (size == 0)
         return 0;
@@ -1353,6 +1615,19 @@ uint8_t detectFSKClk(const uint8_t *bits, size_t size, uint8_t fcHigh, uint8_t f
     if (g_debugMode == 2)
         prnt("DEBUG FSK: most counted rf values: 1 %d, 2 %d, 3 %d", rfLens[rfHighest], rfLens[rfHighest2], rfLens[rfHighest3]);
 
+    // score each clock by the bit runs it divides within tolerance
+    for (int c = 7; c >= 2; c--) {
+        uint32_t score = 0;
+        for (i = 0; i < 15; i++) {
+            if (rfLens[i] == 0)
+                continue;
+            if (rfLens[i] % clk[c] < tol1 || rfLens[i] % clk[c] > clk[c] - tol1)
+                score += rfCnts[i];
+        }
+        addClockScore(clk[c], score);
+    }
+    finishClockScores();
+
     // loop to find the highest clock that has a remainder less than the tolerance
     //   compare samples counted divided by
     // test 128 down to 32 (shouldn't be possible to have fc/10 & fc/8 and rf/16 or less)
@@ -1374,6 +1649,23 @@ uint8_t detectFSKClk(const uint8_t *bits, size_t size, uint8_t fcHigh, uint8_t f
     return clk[m];
 }
 
+uint8_t detectFSKClk(const uint8_t *bits, size_t size, uint8_t fcHigh, uint8_t fcLow, int *firstClockEdge) {
+    clk_cache_res_t res = {0};
+    uint64_t hash = samplesHash(bits, size);
+    if (clkCacheGet(CLK_CACHE_FSK, hash, size, (fcHigh << 8) | fcLow, 0, &res)) {
+        *firstClockEdge = res.out[0];
+        return res.ret;
+    }
+
+    resetClockScores();
+    res.ret = fskClockDetect(bits, size, fcHigh, fcLow, firstClockEdge);
+    res.out[0] = *firstClockEdge;
+    if (res.ret <= 0)
+        resetClockScores();
+    clkCachePut(CLK_CACHE_FSK, hash, size, (fcHigh << 8) | fcLow, 0, &res);
+    return res.ret;
+}
+
 
 // **********************************************************************************************
 // --------------------Modulation Demods &/or Decoding Section-----------------------------------
@@ -1403,21 +1695,17 @@ static bool findST(int *stStopLoc, int *stStartIdx,
 }
 
 // attempt to identify a Sequence Terminator in ASK modulated raw wave
-bool DetectST(uint8_t *buffer, size_t *size, int *foundclock, size_t *ststart, size_t *stend) {
+// tmpbuff: low to low wave count, waveLen: high to low wave count, both hold bufsize / LOWEST_DEFAULT_CLOCK zeroed entries
+static bool detectST_waves(uint8_t *buffer, size_t *size, int *foundclock, size_t *ststart, size_t *stend, int *tmpbuff, int *waveLen) {
     size_t bufsize = *size;
     //need to loop through all samples and identify our clock, look for the ST pattern
     int clk = 0;
     int tol = 0;
     int j = 0, high, low, skip = 0, start = 0, end = 0, minClk = 255;
     size_t i = 0;
-    //probably should calloc... || test if memory is available ... handle device side? memory danger!!! [marshmellow]
-    int tmpbuff[bufsize / LOWEST_DEFAULT_CLOCK]; // low to low wave count //guess rf/32 clock, if click is smaller we will only have room for a fraction of the samples captured
-    int waveLen[bufsize / LOWEST_DEFAULT_CLOCK]; // high to low wave count //if clock is larger then we waste memory in array size that is not needed...
     //size_t testsize = (bufsize < 512) ? bufsize : 512;
     int phaseoff = 0;
     high = low = 128;
-    memset(tmpbuff, 0, sizeof(tmpbuff));
-    memset(waveLen, 0, sizeof(waveLen));
 
     if (!loadWaveCounters(buffer, bufsize, tmpbuff, waveLen, &j, &skip, &minClk, &high, &low)) return false;
     // set clock  - might be able to get this externally and remove this work...
@@ -1525,6 +1813,29 @@ bool DetectST(uint8_t *buffer, size_t *size, int *foundclock, size_t *ststart, s
     return true;
 }
 
+bool DetectST(uint8_t *buffer, size_t *size, int *foundclock, size_t *ststart, size_t *stend) {
+    size_t waves = *size / LOWEST_DEFAULT_CLOCK;
+#ifdef ON_DEVICE
+    //guess rf/32 clock, if clock is smaller we will only have room for a fraction of the samples captured
+    int tmpbuff[waves];
+    int waveLen[waves];
+    memset(tmpbuff, 0, sizeof(tmpbuff));
+    memset(waveLen, 0, sizeof(waveLen));
+    return detectST_waves(buffer, size, foundclock, ststart, stend, tmpbuff, waveLen);
+#else
+    // client graph traces can be far larger than the stack
+    int *tmpbuff = calloc(waves + 1, sizeof(int));
+    int *waveLen = calloc(waves + 1, sizeof(int));
+    bool res = false;
+    if (tmpbuff != NULL && waveLen != NULL) {
+        res = detectST_waves(buffer, size, foundclock, ststart, stend, tmpbuff, waveLen);
+    }
+    free(tmpbuff);
+    free(waveLen);
+    return res;
+#endif
+}
+
 // take 11 10 01 11 00 and make 01100 ... miller decoding
 // check for phase errors - should never have half a 1 or 0 by itself and should never exceed 1111 or 0000 in a row
 // decodes miller encoded binary
@@ -1921,8 +2232,8 @@ static size_t fsk_wave_demod(uint8_t *dest, size_t size, uint8_t fchigh, uint8_t
 
     //find start of modulating data in trace
     idx = findModStart(dest, size, fchigh);
-    // Need to threshold first sample
-    dest[idx] = (dest[idx] < signalprop.mean) ? 0 : 1;
+    // threshold all samples up front, the bits written below stay behind idx
+    lfsimd_threshold(dest + idx, (idx < size - 20) ? size - 20 - idx : 1, signalprop.mean);
 
     last_transition = idx;
     idx++;
@@ -1957,45 +2268,39 @@ static size_t fsk_wave_demod(uint8_t *dest, size_t size, uint8_t fchigh, uint8_t
     // width should be divided with exp_one.  i:e 6+7+6+2=21,  21/5 = 4,
     // the 1-0 to 0-1  width should be divided with exp_zero.   Ie: 3+5+6+7 = 21/6 = 3
 
-    for (; idx < size - 20; idx++) {
-
-        // threshold current value
-        dest[idx] = (dest[idx] < signalprop.mean) ? 0 : 1;
-
-        // Check for 0->1 transition
-        if (dest[idx - 1] < dest[idx]) {
-            preLastSample = LastSample;
-            LastSample = currSample;
-            currSample = idx - last_transition;
-            if (currSample < (fclow - 2)) {         //0-5 = garbage noise (or 0-3)
-                //do nothing with extra garbage
-            } else if (currSample < (fchigh - 1)) {         //6-8 = 8 sample waves  (or 3-6 = 5)
-                //correct previous 9 wave surrounded by 8 waves (or 6 surrounded by 5)
-                if (numBits > 1 && LastSample > (fchigh - 2) && (preLastSample < (fchigh - 1))) {
-                    dest[numBits - 1] = 1;
-                }
-                dest[numBits++] = 1;
+    // walk the 0->1 transitions
+    for (idx = lfsimd_next_rise(dest, idx, size - 20); idx < size - 20; idx = lfsimd_next_rise(dest, idx + 1, size - 20)) {
+        preLastSample = LastSample;
+        LastSample = currSample;
+        currSample = idx - last_transition;
+        if (currSample < (fclow - 2)) {         //0-5 = garbage noise (or 0-3)
+            //do nothing with extra garbage
+        } else if (currSample < (fchigh - 1)) {         //6-8 = 8 sample waves  (or 3-6 = 5)
+            //correct previous 9 wave surrounded by 8 waves (or 6 surrounded by 5)
+            if (numBits > 1 && LastSample > (fchigh - 2) && (preLastSample < (fchigh - 1))) {
+                dest[numBits - 1] = 1;
+            }
+            dest[numBits++] = 1;
 
 
-                if (numBits > 0 && *startIdx == 0)
-                    *startIdx = idx - fclow;
+            if (numBits > 0 && *startIdx == 0)
+                *startIdx = idx - fclow;
 
-            } else if (currSample > (fchigh + 1) && numBits < 3) { //12 + and first two bit = unusable garbage
-                //do nothing with beginning garbage and reset..  should be rare..
-                numBits = 0;
-            } else if (currSample == (fclow + 1) && LastSample == (fclow - 1)) { // had a 7 then a 9 should be two 8's (or 4 then a 6 should be two 5's)
-                dest[numBits++] = 1;
-                if (numBits > 0 && *startIdx == 0) {
-                    *startIdx = idx - fclow;
-                }
-            } else {                                        //9+ = 10 sample waves (or 6+ = 7)
-                dest[numBits++] = 0;
-                if (numBits > 0 && *startIdx == 0) {
-                    *startIdx = idx - fchigh;
-                }
+        } else if (currSample > (fchigh + 1) && numBits < 3) { //12 + and first two bit = unusable garbage
+            //do nothing with beginning garbage and reset..  should be rare..
+            numBits = 0;
+        } else if (currSample == (fclow + 1) && LastSample == (fclow - 1)) { // had a 7 then a 9 should be two 8's (or 4 then a 6 should be two 5's)
+            dest[numBits++] = 1;
+            if (numBits > 0 && *startIdx == 0) {
+                *startIdx = idx - fclow;
+            }
+        } else {                                        //9+ = 10 sample waves (or 6+ = 7)
+            dest[numBits++] = 0;
+            if (numBits > 0 && *startIdx == 0) {
+                *startIdx = idx - fchigh;
             }
-            last_transition = idx;
         }
+        last_transition = idx;
     }
     return numBits; //Actually, it returns the number of bytes, but each byte represents a bit: 1 or 0
 }
@@ -2011,8 +2316,13 @@ static size_t aggregate_bits(uint8_t *dest, size_t size, uint8_t clk, uint8_t in
     uint8_t hclk = clk / 2;
 
     for (i = 1; i < size; i++) {
+        //skip until we hit a transition
+        size_t next = lfsimd_next_diff(dest, i, size, lastval);
+        n += next - i;
+        i = next;
+        if (i == size) break;
+
         n++;
-        if (dest[i] == lastval) continue; //skip until we hit a transition
 
         //find out how many bits (n) we collected (use 1/2 clk tolerance)
 
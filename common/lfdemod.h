@@ -43,6 +43,16 @@ typedef struct {
 } signal_t;
 signal_t *getSignalProperties(void);
 
+// per candidate clock scores of the last clock detection, relative to the best
+// candidate (100).  0 means the clock was not tested or did not match at all.
+#define CLOCK_SCORES_MAX 11
+typedef struct {
+    uint8_t count;
+    uint16_t clock[CLOCK_SCORES_MAX];
+    uint8_t confidence[CLOCK_SCORES_MAX];
+} clock_scores_t;
+const clock_scores_t *getClockScores(void);
+
 void computeSignalProperties(const uint8_t *samples, uint32_t size);
 void removeSignalOffset(uint8_t *samples, uint32_t size);
 void getNextLow(const uint8_t *samples, size_t size, int low, size_t *i);
@@ -0,0 +1,405 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// SIMD versions of the LF demod byte kernels, client side only.
+// Every kernel gives the same result as its scalar version in lfdemod_simd.h,
+// `data lfsimd` checks that over a set of traces.
+//-----------------------------------------------------------------------------
+
+#include "lfdemod_simd.h"
+#include <string.h>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+# define LFSIMD_HAS_SSE2
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# include <immintrin.h>
+# define LFSIMD_HAS_AVX2
+#endif
+
+#if defined(__ARM_NEON)
+# include <arm_neon.h>
+# define LFSIMD_HAS_NEON
+#endif
+
+typedef struct {
+    void (*offset)(uint8_t *s, size_t n, int off);
+    void (*threshold)(uint8_t *s, size_t n, int level);
+    size_t (*next_rise)(const uint8_t *s, size_t i, size_t end);
+    size_t (*next_diff)(const uint8_t *s, size_t i, size_t end, uint8_t v);
+} lfsimd_kernels_t;
+
+// the vector kernels handle the saturated cases first, so the splatted values fit a byte
+static bool offset_trivial(uint8_t *s, size_t n, int off) {
+    if (off >= 255) {
+        memset(s, 0, n);
+        return true;
+    }
+    if (off <= -255) {
+        memset(s, 255, n);
+        return true;
+    }
+    return (off == 0);
+}
+
+static bool threshold_trivial(uint8_t *s, size_t n, int level) {
+    if (level <= 0) {
+        memset(s, 1, n);
+        return true;
+    }
+    if (level > 255) {
+        memset(s, 0, n);
+        return true;
+    }
+    return false;
+}
+
+static const lfsimd_kernels_t kernels_none = {
+    lfsimd_offset_scalar,
+    lfsimd_threshold_scalar,
+    lfsimd_next_rise_scalar,
+    lfsimd_next_diff_scalar,
+};
+
+#ifdef LFSIMD_HAS_SSE2
+
+static void offset_sse2(uint8_t *s, size_t n, int off) {
+    if (offset_trivial(s, n, off)) return;
+
+    size_t i = 0;
+    __m128i d = _mm_set1_epi8((char)((off > 0) ? off : -off));
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+        x = (off > 0) ? _mm_subs_epu8(x, d) : _mm_adds_epu8(x, d);
+        _mm_storeu_si128((__m128i *)(s + i), x);
+    }
+    lfsimd_offset_scalar(s + i, n - i, off);
+}
+
+static void threshold_sse2(uint8_t *s, size_t n, int level) {
+    if (threshold_trivial(s, n, level)) return;
+
+    size_t i = 0;
+    __m128i l = _mm_set1_epi8((char)level);
+    __m128i one = _mm_set1_epi8(1);
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i ge = _mm_cmpeq_epi8(_mm_max_epu8(x, l), x);
+        _mm_storeu_si128((__m128i *)(s + i), _mm_and_si128(ge, one));
+    }
+    lfsimd_threshold_scalar(s + i, n - i, level);
+}
+
+static size_t next_rise_sse2(const uint8_t *s, size_t i, size_t end) {
+    for (; i + 16 <= end; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(s + i - 1));
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + i));
+        // a >= b everywhere but where the signal rises
+        uint32_t m = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(a, b), a)) & 0xFFFF;
+        if (m) {
+            return i + __builtin_ctz(m);
+        }
+    }
+    return lfsimd_next_rise_scalar(s, i, end);
+}
+
+static size_t next_diff_sse2(const uint8_t *s, size_t i, size_t end, uint8_t v) {
+    __m128i vv = _mm_set1_epi8((char)v);
+    for (; i + 16 <= end; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(s + i));
+        uint32_t m = ~_mm_movemask_epi8(_mm_cmpeq_epi8(x, vv)) & 0xFFFF;
+        if (m) {
+            return i + __builtin_ctz(m);
+        }
+    }
+    return lfsimd_next_diff_scalar(s, i, end, v);
+}
+
+
+static const lfsimd_kernels_t kernels_sse2 = {
+    offset_sse2,
+    threshold_sse2,
+    next_rise_sse2,
+    next_diff_sse2,
+};
+
+#endif // LFSIMD_HAS_SSE2
+
+#ifdef LFSIMD_HAS_AVX2
+
+#define AVX2_FN __attribute__((target("avx2")))
+
+AVX2_FN static void offset_avx2(uint8_t *s, size_t n, int off) {
+    if (offset_trivial(s, n, off)) return;
+
+    size_t i = 0;
+    __m256i d = _mm256_set1_epi8((char)((off > 0) ? off : -off));
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(s + i));
+        x = (off > 0) ? _mm256_subs_epu8(x, d) : _mm256_adds_epu8(x, d);
+        _mm256_storeu_si256((__m256i *)(s + i), x);
+    }
+    lfsimd_offset_scalar(s + i, n - i, off);
+}
+
+AVX2_FN static void threshold_avx2(uint8_t *s, size_t n, int level) {
+    if (threshold_trivial(s, n, level)) return;
+
+    size_t i = 0;
+    __m256i l = _mm256_set1_epi8((char)level);
+    __m256i one = _mm256_set1_epi8(1);
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i ge = _mm256_cmpeq_epi8(_mm256_max_epu8(x, l), x);
+        _mm256_storeu_si256((__m256i *)(s + i), _mm256_and_si256(ge, one));
+    }
+    lfsimd_threshold_scalar(s + i, n - i, level);
+}
+
+AVX2_FN static size_t next_rise_avx2(const uint8_t *s, size_t i, size_t end) {
+    for (; i + 32 <= end; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(s + i - 1));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(s + i));
+        uint32_t m = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(a, b), a));
+        if (m) {
+            return i + __builtin_ctz(m);
+        }
+    }
+    return lfsimd_next_rise_scalar(s, i, end);
+}
+
+AVX2_FN static size_t next_diff_avx2(const uint8_t *s, size_t i, size_t end, uint8_t v) {
+    __m256i vv = _mm256_set1_epi8((char)v);
+    for (; i + 32 <= end; i += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(s + i));
+        uint32_t m = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, vv));
+        if (m) {
+            return i + __builtin_ctz(m);
+        }
+    }
+    return lfsimd_next_diff_scalar(s, i, end, v);
+}
+
+
+static const lfsimd_kernels_t kernels_avx2 = {
+    offset_avx2,
+    threshold_avx2,
+    next_rise_avx2,
+    next_diff_avx2,
+};
+
+#endif // LFSIMD_HAS_AVX2
+
+#ifdef LFSIMD_HAS_NEON
+
+// index of the first set byte of a compare result, 16 if none
+static inline uint32_t first_set_neon(uint8x16_t m) {
+    // narrow every byte to a nibble
+    uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+    return bits ? (uint32_t)(__builtin_ctzll(bits) >> 2) : 16;
+}
+
+static void offset_neon(uint8_t *s, size_t n, int off) {
+    if (offset_trivial(s, n, off)) return;
+
+    size_t i = 0;
+    uint8x16_t d = vdupq_n_u8((uint8_t)((off > 0) ? off : -off));
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t x = vld1q_u8(s + i);
+        x = (off > 0) ? vqsubq_u8(x, d) : vqaddq_u8(x, d);
+        vst1q_u8(s + i, x);
+    }
+    lfsimd_offset_scalar(s + i, n - i, off);
+}
+
+static void threshold_neon(uint8_t *s, size_t n, int level) {
+    if (threshold_trivial(s, n, level)) return;
+
+    size_t i = 0;
+    uint8x16_t l = vdupq_n_u8((uint8_t)level);
+    uint8x16_t one = vdupq_n_u8(1);
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t x = vld1q_u8(s + i);
+        vst1q_u8(s + i, vandq_u8(vcgeq_u8(x, l), one));
+    }
+    lfsimd_threshold_scalar(s + i, n - i, level);
+}
+
+static size_t next_rise_neon(const uint8_t *s, size_t i, size_t end) {
+    for (; i + 16 <= end; i += 16) {
+        uint32_t j = first_set_neon(vcltq_u8(vld1q_u8(s + i - 1), vld1q_u8(s + i)));
+        if (j < 16) {
+            return i + j;
+        }
+    }
+    return lfsimd_next_rise_scalar(s, i, end);
+}
+
+static size_t next_diff_neon(const uint8_t *s, size_t i, size_t end, uint8_t v) {
+    uint8x16_t vv = vdupq_n_u8(v);
+    for (; i + 16 <= end; i += 16) {
+        uint32_t j = first_set_neon(vmvnq_u8(vceqq_u8(vld1q_u8(s + i), vv)));
+        if (j < 16) {
+            return i + j;
+        }
+    }
+    return lfsimd_next_diff_scalar(s, i, end, v);
+}
+
+
+static const lfsimd_kernels_t kernels_neon = {
+    offset_neon,
+    threshold_neon,
+    next_rise_neon,
+    next_diff_neon,
+};
+
+#endif // LFSIMD_HAS_NEON
+
+static const lfsimd_kernels_t *kernels = NULL;
+static lfsimd_engine_t engine_in_use = LFSIMD_NONE;
+
+bool lfsimd_supported(lfsimd_engine_t engine) {
+    switch (engine) {
+        case LFSIMD_AUTO:
+        case LFSIMD_NONE:
+            return true;
+        case LFSIMD_SSE2:
+#ifdef LFSIMD_HAS_SSE2
+            return true;
+#else
+            return false;
+#endif
+        case LFSIMD_AVX2:
+#ifdef LFSIMD_HAS_AVX2
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("avx2");
+#else
+            return false;
+#endif
+        case LFSIMD_NEON:
+#ifdef LFSIMD_HAS_NEON
+            return true;
+#else
+            return false;
+#endif
+        case LFSIMD_ENGINES:
+        default:
+            return false;
+    }
+}
+
+const char *lfsimd_name(lfsimd_engine_t engine) {
+    switch (engine) {
+        case LFSIMD_AUTO:
+            return "auto";
+        case LFSIMD_NONE:
+            return "scalar";
+        case LFSIMD_SSE2:
+            return "SSE2";
+        case LFSIMD_AVX2:
+            return "AVX2";
+        case LFSIMD_NEON:
+            return "NEON";
+        case LFSIMD_ENGINES:
+        default:
+            return "unknown";
+    }
+}
+
+void lfsimd_set_engine(lfsimd_engine_t engine) {
+    if (engine == LFSIMD_AUTO) {
+        engine = LFSIMD_NONE;
+        for (lfsimd_engine_t e = LFSIMD_NONE; e < LFSIMD_ENGINES; e++) {
+            if (lfsimd_supported(e)) {
+                engine = e;
+            }
+        }
+    }
+
+    if (lfsimd_supported(engine) == false) {
+        return;
+    }
+
+    kernels = &kernels_none;
+#ifdef LFSIMD_HAS_SSE2
+    if (engine == LFSIMD_SSE2)
+        kernels = &kernels_sse2;
+#endif
+#ifdef LFSIMD_HAS_AVX2
+    if (engine == LFSIMD_AVX2)
+        kernels = &kernels_avx2;
+#endif
+#ifdef LFSIMD_HAS_NEON
+    if (engine == LFSIMD_NEON)
+        kernels = &kernels_neon;
+#endif
+    engine_in_use = engine;
+}
+
+lfsimd_engine_t lfsimd_get_engine(void) {
+    if (kernels == NULL) {
+        lfsimd_set_engine(LFSIMD_AUTO);
+    }
+    return engine_in_use;
+}
+
+static inline const lfsimd_kernels_t *get_kernels(void) {
+    if (kernels == NULL) {
+        lfsimd_set_engine(LFSIMD_AUTO);
+    }
+    return kernels;
+}
+
+void lfsimd_offset(uint8_t *s, size_t n, int off) {
+    get_kernels()->offset(s, n, off);
+}
+
+void lfsimd_threshold(uint8_t *s, size_t n, int level) {
+    get_kernels()->threshold(s, n, level);
+}
+
+size_t lfsimd_next_rise_long(const uint8_t *s, size_t i, size_t end) {
+    return get_kernels()->next_rise(s, i, end);
+}
+
+size_t lfsimd_next_diff_long(const uint8_t *s, size_t i, size_t end, uint8_t v) {
+    return get_kernels()->next_diff(s, i, end, v);
+}
+
+
+// There is no useful vector histogram, four tables keep consecutive samples of
+// the same value from waiting on each other.
+void lfsimd_histogram(const uint8_t *s, size_t n, uint32_t hist[256]) {
+    uint32_t h[4][256];
+    memset(h, 0, sizeof(h));
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        h[0][s[i]]++;
+        h[1][s[i + 1]]++;
+        h[2][s[i + 2]]++;
+        h[3][s[i + 3]]++;
+    }
+    for (; i < n; i++) {
+        h[0][s[i]]++;
+    }
+
+    for (int v = 0; v < 256; v++) {
+        hist[v] = h[0][v] + h[1][v] + h[2][v] + h[3][v];
+    }
+}
@@ -0,0 +1,126 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// Byte kernels for the LF demodulators
+//
+// The scalar versions below are what the firmware runs and the reference for
+// the SSE2 / AVX2 / NEON versions in lfdemod_simd.c, which is client only.
+// The client picks the widest engine the CPU supports on first use.
+//-----------------------------------------------------------------------------
+
+#ifndef LFDEMOD_SIMD_H__
+#define LFDEMOD_SIMD_H__
+
+#include "common.h"
+
+// shift samples by -off, saturating at 0 and 255
+static inline void lfsimd_offset_scalar(uint8_t *s, size_t n, int off) {
+    for (size_t i = 0; i < n; i++) {
+        if (off > 0) {
+            s[i] = (s[i] >= off) ? s[i] - off : 0;
+        }
+        if (off < 0) {
+            s[i] = (255 - s[i] >= -off) ? s[i] - off : 255;
+        }
+    }
+}
+
+// s[i] = 0 below level, 1 otherwise
+static inline void lfsimd_threshold_scalar(uint8_t *s, size_t n, int level) {
+    for (size_t i = 0; i < n; i++) {
+        s[i] = (s[i] < level) ? 0 : 1;
+    }
+}
+
+// first j in [i, end) with s[j - 1] < s[j], end if none. i must be > 0
+static inline size_t lfsimd_next_rise_scalar(const uint8_t *s, size_t i, size_t end) {
+    for (; i < end; i++) {
+        if (s[i - 1] < s[i]) {
+            break;
+        }
+    }
+    return i;
+}
+
+// first j in [i, end) with s[j] != v, end if none
+static inline size_t lfsimd_next_diff_scalar(const uint8_t *s, size_t i, size_t end, uint8_t v) {
+    for (; i < end; i++) {
+        if (s[i] != v) {
+            break;
+        }
+    }
+    return i;
+}
+
+#ifdef ON_DEVICE
+
+static inline void lfsimd_offset(uint8_t *s, size_t n, int off) {
+    lfsimd_offset_scalar(s, n, off);
+}
+static inline void lfsimd_threshold(uint8_t *s, size_t n, int level) {
+    lfsimd_threshold_scalar(s, n, level);
+}
+static inline size_t lfsimd_next_rise(const uint8_t *s, size_t i, size_t end) {
+    return lfsimd_next_rise_scalar(s, i, end);
+}
+static inline size_t lfsimd_next_diff(const uint8_t *s, size_t i, size_t end, uint8_t v) {
+    return lfsimd_next_diff_scalar(s, i, end, v);
+}
+
+#else
+
+typedef enum {
+    LFSIMD_AUTO = 0,
+    LFSIMD_NONE,
+    LFSIMD_SSE2,
+    LFSIMD_AVX2,
+    LFSIMD_NEON,
+    LFSIMD_ENGINES
+} lfsimd_engine_t;
+
+bool lfsimd_supported(lfsimd_engine_t engine);
+// LFSIMD_AUTO selects the best supported engine, unsupported engines are ignored
+void lfsimd_set_engine(lfsimd_engine_t engine);
+lfsimd_engine_t lfsimd_get_engine(void);
+const char *lfsimd_name(lfsimd_engine_t engine);
+
+void lfsimd_offset(uint8_t *s, size_t n, int off);
+void lfsimd_threshold(uint8_t *s, size_t n, int level);
+
+// the searches are called once per edge, short distances are the common case
+// and are cheaper to look at inline than to hand to the vector kernels
+#define LFSIMD_PROBE 16
+
+size_t lfsimd_next_rise_long(const uint8_t *s, size_t i, size_t end);
+size_t lfsimd_next_diff_long(const uint8_t *s, size_t i, size_t end, uint8_t v);
+
+static inline size_t lfsimd_next_rise(const uint8_t *s, size_t i, size_t end) {
+    size_t stop = (i + LFSIMD_PROBE < end) ? i + LFSIMD_PROBE : end;
+    i = lfsimd_next_rise_scalar(s, i, stop);
+    return (i < stop || i >= end) ? i : lfsimd_next_rise_long(s, i, end);
+}
+
+static inline size_t lfsimd_next_diff(const uint8_t *s, size_t i, size_t end, uint8_t v) {
+    size_t stop = (i + LFSIMD_PROBE < end) ? i + LFSIMD_PROBE : end;
+    i = lfsimd_next_diff_scalar(s, i, stop, v);
+    return (i < stop || i >= end) ? i : lfsimd_next_diff_long(s, i, end, v);
+}
+
+// hist[v] = number of samples with value v
+void lfsimd_histogram(const uint8_t *s, size_t n, uint32_t hist[256]);
+
+#endif // ON_DEVICE
+
+#endif
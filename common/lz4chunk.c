@@ -0,0 +1,66 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// LZ4 compressed chunks, used for bulk downloads from the device
+//-----------------------------------------------------------------------------
+#include "lz4chunk.h"
+
+#include <string.h>
+#include "lz4.h"
+
+int lz4chunk_pack(const uint8_t *src, int srclen, uint8_t *dst, int dstlen, int *rawlen) {
+
+    if (srclen <= 0 || dstlen <= 1) {
+        *rawlen = 0;
+        return 0;
+    }
+
+    // fills dst, as far as the source goes
+    int consumed = srclen;
+    int n = LZ4_compress_destSize((const char *)src, (char *)dst + 1, &consumed, dstlen - 1);
+    if (n > 0 && n < consumed) {
+        dst[0] = LZ4CHUNK_LZ4;
+        *rawlen = consumed;
+        return 1 + n;
+    }
+
+    // incompressible, store it
+    dst[0] = LZ4CHUNK_STORED;
+    *rawlen = MIN(srclen, dstlen - 1);
+    memcpy(dst + 1, src, *rawlen);
+    return 1 + *rawlen;
+}
+
+int lz4chunk_unpack(const uint8_t *src, int srclen, uint8_t *dst, int rawlen) {
+
+    if (srclen <= 1) {
+        return -1;
+    }
+
+    switch (src[0]) {
+        case LZ4CHUNK_STORED:
+            if (srclen - 1 != rawlen) {
+                return -1;
+            }
+            memcpy(dst, src + 1, rawlen);
+            return rawlen;
+        case LZ4CHUNK_LZ4: {
+            int n = LZ4_decompress_safe((const char *)src + 1, (char *)dst, srclen - 1, rawlen);
+            return (n == rawlen) ? n : -1;
+        }
+        default:
+            return -1;
+    }
+}
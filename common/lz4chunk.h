@@ -0,0 +1,44 @@
+//-----------------------------------------------------------------------------
+// Copyright (C) Proxmark3 contributors. See AUTHORS.md for details.
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// See LICENSE.txt for the text of the license.
+//-----------------------------------------------------------------------------
+// LZ4 compressed chunks, used for bulk downloads from the device
+//
+// A chunk stands for rawlen bytes of device memory. Its payload starts with
+// a type byte, followed by a single LZ4 block or, when that doesn't pay off,
+// the raw bytes themselves.
+//-----------------------------------------------------------------------------
+
+#ifndef LZ4CHUNK_H__
+#define LZ4CHUNK_H__
+
+#include "common.h"
+#include "pm3_cmd.h"
+
+// what fits in a MIX frame, next to its three arguments
+#define LZ4CHUNK_PAYLOAD_SIZE   (PM3_CMD_DATA_SIZE - 3 * sizeof(uint64_t))
+
+// first byte of a payload
+#define LZ4CHUNK_STORED         0x00
+#define LZ4CHUNK_LZ4            0x01
+
+// Packs as much of src as fits into dstlen bytes of payload.
+// Returns the payload length, *rawlen is set to the number of bytes of src it covers
+int lz4chunk_pack(const uint8_t *src, int srclen, uint8_t *dst, int dstlen, int *rawlen);
+
+// Unpacks a payload of srclen bytes standing for rawlen bytes into dst.
+// Returns rawlen, or -1 if the payload is corrupt
+int lz4chunk_unpack(const uint8_t *src, int srclen, uint8_t *dst, int rawlen);
+
+#endif
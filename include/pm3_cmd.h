@@ -63,6 +63,7 @@ typedef struct {
         uint32_t asDwords[PM3_CMD_DATA_SIZE / 4];
     } data;
     bool ng;             // does it store NG data or OLD data?
+    uint16_t seq;        //  tagged NG, 0 if untagged
 } PacketCommandNG;
 
 // For reception and CRC check
@@ -111,6 +112,7 @@ typedef struct {
         uint32_t asDwords[PM3_CMD_DATA_SIZE / 4];
     } data;
     bool ng;             // does it store NG data or OLD data?
+    uint16_t seq;        //  tagged NG, 0 if untagged
 } PacketResponseNG;
 
 // For reception and CRC check
@@ -120,6 +122,25 @@ typedef struct {
     PacketResponseNGPostamble foopost; // Probably not at that offset!
 } PACKED PacketResponseNGRaw;
 
+// Tagged NG frames, only used when the device announces capabilities_t.tagged_frames.
+// Same as NG frames, with a sequence tag between preamble and payload, covered by the CRC.
+// A device answers a tagged command with tagged frames carrying the same tag, so
+// several commands can be outstanding and their replies told apart.
+#define COMMANDNG_TAGGED_MAGIC     0x63334d50 // PM3c
+#define RESPONSENG_TAGGED_MAGIC    0x64334d50 // PM3d
+#define PM3_NG_TAG_SIZE            sizeof(uint16_t)
+
+// For reception of NG and tagged NG frames, body is [tag] payload postamble
+typedef struct {
+    PacketCommandNGPreamble pre;
+    uint8_t body[PM3_NG_TAG_SIZE + PM3_CMD_DATA_SIZE + sizeof(PacketCommandNGPostamble)];
+} PACKED PacketCommandNGTaggedRaw;
+
+typedef struct {
+    PacketResponseNGPreamble pre;
+    uint8_t body[PM3_NG_TAG_SIZE + PM3_CMD_DATA_SIZE + sizeof(PacketResponseNGPostamble)];
+} PACKED PacketResponseNGTaggedRaw;
+
 // A struct used to send sample-configs over USB
 typedef struct {
     int8_t decimation;
@@ -231,9 +252,13 @@ typedef struct {
     bool hw_available_flash            : 1;
     bool hw_available_smartcard        : 1;
     bool is_rdv4                       : 1;
+
+    // comms
+    bool tagged_frames                 : 1;
+    bool compressed_download           : 1;
+    bool coalesced_frames              : 1;  // several command frames may share a USB packet
 } PACKED capabilities_t;
-#define CAPABILITIES_VERSION 6
-extern capabilities_t g_pm3_capabilities;
+#define CAPABILITIES_VERSION 8
 
 // For CMD_LF_T55XX_WRITEBL
 typedef struct {
@@ -1041,6 +1066,10 @@ typedef struct {
 /* CMD_READ_MEM_DOWNLOAD flags */
 #define READ_MEM_DOWNLOAD_FLAG_RAW                   (1<<0)
 
+/* CMD_DOWNLOAD_BIGBUF and CMD_DOWNLOAD_EML_BIGBUF flags, in arg2.
+   With LZ4 the chunks come as MIX frames, see common/lz4chunk.h */
+#define DOWNLOAD_FLAG_LZ4                            (1<<0)
+
 /* CMD_START_FLASH may have three arguments: start of area to flash,
    end of area to flash, optional magic.
    The bootrom will not allow to overwrite itself unless this magic
@@ -1,9 +1,11 @@
 /*
  * ht2crack2buildtable.c
  * This builds the 1.2TB table and sorts it.
+ * With -c it builds the compact table instead, see ht2crack2compact.h.
  */
 
 #include "ht2crackutils.h"
+#include "ht2crack2compact.h"
 #include <stdlib.h>
 
 // DATAMAX is the size of each bucket (bytes).  There are 65536 buckets so choose a value such that
@@ -27,10 +29,11 @@
 #define NUM_SORT_THREADS 8
 
 // DATASIZE is the number of bytes in an entry.  This is 10; 4 bytes of keystream (2 are in the filepath) +
-// 6 bytes of PRNG state.
+// 6 bytes of PRNG state.  In compact mode the PRNG state is replaced by its position in the PRNG run.
 #define DATASIZE 10
 
 int debug = 0;
+int compact = 0;
 
 // table entry for a bucket
 struct table {
@@ -281,7 +284,7 @@ static void *buildtable(void *dd) {
     int tnum = NUM_BUILD_THREADS;
 
     /* set random state */
-    hstate.shiftreg = 0x123456789abc;
+    hstate.shiftreg = HT2C_START_STATE;
     buildlfsr(&hstate);
 
     /* jump to offset using jump table 2 (2048) */
@@ -314,7 +317,12 @@ static void *buildtable(void *dd) {
         uint32_t ks1 = hitag2_nstep(&hstate2, 24);
         uint32_t ks2 = hitag2_nstep(&hstate2, 24);
 
-        write_ks_s(ks1, ks2, hstate.shiftreg);
+        // compact tables store the position in the PRNG run, in HT2C_STEP units
+        if (compact) {
+            write_ks_s(ks1, ks2, index + (i * NUM_BUILD_THREADS));
+        } else {
+            write_ks_s(ks1, ks2, hstate.shiftreg);
+        }
 
         // jump hstate forward 2048 * NUM_BUILD_THREADS states using di table
         // this is because we're running NUM_BUILD_THREADS threads at once, from NUM_BUILD_THREADS
@@ -326,17 +334,18 @@ static void *buildtable(void *dd) {
 }
 
 
-// make 'table/' (unsorted) and 'sorted/' dir structures
+// make 'table/' (unsorted) and 'sorted/' or 'compact/' dir structures
 static void makedirs(void) {
     char path[32];
+    const char *outdir = compact ? "compact" : "sorted";
     int i;
 
     if (mkdir("table", 0755)) {
         printf("cannot make dir table\n");
         exit(1);
     }
-    if (mkdir("sorted", 0755)) {
-        printf("cannot make dir sorted\n");
+    if (mkdir(outdir, 0755)) {
+        printf("cannot make dir %s\n", outdir);
         exit(1);
     }
 
@@ -346,7 +355,7 @@ static void makedirs(void) {
             printf("cannot make dir %s\n", path);
             exit(1);
         }
-        snprintf(path, sizeof(path), "sorted/%02x", i);
+        snprintf(path, sizeof(path), "%s/%02x", outdir, i);
         if (mkdir(path, 0755)) {
             printf("cannot make dir %s\n", path);
             exit(1);
@@ -361,6 +370,24 @@ static int datacmp(const void *p1, const void *p2, void *dummy) {
     return memcmp(d_1, d_2, DATASIZE);
 }
 
+// convert unsorted entries to compact items and write the compact bucket file
+static void writecompact(const char *outfile, const unsigned char *table, uint64_t numentries, uint64_t *items) {
+    for (uint64_t n = 0; n < numentries; n++) {
+        const unsigned char *e = table + (n * DATASIZE);
+        uint64_t pos = 0;
+
+        for (int k = 4; k < DATASIZE; k++) {
+            pos = (pos << 8) | e[k];
+        }
+
+        items[n] = ((uint64_t)ht2c_subbucket(e) << HT2C_POS_BITS) | pos;
+    }
+
+    if (!ht2c_write_bucket(outfile, items, numentries)) {
+        exit(1);
+    }
+}
+
 static void *sorttable(void *dd) {
     int i, j;
     int fdin;
@@ -379,6 +406,16 @@ static void *sorttable(void *dd) {
         exit(1);
     }
 
+    // compact items, one uint64_t per entry
+    uint64_t *items = NULL;
+    if (compact) {
+        items = (uint64_t *)calloc(1, (50UL * 1024UL * 1024UL / DATASIZE) * sizeof(uint64_t));
+        if (!items) {
+            printf("sorttable: cannot calloc items\n");
+            exit(1);
+        }
+    }
+
     // loop over our first byte values
     for (i = (index * space); i < ((index + 1) * space); i++) {
         // loop over all second byte values
@@ -419,22 +456,27 @@ static void *sorttable(void *dd) {
 
             close(fdin);
 
-            // sort it
-            void *dummy = NULL; // clang
-            qsort_r(table, numentries, DATASIZE, datacmp, dummy);
-
-            // write to file
-            snprintf(outfile, sizeof(outfile), "sorted/%02x/%02x.bin", i, j);
-            fdout = open(outfile, O_WRONLY | O_CREAT, 0644);
-            if (fdout <= 0) {
-                printf("cannot create outfile %s\n", outfile);
-                exit(1);
+            if (compact) {
+                snprintf(outfile, sizeof(outfile), "compact/%02x/%02x.bin", i, j);
+                writecompact(outfile, table, numentries, items);
+            } else {
+                // sort it
+                void *dummy = NULL; // clang
+                qsort_r(table, numentries, DATASIZE, datacmp, dummy);
+
+                // write to file
+                snprintf(outfile, sizeof(outfile), "sorted/%02x/%02x.bin", i, j);
+                fdout = open(outfile, O_WRONLY | O_CREAT, 0644);
+                if (fdout <= 0) {
+                    printf("cannot create outfile %s\n", outfile);
+                    exit(1);
+                }
+                if (write(fdout, table, numentries * DATASIZE) != (numentries * DATASIZE)) {
+                    printf("writetable cannot write all of the data\n");
+                    exit(1);
+                }
+                close(fdout);
             }
-            if (write(fdout, table, numentries * DATASIZE) != (numentries * DATASIZE)) {
-                printf("writetable cannot write all of the data\n");
-                exit(1);
-            }
-            close(fdout);
 
             // remove input file
             if (unlink(infile)) {
@@ -444,6 +486,7 @@ static void *sorttable(void *dd) {
         }
     }
 
+    free(items);
     return NULL;
 }
 
@@ -451,6 +494,14 @@ int main(int argc, char *argv[]) {
     pthread_t threads[NUM_BUILD_THREADS];
     void *status;
 
+    if ((argc > 1) && !strcmp(argv[1], "-c")) {
+        compact = 1;
+    } else if (argc > 1) {
+        printf("%s [-c]\n", argv[0]);
+        printf("  -c   build the compact table in compact/ instead of sorted/\n");
+        exit(1);
+    }
+
     // make the table of tables
     t = (struct table *)calloc(sizeof(struct table) * 65536, sizeof(uint8_t));
     if (!t) {
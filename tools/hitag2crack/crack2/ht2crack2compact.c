@@ -0,0 +1,222 @@
+/*
+ * ht2crack2compact.c
+ * Compact table encoding, decoding and position to state regeneration.
+ * See ht2crack2compact.h for the file layout.
+ */
+
+#include "ht2crack2compact.h"
+
+// jt[b] jumps a state forward HT2C_STEP * 2^b steps, sliced per byte of the state
+static uint64_t jt[HT2C_POS_BITS][6][256];
+
+static uint64_t jump(int b, uint64_t s) {
+    return jt[b][0][s & 0xff] ^ jt[b][1][(s >> 8) & 0xff] ^ jt[b][2][(s >> 16) & 0xff]
+           ^ jt[b][3][(s >> 24) & 0xff] ^ jt[b][4][(s >> 32) & 0xff] ^ jt[b][5][(s >> 40) & 0xff];
+}
+
+void ht2c_init(void) {
+    uint64_t cols[48];
+    Hitag_State hstate;
+
+    // the PRNG is linear, so a jump of n steps is a 48x48 matrix over GF(2).
+    // start with the columns of the HT2C_STEP matrix
+    for (int i = 0; i < 48; i++) {
+        hstate.shiftreg = 1ULL << i;
+        buildlfsr(&hstate);
+        hitag2_nstep(&hstate, HT2C_STEP);
+        cols[i] = hstate.shiftreg;
+    }
+
+    for (int b = 0; b < HT2C_POS_BITS; b++) {
+        for (int n = 0; n < 6; n++) {
+            for (int v = 0; v < 256; v++) {
+                uint64_t x = 0;
+                for (int j = 0; j < 8; j++) {
+                    if (v & (1 << j)) {
+                        x ^= cols[(n * 8) + j];
+                    }
+                }
+                jt[b][n][v] = x;
+            }
+        }
+
+        // square the matrix for the next power of two
+        for (int i = 0; i < 48; i++) {
+            cols[i] = jump(b, cols[i]);
+        }
+    }
+}
+
+uint64_t ht2c_pos2state(uint64_t pos) {
+    uint64_t s = HT2C_START_STATE;
+
+    for (int b = 0; pos; b++, pos >>= 1) {
+        if (pos & 1) {
+            s = jump(b, s);
+        }
+    }
+    return s;
+}
+
+uint16_t ht2c_subbucket(const unsigned char *ks) {
+    return ((ks[0] << 8) | ks[1]) >> (16 - HT2C_FENCE_BITS);
+}
+
+static int cmp_item(const void *p1, const void *p2) {
+    uint64_t a = *(const uint64_t *)p1;
+    uint64_t b = *(const uint64_t *)p2;
+
+    return (a > b) - (a < b);
+}
+
+// pick the Rice parameter from the mean distance between positions in a sub-bucket
+static uint8_t rice_param(uint64_t count) {
+    uint8_t k = 0;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t mean = ((1ULL << HT2C_POS_BITS) * HT2C_SUBBUCKETS) / count;
+    while ((k < (HT2C_POS_BITS - 1)) && ((2ULL << k) <= mean)) {
+        k++;
+    }
+    return k;
+}
+
+typedef struct {
+    unsigned char *data;
+    uint64_t bitpos;
+} bitwriter_t;
+
+static void putbit(bitwriter_t *bw, int bit) {
+    if (bit) {
+        bw->data[bw->bitpos >> 3] |= 0x80 >> (bw->bitpos & 7);
+    }
+    bw->bitpos++;
+}
+
+int ht2c_write_bucket(const char *path, uint64_t *items, uint64_t count) {
+    uint32_t fence[HT2C_SUBBUCKETS + 1];
+    ht2c_header_t hdr;
+    uint64_t i;
+    uint64_t prev;
+    int sub;
+
+    qsort(items, count, sizeof(uint64_t), cmp_item);
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = HT2C_MAGIC;
+    hdr.version = HT2C_VERSION;
+    hdr.fence_bits = HT2C_FENCE_BITS;
+    hdr.rice_k = rice_param(count);
+    hdr.count = count;
+
+    // first pass, size every sub-bucket run
+    uint64_t bytes = 0;
+    i = 0;
+    for (sub = 0; sub < HT2C_SUBBUCKETS; sub++) {
+        uint64_t bits = 0;
+        prev = 0;
+        fence[sub] = (uint32_t)bytes;
+        while ((i < count) && ((items[i] >> HT2C_POS_BITS) == sub)) {
+            uint64_t pos = items[i] & ((1ULL << HT2C_POS_BITS) - 1);
+            bits += ((pos - prev) >> hdr.rice_k) + 1 + hdr.rice_k;
+            prev = pos;
+            i++;
+        }
+        bytes += (bits + 7) / 8;
+    }
+    fence[HT2C_SUBBUCKETS] = (uint32_t)bytes;
+
+    if (bytes > 0xffffffff) {
+        printf("ht2c_write_bucket: bucket %s too large\n", path);
+        return 0;
+    }
+
+    unsigned char *data = (unsigned char *)calloc(1, bytes + 1);
+    if (!data) {
+        printf("ht2c_write_bucket: cannot calloc data\n");
+        return 0;
+    }
+
+    // second pass, Rice code the position deltas of each sub-bucket
+    i = 0;
+    for (sub = 0; sub < HT2C_SUBBUCKETS; sub++) {
+        bitwriter_t bw = { data + fence[sub], 0 };
+        prev = 0;
+        while ((i < count) && ((items[i] >> HT2C_POS_BITS) == sub)) {
+            uint64_t pos = items[i] & ((1ULL << HT2C_POS_BITS) - 1);
+            uint64_t delta = pos - prev;
+
+            for (uint64_t q = delta >> hdr.rice_k; q; q--) {
+                putbit(&bw, 1);
+            }
+            putbit(&bw, 0);
+            for (int b = hdr.rice_k - 1; b >= 0; b--) {
+                putbit(&bw, (delta >> b) & 1);
+            }
+
+            prev = pos;
+            i++;
+        }
+
+        // pad with ones, the decoder stops on an unterminated quotient
+        while (bw.bitpos & 7) {
+            putbit(&bw, 1);
+        }
+    }
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd <= 0) {
+        printf("ht2c_write_bucket: cannot create %s\n", path);
+        free(data);
+        return 0;
+    }
+
+    if ((write(fd, &hdr, sizeof(hdr)) != sizeof(hdr))
+            || (write(fd, fence, sizeof(fence)) != sizeof(fence))
+            || (write(fd, data, bytes) != (ssize_t)bytes)) {
+        printf("ht2c_write_bucket: cannot write all of the data to %s\n", path);
+        close(fd);
+        free(data);
+        return 0;
+    }
+
+    close(fd);
+    free(data);
+    return 1;
+}
+
+uint64_t ht2c_decode(const unsigned char *data, size_t len, uint8_t k, uint64_t *out, uint64_t max) {
+    uint64_t bitlen = (uint64_t)len * 8;
+    uint64_t bitpos = 0;
+    uint64_t pos = 0;
+    uint64_t n = 0;
+
+    while (n < max) {
+        uint64_t q = 0;
+
+        // unary quotient
+        while ((bitpos < bitlen) && (data[bitpos >> 3] & (0x80 >> (bitpos & 7)))) {
+            q++;
+            bitpos++;
+        }
+
+        // no terminating zero or no room for the remainder: padding reached
+        if ((bitpos + 1 + k) > bitlen) {
+            break;
+        }
+        bitpos++;
+
+        uint64_t r = 0;
+        for (int b = 0; b < k; b++, bitpos++) {
+            r = (r << 1) | ((data[bitpos >> 3] >> (7 - (bitpos & 7))) & 1);
+        }
+
+        pos += (q << k) | r;
+        out[n++] = pos;
+    }
+
+    return n;
+}
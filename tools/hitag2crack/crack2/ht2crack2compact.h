@@ -0,0 +1,64 @@
+/*
+ * ht2crack2compact.h
+ * Compact on-disk layout for the ht2crack2 time-space tradeoff table.
+ *
+ * The raw sorted table stores 10 bytes per entry: 4 bytes of keystream (2 more
+ * are in the file path) and the 6 byte PRNG state.  All entries are taken from a
+ * single PRNG run, HT2C_STEP states apart, so a state is fully described by its
+ * HT2C_POS_BITS bit position in that run and can be regenerated with a few table
+ * lookups.
+ *
+ * A compact bucket file (compact/XX/YY.bin, XX YY being the first two keystream
+ * bytes) is split into HT2C_SUBBUCKETS sub-buckets on the next HT2C_FENCE_BITS
+ * keystream bits.  Each sub-bucket holds the sorted positions of its entries as
+ * Rice coded deltas.  The remaining keystream bits are not stored at all: the
+ * searcher regenerates the keystream of every position of the sub-bucket and
+ * compares it to the candidate, which also rules out false matches.
+ *
+ * File layout:
+ *   ht2c_header_t
+ *   uint32_t fence[HT2C_SUBBUCKETS + 1]   byte offset of each sub-bucket in the data
+ *   data                                  Rice coded position deltas, one byte aligned run per sub-bucket
+ */
+
+#ifndef HT2CRACK2COMPACT_H
+#define HT2CRACK2COMPACT_H
+
+#include "ht2crackutils.h"
+
+#define HT2C_MAGIC          0x43325448  // "HT2C"
+#define HT2C_VERSION        1
+#define HT2C_FENCE_BITS     12
+#define HT2C_SUBBUCKETS     (1 << HT2C_FENCE_BITS)
+#define HT2C_POS_BITS       37
+#define HT2C_STEP           2048
+#define HT2C_START_STATE    0x123456789abcULL
+
+typedef struct {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t fence_bits;
+    uint8_t rice_k;
+    uint8_t reserved;
+    uint64_t count;
+} ht2c_header_t;
+
+#define HT2C_FENCE_OFFSET   (sizeof(ht2c_header_t))
+#define HT2C_DATA_OFFSET    (HT2C_FENCE_OFFSET + ((HT2C_SUBBUCKETS + 1) * sizeof(uint32_t)))
+
+// build the position -> state jump tables, must be called once before ht2c_pos2state
+void ht2c_init(void);
+
+// PRNG shift register at table position pos
+uint64_t ht2c_pos2state(uint64_t pos);
+
+// sub-bucket of an entry from keystream bytes 2 and 3
+uint16_t ht2c_subbucket(const unsigned char *ks);
+
+// sort and write items ((subbucket << HT2C_POS_BITS) | position) as a compact bucket file
+int ht2c_write_bucket(const char *path, uint64_t *items, uint64_t count);
+
+// decode one sub-bucket run into positions, returns number of positions
+uint64_t ht2c_decode(const unsigned char *data, size_t len, uint8_t k, uint64_t *out, uint64_t max);
+
+#endif /* HT2CRACK2COMPACT_H */
@@ -2,13 +2,36 @@
  * ht2crack2search.c
  * this searches the sorted tables for the given RNG data, retrieves the matching
  * PRNG state, checks it is correct, and then rolls back the PRNG to recover the key
+ *
+ * if a compact/ table is present (see ht2crack2compact.h) it is used instead of sorted/.
+ * All keystream windows are then looked up in batches ordered by bucket, and the pages
+ * each batch needs are prefetched before they are read.
  */
 
 #include "ht2crackutils.h"
+#include "ht2crack2compact.h"
 
 #define INPUTFILE "sorted/%02x/%02x.bin"
+#define COMPACTDIR "compact"
+#define COMPACTFILE COMPACTDIR "/%02x/%02x.bin"
 #define DATASIZE 10
 
+// number of compact lookups prefetched together
+#define COMPACT_BATCH 64
+
+// one keystream window to look up in the compact table
+struct lookup {
+    unsigned char cand[6];
+    unsigned char rngtest[6];
+    int fwd;
+    int bitoffset;
+    uint16_t sub;
+    int fd;
+    uint8_t rice_k;
+    uint32_t start;
+    uint32_t end;
+};
+
 struct rngdata {
     unsigned char *data;
     int len;
@@ -113,19 +136,14 @@ static int makecand(unsigned char *c, struct rngdata *r, int bitoffset) {
 }
 
 
-// test the candidate against the next or previous rng data
-static int testcand(const unsigned char *f, unsigned char *rt, int fwd) {
+// test the prng state against the next or previous rng data
+static int teststate(uint64_t state, const unsigned char *rt, int fwd) {
     Hitag_State hstate;
-    int i;
     uint32_t ks1;
     uint32_t ks2;
     unsigned char buf[6];
 
-    // build the prng state at the candidate
-    hstate.shiftreg = 0;
-    for (i = 0; i < 6; i++) {
-        hstate.shiftreg = (hstate.shiftreg << 8) | f[i + 4];
-    }
+    hstate.shiftreg = state;
     buildlfsr(&hstate);
 
     if (fwd) {
@@ -152,6 +170,19 @@ static int testcand(const unsigned char *f, unsigned char *rt, int fwd) {
     }
 }
 
+// test the candidate against the next or previous rng data
+static int testcand(const unsigned char *f, unsigned char *rt, int fwd) {
+    uint64_t state = 0;
+    int i;
+
+    // build the prng state at the candidate
+    for (i = 0; i < 6; i++) {
+        state = (state << 8) | f[i + 4];
+    }
+
+    return teststate(state, rt, fwd);
+}
+
 static int searchcand(unsigned char *c, unsigned char *rt, int fwd, unsigned char *m, unsigned char *s) {
     int fd;
     struct stat filestat;
@@ -271,6 +302,232 @@ static int findmatch(struct rngdata *r, unsigned char *outmatch, unsigned char *
     return 0;
 }
 
+static int lookupcmp(const void *p1, const void *p2) {
+    const struct lookup *l1 = (const struct lookup *)p1;
+    const struct lookup *l2 = (const struct lookup *)p2;
+
+    int res = memcmp(l1->cand, l2->cand, 4);
+    if (res) {
+        return res;
+    }
+    return l1->bitoffset - l2->bitoffset;
+}
+
+static void prefetch(int fd, off_t offset, off_t len) {
+#ifdef POSIX_FADV_WILLNEED
+    posix_fadvise(fd, offset, len, POSIX_FADV_WILLNEED);
+#else
+    (void)fd;
+    (void)offset;
+    (void)len;
+#endif
+}
+
+// open the bucket files of a batch and read the fence entries of every lookup
+static void compactfence(struct lookup *l, int n) {
+    ht2c_header_t hdr;
+    uint32_t fence[2];
+    char file[64];
+    int i;
+
+    for (i = 0; i < n; i++) {
+        // lookups are sorted, so consecutive lookups in the same bucket share the file
+        if (i && !memcmp(l[i].cand, l[i - 1].cand, 2)) {
+            l[i].fd = l[i - 1].fd;
+            continue;
+        }
+
+        snprintf(file, sizeof(file), COMPACTFILE, l[i].cand[0], l[i].cand[1]);
+        l[i].fd = open(file, O_RDONLY);
+        if (l[i].fd <= 0) {
+            printf("cannot open table file %s\n", file);
+            exit(1);
+        }
+    }
+
+    // queue the header and fence pages of the whole batch before reading any of them
+    for (i = 0; i < n; i++) {
+        prefetch(l[i].fd, 0, sizeof(hdr));
+        prefetch(l[i].fd, HT2C_FENCE_OFFSET + (l[i].sub * sizeof(uint32_t)), sizeof(fence));
+    }
+
+    for (i = 0; i < n; i++) {
+        if (pread(l[i].fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)
+                || (hdr.magic != HT2C_MAGIC)
+                || (hdr.version != HT2C_VERSION)
+                || (hdr.fence_bits != HT2C_FENCE_BITS)) {
+            printf("invalid compact table file %02x/%02x\n", l[i].cand[0], l[i].cand[1]);
+            exit(1);
+        }
+
+        if (pread(l[i].fd, fence, sizeof(fence), HT2C_FENCE_OFFSET + (l[i].sub * sizeof(uint32_t))) != sizeof(fence)) {
+            printf("cannot read fence of compact table file %02x/%02x\n", l[i].cand[0], l[i].cand[1]);
+            exit(1);
+        }
+
+        l[i].rice_k = hdr.rice_k;
+        l[i].start = fence[0];
+        l[i].end = fence[1];
+    }
+}
+
+// search one batch of lookups, returns the index of the matching lookup or -1
+static int compactsearch(struct lookup *l, int n, unsigned char **buf, size_t *buflen, uint64_t **pos, uint64_t *poslen, uint64_t *outstate) {
+    Hitag_State hstate;
+    unsigned char ks[6];
+    int i;
+
+    compactfence(l, n);
+
+    // queue the sub-bucket pages of the whole batch
+    for (i = 0; i < n; i++) {
+        prefetch(l[i].fd, HT2C_DATA_OFFSET + l[i].start, l[i].end - l[i].start);
+    }
+
+    for (i = 0; i < n; i++) {
+        size_t len = l[i].end - l[i].start;
+
+        if (len > *buflen) {
+            *buflen = len;
+            *buf = (unsigned char *)realloc(*buf, len);
+            if (!*buf) {
+                printf("cannot realloc sub-bucket buffer\n");
+                exit(1);
+            }
+        }
+
+        // every entry takes at least one bit
+        if ((len * 8) > *poslen) {
+            *poslen = len * 8;
+            *pos = (uint64_t *)realloc(*pos, *poslen * sizeof(uint64_t));
+            if (!*pos) {
+                printf("cannot realloc position buffer\n");
+                exit(1);
+            }
+        }
+
+        if (pread(l[i].fd, *buf, len, HT2C_DATA_OFFSET + l[i].start) != (ssize_t)len) {
+            printf("cannot read compact table file %02x/%02x\n", l[i].cand[0], l[i].cand[1]);
+            exit(1);
+        }
+
+        uint64_t count = ht2c_decode(*buf, len, l[i].rice_k, *pos, *poslen);
+
+        // regenerate the keystream of every entry in the sub-bucket
+        for (uint64_t j = 0; j < count; j++) {
+            uint64_t state = ht2c_pos2state((*pos)[j]);
+
+            hstate.shiftreg = state;
+            buildlfsr(&hstate);
+            writebuf(ks, hitag2_nstep(&hstate, 24), 3);
+            if (memcmp(ks, l[i].cand, 3)) {
+                continue;
+            }
+            writebuf(ks + 3, hitag2_nstep(&hstate, 24), 3);
+
+            if (!memcmp(ks, l[i].cand, 6) && teststate(state, l[i].rngtest, l[i].fwd)) {
+                *outstate = state;
+                return i;
+            }
+        }
+    }
+
+    return -1;
+}
+
+static int findmatch_compact(struct rngdata *r, unsigned char *outmatch, unsigned char *outstate, int *bitoffset) {
+    struct lookup *l;
+    unsigned char *buf = NULL;
+    size_t buflen = 0;
+    uint64_t *pos = NULL;
+    uint64_t poslen = 0;
+    uint64_t state = 0;
+    int bitlen;
+    int nlookups;
+    int found = -1;
+    int i, j;
+
+    if (!r || !outmatch || !outstate || !bitoffset) {
+        printf("findmatch_compact: invalid params\n");
+        return 0;
+    }
+
+    bitlen = r->len * 8;
+    if (bitlen < 96) {
+        printf("findmatch_compact: not enough rng data\n");
+        return 0;
+    }
+
+    nlookups = bitlen - 47;
+    l = (struct lookup *)calloc(nlookups, sizeof(struct lookup));
+    if (!l) {
+        printf("cannot calloc lookups\n");
+        exit(1);
+    }
+
+    // build every keystream window up front, with the same test data as findmatch
+    for (i = 0; i < nlookups; i++) {
+        l[i].bitoffset = i;
+        if (!makecand(l[i].cand, r, i)) {
+            printf("cannot makecand, %d\n", i);
+            free(l);
+            return 0;
+        }
+
+        if (i < (bitlen - 96)) {
+            if (!makecand(l[i].rngtest, r, i + 48)) {
+                printf("cannot makecand rngtest %d + 48\n", i);
+                free(l);
+                return 0;
+            }
+            l[i].fwd = 1;
+        } else {
+            if (!makecand(l[i].rngtest, r, i - 48)) {
+                printf("cannot makecand rngtest %d - 48\n", i);
+                free(l);
+                return 0;
+            }
+            l[i].fwd = 0;
+        }
+
+        l[i].sub = ht2c_subbucket(l[i].cand + 2);
+    }
+
+    // walk the table in file order
+    qsort(l, nlookups, sizeof(struct lookup), lookupcmp);
+
+    for (i = 0; (i < nlookups) && (found < 0); i += COMPACT_BATCH) {
+        int n = ((nlookups - i) < COMPACT_BATCH) ? (nlookups - i) : COMPACT_BATCH;
+
+        if (((i / COMPACT_BATCH) % 4) == 0) {
+            printf("searching windows %d-%d of %d\n", i, i + n - 1, nlookups);
+        }
+
+        int res = compactsearch(l + i, n, &buf, &buflen, &pos, &poslen, &state);
+        if (res >= 0) {
+            found = i + res;
+        }
+
+        for (j = 0; j < n; j++) {
+            if (!j || (l[i + j].fd != l[i + j - 1].fd)) {
+                close(l[i + j].fd);
+            }
+        }
+    }
+
+    if (found >= 0) {
+        memcpy(outmatch, l[found].cand, 6);
+        writebuf(outstate, state, 6);
+        *bitoffset = l[found].bitoffset;
+    }
+
+    free(pos);
+    free(buf);
+    free(l);
+
+    return (found >= 0);
+}
+
 static void rollbackrng(Hitag_State *hstate, const unsigned char *s, int offset) {
     int i;
 
@@ -385,7 +642,15 @@ int main(int argc, char *argv[]) {
     }
 
 
-    if (!findmatch(&rng, rngmatch, rngstate, &bitoffset)) {
+    struct stat compactstat;
+    if (!stat(COMPACTDIR, &compactstat) && S_ISDIR(compactstat.st_mode)) {
+        printf("using compact table in " COMPACTDIR "/\n");
+        ht2c_init();
+        if (!findmatch_compact(&rng, rngmatch, rngstate, &bitoffset)) {
+            printf("couldn't find a match\n");
+            exit(1);
+        }
+    } else if (!findmatch(&rng, rngmatch, rngstate, &bitoffset)) {
         printf("couldn't find a match\n");
         exit(1);
     }
@@ -32,9 +32,10 @@
  * a table size of about 3000000 and expect it to take around 4 mins to run, but
  * with a high likelihood of success.
  *
- * Setting table size to a large number (~32000000) will likely blow up the stack
- * during the recursive qsort().  This could be fixed by making the stack space
- * larger but really, you need a smaller table and more encrypted nonces.
+ * Each round only the best half of the table is kept.  They are found with a
+ * selection of the score threshold rather than a full sort of the table, and
+ * are then copied and expanded in parallel into a second table, so the table
+ * size is only limited by memory (2 * TABLESIZE * (16 + 4 * pairs) bytes).
  *
  * The scoring of the guesses is controversial, having been tweaked over and again
  * to find a measure that provides the best results.  Feel free to tweak it yourself
@@ -66,28 +67,48 @@ struct nonce {
     uint64_t ks;
 };
 
-/* guess table entry - we store key guesses and do the maths to convert
- * to states in the code
- * score is used for sorting purposes
- * b0to31 is an array of the keystream generated from the init state
- * that is later XORed with the encrypted nonce and key guess
+/* guess table - we store key guesses and do the maths to convert
+ * to states in the code.  The table is a struct of arrays so every
+ * pass only streams through the fields it needs.
+ * score is used for selecting the best guesses
+ * b0to31 holds num_nRaR words per guess, the keystream generated from
+ * the init state that is later XORed with the encrypted nonce and key guess.
+ * Only bits 0-31 are ever used, the bit generated in the last round is not.
  */
-struct guess {
-    uint64_t key;
-    double score;
-    uint64_t b0to31[MAX_NONCES];
+struct guess_table {
+    uint64_t *key;
+    double *score;
+    uint32_t *b0to31;
 };
 
-/* thread_data is the data sent to the scoring threads */
+/* thread_data is the data sent to the scoring, selection and checking threads */
 struct thread_data {
     unsigned int start;
     unsigned int end;
     unsigned int size;
+    // selection
+    unsigned int num_gt;
+    unsigned int num_eq;
+    unsigned int quota_eq;
+    unsigned int dest;
+    double best_score;
+    double min_score;
+    uint64_t best_key;
 };
 
-/* guess table and encrypted nonce/keystream table */
-struct guess *guesses = NULL;
+/* guess table, the spare table the best guesses are expanded into,
+ * and encrypted nonce/keystream table */
+struct guess_table guesses;
+struct guess_table spare;
 unsigned int num_guesses;
+unsigned int table_capacity;
+double *scratch = NULL;
+double sel_threshold;
+unsigned int sel_halfsize;
+double top_score;
+double min_score;
+uint64_t top_key;
+int found_idx = -1;  // shared by the check threads, only use __atomic_* on it
 struct nonce nonces[MAX_NONCES];
 unsigned int num_nRaR;
 uint64_t uid;
@@ -224,31 +245,41 @@ static uint64_t packstate(uint64_t s) {
 }
 
 
-/* create_guess_table mallocs the tables */
+static void alloc_table(struct guess_table *t) {
+    t->key = (uint64_t *)calloc(table_capacity, sizeof(uint64_t));
+    t->score = (double *)calloc(table_capacity, sizeof(double));
+    t->b0to31 = (uint32_t *)calloc((size_t)table_capacity * num_nRaR, sizeof(uint32_t));
+    if (!t->key || !t->score || !t->b0to31) {
+        printf("Failed to allocate memory\n");
+        exit(1);
+    }
+}
+
+
+/* create_guess_table mallocs the tables, once the number of nRaR pairs is known */
 static void create_guess_table(void) {
-    guesses = (struct guess *)calloc(1, sizeof(struct guess) * maxtablesize);
-    if (guesses == NULL) {
+    // the first round starts with 2^16 guesses whatever the table size
+    table_capacity = (maxtablesize < 65536) ? 65536 : maxtablesize;
+
+    alloc_table(&guesses);
+    alloc_table(&spare);
+
+    scratch = (double *)calloc(table_capacity, sizeof(double));
+    if (!scratch) {
         printf("Failed to allocate memory\n");
         exit(1);
     }
 }
 
 
-/* init the guess table by reading in the encrypted nR,aR values and
- * setting the first 2^16 key guesses */
-static void init_guess_table(char *filename, char *uidstr) {
-    unsigned int i, j;
+/* read in the encrypted nR,aR values */
+static void load_nonces(char *filename, char *uidstr) {
     FILE *fp;
     char *buf = NULL;
     char *buft1 = NULL;
     char *buft2 = NULL;
     size_t lenbuf = 64;
 
-    if (!guesses) {
-        printf("guesses is NULL\n");
-        exit(1);
-    }
-
     // read uid
     if (!strncmp(uidstr, "0x", 2)) {
         uid = rev32(hexreversetoulong(uidstr + 2));
@@ -296,43 +327,34 @@ static void init_guess_table(char *filename, char *uidstr) {
     }
 
     fclose(fp);
+    free(buf);
     fprintf(stderr, "Loaded %u nRaR pairs\n", num_nRaR);
+}
 
-    // set key and copy in enc_nR and ks values
+
+/* init the guess table by setting the first 2^16 key guesses */
+static void init_guess_table(void) {
+    // set key, the b0to31 values are zero from calloc
     // set score to -1.0 to distinguish them from 0 scores
-    for (i = 0; i < 65536; i++) {
-        guesses[i].key = i;
-        guesses[i].score = -1.0;
-        for (j = 0; j < num_nRaR; j++) {
-            guesses[i].b0to31[j] = 0;
-        }
+    for (unsigned int i = 0; i < 65536; i++) {
+        guesses.key[i] = i;
+        guesses.score[i] = -1.0;
     }
 
     num_guesses = 65536;
 }
 
 
-/* bit_score calculates the ratio of partial states that could generate
- * the resulting bit b to all possible states
- * size is the number of confirmed bits in the state */
-static double bit_score(uint64_t s, uint64_t size, uint64_t b) {
-    uint64_t packed;
-    uint64_t chopped;
-    unsigned int n;
-    uint64_t b1;
-    double nibprob1, nibprob0, prob;
-    unsigned int fncinput;
-
-
-    // chop away any bits beyond size
-    chopped = s & ((1l << size) - 1);
-    // and pack the remaining bits
-    packed = packstate(chopped);
-
-    // calc size of packed version
-    n = packed_size[size];
-
-    b1 = b & 0x1;
+/* bit_score calculates, for every trace, the ratio of partial states that
+ * could generate the resulting bit b to all possible states.
+ * s are the states and b the keystream bits, both used from bit shift onwards.
+ * size is the number of confirmed bits in the states; it is the same for all
+ * traces, so the case selection is done once and each case is a branch free
+ * loop over the traces that the compiler can vectorise. */
+static void bit_score(const uint64_t *s, unsigned int shift, unsigned int size, const uint64_t *b, double *out) {
+    const uint64_t mask = (1ULL << size) - 1;
+    const unsigned int n = packed_size[size];
+    unsigned int i;
 
     // calc probability of getting b1
 
@@ -342,165 +364,152 @@ static double bit_score(uint64_t s, uint64_t size, uint64_t b) {
     if (n == 0) {
         // catch the case where we have no relevant bits and return
         // the default probability
-        return 0.5;
+        for (i = 0; i < num_nRaR; i++) {
+            out[i] = 0.5;
+        }
     } else if (n < 4) {
         // incomplete first nibble
         // get probability of getting a 1 from first nibble
         // and by subtraction from 1, prob of getting a 0
-        nibprob1 = pfna[n - 1][packed];
-        nibprob0 = 1.0 - nibprob1;
-
-        // calc fnc prob as sum of probs of nib 1 producing a 1 and 0
-        prob = (nibprob0 * pfnc[0][0]) + (nibprob1 * pfnc[0][1]);
+        // then calc fnc prob as sum of probs of nib 1 producing a 1 and 0
+        for (i = 0; i < num_nRaR; i++) {
+            uint64_t packed = packstate((s[i] >> shift) & mask);
+            double nibprob1 = pfna[n - 1][packed];
+            double nibprob0 = 1.0 - nibprob1;
+            double prob = (nibprob0 * pfnc[0][0]) + (nibprob1 * pfnc[0][1]);
+            out[i] = ((b[i] >> shift) & 1) ? prob : (1.0 - prob);
+        }
     } else if (n < 20) {
-        // calculate the fnc input first, then we'll fix it
-        fncinput = (ht2_function4a >> (packed & 0xf)) & 1;
-        fncinput |= ((ht2_function4b << 1) >> ((packed >> 4) & 0xf)) & 0x02;
-        fncinput |= ((ht2_function4b << 2) >> ((packed >> 8) & 0xf)) & 0x04;
-        fncinput |= ((ht2_function4b << 3) >> ((packed >> 12) & 0xf)) & 0x08;
-        fncinput |= ((ht2_function4a << 4) >> ((packed >> 16) & 0xf)) & 0x10;
-
-        // mask to keep the full nibble bits
-        fncinput = fncinput & ((1l << (n / 4)) - 1);
-
-        if ((n % 4) == 0) {
-            // only complete nibbles
-            prob = pfnc[(n / 4) - 1][fncinput];
-        } else {
-            // one nibble is incomplete
-            if (n <= 16) {
-                // it's in the fnb area
-                nibprob1 = pfnb[(n % 4) - 1][packed >> ((n / 4) * 4)];
-                nibprob0 = 1.0 - nibprob1;
-                prob = (nibprob0 * pfnc[n / 4][fncinput]) + (nibprob1 * pfnc[n / 4][fncinput | (1l << (n / 4))]);
+        for (i = 0; i < num_nRaR; i++) {
+            uint64_t packed = packstate((s[i] >> shift) & mask);
+            double prob;
+
+            // calculate the fnc input first, then we'll fix it
+            unsigned int fncinput = (ht2_function4a >> (packed & 0xf)) & 1;
+            fncinput |= ((ht2_function4b << 1) >> ((packed >> 4) & 0xf)) & 0x02;
+            fncinput |= ((ht2_function4b << 2) >> ((packed >> 8) & 0xf)) & 0x04;
+            fncinput |= ((ht2_function4b << 3) >> ((packed >> 12) & 0xf)) & 0x08;
+            fncinput |= ((ht2_function4a << 4) >> ((packed >> 16) & 0xf)) & 0x10;
+
+            // mask to keep the full nibble bits
+            fncinput = fncinput & ((1U << (n / 4)) - 1);
+
+            if ((n % 4) == 0) {
+                // only complete nibbles
+                prob = pfnc[(n / 4) - 1][fncinput];
+            } else if (n <= 16) {
+                // one nibble is incomplete, it's in the fnb area
+                double nibprob1 = pfnb[(n % 4) - 1][packed >> ((n / 4) * 4)];
+                double nibprob0 = 1.0 - nibprob1;
+                prob = (nibprob0 * pfnc[n / 4][fncinput]) + (nibprob1 * pfnc[n / 4][fncinput | (1U << (n / 4))]);
             } else {
-                // it's in the final fna
-                nibprob1 = pfna[(n % 4) - 1][packed >> 16];
-                nibprob0 = 1.0 - nibprob1;
+                // one nibble is incomplete, it's in the final fna
+                double nibprob1 = pfna[(n % 4) - 1][packed >> 16];
+                double nibprob0 = 1.0 - nibprob1;
                 prob = (nibprob0 * ((ht2_function5c >> fncinput) & 0x1)) + (nibprob1 * ((ht2_function5c >> (fncinput | 0x10)) & 0x1));
             }
+
+            out[i] = ((b[i] >> shift) & 1) ? prob : (1.0 - prob);
         }
     } else {
         // n==20
-        prob = f20(packed);
-    }
-
-    if (b1) {
-        return prob;
-    } else {
-        return (1.0 - prob);
-    }
-}
-
-
-/* score is like bit_score but does multiple bit correlation.
- * bit_score and then shift and then repeat, adding all
- * bit_scores together until no bits remain. bit_scores are
- * multiplied by the number of relevant bits in the scored state
- * to give weight to more complete states. */
-static double score(uint64_t s, unsigned int size, uint64_t ks, unsigned int kssize) {
-    double sc;
-
-    if ((size == 1) || (kssize == 1)) {
-        sc = bit_score(s, size, ks & 0x1);
-        return (sc * (packed_size[size] + 1));
-    } else {
-        // I've introduced a weighting for each score to
-        // give more significance to bigger windows.
-
-        sc = bit_score(s, size, ks & 0x1);
-
-        // if a bit_score returns a probability of 0 then this can't be a winner
-        if (sc == 0.0) {
-            return 0.0;
-        } else {
-
-            double sc2 = score(s >> 1, size - 1, ks >> 1, kssize - 1);
-
-            // if score returns a probability of 0 then this can't be a winner
-            if (sc2 == 0.0) {
-                return 0.0;
-            } else {
-                return (sc * (packed_size[size] + 1)) + sc2;
-            }
+        for (i = 0; i < num_nRaR; i++) {
+            double prob = f20(packstate((s[i] >> shift) & mask));
+            out[i] = ((b[i] >> shift) & 1) ? prob : (1.0 - prob);
         }
     }
 }
 
 
-/* score_traces runs score for each encrypted nonce */
-static void score_traces(struct guess *g, unsigned int size) {
+/* score_traces does multiple bit correlation for each encrypted nonce:
+ * bit_score and then shift and then repeat, adding all bit_scores together
+ * until no bits remain. bit_scores are multiplied by the number of relevant
+ * bits in the scored state to give weight to more complete states.
+ * All traces are scored one bit position at a time, and the per trace sums
+ * are added up from the last bit position backwards. */
+static void score_traces(unsigned int g, unsigned int size) {
+    uint64_t lfsr[MAX_NONCES];
+    uint64_t ks[MAX_NONCES];
+    double sc[32][MAX_NONCES];
+    uint32_t *b0to31 = guesses.b0to31 + ((size_t)g * num_nRaR);
+    uint64_t key = guesses.key[g];
     double total_score = 0.0;
+    unsigned int i;
+    int k;
 
     // don't bother scoring traces that are already losers
-    if (g->score == 0.0) {
+    if (guesses.score[g] == 0.0) {
         return;
     }
 
-    for (unsigned int i = 0; i < num_nRaR; i++) {
+    for (i = 0; i < num_nRaR; i++) {
         // calc next b
         // create lfsr - lower 32 bits is uid, upper 16 bits are lower 16 bits of key
         // then shift by size - 16, insert upper key XOR enc_nonce XOR bitstream,
         // and calc new bit b
-        uint64_t lfsr = (uid >> (size - 16)) | ((g->key << (48 - size)) ^
-                                                ((nonces[i].enc_nR ^ g->b0to31[i]) << (64 - size)));
-        g->b0to31[i] = g->b0to31[i] | (ht2crypt(lfsr) << (size - 16));
+        uint64_t l = (uid >> (size - 16)) | ((key << (48 - size)) ^
+                                             ((nonces[i].enc_nR ^ b0to31[i]) << (64 - size)));
+        b0to31[i] = b0to31[i] | (uint32_t)(ht2crypt(l) << (size - 16));
 
         // create lfsr - lower 16 bits are lower 16 bits of key
         // bits 16-47 are upper bits of key XOR enc_nonce XOR bitstream
-        lfsr = g->key ^ ((nonces[i].enc_nR ^ g->b0to31[i]) << 16);
+        lfsr[i] = key ^ ((nonces[i].enc_nR ^ b0to31[i]) << 16);
+        ks[i] = nonces[i].ks;
+    }
+
+    // the window shrinks by one bit per position until the state or the 32 bit keystream runs out
+    int levels = (size < 32) ? size : 32;
 
-        double sc = score(lfsr, size, nonces[i].ks, 32);
+    for (k = 0; k < levels; k++) {
+        bit_score(lfsr, k, size - k, ks, sc[k]);
 
-        // look out for losers
-        if (sc == 0.0) {
-            g->score = 0.0;
+        // if a bit_score returns a probability of 0 then this can't be a winner
+        int loser = 0;
+        for (i = 0; i < num_nRaR; i++) {
+            loser |= (sc[k][i] == 0.0);
+        }
+        if (loser) {
+            guesses.score[g] = 0.0;
             return;
         }
-        total_score = total_score + sc;
     }
 
-    // save average score
-    g->score = total_score / num_nRaR;
+    for (i = 0; i < num_nRaR; i++) {
+        // I've introduced a weighting for each score to
+        // give more significance to bigger windows.
+        double tsc = sc[levels - 1][i] * (packed_size[size - levels + 1] + 1);
+        for (k = levels - 2; k >= 0; k--) {
+            tsc = (sc[k][i] * (packed_size[size - k] + 1)) + tsc;
+        }
+        total_score = total_score + tsc;
+    }
 
+    // save average score
+    guesses.score[g] = total_score / num_nRaR;
 }
 
 
-/* score_all_traces runs score_traces for every key guess in the table */
-/* this was used in the non-threaded version */
-/*
-void score_all_traces(unsigned int size)
-{
-    unsigned int i;
-
-    for (i=0; i<num_guesses; i++) {
-        score_traces(&(guesses[i]), size);
-    }
-}
-*/
-
 /* score_some_traces runs score_traces for every key guess in a section of the table */
 static void *score_some_traces(void *data) {
     unsigned int i;
     struct thread_data *tdata = (struct thread_data *)data;
 
     for (i = tdata->start; i < tdata->end; i++) {
-        score_traces(&(guesses[i]), tdata->size);
+        score_traces(i, tdata->size);
     }
 
     return NULL;
 }
 
 
-/* score_all_traces runs score_traces for every key guess in the table */
-static void score_all_traces(unsigned int size) {
+/* run_threads runs fn over NUM_THREADS sections of the first n guesses */
+static void run_threads(void *(*fn)(void *), struct thread_data *tdata, unsigned int n, unsigned int size) {
     pthread_t threads[NUM_THREADS];
     void *status;
-    struct thread_data tdata[NUM_THREADS];
     unsigned int i;
     unsigned int chunk_size;
 
-    chunk_size = num_guesses / NUM_THREADS;
+    chunk_size = n / NUM_THREADS;
 
     // create thread data
     for (i = 0; i < NUM_THREADS; i++) {
@@ -510,11 +519,11 @@ static void score_all_traces(unsigned int size) {
     }
 
     // fix last chunk
-    tdata[NUM_THREADS - 1].end = num_guesses;
+    tdata[NUM_THREADS - 1].end = n;
 
     // start the threads
     for (i = 0; i < NUM_THREADS; i++) {
-        if (pthread_create(&(threads[i]), NULL, score_some_traces, (void *)(tdata + i))) {
+        if (pthread_create(&(threads[i]), NULL, fn, (void *)(tdata + i))) {
             printf("cannot start thread %u\n", i);
             exit(1);
         }
@@ -530,37 +539,116 @@ static void score_all_traces(unsigned int size) {
 }
 
 
+/* score_all_traces runs score_traces for every key guess in the table */
+static void score_all_traces(unsigned int size) {
+    struct thread_data tdata[NUM_THREADS];
 
+    run_threads(score_some_traces, tdata, num_guesses, size);
+}
 
 
-/* cmp_guess is the comparison function for qsorting the guess table */
-static int cmp_guess(const void *a, const void *b) {
-    struct guess *a1 = (struct guess *)a;
-    struct guess *b1 = (struct guess *)b;
+/* kth_largest returns the k-th largest (0 based) of n values, reordering them */
+static double kth_largest(double *a, unsigned int n, unsigned int k) {
+    long lo = 0;
+    long hi = (long)n - 1;
 
-    if (a1->score < b1->score) {
-        return 1;
-    } else if (a1->score > b1->score) {
-        return -1;
-    } else {
-        return 0;
+    while (lo < hi) {
+        // median of three pivot, then Hoare partition in descending order
+        long mid = lo + ((hi - lo) / 2);
+        double x = a[lo], y = a[mid], z = a[hi];
+        double pivot = (x > y) ? ((y > z) ? y : ((x > z) ? z : x)) : ((x > z) ? x : ((y > z) ? z : y));
+
+        long i = lo;
+        long j = hi;
+        while (i <= j) {
+            while (a[i] > pivot) {
+                i++;
+            }
+            while (a[j] < pivot) {
+                j--;
+            }
+            if (i <= j) {
+                double t = a[i];
+                a[i] = a[j];
+                a[j] = t;
+                i++;
+                j--;
+            }
+        }
+
+        if ((long)k <= j) {
+            hi = j;
+        } else if ((long)k >= i) {
+            lo = i;
+        } else {
+            return a[k];
+        }
     }
+    return a[k];
 }
 
 
-/* expand all guesses in first half of (sorted) table by
- * copying them into the second half and extending the copied
- * ones with an extra 1, leaving the first half with an extra 0 */
-static void expand_guesses(unsigned int halfsize, unsigned int size) {
-    unsigned int i, j;
+/* count_some_guesses counts the guesses above and at the threshold in a section of the table */
+static void *count_some_guesses(void *data) {
+    struct thread_data *tdata = (struct thread_data *)data;
+
+    tdata->num_gt = 0;
+    tdata->num_eq = 0;
+    for (unsigned int i = tdata->start; i < tdata->end; i++) {
+        tdata->num_gt += (guesses.score[i] > sel_threshold);
+        tdata->num_eq += (guesses.score[i] == sel_threshold);
+    }
+
+    return NULL;
+}
+
+
+/* copy_row copies guess src of the table into guess dst of the spare table */
+static void copy_row(unsigned int dst, unsigned int src, uint64_t keybit) {
+    spare.key[dst] = guesses.key[src] | keybit;
+    spare.score[dst] = guesses.score[src];
+    memcpy(spare.b0to31 + ((size_t)dst * num_nRaR), guesses.b0to31 + ((size_t)src * num_nRaR), num_nRaR * sizeof(uint32_t));
+}
+
+
+/* expand_some_guesses copies the selected guesses of a section of the table
+ * into the first half of the spare table, extended with an extra 0, and into
+ * the second half, extended with an extra 1 */
+static void *expand_some_guesses(void *data) {
+    struct thread_data *tdata = (struct thread_data *)data;
+    unsigned int dest = tdata->dest;
+    unsigned int quota = tdata->quota_eq;
+    uint64_t keybit = 1ULL << tdata->size;
 
-    for (i = 0; i < halfsize; i++) {
-        guesses[i + halfsize].key = guesses[i].key | (1l << size);
-        guesses[i + halfsize].score = guesses[i].score;
-        for (j = 0; j < num_nRaR; j++) {
-            guesses[i + halfsize].b0to31[j] = guesses[i].b0to31[j];
+    tdata->best_score = -2.0;
+    tdata->min_score = INFINITY;
+    tdata->best_key = 0;
+
+    for (unsigned int i = tdata->start; i < tdata->end; i++) {
+        double sc = guesses.score[i];
+
+        if (!(sc > sel_threshold)) {
+            // ties at the threshold are taken in table order
+            if ((sc != sel_threshold) || (quota == 0)) {
+                continue;
+            }
+            quota--;
+        }
+
+        copy_row(dest, i, 0);
+        copy_row(dest + sel_halfsize, i, keybit);
+        dest++;
+
+        if (sc > tdata->best_score) {
+            tdata->best_score = sc;
+            tdata->best_key = guesses.key[i];
+        }
+        if (sc < tdata->min_score) {
+            tdata->min_score = sc;
         }
     }
+
+    return NULL;
 }
 
 
@@ -570,11 +658,16 @@ static void check_supplied_testkey(unsigned int size) {
     uint64_t partkey;
     unsigned int i;
 
-    partkey = supplied_testkey & ((1l << size) - 1);
+    partkey = supplied_testkey & ((1ULL << size) - 1);
 
     for (i = 0; i < num_guesses; i++) {
-        if (guesses[i].key == partkey) {
-            fprintf(stderr, " supplied test key score = %1.10f, position = %u\n", guesses[i].score, i);
+        if (guesses.key[i] == partkey) {
+            // position is the rank of the score in the table
+            unsigned int position = 0;
+            for (unsigned int j = 0; j < num_guesses; j++) {
+                position += (guesses.score[j] > guesses.score[i]);
+            }
+            fprintf(stderr, " supplied test key score = %1.10f, position = %u\n", guesses.score[i], position);
             return;
         }
     }
@@ -584,16 +677,15 @@ static void check_supplied_testkey(unsigned int size) {
 }
 
 
-/* execute_round scores the guesses, sorts them and expands the good half */
+/* execute_round scores the guesses, selects the good half and expands it */
 static void execute_round(unsigned int size) {
+    struct thread_data tdata[NUM_THREADS];
     unsigned int halfsize;
+    unsigned int i;
 
     // score all the current guesses
     score_all_traces(size);
 
-    // sort the guesses by score
-    qsort(guesses, num_guesses, sizeof(struct guess), cmp_guess);
-
     if (supplied_testkey) {
         check_supplied_testkey(size);
     }
@@ -604,9 +696,63 @@ static void execute_round(unsigned int size) {
     } else {
         halfsize = (maxtablesize / 2);
     }
+    sel_halfsize = halfsize;
 
-    // expand guesses
-    expand_guesses(halfsize, size);
+    // find the score of the worst guess we keep, no need to sort the table for that
+    if (halfsize < num_guesses) {
+        memcpy(scratch, guesses.score, num_guesses * sizeof(double));
+        sel_threshold = kth_largest(scratch, num_guesses, halfsize - 1);
+    } else {
+        sel_threshold = -INFINITY;
+    }
+
+    // count the guesses above and at the threshold in each section
+    run_threads(count_some_guesses, tdata, num_guesses, size);
+
+    // share out the guesses tied at the threshold and the destinations
+    unsigned int num_gt = 0;
+    for (i = 0; i < NUM_THREADS; i++) {
+        num_gt += tdata[i].num_gt;
+    }
+    unsigned int remaining_eq = halfsize - num_gt;
+    unsigned int dest = 0;
+    for (i = 0; i < NUM_THREADS; i++) {
+        tdata[i].quota_eq = (tdata[i].num_eq < remaining_eq) ? tdata[i].num_eq : remaining_eq;
+        remaining_eq -= tdata[i].quota_eq;
+        tdata[i].dest = dest;
+        dest += tdata[i].num_gt + tdata[i].quota_eq;
+    }
+
+    // expand guesses into the spare table, this keeps the chunks and quotas set above
+    pthread_t threads[NUM_THREADS];
+    for (i = 0; i < NUM_THREADS; i++) {
+        if (pthread_create(&(threads[i]), NULL, expand_some_guesses, (void *)(tdata + i))) {
+            printf("cannot start thread %u\n", i);
+            exit(1);
+        }
+    }
+    for (i = 0; i < NUM_THREADS; i++) {
+        if (pthread_join(threads[i], NULL)) {
+            printf("cannot join thread %u\n", i);
+            exit(1);
+        }
+    }
+
+    top_score = -2.0;
+    min_score = INFINITY;
+    for (i = 0; i < NUM_THREADS; i++) {
+        if (tdata[i].best_score > top_score) {
+            top_score = tdata[i].best_score;
+            top_key = tdata[i].best_key;
+        }
+        if (tdata[i].min_score < min_score) {
+            min_score = tdata[i].min_score;
+        }
+    }
+
+    struct guess_table t = guesses;
+    guesses = spare;
+    spare = t;
 
     num_guesses = halfsize * 2;
 }
@@ -619,9 +765,9 @@ static void crack(void) {
         execute_round(i);
 
         // print some metrics
-        uint64_t revkey = rev64(guesses[0].key);
+        uint64_t revkey = rev64(top_key);
         uint64_t foundkey = ((revkey >> 40) & 0xff) | ((revkey >> 24) & 0xff00) | ((revkey >> 8) & 0xff0000) | ((revkey << 8) & 0xff000000) | ((revkey << 24) & 0xff00000000) | ((revkey << 40) & 0xff0000000000);
-        fprintf(stderr, " guess=%012" PRIx64 ", num_guesses = %u, top score=%1.10f, min score=%1.10f\n", foundkey, num_guesses, guesses[0].score, guesses[num_guesses - 1].score);
+        fprintf(stderr, " guess=%012" PRIx64 ", num_guesses = %u, top score=%1.10f, min score=%1.10f\n", foundkey, num_guesses, top_score, min_score);
     }
 }
 
@@ -769,9 +915,25 @@ static int check_key(uint64_t key, uint64_t enc_nR, uint64_t ks) {
 }
 
 
+/* check_some_keys tests all key guesses in a section of the table until one works */
+static void *check_some_keys(void *data) {
+    struct thread_data *tdata = (struct thread_data *)data;
+
+    for (unsigned int i = tdata->start; (i < tdata->end) && (__atomic_load_n(&found_idx, __ATOMIC_ACQUIRE) < 0); i++) {
+        if (check_key(guesses.key[i], nonces[0].enc_nR, nonces[0].ks) &&
+                check_key(guesses.key[i], nonces[1].enc_nR, nonces[1].ks)) {
+            // first thread to find a key wins, the others leave it alone
+            int none = -1;
+            __atomic_compare_exchange_n(&found_idx, &none, (int)i, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    return NULL;
+}
+
 /* start up */
 int main(int argc, char *argv[]) {
-    unsigned int i;
+    struct thread_data tdata[NUM_THREADS];
     uint64_t revkey;
     uint64_t foundkey;
     int tot_nRaR = 0;
@@ -811,27 +973,28 @@ int main(int argc, char *argv[]) {
         usage();
     }
 
-    create_guess_table();
-
-    init_guess_table(noncefilestr, uidstr);
+    load_nonces(noncefilestr, uidstr);
 
     if ((tot_nRaR > 0) && (tot_nRaR <= num_nRaR)) {
         num_nRaR = tot_nRaR;
     }
     fprintf(stderr, "Using %u nRaR pairs\n", num_nRaR);
 
+    create_guess_table();
+
+    init_guess_table();
+
     crack();
 
-    // test all key guesses and stop if one works
-    for (i = 0; i < num_guesses; i++) {
-        if (check_key(guesses[i].key, nonces[0].enc_nR, nonces[0].ks) &&
-                check_key(guesses[i].key, nonces[1].enc_nR, nonces[1].ks)) {
-            printf("WIN!!! :)\n");
-            revkey = rev64(guesses[i].key);
-            foundkey = ((revkey >> 40) & 0xff) | ((revkey >> 24) & 0xff00) | ((revkey >> 8) & 0xff0000) | ((revkey << 8) & 0xff000000) | ((revkey << 24) & 0xff00000000) | ((revkey << 40) & 0xff0000000000);
-            printf("key = %012" PRIX64 "\n", foundkey);
-            exit(0);
-        }
+    // test all key guesses in parallel and stop if one works
+    run_threads(check_some_keys, tdata, num_guesses, 0);
+    int idx = __atomic_load_n(&found_idx, __ATOMIC_ACQUIRE);
+    if (idx >= 0) {
+        printf("WIN!!! :)\n");
+        revkey = rev64(guesses.key[idx]);
+        foundkey = ((revkey >> 40) & 0xff) | ((revkey >> 24) & 0xff00) | ((revkey >> 8) & 0xff0000) | ((revkey << 8) & 0xff000000) | ((revkey << 24) & 0xff00000000) | ((revkey << 40) & 0xff0000000000);
+        printf("key = %012" PRIX64 "\n", foundkey);
+        exit(0);
     }
 
     printf("FAIL :( - none of the potential keys in the table are correct.\n");
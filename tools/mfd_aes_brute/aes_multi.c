@@ -0,0 +1,305 @@
+//-----------------------------------------------------------------------------
+//  Copyright Iceman 2022
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+// Multi-key AES-128 engine, see aes_multi.h
+//
+// The SIMD engines expand all key schedules side by side and then run the
+// decryptions of every key in lockstep, so the AES units always have
+// independent rounds in flight instead of waiting on one dependency chain.
+//
+// Key expansion uses AESENCLAST instead of AESKEYGENASSIST: with RotWord(w3)
+// broadcast to all four columns ShiftRows is a no-op, so AESENCLAST with the
+// round constant as key gives SubWord(RotWord(w3)) ^ rcon.  That also has a
+// 512-bit VAES form, AESKEYGENASSIST does not.  The decryption keys need
+// InvMixColumns, which is AESDEC(AESENCLAST(x, 0), 0) for the same reason.
+//-----------------------------------------------------------------------------
+
+#include "aes_multi.h"
+
+#include <string.h>
+#include <openssl/evp.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AESM_X86
+#include <immintrin.h>
+#include "detectaes.h"
+#endif
+
+// VAES intrinsics need gcc 8 or clang 8, build with -DAESM_NO_VAES to leave them out
+#if defined(AESM_X86) && !defined(AESM_NO_VAES) && \
+    ((defined(__clang__) && (__clang_major__ >= 8)) || (!defined(__clang__) && defined(__GNUC__) && (__GNUC__ >= 8)))
+#define AESM_HAVE_VAES
+#endif
+
+static const uint8_t rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1b, 0x36 };
+
+// rndB' is rndB rotated left one byte
+static bool match(const uint8_t dec_tag[16], const uint8_t dec_rdr[16]) {
+    if (dec_tag[0] != dec_rdr[15])
+        return false;
+
+    return memcmp(dec_tag + 1, dec_rdr, 15) == 0;
+}
+
+static uint32_t check_openssl(const aesm_ctx_t *ctx, const uint8_t *keys, uint32_t n) {
+    uint32_t res = 0;
+    uint8_t iv[16] = {0};
+    EVP_CIPHER_CTX *ectx = EVP_CIPHER_CTX_new();
+    if (ectx == NULL)
+        return 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint8_t dec_tag[16];
+        uint8_t dec_rdr[16];
+        int len = 0;
+
+        // ECB on single blocks, the CBC chaining is applied by hand
+        EVP_DecryptInit_ex(ectx, EVP_aes_128_ecb(), NULL, keys + (i * 16), NULL);
+        EVP_CIPHER_CTX_set_padding(ectx, 0);
+        EVP_DecryptUpdate(ectx, dec_tag, &len, ctx->tag, 16);
+        EVP_DecryptUpdate(ectx, dec_rdr, &len, ctx->rdr + 16, 16);
+
+        for (int j = 0; j < 16; j++) {
+            dec_tag[j] ^= iv[j];
+            dec_rdr[j] ^= ctx->rdr[j];
+        }
+
+        if (match(dec_tag, dec_rdr))
+            res |= (1U << i);
+    }
+
+    EVP_CIPHER_CTX_free(ectx);
+    return res;
+}
+
+#ifdef AESM_X86
+
+#define AESNI_TARGET __attribute__((target("aes,sse4.1")))
+#define AESNI_KEYS  8
+
+AESNI_TARGET static inline __m128i aesni_expand(__m128i k, __m128i rc) {
+    __m128i t = _mm_aesenclast_si128(_mm_shuffle_epi8(k, _mm_set1_epi32(0x0c0f0e0d)), rc);
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 8));
+    return _mm_xor_si128(k, t);
+}
+
+AESNI_TARGET static uint32_t check_aesni8(const aesm_ctx_t *ctx, const uint8_t *keys) {
+    __m128i rk[11][AESNI_KEYS];
+    __m128i t[AESNI_KEYS];
+    __m128i h[AESNI_KEYS];
+
+    for (int l = 0; l < AESNI_KEYS; l++) {
+        rk[0][l] = _mm_loadu_si128((const __m128i *)(keys + (l * 16)));
+    }
+
+    for (int r = 1; r <= 10; r++) {
+        __m128i rc = _mm_set1_epi32(rcon[r - 1]);
+        for (int l = 0; l < AESNI_KEYS; l++) {
+            rk[r][l] = aesni_expand(rk[r - 1][l], rc);
+        }
+    }
+
+    __m128i tag = _mm_loadu_si128((const __m128i *)ctx->tag);
+    __m128i rdr0 = _mm_loadu_si128((const __m128i *)ctx->rdr);
+    __m128i rdr1 = _mm_loadu_si128((const __m128i *)(ctx->rdr + 16));
+
+    for (int l = 0; l < AESNI_KEYS; l++) {
+        t[l] = _mm_xor_si128(tag, rk[10][l]);
+        h[l] = _mm_xor_si128(rdr1, rk[10][l]);
+    }
+
+    for (int r = 9; r > 0; r--) {
+        for (int l = 0; l < AESNI_KEYS; l++) {
+            __m128i dk = _mm_aesimc_si128(rk[r][l]);
+            t[l] = _mm_aesdec_si128(t[l], dk);
+            h[l] = _mm_aesdec_si128(h[l], dk);
+        }
+    }
+
+    uint32_t res = 0;
+    for (int l = 0; l < AESNI_KEYS; l++) {
+        t[l] = _mm_aesdeclast_si128(t[l], rk[0][l]);
+        h[l] = _mm_xor_si128(_mm_aesdeclast_si128(h[l], rk[0][l]), rdr0);
+
+        __m128i eq = _mm_cmpeq_epi8(h[l], _mm_alignr_epi8(t[l], t[l], 1));
+        if (_mm_movemask_epi8(eq) == 0xFFFF)
+            res |= (1U << l);
+    }
+    return res;
+}
+
+static uint32_t check_aesni(const aesm_ctx_t *ctx, const uint8_t *keys) {
+    return check_aesni8(ctx, keys) | (check_aesni8(ctx, keys + (AESNI_KEYS * 16)) << AESNI_KEYS);
+}
+
+#endif // AESM_X86
+
+#ifdef AESM_HAVE_VAES
+
+#define VAES_TARGET __attribute__((target("aes,avx512f,avx512bw,vaes")))
+#define VAES_REGS   (AESM_LANES / 4)
+
+VAES_TARGET static inline __m512i vaes_expand(__m512i k, __m512i rc) {
+    __m512i t = _mm512_aesenclast_epi128(_mm512_shuffle_epi8(k, _mm512_set1_epi32(0x0c0f0e0d)), rc);
+    k = _mm512_xor_si512(k, _mm512_bslli_epi128(k, 4));
+    k = _mm512_xor_si512(k, _mm512_bslli_epi128(k, 8));
+    return _mm512_xor_si512(k, t);
+}
+
+VAES_TARGET static inline __m512i vaes_imc(__m512i k) {
+    const __m512i zero = _mm512_setzero_si512();
+    return _mm512_aesdec_epi128(_mm512_aesenclast_epi128(k, zero), zero);
+}
+
+VAES_TARGET static uint32_t check_vaes(const aesm_ctx_t *ctx, const uint8_t *keys) {
+    __m512i rk[11][VAES_REGS];
+    __m512i t[VAES_REGS];
+    __m512i h[VAES_REGS];
+
+    for (int g = 0; g < VAES_REGS; g++) {
+        rk[0][g] = _mm512_loadu_si512((const void *)(keys + (g * 64)));
+    }
+
+    for (int r = 1; r <= 10; r++) {
+        __m512i rc = _mm512_set1_epi32(rcon[r - 1]);
+        for (int g = 0; g < VAES_REGS; g++) {
+            rk[r][g] = vaes_expand(rk[r - 1][g], rc);
+        }
+    }
+
+    // maskz form, the plain broadcast trips -Wuninitialized on gcc 12
+    __m512i tag = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_loadu_si128((const __m128i *)ctx->tag));
+    __m512i rdr0 = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_loadu_si128((const __m128i *)ctx->rdr));
+    __m512i rdr1 = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_loadu_si128((const __m128i *)(ctx->rdr + 16)));
+
+    for (int g = 0; g < VAES_REGS; g++) {
+        t[g] = _mm512_xor_si512(tag, rk[10][g]);
+        h[g] = _mm512_xor_si512(rdr1, rk[10][g]);
+    }
+
+    for (int r = 9; r > 0; r--) {
+        for (int g = 0; g < VAES_REGS; g++) {
+            __m512i dk = vaes_imc(rk[r][g]);
+            t[g] = _mm512_aesdec_epi128(t[g], dk);
+            h[g] = _mm512_aesdec_epi128(h[g], dk);
+        }
+    }
+
+    uint32_t res = 0;
+    for (int g = 0; g < VAES_REGS; g++) {
+        t[g] = _mm512_aesdeclast_epi128(t[g], rk[0][g]);
+        h[g] = _mm512_xor_si512(_mm512_aesdeclast_epi128(h[g], rk[0][g]), rdr0);
+
+        uint64_t eq = _mm512_cmpeq_epi8_mask(h[g], _mm512_alignr_epi8(t[g], t[g], 1));
+        for (int j = 0; j < 4; j++) {
+            if (((eq >> (j * 16)) & 0xFFFF) == 0xFFFF)
+                res |= (1U << ((g * 4) + j));
+        }
+    }
+    return res;
+}
+
+#endif // AESM_HAVE_VAES
+
+bool aesm_engine_supported(aesm_engine_t engine) {
+    switch (engine) {
+        case AESM_OPENSSL:
+            return true;
+        case AESM_AESNI:
+#ifdef AESM_X86
+            return platform_aes_hw_available();
+#else
+            return false;
+#endif
+        case AESM_VAES:
+#ifdef AESM_HAVE_VAES
+            return platform_vaes_hw_available();
+#else
+            return false;
+#endif
+        case AESM_ENGINES:
+        default:
+            return false;
+    }
+}
+
+aesm_engine_t aesm_best_engine(void) {
+    for (int e = AESM_ENGINES - 1; e > AESM_OPENSSL; e--) {
+        if (aesm_engine_supported(e))
+            return e;
+    }
+    return AESM_OPENSSL;
+}
+
+const char *aesm_engine_name(aesm_engine_t engine) {
+    switch (engine) {
+        case AESM_OPENSSL:
+            return "OpenSSL";
+        case AESM_AESNI:
+            return "AES-NI x16";
+        case AESM_VAES:
+            return "VAES x16";
+        case AESM_ENGINES:
+        default:
+            return "unknown";
+    }
+}
+
+void aesm_init(aesm_ctx_t *ctx, aesm_engine_t engine, const uint8_t tag[16], const uint8_t rdr[32]) {
+    ctx->engine = (aesm_engine_supported(engine)) ? engine : AESM_OPENSSL;
+    memcpy(ctx->tag, tag, sizeof(ctx->tag));
+    memcpy(ctx->rdr, rdr, sizeof(ctx->rdr));
+}
+
+uint32_t aesm_check(const aesm_ctx_t *ctx, const uint8_t *keys, uint32_t n) {
+
+    if (n == 0 || n > AESM_LANES)
+        return 0;
+
+    if (ctx->engine == AESM_OPENSSL)
+        return check_openssl(ctx, keys, n);
+
+    // the SIMD engines always run all lanes, pad a short batch
+    uint8_t padded[AESM_LANES * 16];
+    if (n < AESM_LANES) {
+        memset(padded, 0, sizeof(padded));
+        memcpy(padded, keys, n * 16);
+        keys = padded;
+    }
+
+    uint32_t res;
+    switch (ctx->engine) {
+        case AESM_VAES:
+#ifdef AESM_HAVE_VAES
+            res = check_vaes(ctx, keys);
+            break;
+#endif
+        case AESM_AESNI:
+#ifdef AESM_X86
+            res = check_aesni(ctx, keys);
+            break;
+#endif
+        case AESM_OPENSSL:
+        case AESM_ENGINES:
+        default:
+            res = check_openssl(ctx, keys, AESM_LANES);
+            break;
+    }
+
+    return res & ((n < 32) ? ((1U << n) - 1) : 0xFFFFFFFF);
+}
@@ -0,0 +1,62 @@
+//-----------------------------------------------------------------------------
+//  Copyright Iceman 2022
+//
+//  This program is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation, either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+// Multi-key AES-128 engine for the MIFARE DESFire AES bruteforcers
+//
+// A candidate key matches a sniffed authentication when the tag challenge
+// decrypted with it (rndB) equals the second block of the CBC decrypted reader
+// response (rndB rotated left one byte).  Only those two blocks are decrypted.
+//
+// The engine is picked at runtime from what the CPU supports:
+//   VAES     16 keys per call, 4 per 512-bit register (VAES + AVX-512BW)
+//   AES-NI   16 keys per call, two interleaved groups of 8
+//   OpenSSL  one key at a time, any platform
+//-----------------------------------------------------------------------------
+
+#ifndef AES_MULTI_H__
+#define AES_MULTI_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// keys handled by one aesm_check() call
+#define AESM_LANES  16
+
+typedef enum {
+    AESM_OPENSSL = 0,
+    AESM_AESNI,
+    AESM_VAES,
+    AESM_ENGINES
+} aesm_engine_t;
+
+typedef struct {
+    aesm_engine_t engine;
+    uint8_t tag[16];    // tag challenge, ek(rndB)
+    uint8_t rdr[32];    // reader response, ek(rndA || rndB')
+} aesm_ctx_t;
+
+bool aesm_engine_supported(aesm_engine_t engine);
+aesm_engine_t aesm_best_engine(void);
+const char *aesm_engine_name(aesm_engine_t engine);
+
+void aesm_init(aesm_ctx_t *ctx, aesm_engine_t engine, const uint8_t tag[16], const uint8_t rdr[32]);
+
+// keys holds n keys of 16 bytes, n <= AESM_LANES.
+// Returns a bitmask, bit i set when keys[i] matches.
+uint32_t aesm_check(const aesm_ctx_t *ctx, const uint8_t *keys, uint32_t n);
+
+#endif
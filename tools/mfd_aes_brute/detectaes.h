@@ -42,6 +42,25 @@ static bool platform_aes_hw_available(void) {
     return (CPUInfo[2] & (1 << 25)) != 0 && (CPUInfo[2] & (1 << 19)) != 0; /* Check AES and SSE4.1 */
 }
 
+static inline bool platform_vaes_hw_available(void) {
+    unsigned int CPUInfo[4];
+    if (platform_aes_hw_available() == false || __get_cpuid_max(0, NULL) < 7)
+        return false;
+
+    /* OS must save the AVX-512 state: OSXSAVE, then XCR0 SSE, AVX, opmask, ZMM */
+    __cpuid(1, CPUInfo[0], CPUInfo[1], CPUInfo[2], CPUInfo[3]);
+    if ((CPUInfo[2] & (1 << 27)) == 0)
+        return false;
+
+    unsigned int xcr0_lo, xcr0_hi;
+    __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 0xE6) != 0xE6)
+        return false;
+
+    __cpuid_count(7, 0, CPUInfo[0], CPUInfo[1], CPUInfo[2], CPUInfo[3]);
+    return (CPUInfo[1] & (1 << 16)) != 0 && (CPUInfo[1] & (1 << 30)) != 0 && (CPUInfo[2] & (1 << 9)) != 0; /* Check AVX512F, AVX512BW and VAES */
+}
+
 #else /* defined(__clang__) || defined(__GNUC__) */
 
 static bool platform_aes_hw_available(void) {
@@ -50,6 +69,10 @@ static bool platform_aes_hw_available(void) {
     return (CPUInfo[2] & (1 << 25)) != 0 && (CPUInfo[2] & (1 << 19)) != 0; /* Check AES and SSE4.1 */
 }
 
+static inline bool platform_vaes_hw_available(void) {
+    return false;
+}
+
 #endif /* defined(__clang__) || defined(__GNUC__) */
 
 #else /* defined(__x86_64__) || defined(__i386) */
@@ -69,4 +92,8 @@ static bool platform_aes_hw_available(void) {
 #endif
 }
 
+static inline bool platform_vaes_hw_available(void) {
+    return false;
+}
+
 #endif /* defined(__x86_64__) || defined(__i386) */
@@ -27,14 +27,13 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <limits.h>
-#include <openssl/evp.h>
-#include <openssl/err.h>
 #include <string.h>
 #include <time.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <inttypes.h>
 #include "util_posix.h"
+#include "aes_multi.h"
 
 #define AEND  "\x1b[0m"
 #define _RED_(s) "\x1b[31m" s AEND
@@ -57,50 +56,24 @@ typedef struct thread_args {
     uint8_t rdr[32];
 } targs;
 
-static void make_key(uint32_t seed, uint8_t key[]) {
+// Telenot's Borland style key generator, for AESM_LANES consecutive seeds at a time
+static void make_keys(uint32_t seed, uint8_t keys[], uint32_t n) {
 
-    uint32_t lseed = seed;
-    lseed = (lseed * 22695477) % UINT_MAX;
-    lseed = (lseed + 1) % UINT_MAX;
+    uint32_t lseed[AESM_LANES];
+    for (uint32_t l = 0; l < n; l++) {
+        lseed[l] = ((seed + l) * 22695477) % UINT_MAX;
+        lseed[l] = (lseed[l] + 1) % UINT_MAX;
+    }
 
     for (int i = 0; i < 16; i++) {
-        lseed = (lseed * 22695477) % UINT_MAX;
-        lseed = (lseed + 1) % UINT_MAX;
-        key[i] = ((lseed >> 16) & 0x7fff) % 0xFF;
+        for (uint32_t l = 0; l < n; l++) {
+            lseed[l] = (lseed[l] * 22695477) % UINT_MAX;
+            lseed[l] = (lseed[l] + 1) % UINT_MAX;
+            keys[(l * 16) + i] = ((lseed[l] >> 16) & 0x7fff) % 0xFF;
+        }
     }
 }
 
-static void handleErrors(void) {
-    ERR_print_errors_fp(stderr);
-    abort();
-}
-
-// source https://wiki.openssl.org/index.php/EVP_Symmetric_Encryption_and_Decryption#Decrypting_the_Message
-static int decrypt_aes(uint8_t ciphertext[], int ciphertext_len, uint8_t key[], uint8_t iv[], uint8_t plaintext[]) {
-    EVP_CIPHER_CTX *ctx;
-    if (!(ctx = EVP_CIPHER_CTX_new()))
-        handleErrors();
-
-    if (1 != EVP_DecryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, key, iv))
-        handleErrors();
-
-    EVP_CIPHER_CTX_set_padding(ctx, 0);
-
-    int len = 0;
-    if (1 != EVP_DecryptUpdate(ctx, plaintext, &len, ciphertext, ciphertext_len))
-        handleErrors();
-
-    int plaintext_len = len;
-
-    if (1 != EVP_DecryptFinal_ex(ctx, plaintext + len, &len))
-        handleErrors();
-
-    plaintext_len += len;
-
-    EVP_CIPHER_CTX_free(ctx);
-    return plaintext_len;
-}
-
 static int hexstr_to_byte_array(char hexstr[], uint8_t bytes[], size_t byte_len) {
     size_t hexstr_len = strlen(hexstr);
     if (hexstr_len % 16) {
@@ -154,48 +127,28 @@ static void *brute_thread(void *arguments) {
     struct thread_args *args = (struct thread_args *) arguments;
 
     uint64_t starttime = args->starttime;
-
     uint64_t stoptime = args->stoptime;
-    uint8_t local_tag[16];
-    uint8_t local_rdr[32];
-    memcpy(local_tag, args->tag, 16);
-    memcpy(local_rdr, args->rdr, 32);
+    const uint64_t stride = (uint64_t)thread_count * AESM_LANES;
+
+    aesm_ctx_t ctx;
+    aesm_init(&ctx, aesm_best_engine(), args->tag, args->rdr);
 
-    for (uint64_t i = starttime + args->idx; i < stoptime; i += thread_count) {
+    uint8_t keys[AESM_LANES * 16];
+
+    // each thread takes every thread_count'th batch of AESM_LANES timestamps
+    for (uint64_t i = starttime + ((uint64_t)args->idx * AESM_LANES); i < stoptime; i += stride) {
 
         if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1) {
             break;
         }
 
-        uint8_t key[16] = {0x00};
-        make_key(i, key);
-
-        uint8_t iv[16] = {0x00};
-        uint8_t dec_tag[16] = {0x00};
-        decrypt_aes(local_tag, 16, key, iv, dec_tag);
-
-        uint8_t dec_rdr[32] = {0x00};
-        decrypt_aes(local_rdr, 32, key, local_tag, dec_rdr);
-
-        // check rol byte first
-        if (dec_tag[0] != dec_rdr[31]) continue;
-
-        // compare rest
-        if (dec_tag[1] != dec_rdr[16]) continue;
-        if (dec_tag[2] != dec_rdr[17]) continue;
-        if (dec_tag[3] != dec_rdr[18]) continue;
-        if (dec_tag[4] != dec_rdr[19]) continue;
-        if (dec_tag[5] != dec_rdr[20]) continue;
-        if (dec_tag[6] != dec_rdr[21]) continue;
-        if (dec_tag[7] != dec_rdr[22]) continue;
-        if (dec_tag[8] != dec_rdr[23]) continue;
-        if (dec_tag[9] != dec_rdr[24]) continue;
-        if (dec_tag[10] != dec_rdr[25]) continue;
-        if (dec_tag[11] != dec_rdr[26]) continue;
-        if (dec_tag[12] != dec_rdr[27]) continue;
-        if (dec_tag[13] != dec_rdr[28]) continue;
-        if (dec_tag[14] != dec_rdr[29]) continue;
-        if (dec_tag[15] != dec_rdr[30]) continue;
+        uint32_t n = ((stoptime - i) < AESM_LANES) ? (uint32_t)(stoptime - i) : AESM_LANES;
+        make_keys(i, keys, n);
+
+        uint32_t hits = aesm_check(&ctx, keys, n);
+        if (hits == 0) continue;
+
+        int l = __builtin_ctz(hits);
 
         __sync_fetch_and_add(&global_found, 1);
 
@@ -203,10 +156,10 @@ static void *brute_thread(void *arguments) {
         pthread_mutex_lock(&print_lock);
 
         printf("Found timestamp........ ");
-        print_time(i);
+        print_time(i + l);
 
         printf("key.................... \x1b[32m");
-        print_hex(key, sizeof(key));
+        print_hex(keys + (l * 16), 16);
         printf(AEND);
 
         pthread_mutex_unlock(&print_lock);
@@ -257,6 +210,9 @@ int main(int argc, char *argv[]) {
     printf("Rdr Resp & Challenge... ");
     print_hex(rdr_resp_challenge, sizeof(rdr_resp_challenge));
 
+    printf("AES engine............. ");
+    printf(_GREEN_("%s") "\n", aesm_engine_name(aesm_best_engine()));
+
 
     uint64_t t1 = msclock();
 
@@ -40,12 +40,7 @@
 #include "util_posix.h"
 #include "randoms.h"
 
-#include "aes-ni.h"
-
-#if defined(__APPLE__) || defined(__MACH__)
-#else
-#include "detectaes.h"
-#endif
+#include "aes_multi.h"
 
 
 #define AEND  "\x1b[0m"
@@ -56,14 +51,14 @@
 
 
 static generator_t generators[] = {
-    {"Borland",      make_key_borland_n},
-    {"Recipies",     make_key_recipies_n},
-    {"GlibC",        make_key_glibc_n},
-    {"AnsiC",        make_key_ansic_n},
-    {"Turbo Pascal", make_key_turbopascal_n},
-    {"posix rand_r",          make_key_posix_rand_r_n},
-    {"MS Visual/Quick C/C++",  make_key_ms_rand_r_n},
-    {NULL, NULL}
+    {"Borland",      make_key_borland_n, make_key_borland_batch},
+    {"Recipies",     make_key_recipies_n, make_key_recipies_batch},
+    {"GlibC",        make_key_glibc_n, make_key_glibc_batch},
+    {"AnsiC",        make_key_ansic_n, make_key_ansic_batch},
+    {"Turbo Pascal", make_key_turbopascal_n, make_key_turbopascal_batch},
+    {"posix rand_r",          make_key_posix_rand_r_n, make_key_posix_rand_r_batch},
+    {"MS Visual/Quick C/C++",  make_key_ms_rand_r_n, make_key_ms_rand_r_batch},
+    {NULL, NULL, NULL}
 };
 
 #define ARRAYLEN(x) (sizeof(x)/sizeof((x)[0]))
@@ -74,6 +69,9 @@ pthread_mutex_t print_lock;
 static int global_found = 0;
 static int thread_count = 2;
 
+// AES challenge and engine shared by all threads
+static aesm_ctx_t aes_ctx;
+
 typedef struct thread_args {
     int thread;
     int idx;
@@ -86,17 +84,6 @@ typedef struct thread_args {
 } targs;
 
 
-// source https://wiki.openssl.org/index.php/EVP_Symmetric_Encryption_and_Decryption#Decrypting_the_Message
-static void decrypt_aes(uint8_t ciphertext[], int ciphertext_len, uint8_t key[], uint8_t iv[], uint8_t plaintext[]) {
-    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
-    EVP_DecryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, key, iv);
-//    EVP_CIPHER_CTX_set_padding(ctx, 0);
-    int len = 0;
-    EVP_DecryptUpdate(ctx, plaintext, &len, ciphertext, ciphertext_len);
-    EVP_DecryptFinal_ex(ctx, plaintext + len, &len);
-    EVP_CIPHER_CTX_free(ctx);
-}
-
 static void decrypt_3kdes(uint8_t ciphertext[], int ciphertext_len, uint8_t key[], uint8_t iv[], uint8_t plaintext[]) {
     EVP_CIPHER_CTX *ctx;
     ctx = EVP_CIPHER_CTX_new();
@@ -181,8 +168,6 @@ static void print_time(uint64_t at) {
 
 static void *brute_thread(void *arguments) {
 
-    //const bool support_aesni = platform_aes_hw_available();
-
     struct thread_args *args = (struct thread_args *) arguments;
 
     uint64_t starttime = args->starttime;
@@ -283,29 +268,6 @@ static void *brute_thread(void *arguments) {
             if (dec_tag[14] != dec_rdr[29]) continue;
             if (dec_tag[15] != dec_rdr[30]) continue;
 
-        } else if (local_algo == 3) {
-            decrypt_aes(local_tag, 16, key, iv, dec_tag);
-            decrypt_aes(local_rdr, 32, key, local_tag, dec_rdr);
-
-            // check rol byte first
-            if (dec_tag[0] != dec_rdr[31]) continue;
-
-            // compare rest
-            if (dec_tag[1] != dec_rdr[16]) continue;
-            if (dec_tag[2] != dec_rdr[17]) continue;
-            if (dec_tag[3] != dec_rdr[18]) continue;
-            if (dec_tag[4] != dec_rdr[19]) continue;
-            if (dec_tag[5] != dec_rdr[20]) continue;
-            if (dec_tag[6] != dec_rdr[21]) continue;
-            if (dec_tag[7] != dec_rdr[22]) continue;
-            if (dec_tag[8] != dec_rdr[23]) continue;
-            if (dec_tag[9] != dec_rdr[24]) continue;
-            if (dec_tag[10] != dec_rdr[25]) continue;
-            if (dec_tag[11] != dec_rdr[26]) continue;
-            if (dec_tag[12] != dec_rdr[27]) continue;
-            if (dec_tag[13] != dec_rdr[28]) continue;
-            if (dec_tag[14] != dec_rdr[29]) continue;
-            if (dec_tag[15] != dec_rdr[30]) continue;
         }
 
         __sync_fetch_and_add(&global_found, 1);
@@ -326,6 +288,130 @@ static void *brute_thread(void *arguments) {
     return NULL;
 }
 
+// AES keys are generated and checked AESM_LANES consecutive seeds at a time,
+// each thread takes every thread_count'th batch.
+static void *brute_thread_aes(void *arguments) {
+
+    struct thread_args *args = (struct thread_args *) arguments;
+    const generator_t *gen = &generators[args->generator_idx];
+    const uint64_t stride = (uint64_t)thread_count * AESM_LANES;
+    uint8_t keys[AESM_LANES * 16];
+
+    for (uint64_t i = args->starttime + ((uint64_t)args->idx * AESM_LANES); i < args->stoptime; i += stride) {
+
+        if (__atomic_load_n(&global_found, __ATOMIC_ACQUIRE) == 1) {
+            break;
+        }
+
+        uint32_t n = ((args->stoptime - i) < AESM_LANES) ? (uint32_t)(args->stoptime - i) : AESM_LANES;
+        gen->ParseBatch(i, keys, 16, n);
+
+        uint32_t hits = aesm_check(&aes_ctx, keys, n);
+        if (hits == 0) continue;
+
+        int l = __builtin_ctz(hits);
+
+        __sync_fetch_and_add(&global_found, 1);
+
+        // lock this section to avoid interlacing prints from different threats
+        pthread_mutex_lock(&print_lock);
+        printf("Found timestamp........ ");
+        print_time(i + l);
+
+        printf("Key.................... \x1b[32m");
+        print_hex(keys + (l * 16), 16);
+        printf(AEND);
+
+        pthread_mutex_unlock(&print_lock);
+        break;
+    }
+    free(args);
+    return NULL;
+}
+
+// DESFire AES authentication as the reader would send it for key
+static void make_aes_challenge(const uint8_t key[16], uint8_t tag[16], uint8_t rdr[32]) {
+    const uint8_t rnd_a[16] = { 0x13, 0x37, 0xC0, 0xDE, 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB };
+    const uint8_t rnd_b[16] = { 0xB0, 0x0B, 0xFA, 0xCE, 0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF, 0xFE, 0xDC, 0xBA, 0x98 };
+    uint8_t plain[32];
+    uint8_t iv[16] = {0x00};
+    int len = 0;
+
+    memcpy(plain, rnd_a, 16);
+    memcpy(plain + 16, rnd_b + 1, 15);
+    plain[31] = rnd_b[0];
+
+    EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+    EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, key, iv);
+    EVP_CIPHER_CTX_set_padding(ctx, 0);
+    EVP_EncryptUpdate(ctx, tag, &len, rnd_b, 16);
+
+    EVP_EncryptInit_ex(ctx, EVP_aes_128_cbc(), NULL, key, tag);
+    EVP_CIPHER_CTX_set_padding(ctx, 0);
+    EVP_EncryptUpdate(ctx, rdr, &len, plain, 32);
+    EVP_CIPHER_CTX_free(ctx);
+}
+
+// Single thread speed of every AES engine, generator included. Each engine
+// searches a range holding one planted key, which it must find, and no other key.
+static int bench(uint8_t g_idx) {
+
+    const uint64_t start = 1600000000;
+    const generator_t *gen = &generators[g_idx];
+    bool ok = true;
+
+    printf("LCR Random generator... " _GREEN_("%s") "\n", gen->Name);
+    printf("Best AES engine........ " _GREEN_("%s") "\n\n", aesm_engine_name(aesm_best_engine()));
+
+    for (int e = AESM_OPENSSL; e < AESM_ENGINES; e++) {
+
+        if (aesm_engine_supported(e) == false) {
+            printf("  %-12s not supported\n", aesm_engine_name(e));
+            continue;
+        }
+
+        // not a multiple of AESM_LANES, the last batch is a short one
+        uint64_t count = ((e == AESM_OPENSSL) ? (1 << 18) : (1 << 22)) + 5;
+        uint64_t planted = start + count - 2;
+
+        uint8_t key[16], tag[16], rdr[32];
+        gen->Parse(planted, key, sizeof(key));
+        make_aes_challenge(key, tag, rdr);
+
+        aesm_ctx_t ctx;
+        aesm_init(&ctx, e, tag, rdr);
+
+        uint8_t keys[AESM_LANES * 16];
+        bool found = false, wrong = false;
+        uint64_t t1 = msclock();
+
+        for (uint64_t i = start; i < start + count; i += AESM_LANES) {
+            uint32_t n = ((start + count - i) < AESM_LANES) ? (uint32_t)(start + count - i) : AESM_LANES;
+            gen->ParseBatch(i, keys, 16, n);
+
+            // weak generators repeat keys, a hit is only wrong if its key differs
+            uint32_t m = aesm_check(&ctx, keys, n);
+            while (m) {
+                int l = __builtin_ctz(m);
+                found |= ((i + l) == planted);
+                wrong |= (memcmp(keys + (l * 16), key, sizeof(key)) != 0);
+                m &= m - 1;
+            }
+        }
+
+        t1 = msclock() - t1;
+        bool pass = (found && wrong == false);
+        ok &= pass;
+
+        printf("  %-12s " _YELLOW_("%8.2f") " Mkeys/s  %s\n", aesm_engine_name(e),
+               (t1 > 0) ? ((double)count / 1000.0) / (double)t1 : 0.0,
+               (pass) ? _GREEN_("ok") : _RED_("fail"));
+    }
+
+    printf("\nSelf test.............. %s\n", (ok) ? _GREEN_("ok") : _RED_("fail"));
+    return (ok) ? 0 : 1;
+}
+
 static int usage(const char *s) {
 
     printf("\n");
@@ -335,9 +421,11 @@ static int usage(const char *s) {
     printf("This version is multi-threaded, multi-crypto support and multi LCG generator support.\n");
     printf("\n");
     printf(_CYAN_("syntax") "\n");
-    printf("  %s <crypto algo> <generator> <unix timestamp> <16 byte tag challenge> <32 byte reader response challenge>\n\n", s);
+    printf("  %s <crypto algo> <generator> <unix timestamp> <16 byte tag challenge> <32 byte reader response challenge>\n", s);
+    printf("  %s bench [generator]\n\n", s);
     printf("     crypt algo -  <DES|2KDES|3KDES|AES>\n");
-    printf("     generator  -  <0-5>\n");
+    printf("     generator  -  <0-6>\n");
+    printf("     bench      -  AES keys/s of every engine on this CPU, and a self test\n");
     printf("\n");
     printf(_CYAN_("samples") "\n");
     printf("     %s DES 0 1599999999 118565f6e5e6c839 d570fd1578079e6b22aaa187b99f0a2a\n", s);
@@ -350,6 +438,15 @@ static int usage(const char *s) {
 
 int main(int argc, char *argv[]) {
 
+    if (argc >= 2 && argc <= 3 && strcasecmp(argv[1], "bench") == 0) {
+        uint8_t g_idx = (argc == 3) ? atoi(argv[2]) : 0;
+        if (g_idx > ARRAYLEN(generators) - 2) {
+            printf("generator index is out-of-range\n");
+            return 1;
+        }
+        return bench(g_idx);
+    }
+
     if (argc != 6) {
         return usage(argv[0]);
     }
@@ -390,11 +487,9 @@ int main(int argc, char *argv[]) {
     printf("Crypto algo............ " _GREEN_("%s") "\n", algostr);
     printf("LCR Random generator... " _GREEN_("%s") "\n", generators[g_idx].Name);
 
-#if defined(__APPLE__) || defined(__MACH__)
-#else
-    bool support_aesni = platform_aes_hw_available();
-    printf("AES-NI detected........ " _GREEN_("%s") "\n", (support_aesni) ? "yes" : "no");
-#endif
+    if (algo == 3) {
+        printf("AES engine............. " _GREEN_("%s") "\n", aesm_engine_name(aesm_best_engine()));
+    }
 
     printf("Starting timestamp..... ");
     print_time(start_time);
@@ -449,6 +544,8 @@ int main(int argc, char *argv[]) {
 
         printf("Rdr Resp & Challenge... ");
         print_hex(rdr_resp_challenge, 32);
+
+        aesm_init(&aes_ctx, aesm_best_engine(), tag_challenge, rdr_resp_challenge);
     }
 
     uint64_t t1 = msclock();
@@ -496,7 +593,7 @@ int main(int argc, char *argv[]) {
             memcpy(a->rdr, rdr_resp_challenge, 32);
         }
 
-        pthread_create(&threads[i], NULL, brute_thread, (void *)a);
+        pthread_create(&threads[i], NULL, (algo == 3) ? brute_thread_aes : brute_thread, (void *)a);
     }
 
     // wait for threads to terminate:
@@ -99,3 +99,74 @@ void make_key_ms_rand_r_n(uint32_t seed, uint8_t key[], const size_t keylen) {
         key[i] = ((lseed >> 16) & 0x7FFF);
     }
 }
+
+// Batched generators, the keys of up to RAND_BATCH_MAX consecutive seeds at a time.
+// Each step below produces the same byte as its _n counterpart above, the lane
+// loop is innermost so the compiler can run all seeds through one vector LCG.
+
+static inline uint8_t borland_step(uint32_t *s) {
+    *s = ((*s * 22695477U) + 1) % UINT_MAX;
+    return ((*s >> 16) & 0x7fff) % 0xFF;
+}
+
+static inline uint8_t recipies_step(uint32_t *s) {
+    *s = ((*s * 1664525U) + 1013904223U) % UINT_MAX;
+    return (*s % 0xFF);
+}
+
+static inline uint8_t glibc_step(uint32_t *s) {
+    *s = ((*s * 1103515245U) + 12345U) & 0x7fffffff;
+    return (*s & 0xFF);
+}
+
+static inline uint8_t ansic_step(uint32_t *s) {
+    *s = ((*s * 1103515245U) + 12345U) & 0x7fffffff;
+    return ((*s >> 16) & 0x7fff) & 0xFF;
+}
+
+static inline uint8_t turbopascal_step(uint32_t *s) {
+    *s = ((*s * 134775813) + 1) % UINT_MAX;
+    return (*s % 0xFF);
+}
+
+static inline uint8_t posix_rand_r_step(uint32_t *s) {
+    *s = (*s * 1103515245) + 12345;
+    int result = (uint16_t)(*s / 0x10000) % 2048;
+
+    *s = (*s * 1103515245) + 12345;
+    result <<= 10;
+    result ^= (uint16_t)(*s / 0x10000) % 1024;
+
+    *s = (*s * 1103515245) + 12345;
+    result <<= 10;
+    result ^= (uint16_t)(*s / 0x10000) % 1024;
+
+    return (result % 0xFF);
+}
+
+static inline uint8_t ms_rand_r_step(uint32_t *s) {
+    *s = ((*s * 214013L) + 2531011L);
+    return ((*s >> 16) & 0x7FFF);
+}
+
+#define MAKE_KEY_BATCH(name, first) \
+    void make_key_##name##_batch(uint32_t seed, uint8_t keys[], const size_t keylen, const size_t n) { \
+        uint32_t lseed[RAND_BATCH_MAX]; \
+        for (size_t l = 0; l < n; l++) { \
+            uint32_t s = seed + l; \
+            lseed[l] = (first); \
+        } \
+        for (size_t i = 0; i < keylen; i++) { \
+            for (size_t l = 0; l < n; l++) { \
+                keys[(l * keylen) + i] = name##_step(&lseed[l]); \
+            } \
+        } \
+    }
+
+MAKE_KEY_BATCH(borland, ((s * 22695477U) + 1) % UINT_MAX)
+MAKE_KEY_BATCH(recipies, s)
+MAKE_KEY_BATCH(glibc, s)
+MAKE_KEY_BATCH(ansic, s)
+MAKE_KEY_BATCH(turbopascal, s)
+MAKE_KEY_BATCH(posix_rand_r, s)
+MAKE_KEY_BATCH(ms_rand_r, s)
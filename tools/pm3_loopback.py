@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+#+---------------------------------------------------------------------------+
+#|    Loopback : a Proxmark3 stand-in to exercise the client comms without   |
+#|               hardware                                                    |
+#+---------------------------------------------------------------------------+
+#| This program is free software: you can redistribute it and/or modify      |
+#| it under the terms of the GNU General Public License as published by      |
+#| the Free Software Foundation, either version 3 of the License, or         |
+#| (at your option) any later version.                                       |
+#|                                                                           |
+#| This program is distributed in the hope that it will be useful,           |
+#| but WITHOUT ANY WARRANTY; without even the implied warranty of            |
+#| MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the              |
+#| GNU General Public License for more details.                              |
+#|                                                                           |
+#| You should have received a copy of the GNU General Public License         |
+#| along with this program. If not, see <http://www.gnu.org/licenses/>.      |
+#+---------------------------------------------------------------------------+
+#
+# Listens on a local TCP port, speaks NG and tagged NG frames like the
+# firmware does (see include/pm3_cmd.h) and runs the client against it:
+#
+#   tools/pm3_loopback.py ./client/proxmark3 [client options]
+#
+# Replies to tagged commands which arrive together are sent in reverse order,
+# the client has to match them by their tag. BigBuf downloads asking for LZ4
+# are packed like the firmware does (common/lz4chunk.c), through the liblz4
+# the client links against.
+
+import ctypes
+import ctypes.util
+import random
+import re
+import socket
+import struct
+import subprocess
+import sys
+import threading
+
+COMMANDNG_PREAMBLE_MAGIC = 0x61334d50   # PM3a
+COMMANDNG_TAGGED_MAGIC = 0x63334d50     # PM3c
+RESPONSENG_PREAMBLE_MAGIC = 0x62334d50  # PM3b
+RESPONSENG_TAGGED_MAGIC = 0x64334d50    # PM3d
+RESPONSENG_POSTAMBLE_MAGIC = 0x3362     # b3
+
+CAPABILITIES_VERSION = 8
+
+CMD_ACK = 0x00ff
+CMD_PING = 0x0109
+CMD_CAPABILITIES = 0x0112
+CMD_DOWNLOAD_BIGBUF = 0x0207
+CMD_DOWNLOADED_BIGBUF = 0x0208
+
+PM3_CMD_DATA_SIZE = 512
+BIGBUF_SIZE = 40000
+
+DOWNLOAD_FLAG_LZ4 = 1 << 0
+LZ4CHUNK_PAYLOAD_SIZE = PM3_CMD_DATA_SIZE - 24
+LZ4CHUNK_STORED = 0x00
+LZ4CHUNK_LZ4 = 0x01
+
+
+def load_lz4():
+    name = ctypes.util.find_library('lz4')
+    if name is None:
+        return None
+    try:
+        lib = ctypes.CDLL(name)
+    except OSError:
+        return None
+    lib.LZ4_compress_destSize.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.POINTER(ctypes.c_int), ctypes.c_int]
+    lib.LZ4_compress_destSize.restype = ctypes.c_int
+    return lib
+
+
+LZ4 = load_lz4()
+
+
+def lz4chunk_pack(src):
+    # same as lz4chunk_pack(), a type byte then the LZ4 block, or the raw bytes when compressing doesn't pay off
+    dst = ctypes.create_string_buffer(LZ4CHUNK_PAYLOAD_SIZE - 1)
+    consumed = ctypes.c_int(len(src))
+    n = LZ4.LZ4_compress_destSize(src, dst, ctypes.byref(consumed), LZ4CHUNK_PAYLOAD_SIZE - 1)
+    if 0 < n < consumed.value:
+        return bytes([LZ4CHUNK_LZ4]) + dst.raw[:n], consumed.value
+    raw = src[:LZ4CHUNK_PAYLOAD_SIZE - 1]
+    return bytes([LZ4CHUNK_STORED]) + raw, len(raw)
+
+
+def crc14443a(data):
+    crc = 0x6363
+    for b in data:
+        b ^= crc & 0xff
+        b = (b ^ (b << 4)) & 0xff
+        crc = (crc >> 8) ^ (b << 8) ^ (b << 3) ^ (b >> 4)
+    return ((crc & 0xff) << 8) | (crc >> 8)
+
+
+def reply_ng(cmd, data, seq=0, ng=True, status=0):
+    length = len(data) | (0x8000 if ng else 0)
+    magic = RESPONSENG_TAGGED_MAGIC if seq else RESPONSENG_PREAMBLE_MAGIC
+    frame = struct.pack('<IHbbH', magic, length, status, 0, cmd)
+    if seq:
+        frame += struct.pack('<H', seq)
+    frame += data
+    return frame + struct.pack('<H', RESPONSENG_POSTAMBLE_MAGIC)
+
+
+def reply_old(cmd, arg0, arg1, arg2, data):
+    return struct.pack('<QQQQ', cmd, arg0, arg1, arg2) + data.ljust(PM3_CMD_DATA_SIZE, b'\0')
+
+
+def capabilities():
+    # version, baudrate, bigbuf_size, then the bit fields: via_usb, nothing compiled in, tagged_frames,
+    # compressed_download, coalesced_frames
+    bits = (1 << 1) | (1 << 25) | (1 << 27)
+    if LZ4 is not None:
+        bits |= 1 << 26
+    return struct.pack('<BII', CAPABILITIES_VERSION, 0, BIGBUF_SIZE) + struct.pack('<I', bits)
+
+
+class Device:
+
+    def __init__(self):
+        # something like LF samples, with a stretch of noise in every 4 kB
+        rnd = random.Random(1)
+        self.bigbuf = bytes(rnd.getrandbits(8) if (i % 4096) >= 3072 else (0xb0 if (i // 32) & 1 else 0x40) + rnd.randint(0, 1)
+                            for i in range(BIGBUF_SIZE))
+        self.lz4_plain = 0
+        self.lz4_wire = 0
+        self.tagged = 0
+        self.reordered = 0
+        self.crc_errors = 0
+
+    def answer(self, cmd, seq, ng, data):
+        if cmd == CMD_PING:
+            return reply_ng(CMD_PING, data, seq)
+        if cmd == CMD_CAPABILITIES:
+            return reply_ng(CMD_CAPABILITIES, capabilities(), seq)
+        if cmd == CMD_DOWNLOAD_BIGBUF and ng is False:
+            start, length, flags = struct.unpack('<QQQ', data[:24])
+            out = b''
+            if flags & DOWNLOAD_FLAG_LZ4:
+                offset = 0
+                while offset < length:
+                    payload, n = lz4chunk_pack(self.bigbuf[start + offset:start + length])
+                    out += reply_ng(CMD_DOWNLOADED_BIGBUF, struct.pack('<QQQ', offset, n, 0) + payload, ng=False)
+                    self.lz4_plain += n
+                    self.lz4_wire += len(payload)
+                    offset += n
+                return out + reply_ng(CMD_ACK, struct.pack('<QQQ', 1, 0, 0), seq, ng=False)
+            for offset in range(0, length, PM3_CMD_DATA_SIZE):
+                n = min(PM3_CMD_DATA_SIZE, length - offset)
+                out += reply_old(CMD_DOWNLOADED_BIGBUF, offset, n, 0, self.bigbuf[start + offset:start + offset + n])
+            return out + reply_ng(CMD_ACK, struct.pack('<QQQ', 1, 0, 0), seq, ng=False)
+        # anything else is answered with an empty reply
+        return reply_ng(cmd, b'', seq)
+
+    def serve(self, conn):
+        buf = b''
+        while True:
+            chunk = conn.recv(65536)
+            if not chunk:
+                return
+            buf += chunk
+
+            ordered = []
+            tagged = []
+            while len(buf) >= 8:
+                magic, length, cmd = struct.unpack('<IHH', buf[:8])
+                if magic not in (COMMANDNG_PREAMBLE_MAGIC, COMMANDNG_TAGGED_MAGIC):
+                    buf = buf[1:]
+                    continue
+                taglen = 2 if magic == COMMANDNG_TAGGED_MAGIC else 0
+                n = length & 0x7fff
+                if len(buf) < 8 + taglen + n + 2:
+                    break
+                frame = buf[:8 + taglen + n]
+                crc, = struct.unpack('<H', buf[8 + taglen + n:8 + taglen + n + 2])
+                buf = buf[8 + taglen + n + 2:]
+                if crc != 0x3361 and crc != crc14443a(frame):
+                    self.crc_errors += 1
+                    continue
+                seq = struct.unpack('<H', frame[8:10])[0] if taglen else 0
+                reply = self.answer(cmd, seq, bool(length & 0x8000), frame[8 + taglen:])
+                if seq:
+                    self.tagged += 1
+                    tagged.append(reply)
+                else:
+                    ordered.append(reply)
+
+            # tagged replies may complete in any order
+            if len(tagged) > 1:
+                self.reordered += len(tagged)
+            conn.sendall(b''.join(ordered) + b''.join(reversed(tagged)))
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(f"Usage: {sys.argv[0]} <proxmark3 client> [client options]")
+        return 1
+
+    srv = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    srv.bind(('127.0.0.1', 0))
+    srv.listen(1)
+    port = srv.getsockname()[1]
+
+    dev = Device()
+
+    def accept():
+        conn, _ = srv.accept()
+        conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        with conn:
+            dev.serve(conn)
+
+    threading.Thread(target=accept, daemon=True).start()
+
+    cmd = sys.argv[1:] + ['-p', f'tcp:127.0.0.1:{port}', '-c', 'hw bench -n 16 --len 4096']
+    res = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, timeout=60)
+    out = re.sub(r'\x1b\[[0-9;]*m', '', res.stdout.decode(errors='replace'))
+    print(out)
+
+    ok = re.search(r'Pipelined.*, tagged replies, coalesced writes \( ok \)', out) is not None
+    ok = ok and 'Throughput' in out and dev.reordered > 0 and dev.crc_errors == 0
+    if LZ4 is not None:
+        ok = ok and re.search(r'Download LZ4.*\( ok \)', out) is not None
+    print(f"Loopback: {dev.tagged} tagged commands, {dev.reordered} answered out of order, {dev.crc_errors} CRC errors")
+    if dev.lz4_plain:
+        print(f"Loopback: LZ4 downloads, {dev.lz4_plain} bytes sent as {dev.lz4_wire} ( {100 * dev.lz4_wire / dev.lz4_plain:.0f}% )")
+    print(f"Loopback test ( {'ok' if ok else 'fail'} )")
+    return 0 if ok else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
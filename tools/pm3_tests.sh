@@ -344,6 +344,10 @@ while true; do
       if ! CheckFileExist "mfd_aes_brute exists"          "$MFDASEBRUTEBIN"; then break; fi
       if ! CheckExecute      "mfd_aes_brute test 1/2"         "$MFDASEBRUTEBIN 1629394800 bb6aea729414a5b1eff7b16328ce37fd 82f5f498dbc29f7570102397a2e5ef2b6dc14a864f665b3c54d11765af81e95c" "key.................... .*261C07A23F2BC8262F69F10A5BDF3764"; then break; fi
       if ! CheckExecute slow "mfd_aes_brute test 2/2"         "$MFDASEBRUTEBIN 1546300800 3fda933e2953ca5e6cfbbf95d1b51ddf 97fe4b5de24188458d102959b888938c988e96fb98469ce7426f50f108eaa583" "key.................... .*E757178E13516A4F3171BC6EA85E165A"; then break; fi
+      echo -e "\n${C_BLUE}Testing mfd_multi_brute:${C_NC} ${MFDMULTIBRUTEBIN:=./tools/mfd_aes_brute/mfd_multi_brute}"
+      if ! CheckFileExist "mfd_multi_brute exists"        "$MFDMULTIBRUTEBIN"; then break; fi
+      if ! CheckExecute      "mfd_multi_brute AES engines"    "$MFDMULTIBRUTEBIN bench" "Self test.............. .*ok"; then break; fi
+      if ! CheckExecute      "mfd_multi_brute AES test"       "$MFDMULTIBRUTEBIN AES 0 1629394800 bb6aea729414a5b1eff7b16328ce37fd 82f5f498dbc29f7570102397a2e5ef2b6dc14a864f665b3c54d11765af81e95c" "Key.................... .*261C07A23F2BC8262F69F10A5BDF3764"; then break; fi
     fi
 
     if $TESTALL || $TESTCRYPTORF; then
@@ -424,6 +428,9 @@ while true; do
       if ! CheckExecute "proxmark multi stdin 2/4"         "echo 'rem foo;rem bar;quit' |$CLIENTBIN" "remark: bar"; then break; fi
       if ! CheckExecute "proxmark multi stdin 3/4"         "echo -e 'rem foo\nrem bar;quit' |$CLIENTBIN" "remark: foo"; then break; fi
       if ! CheckExecute "proxmark multi stdin 4/4"         "echo -e 'rem foo\nrem bar;quit' |$CLIENTBIN" "remark: bar"; then break; fi
+      if ! CheckExecute "proxmark startup profile"         "$CLIENTBIN --startup-profile -c 'rem foo'" "total.*ms"; then break; fi
+      if ! CheckExecute "proxmark trace events"            "$CLIENTBIN --trace-events /tmp/pm3_tests_trace.json -c 'data load -f traces/lf_EM4102-1.pm3; lf em 410x demod' >/dev/null; python3 -m json.tool --compact /tmp/pm3_tests_trace.json; rm -f /tmp/pm3_tests_trace.json" '"cat":"demod","name":"ask"'; then break; fi
+      if ! CheckExecute "proxmark comms loopback"          "tools/pm3_loopback.py $CLIENTBIN 2>&1" "Loopback test \( ok \)"; then break; fi
 
       echo -e "\n${C_BLUE}Testing scripts:${C_NC}"
       if ! CheckExecute "script run cmdscript"             "$CLIENTBIN -c 'script run example.cmd'" "remark: world"; then break; fi
@@ -440,6 +447,7 @@ while true; do
       if ! CheckExecute "reveng -w test"          "$CLIENTBIN -c 'reveng -w 8 -s 01020304e3 010204039d'" "CRC-8/SMBUS"; then break; fi
       if ! CheckExecute "mfu pwdgen test"         "$CLIENTBIN -c 'hf mfu pwdgen --test'" "Selftest ok"; then break; fi
       if ! CheckExecute "mfu keygen test"         "$CLIENTBIN -c 'hf mfu keygen --uid 11223344556677'" "80 B1 C2 71 D8 A0"; then break; fi
+      if ! CheckExecute "lz4 chunk codec test"    "$CLIENTBIN -c 'hw bench --test'" "Tests \( ok \)"; then break; fi
       if ! CheckExecute "jooki encode test"       "$CLIENTBIN -c 'hf jooki encode --test'" "04 28 F4 DA F0 4A 81  \( ok \)"; then break; fi
       if ! CheckExecute "trace load/list 14a"     "$CLIENTBIN -c 'trace load -f traces/hf_14a_mfu.trace; trace list -1 -t 14a;'" "READBLOCK\(8\)"; then break; fi
       if ! CheckExecute "trace load/list x"       "$CLIENTBIN -c 'trace load -f traces/hf_14a_mfu.trace; trace list -x1 -t 14a;'" "0.0101840425"; then break; fi
@@ -450,14 +458,25 @@ while true; do
       if ! CheckExecute "nfc decode test - signature"    "$CLIENTBIN -c 'nfc decode -d 03FF010194113870696C65742E65653A656B616172743A3266195F26063132303832325904202020205F28033233335F2701316E1B5A13333038363439303039303030323636343030355304EBF2CE704103000000AC536967010200803A2448FCA7D354A654A81BD021150D1A152D1DF4D7A55D2B771F12F094EAB6E5E10F2617A2F8DAD4FD38AFF8EA39B71C19BD42618CDA86EE7E144636C8E0E7CFC4096E19C3680E09C78A0CDBC05DA2D698E551D5D709717655E56FE3676880B897D2C70DF5F06ECE07C71435255144F8EE41AF110E7B180DA0E6C22FB8FDEF61800025687474703A2F2F70696C65742E65652F6372742F33303836343930302D303030312E637274FE'" "30864900-0001.crt"; then break; fi
       if ! CheckExecute "wiegand decode test - raw"  "$CLIENTBIN -c 'wiegand decode --raw 2006F623AE'" "FC: 123  CN: 4567  parity \( ok \)"; then break; fi
       if ! CheckExecute "wiegand decode test - new"  "$CLIENTBIN -c 'wiegand decode --new 06BD88EB80'" "FC: 123  CN: 4567  parity \( ok \)"; then break; fi
+      if ! CheckExecute "wiegand decode test - file" "printf '2006F623AE\\n' > wiegand_test.txt; $CLIENTBIN -c 'wiegand decode -f wiegand_test.txt -o wiegand_test.csv' >/dev/null; cat wiegand_test.csv; rm -f wiegand_test.txt wiegand_test.csv" "2006F623AE,26,H10301,123,4567,0,0,ok"; then break; fi
 
       echo -e "\n${C_BLUE}Testing LF:${C_NC}"
+      if ! CheckExecute "lf demod SIMD kernels test" "$CLIENTBIN -c 'data lfsimd -d traces -n 1'" "Equivalence.*ok"; then break; fi
+      if ! CheckExecute "graph undo redo test" "$CLIENTBIN -c 'data load -f traces/lf_EM4102-1.pm3; data hpf; data norm; data undo -n 2; data redo'" "undo levels 2, redo levels 1"; then break; fi
+      if ! CheckExecute "pm3z save load test" "$CLIENTBIN -c 'data load -f traces/lf_EM4102-1.pm3; data save -z -f /tmp/pm3_tests_pm3z; data load -f /tmp/pm3_tests_pm3z.pm3z; lf em 410x demod'" "EM 410x ID 010872E77C"; then break; fi
       if ! CheckExecute "lf hitag2 test"             "$CLIENTBIN -c 'lf hitag test'" "Tests \( ok"; then break; fi
       if ! CheckExecute "lf cotag demod test"        "$CLIENTBIN -c 'data load -f traces/lf_cotag_220_8331.pm3; data norm; data cthreshold -u 50 -d -20; data envelope; data raw --ar -c 272; lf cotag demod'" \
                                                                      "COTAG Found: FC 220, CN: 8331 Raw: FFB841170363FFFE00001E7F00000000"; then break; fi
       if ! CheckExecute "lf AWID test"               "$CLIENTBIN -c 'data load -f traces/lf_AWID-15-259.pm3;lf search -1'" "AWID ID found"; then break; fi
       if ! CheckExecute "lf EM410x test"             "$CLIENTBIN -c 'data load -f traces/lf_EM4102-1.pm3;lf search -1'" "EM410x ID found"; then break; fi
       if ! CheckExecute "lf EM4x05 test"             "$CLIENTBIN -c 'data load -f traces/lf_EM4x05.pm3;lf search -1'" "FDX-B ID found"; then break; fi
+      if ! CheckExecute "lf PSK1 demod invert test 1/2" "$CLIENTBIN -c 'data load -f traces/lf_Q5_mod-psk1.pm3; data rawdemod --p1; data rawdemod --p1 -i' | grep -A1 'DemodBuffer:' | grep -c ' 10100000101100000000000000010000$'" "^2$"; then break; fi
+      if ! CheckExecute "lf PSK1 demod invert test 2/2" "$CLIENTBIN -c 'data load -f traces/lf_Q5_mod-psk1.pm3; data rawdemod --p1 -i; data rawdemod --p1' | grep -A1 'DemodBuffer:' | grep -c ' 10100000101100000000000000010000$'" "^2$"; then break; fi
+      if ! CheckExecute "lf T55xx detect psk test"   "$CLIENTBIN -c 'data load -f traces/lf_Q5_mod-psk1.pm3; lf t55xx detect -1'" "Block0............ 1014181C \(auto detect\)"; then break; fi
+      if ! CheckExecute "lf T55xx sniff test"        "$CLIENTBIN -c 'data load -f traces/lf_sniff_blue_cloner_em4100.pm3; lf t55xx sniff -1'" "Leading 0 pwd write .* 00000000 .* 00000000 .* 0100000000"; then break; fi
+      if ! CheckExecute "lf EM4x05 sniff test"       "$CLIENTBIN -c 'data load -f traces/lf_sniff_blue_cloner_em4100.pm3; lf em 4x05 sniff -1'" "70696 .* Write .* 0011805F .* 4 "; then break; fi
+      if ! CheckExecute "lf live EM410x test"        "$CLIENTBIN -c 'data load -f traces/lf_EM4102-clamshell.pm3; lf search -1; lf read --live -1' | tr '\n' ' '" "EM 410x ID ([0-9A-F]{10}) .*Live demod: [0-9]+ samples, [0-9]+ windows, 1 ID\(s\).* EM 410x ID \\1 "; then break; fi
+      if ! CheckExecute "lf live HID 4 bps test"     "$CLIENTBIN -c 'data load -f traces/lf_HID-proxCardII-05512-11432784-1.pm3; lf search -1; lf read --live -1 -b 4' | tr '\n' ' '" "raw: ([0-9a-f]{24}) .*Live demod: [0-9]+ samples, [0-9]+ windows, 1 ID\(s\).* HID Prox raw \\1 "; then break; fi
       if ! CheckExecute "lf EM4x70 calc test"        "$CLIENTBIN -c 'lf em 4x70 calc --key F32AA98CF5BE4ADFA6D3480B --rnd 45F54ADA252AAC'" "FRN: 4866BB70  GRN: 9BD180"; then break; fi
       if ! CheckExecute "lf EM4x70 recover test 1/3" "$CLIENTBIN -c 'lf em 4x70 recover --key 022A028C02BE --rnd 7D5167003571F8 --frn 982DBCC0 --grn 36C0E0'" "022a028c02be000102030405"; then break; fi
       if ! CheckExecute "lf EM4x70 recover test 2/3" "$CLIENTBIN -c 'lf em 4x70 recover --key 022A028C02BE --rnd 7D5167003571F8 --frn 982DBCC0 --grn 36C0E0'" "022a028c02be366866191b60"; then break; fi
@@ -571,6 +590,7 @@ while true; do
       if ! CheckExecute "hf mf offline text"               "$CLIENTBIN -c 'hf mf'" "content from tag dump file"; then break; fi
       if ! CheckExecute slow retry ignore "hf mf hardnested long test"  "$CLIENTBIN -c 'hf mf hardnested -t --tk 000000000000'" "found:"; then break; fi
       if ! CheckExecute slow "hf iclass loclass long test" "$CLIENTBIN -c 'hf iclass loclass --long'" "verified \( ok \)"; then break; fi
+      if ! CheckExecute slow "hf cryptorf recover test"   "$CLIENTBIN -c 'hf cryptorf recover --ci ffffffffffffffff --q 1234567812345678 --ch 88c9d4466a501a87 --ci1 dec2ee1b1c9276e9'" "key found \[.*4F794A463FF81D81.*\]"; then break; fi
       if ! CheckExecute slow "emv long test"               "$CLIENTBIN -c 'emv test -l'" "Tests \( ok"; then break; fi
       if ! CheckExecute "hf iclass lookup test"            "$CLIENTBIN -c 'hf iclass lookup --csn 9655a400f8ff12e0 --epurse f0ffffffffffffff --macs 0000000089cb984b -f $DICPATH/iclass_default_keys.dic'" \
                                                                 "valid key AEA684A6DAB23278"; then break; fi